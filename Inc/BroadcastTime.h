@@ -17,6 +17,8 @@
 #ifndef __BroadcastTime_h__
 #define __BroadcastTime_h__
 
+#include <string>
+#include <stdint.h>
 #include <time.h>
 
 /**
@@ -64,8 +66,40 @@ public:
     time_t stamp() const
     { return m_stamp; }
 
+    /**
+     * Offsets of broadcast UTC/local time from system time (valid only if
+     * avail())
+     */
+    time_t utcOffset() const
+    { return m_utcOffset; }
+
+    time_t localOffset() const
+    { return m_localOffset; }
+
     bool avail() const
     { return m_type != None; }
 };
 
+/**
+ * Effective broadcast time as it was sent to clients together with
+ * monotonic time it refers to (so clients can extrapolate it)
+ */
+struct EffectiveBroadcastTime
+{
+    bool valid;
+    bool systemTimeUsed;
+    std::string systemTimeSource;
+    time_t adjustedUtc;
+    time_t local;
+    int64_t monotonicMs; // CLOCK_MONOTONIC when adjustedUtc/local were exact (stops in suspend)
+
+    EffectiveBroadcastTime();
+
+    /**
+     * Check if extrapolation of this sample gives actual one (same time
+     * source and no more than toleranceMs off)
+     */
+    bool predicts(const EffectiveBroadcastTime &actual, int64_t toleranceMs) const;
+};
+
 #endif
@@ -25,18 +25,55 @@
 #ifndef __CLOCKHANDLER_H
 #define __CLOCKHANDLER_H
 
+#include <deque>
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+#include <glib.h>
 #include "SignalSlot.h"
+#include "ClockJournal.h"
 
 struct LSPalmService;
 struct LSHandle;
 struct LSMessage;
 
+namespace pbnjson {
+	class JValue;
+}
+
+/**
+ * Keeps time of all time-sources (clocks) as offsets from system time.
+ *
+ * Updates of automatic time-sources are fused: every clock keeps short
+ * history of its offsets which gives its jitter and age, and system offset
+ * is a weighted (by precision and priority) average of clocks which agree
+ * with each other. Clocks too far from weighted median are rejected as
+ * outliers. Manual and micom clocks, and clocks derived from other ones
+ * (broadcast-adjusted), are passed through as is.
+ *
+ * Fused offset is fired with priority of the clock with the biggest weight
+ * rather than of the clock that was updated. So priority still decides
+ * which time wins: a fresh higher priority clock dominates fusion and the
+ * update of a lower priority clock only shifts the result by its weight,
+ * while with stale higher priority clocks the lower one is fired with its
+ * own priority and TimePrefsHandler keeps ignoring it until the time set
+ * by a higher priority clock gets old. Firing each clock on its own would
+ * make system time jump between sources instead of averaging them.
+ */
 class ClockHandler : public Trackable
 {
 public:
 	ClockHandler();
+	~ClockHandler();
+
+	/**
+	 * Use path instead of default for clock journal of handlers created
+	 * afterwards (tests); path must stay valid while they are used
+	 */
+	static void setJournalPath(const char* path);
 
 	/**
 	 * Register/attach this handler to service
@@ -51,9 +88,10 @@ public:
 	 *
 	 * Results in adjusting all clocks
 	 *
-	 * @param offset from old value (i.e. positive means times moves forward)
+	 * @param offset from old value in nanoseconds (i.e. positive means times
+	 *        moves forward)
 	 */
-	void adjust(time_t offset);
+	void adjust(int64_t offset);
 
 	/**
 	 * Notify about about change of manual-time mode
@@ -72,22 +110,24 @@ public:
 	 * Note that its possible to perform second setup which will result in
 	 *      changing priority and optionally offset for that clock.
 	 */
-	void setup(const std::string &clockTag, int priority, time_t offset = invalidOffset);
+	void setup(const std::string &clockTag, int priority, int64_t offset = invalidOffset);
 
 	/**
-	 * Update specific clock with new offset (from system time)
+	 * Update specific clock with new offset (from system time) in nanoseconds
 	 */
-	bool update(time_t offset, const std::string &clockTag = manual, time_t timeStamp = invalidTime);
+	bool update(int64_t offset, const std::string &clockTag = manual, time_t timeStamp = invalidTime);
 
 	/**
 	 * Signal emmited when some clock was changed (i.e. offset from system time
-	 * changed)
+	 * changed). For automatic time-sources fused offset is sent on behalf of
+	 * clock with the biggest weight in it (zero if it is within uncertainty
+	 * of fusion).
 	 * First - time source tag
 	 * Second - priority
-	 * Third - offset from system time
+	 * Third - offset from system time (in nanoseconds)
 	 * Fourth - last system time it was updated
 	 */
-	Signal<const std::string &, int, time_t, time_t> clockChanged;
+	Signal<const std::string &, int, int64_t, time_t> clockChanged;
 
 	/**
 	 * Pre-defined clock tag for manual adjusted time
@@ -104,6 +144,26 @@ public:
 	 */
 	static const std::string system;
 
+	/**
+	 * Pre-defined clock tag for broadcast local time converted to UTC with
+	 * user time-zone. It is derived from the same signal as "broadcast", so
+	 * it is not fused (that would count one source twice).
+	 */
+	static const std::string broadcastAdjusted;
+
+	/**
+	 * Pre-defined clock tag for time restored from journal of offsets
+	 * (lowest priority, any real time-source overrides it)
+	 */
+	static const std::string journal;
+
+	/**
+	 * Seed journal clock with the best offset recorded before restart
+	 *
+	 * @return false if journal has nothing usable
+	 */
+	bool restoreJournal();
+
 	/**
 	 * Pre-defined time_t constant for invalid time (corresponds with mktime
 	 * invalid time result)
@@ -111,9 +171,19 @@ public:
 	static const time_t invalidTime;
 
 	/**
-	 * Pre-defined time_t constant for invalid time offset
+	 * Pre-defined constant for invalid time offset
 	 */
-	static const time_t invalidOffset;
+	static const int64_t invalidOffset;
+
+	/**
+	 * Offset in nanoseconds for offset in whole seconds
+	 */
+	static int64_t secondsOffset(time_t seconds) { return (int64_t)seconds * 1000000000LL; }
+
+	/**
+	 * Whole seconds of offset in nanoseconds (rounded to nearest)
+	 */
+	static time_t offsetSeconds(int64_t offset);
 
 	static bool cbSetTime(LSHandle* lshandle, LSMessage *message,
 	                      void *user_data);
@@ -121,28 +191,151 @@ public:
 	static bool cbGetTime(LSHandle* lshandle, LSMessage *message,
 	                      void *user_data);
 
+	static bool cbCancel(LSHandle* lshandle, LSMessage *message,
+	                     void *user_data);
+
+	/**
+	 * Parameters of /clock/getTime
+	 */
+	struct TimeRequest {
+		TimeRequest() : manualOverride(false), haveFallback(false) {}
+		std::string source;
+		bool        manualOverride;
+		bool        haveFallback;
+		std::string fallback;
+	};
+
+	/**
+	 * Build reply on /clock/getTime
+	 *
+	 * @param state filled with description of clocks reply depends on
+	 *              (same while they don't change)
+	 */
+	void answerTime(const TimeRequest &request, pbnjson::JValue &reply, std::string &state) const;
+
+	/**
+	 * Quality of clock estimated from its history
+	 */
+	struct Quality {
+		size_t  samples;
+		int64_t estimate;	// offset from system time (ns)
+		int64_t jitter;		// standard deviation of samples (ns)
+		int64_t age;		// since last sample (ns)
+		double  variance;	// expected error of estimate (ns^2)
+		bool    stale;
+	};
+
+	/**
+	 * Result of clocks fusion
+	 */
+	struct Fusion {
+		int64_t     offset;			// ns
+		int64_t     uncertainty;	// ns
+		std::string tag;			// clock with the biggest weight
+		int         priority;
+		time_t      lastUpdate;
+		std::vector<std::string> sources;	// clocks used (not rejected)
+	};
+
+	/**
+	 * @return false if no clock has history
+	 */
+	bool quality(const std::string &clockTag, Quality &quality) const;
+
+	/**
+	 * Fuse automatic clocks
+	 *
+	 * @return false if there is no usable clock
+	 */
+	bool fuse(Fusion &fusion) const;
+
 private:
+	struct Sample {
+		int64_t offset;			// from system time (ns), follows system time changes
+		int64_t stamp;			// boot time (ns)
+		bool    wholeSeconds;	// source gave whole seconds only
+	};
+
 	struct Clock {
+		Clock(int priority, int64_t offset) :
+			priority(priority), systemOffset(offset), lastUpdate(invalidTime),
+			restoredVariance(0)
+		{}
+
 		/**
 		 * Priority. Higher overrides lower.
 		 */
 		int priority;
 
 		/**
-		 * Offset from system time (in UTC)
+		 * Offset from system time (in UTC, nanoseconds)
 		 */
-		time_t systemOffset;
+		int64_t systemOffset;
 
 		/**
 		 * Time since some moment of time (valid at least for single boot
 		 * session)
 		 */
 		time_t lastUpdate;
+
+		/**
+		 * Recent offsets (oldest first)
+		 */
+		std::deque<Sample> history;
+
+		/**
+		 * Error of offset restored from journal (ns^2, 0 for live clocks)
+		 */
+		double restoredVariance;
 	};
 
+	static bool isFused(const std::string &clockTag);
+	static void quality(const Clock &clock, int64_t now, Quality &quality);
+	void fireFused();
+
+	/**
+	 * Subscriptions on /clock/getTime. Subscribers with same parameters
+	 * share LS subscription key.
+	 */
+	struct Subscription {
+		TimeRequest request;
+		std::string state;	// last sent to subscribers
+	};
+	typedef std::map<std::string, Subscription> Subscriptions;	// by key
+	typedef std::map<std::string, std::set<std::string> > SubscriptionIndex;	// clock tag to keys
+
+	static std::string subscriptionKey(const TimeRequest &request);
+	void addSubscription(const std::string &key, const TimeRequest &request, const std::string &state);
+	void removeSubscription(const std::string &key);
+
+	/**
+	 * Mark subscriptions which depend on clock as changed (sent from idle
+	 * callback, so that several changes result in single reply)
+	 */
+	void clockChangedFor(const std::string &clockTag);
+	void allClocksChanged();
+	void schedulePush();
+	static gboolean cbPush(gpointer user_data);
+	void pushChanges();
+
 	typedef std::map<std::string, ClockHandler::Clock> ClocksMap;
 	ClocksMap m_clocks;
 	bool m_manualOverride;
+
+	LSPalmService         *m_service;
+	Subscriptions          m_subscriptions;
+	SubscriptionIndex      m_subscriptionIndex;
+	std::set<std::string>  m_changedSubscriptions;
+	guint                  m_pushSource;
+
+	/**
+	 * Sum of all adjust() offsets (ns) and their count. Clock offset plus
+	 * sum stays same while only system time moves.
+	 */
+	int64_t                m_systemShift;
+	unsigned int           m_systemChanges;
+
+	ClockJournal           m_journal;
 };
 
 #endif
@@ -0,0 +1,115 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file ClockJournal.h
+ */
+
+#ifndef __CLOCKJOURNAL_H
+#define __CLOCKJOURNAL_H
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+/**
+ * On-disk journal of recent clock offsets.
+ *
+ * Fixed-size records go to a small ring file, one pwrite() per record
+ * (no fsync, checksum rejects records torn by power loss). Every record
+ * holds system time, boot time and boot id of the moment it was taken,
+ * so at next start offsets can be carried over either exactly (same boot,
+ * e.g. service restart) or through RTC (after reboot).
+ */
+class ClockJournal
+{
+public:
+	/**
+	 * Offset of clock carried over to current system time
+	 */
+	struct Estimate
+	{
+		std::string tag;
+		int64_t     offset;			// from current system time (ns)
+		int64_t     uncertainty;	// ns
+		bool        sameBoot;		// carried over exactly (no reboot since)
+		bool        lowerBound;		// RTC went back, only lower bound known
+	};
+
+	ClockJournal(const char* path);
+	~ClockJournal();
+
+	/**
+	 * Record offset of clock from current system time (in nanoseconds).
+	 * Repeated records of same clock within a while are skipped unless
+	 * offset moved.
+	 */
+	void record(const std::string& tag, int64_t offset, int64_t uncertainty);
+
+	/**
+	 * Read latest record of every clock and carry it over to current time
+	 *
+	 * @return false if there is no usable record
+	 */
+	bool restore(std::map<std::string, Estimate>& estimates);
+
+	/**
+	 * Best (least uncertain) of restored estimates
+	 */
+	static bool best(const std::map<std::string, Estimate>& estimates, Estimate& estimate);
+
+private:
+	struct Record
+	{
+		uint32_t magic;
+		uint32_t sequence;
+		char     tag[16];
+		int64_t  offset;		// ns
+		int64_t  uncertainty;	// ns
+		int64_t  wall;			// system time (ns)
+		int64_t  boot;			// boot time (ns)
+		char     bootId[36];
+		uint32_t checksum;
+	};
+
+	struct Recorded
+	{
+		int64_t offset;
+		int64_t boot;
+	};
+
+	static uint32_t checksum(const Record& record);
+	static bool readBootId(char bootId[36]);
+	bool open();
+
+	ClockJournal(const ClockJournal &);
+	ClockJournal &operator=(const ClockJournal &);
+
+private:
+	std::string m_path;
+	int         m_fd;
+	bool        m_scanned;	// m_sequence follows records in file
+	uint32_t    m_sequence;	// of last written record
+	char        m_bootId[36];
+	bool        m_haveBootId;
+	std::map<std::string, Recorded> m_recorded;	// last written per clock (this run)
+};
+
+#endif
@@ -23,6 +23,8 @@
 
 #include "Settings.h"
 
+#include <stdint.h>
+#include <time.h>
 #include <luna-service2/lunaservice.h>
 #include <pbnjson.h>
 #include <pbnjson.hpp>
@@ -33,6 +35,10 @@
 
 #define STR(x) #x
 
+// double macro extension to pre-process content (schema written as plain JSON)
+#define STRINGIFY(content...) #content
+#define JSON(content...) STRINGIFY(content)
+
 extern const char * STANDARD_JSON_SUCCESS;
 
 /**
@@ -258,4 +264,38 @@ std::string createJsonReplyString(bool returnValue = true, int errorCode = 0, co
 // serialize a reply
 std::string jsonToString(pbnjson::JValue & reply, const char * schema = SCHEMA_ANY);
 
+// schema that accepts any json value
+extern pbnjson::JSchemaFragment schemaGeneric;
+
+// serialize a reply against schema and send it to the message sender
+bool replyJson(LSHandle * handle, LSMessage * message, const pbnjson::JValue & response,
+               const pbnjson::JSchema & schema = schemaGeneric);
+
+// time_t as json number of matching width
+inline pbnjson::JValue toJValue(time_t value)
+{
+	// this check will be compiled-out due to static condition
+	if (sizeof(time_t) <= sizeof(int32_t))
+	{
+		return static_cast<int32_t>(value);
+	}
+	else
+	{
+		return static_cast<int64_t>(value);
+	}
+}
+
+inline time_t toTimeT(const pbnjson::JValue & value)
+{
+	// this check will be compiled-out due to static condition
+	if (sizeof(time_t) <= sizeof(int32_t))
+	{
+		return value.asNumber<int32_t>();
+	}
+	else
+	{
+		return value.asNumber<int64_t>();
+	}
+}
+
 #endif // JSONUTILS_H
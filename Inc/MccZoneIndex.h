@@ -0,0 +1,85 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file MccZoneIndex.h
+ */
+
+#ifndef __MCCZONEINDEX_H
+#define __MCCZONEINDEX_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+struct TimeZoneInfo;
+
+/**
+ * Zone choice for NITZ by mobile country code, offset and dst value.
+ *
+ * Candidates for (mcc, offset) are zones of the MCC's country with that
+ * offset in zone list order. The ranked choice only depends on the dst
+ * value, so it is computed once for every dst value some candidate
+ * supports, plus one choice for any other dst value (ranking can't
+ * distinguish those).
+ */
+class MccZoneIndex
+{
+public:
+	typedef std::list<const TimeZoneInfo*> ZoneList;
+	typedef std::map<int,const TimeZoneInfo*> MccZoneMap;
+	typedef std::vector<const TimeZoneInfo*> Candidates;
+
+	/**
+	 * Build choices from zones (in zone list order) and zones of MCC table
+	 * (which give country code of each MCC)
+	 */
+	void build(const ZoneList& zones, const MccZoneMap& mccZones);
+	void clear() { m_choices.clear(); }
+
+	/**
+	 * Number of (mcc, offset) pairs with some candidate
+	 */
+	size_t size() const { return m_choices.size(); }
+
+	/**
+	 * @return NULL if the MCC's country has no zone with offset
+	 */
+	const TimeZoneInfo* find(int mcc, int offset, int dstValue) const;
+
+	/**
+	 * Rank candidates: preferred with matching dst value, DST enabled,
+	 * preferred, matching dst value, first one
+	 */
+	static const TimeZoneInfo* pick(const Candidates& candidates, int dstValue);
+
+private:
+	typedef std::pair<int,int> Key;	// (mcc, offset)
+
+	struct Choice {
+		Choice() : otherDst(NULL) {}
+		std::vector<std::pair<int,const TimeZoneInfo*> > byDst;	// dst values some candidate supports
+		const TimeZoneInfo* otherDst;							// any other dst value
+	};
+
+	std::map<Key,Choice> m_choices;
+};
+
+#endif // __MCCZONEINDEX_H
@@ -31,35 +31,43 @@
 #include "LSUtils.h"
 
 #include "SignalSlot.h"
+#include "SntpClient.h"
+#include "NTPPollScheduler.h"
 
 class TimePrefsHandler;
 
 /**
  * Groupped information required for handling NTP clocks in TimePrefsHandler
  */
-struct NTPClock
+struct NTPClock : public Trackable
 {
 	TimePrefsHandler &timePrefsHandler;
 
 	NTPClock(TimePrefsHandler &th) :
 		timePrefsHandler(th),
-		sntpPid(-1)
-	{}
-
-	~NTPClock()
+		haveSample(false),
+		sampleTime(0),
+		sampleStamp(0),
+		sampleTtl(0)
 	{
-		if (sntpPid != -1) g_spawn_close_pid(sntpPid);
+		sntpClient.finished.connect(this, &NTPClock::sntpFinished);
 	}
 
 	/**
-	 * PID of "sntp" process we are waiting for or -1 if we are in idle
+	 * Query servers on port instead of standard NTP port (tests point it
+	 * to stand-in servers)
+	 */
+	static void setServerPort(unsigned short port);
+
+	/**
+	 * Client which queries NTP servers (active while we wait for answers)
 	 */
-	GPid sntpPid;
+	SntpClient sntpClient;
 
 	/**
-	 * stdout contents of "sntp" process
+	 * Schedule of automatic NTP polls (fed with results of all queries)
 	 */
-	std::string sntpOutput;
+	NTPPollScheduler pollScheduler;
 
 	/**
 	 * Request for NTP time update.
@@ -69,15 +77,21 @@ struct NTPClock
 	bool requestNTP(LSMessage *message = NULL);
 
 	/**
-	 * Send NTP time offset from system time to all requests and to "ntp" clock
+	 * Send NTP time offset from system time (in nanoseconds) to all requests
+	 * and to "ntp" clock
 	 */
-	void postNTP(time_t offset);
+	void postNTP(int64_t offset);
 
 	/**
 	 * Send Error in response to all NTP requests
 	 */
 	void postError();
 
+	/**
+	 * Send reply to all pending NTP requests and forget them
+	 */
+	void respond(const char *reply);
+
 	/**
 	 * Pending responses for /time/getNTPTime
 	 */
@@ -85,14 +99,38 @@ struct NTPClock
 	RequestMessages requestMessages;
 
 	/**
-	 * Callback for "sntp" child process change state
+	 * Last good NTP time. Requests which come within "NTPCacheTimeout"
+	 * seconds after it are answered with it (extrapolated with boot clock)
+	 * instead of new query.
+	 */
+	bool    haveSample;
+	int64_t sampleTime;		// NTP time (ns)
+	int64_t sampleStamp;	// boot time when sampleTime was valid (ns)
+	int64_t sampleTtl;		// ns
+
+	/**
+	 * @return false if there is no cached NTP time young enough
+	 */
+	bool cachedTime(int64_t &ntpTime) const;
+
+	/**
+	 * Counters of NTP requests handling (since start)
 	 */
-	static void cbChild(GPid pid, gint status, NTPClock *ntpClock);
+	struct Stats {
+		Stats() : requests(0), cacheHits(0), coalesced(0), queries(0), failures(0) {}
+		unsigned int requests;	// /time/getNTPTime calls
+		unsigned int cacheHits;	// answered from cache
+		unsigned int coalesced;	// joined query in progress
+		unsigned int queries;	// SNTP queries sent (including automatic)
+		unsigned int failures;	// SNTP queries failed
+	};
+	Stats stats;
+	void logStats() const;
 
 	/**
-	 * Callback for "sntp" stdout data flow
+	 * Callback for end of SNTP query
 	 */
-	static gboolean cbStdout(GIOChannel *channel, GIOCondition cond, NTPClock *ntpClock);
+	void sntpFinished(bool succeeded, const SntpClient::Sample &sample);
 };
 
 #endif
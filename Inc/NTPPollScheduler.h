@@ -0,0 +1,120 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file NTPPollScheduler.h
+ */
+
+#ifndef __NTPPOLLSCHEDULER_H
+#define __NTPPOLLSCHEDULER_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Decides when NTP servers should be polled again.
+ *
+ * Local clock drift is estimated from successive NTP offsets (taking into
+ * account corrections applied to system time in between) and poll interval
+ * is chosen so that error accumulated until the next poll stays within
+ * tolerance. Failed polls are retried with exponential backoff.
+ *
+ * All time is measured with boot clock of TimeClock (including suspend).
+ */
+class NTPPollScheduler
+{
+public:
+	NTPPollScheduler();
+
+	/**
+	 * Bounds of poll interval (in seconds)
+	 */
+	void setLimits(time_t minInterval, time_t maxInterval);
+
+	/**
+	 * Successful poll with offset of system time from NTP time (in
+	 * nanoseconds) measured now
+	 */
+	void sampled(int64_t offset);
+
+	/**
+	 * Poll failed (no valid answer from servers)
+	 */
+	void failed();
+
+	/**
+	 * System time was changed by delta (in nanoseconds)
+	 */
+	void corrected(int64_t delta);
+
+	/**
+	 * System time no longer follows NTP (e.g. set from other source), so
+	 * poll is due right away. Drift estimation is kept.
+	 */
+	void expire();
+
+	/**
+	 * Seconds left until next poll (0 if poll is due). Expiration overrides
+	 * failure backoff.
+	 */
+	time_t nextPollIn() const;
+
+	bool isPollDue() const { return nextPollIn() == 0; }
+
+	/**
+	 * Current poll interval (in seconds, without failure backoff)
+	 */
+	time_t interval() const { return m_interval; }
+
+	/**
+	 * Estimated drift of system clock (in ppm, positive when it runs slow)
+	 */
+	double drift() const { return m_drift; }
+	bool hasDrift() const { return m_driftSamples > 0; }
+
+	/**
+	 * Number of polls failed in a row
+	 */
+	unsigned int failures() const { return m_failures; }
+
+private:
+	static int64_t now();
+	void updateInterval();
+
+private:
+	time_t       m_minInterval;
+	time_t       m_maxInterval;
+	time_t       m_interval;
+
+	bool         m_synced;		// m_lastSample/m_lastOffset valid
+	bool         m_expired;
+	int64_t      m_lastSample;	// boot time of last sample (ns)
+	int64_t      m_lastOffset;	// offset measured at m_lastSample (ns)
+	int64_t      m_corrections;	// system time changes since m_lastSample (ns)
+	int64_t      m_lastPoll;	// boot time of last successful poll (ns)
+
+	double       m_drift;
+	unsigned int m_driftSamples;
+
+	unsigned int m_failures;
+	int64_t      m_lastFailure;	// boot time of last failed poll (ns)
+};
+
+#endif
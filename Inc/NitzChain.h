@@ -0,0 +1,92 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file NitzChain.h
+ */
+
+#ifndef __NITZCHAIN_H
+#define __NITZCHAIN_H
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+#include "TimeClock.h"
+#include "TimeSyncStats.h"
+
+/**
+ * NITZ processing as a table of handler steps run in order until one
+ * fails. Cost of every step run is accounted by step name.
+ *
+ * Handler steps return success value on success and fill status message
+ * otherwise; error text is failure prefix of the failed step followed by
+ * that message.
+ */
+template <class Handler, class Parameters, int success>
+struct NitzChain
+{
+	typedef int (Handler::*StepFn)(Parameters& nitz, int& flags, std::string& r_statusMsg);
+
+	struct Step {
+		StepFn      handler;
+		const char* name;
+		const char* failure;	//prefix of error text if step fails
+	};
+
+	typedef std::map<std::string, TimeSyncStats::Cost> Costs;
+
+	/**
+	 * Run steps of chain (terminated by step without handler)
+	 *
+	 * @return false if some step failed
+	 */
+	static bool run(Handler& handler, const Step* chain, Parameters& nitz, int& flags,
+	                std::string& r_errorText, Costs& costs)
+	{
+		std::string statusMsg;
+		int64_t stepStart = monotonicNs();
+
+		for (const Step* step = chain; step->handler; ++step)
+		{
+			int rc = (handler.*(step->handler))(nitz, flags, statusMsg);
+
+			int64_t stepEnd = monotonicNs();
+			costs[step->name].add(stepEnd - stepStart);
+			stepStart = stepEnd;
+
+			if (rc != success)
+			{
+				r_errorText = step->failure + statusMsg;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static int64_t monotonicNs()
+	{
+		struct timespec ts;
+		TimeClock::instance()->monotonicTime(ts);
+		return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	}
+};
+
+#endif
@@ -51,6 +51,13 @@ public:
 
 	void setDatabaseFileDeleteOnDestruction(bool deleteAtDestructor=true);
 
+	/**
+	 * Counter which changes on every write to database (allows users to cache
+	 * values derived from preferences)
+	 */
+	unsigned int generation() const
+	{ return m_generation; }
+
 	//keeping all this in one place so that all of system service has one place to look it up in, rather than all over the other source files
 	static const char* s_defaultPrefsFile;
 	static const char* s_defaultPlatformPrefsFile;
@@ -108,6 +115,7 @@ private:
 	bool m_standalone;
 	std::string m_dbFilename;
 	bool m_deleteOnDestroy;
+	unsigned int m_generation;
 };
 
 #endif /* PREFSDB_H */
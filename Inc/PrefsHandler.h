@@ -52,7 +52,10 @@ public:
 		json_object_put(jo);
 	}
 	virtual json_object* valuesForKey(const std::string& key) = 0;
-	// FIXME: We very likely need a windowed version the above function
+	// Windowed version of the above function: serialized getPreferenceValues reply
+	// (including returnValue) which may be filtered/paged by request parameters.
+	// Returns false if not supported for the key (valuesForKey() is used then)
+	virtual bool valuesReplyForKey(const std::string& key, json_object* request, std::string& reply) { return false; }
 	virtual bool isPrefConsistent() { return true; }
 	virtual void restoreToDefault() {}
 	virtual bool shouldRefreshKeys(std::map<std::string,std::string>& keyvalues) { return false;}
@@ -42,6 +42,11 @@ public:
 	bool	m_image2svcAvailable;
 	std::string m_comPalmImage2BinaryFile;
 
+	int		m_zoneCacheSize;	// memory limit for parsed zones (in KiB)
+	std::string m_zonePackFile;	// zone pack built by tzpack (used if present)
+
+	int		m_syncStatsLogInterval;	// seconds between dumps of time sync stats (0 - never)
+
     int schemaValidationOption;
 
 private:
@@ -0,0 +1,114 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file SntpClient.h
+ */
+
+#ifndef __SNTPCLIENT_H
+#define __SNTPCLIENT_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <glib.h>
+
+#include "SignalSlot.h"
+
+/**
+ * Non-blocking SNTP (RFC 4330) client driven by GLib main loop.
+ *
+ * All addresses of all requested servers are queried in parallel over UDP;
+ * once every server answered (or timeout expired) the best sample is
+ * reported through finished signal. Server names are resolved by a worker
+ * thread, so main loop never blocks.
+ */
+class SntpClient
+{
+public:
+	/**
+	 * Time sample of one server
+	 */
+	struct Sample
+	{
+		std::string server;		// name as requested
+		std::string address;	// numeric address answered
+		int64_t     offset;		// server time minus local wall time (ns)
+		int64_t     delay;		// round-trip delay (ns)
+		int64_t     distance;	// root distance, i.e. max error of offset (ns)
+		int         stratum;
+	};
+
+	SntpClient();
+	~SntpClient();
+
+	/**
+	 * Start query of servers (host names or numeric addresses). Query in
+	 * progress (if any) is cancelled.
+	 *
+	 * @param timeoutMs time to wait for answers in total
+	 * @param port UDP port of servers
+	 * @return false if query can't be started (no signal is fired then)
+	 */
+	bool query(const std::vector<std::string>& servers, guint timeoutMs, unsigned short port = 123);
+
+	/**
+	 * Stop query in progress without firing finished signal
+	 */
+	void cancel();
+
+	bool isActive() const { return m_timeout != NULL; }
+
+	/**
+	 * Samples of all servers answered in last query
+	 */
+	const std::vector<Sample>& samples() const { return m_samples; }
+
+	/**
+	 * Fired at end of query with best sample (valid only if first argument
+	 * is true, i.e. some server answered)
+	 */
+	Signal<bool, const Sample&> finished;
+
+private:
+	struct Resolve;
+	struct Peer;
+
+	static gboolean cbResolved(gpointer data);
+	static gboolean cbReadable(GIOChannel* channel, GIOCondition condition, gpointer data);
+	static gboolean cbTimeout(gpointer data);
+
+	void start(const Resolve& resolve);
+	bool receive(Peer& peer);
+	void drop(Peer* peer);
+	void finish();
+
+	SntpClient(const SntpClient &);
+	SntpClient &operator=(const SntpClient &);
+
+private:
+	Resolve*            m_resolve;	// pending resolution
+	std::vector<Peer*>  m_peers;	// addresses waiting for answer
+	GSource*            m_timeout;	// set while query is active
+	std::vector<Sample> m_samples;
+};
+
+#endif
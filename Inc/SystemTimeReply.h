@@ -0,0 +1,84 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file SystemTimeReply.h
+ */
+
+#ifndef __SYSTEMTIMEREPLY_H
+#define __SYSTEMTIMEREPLY_H
+
+#include <string>
+#include <time.h>
+
+struct json_object;
+
+/**
+ * Serialized members (without enclosing braces) of getSystemTime response
+ * for the current second of TimeClock.
+ *
+ * Time members are formatted once per second, "timezone" and "TZ" only
+ * when offset or dst flag of local time changes, and the tail (members
+ * which depend on neither) is set by owner after every invalidate().
+ */
+class SystemTimeReply
+{
+public:
+	SystemTimeReply();
+
+	/**
+	 * Drop cached members (zone, time source or NITZ validity changed)
+	 */
+	void invalidate() { m_valid = false; }
+
+	/**
+	 * @return true if tail has to be set before next members()
+	 */
+	bool needsTail() const { return !m_valid; }
+	void setTail(const std::string& tail);
+
+	/**
+	 * Members for the current second in local time of process (zoneName
+	 * NULL if no zone is set, UTC is reported then)
+	 */
+	const std::string& members(const char* zoneName);
+
+	/**
+	 * Number of times time members were formatted
+	 */
+	unsigned long formatCount() const { return m_formatCount; }
+
+	/**
+	 * Append "key":value (and comma if text isn't empty) and release value
+	 */
+	static void appendMember(std::string& text, const char* key, json_object* value);
+
+private:
+	bool        m_valid;
+	time_t      m_utc;
+	struct tm   m_local;
+	long        m_offset;			// seconds east of UTC
+	std::string m_zoneMembers;		// serialized "timezone" and "TZ"
+	std::string m_tail;
+	std::string m_members;
+	unsigned long m_formatCount;
+};
+
+#endif // __SYSTEMTIMEREPLY_H
@@ -0,0 +1,108 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+
+/**
+ *  @file TimeClock.h
+ */
+
+#ifndef __TIMECLOCK_H
+#define __TIMECLOCK_H
+
+#include <time.h>
+#include <glib.h>
+
+/**
+ * Source of time for time handling code.
+ *
+ * All reads of wall, monotonic and boot clocks and all timers of time
+ * subsystem (TimePrefsHandler, ClockHandler, NTPClock, BroadcastTime) go
+ * through instance() so that another implementation (e.g. simulated time
+ * driven by recorded events) can be plugged in with setInstance().
+ */
+class TimeClock
+{
+public:
+	virtual ~TimeClock() {}
+
+	/**
+	 * Wall clock (CLOCK_REALTIME)
+	 *
+	 * Clock readers return false (and zero time) if clock is not available.
+	 */
+	virtual bool wallTime(struct timespec& ts) const = 0;
+
+	/**
+	 * Set wall clock (settimeofday)
+	 *
+	 * @return false on failure (errno is set)
+	 */
+	virtual bool setWallTime(const struct timespec& ts) = 0;
+
+	/**
+	 * Gradually shift wall clock by delta (adjtime). Clock keeps running
+	 * monotonically while its rate is corrected, so small corrections never
+	 * make time jump. Replaces correction still in progress; zero delta
+	 * just cancels it.
+	 *
+	 * @param remaining if not NULL, set to part of replaced correction
+	 *                  which was not applied yet (normalized, zero if none)
+	 * @return false on failure (errno is set)
+	 */
+	virtual bool slewWallTime(const struct timespec& delta, struct timespec* remaining = NULL) = 0;
+
+	/**
+	 * Clock which never jumps and stops during suspend (CLOCK_MONOTONIC)
+	 */
+	virtual bool monotonicTime(struct timespec& ts) const = 0;
+
+	/**
+	 * Time since boot including suspend (CLOCK_BOOTTIME)
+	 */
+	virtual bool bootTime(struct timespec& ts) const = 0;
+
+	/**
+	 * Create (not attached) timeout source firing every intervalMs
+	 * milliseconds of this clock
+	 *
+	 * @param coalesce timeout may be rounded to whole seconds and grouped
+	 *        with other wake-ups to save power
+	 */
+	virtual GSource* createTimeout(guint intervalMs, bool coalesce = false) const = 0;
+
+	time_t wallSeconds() const
+	{ struct timespec ts; wallTime(ts); return ts.tv_sec; }
+
+	time_t monotonicSeconds() const
+	{ struct timespec ts; monotonicTime(ts); return ts.tv_sec; }
+
+	/**
+	 * Clock used by time subsystem (system clocks unless replaced)
+	 */
+	static TimeClock* instance();
+
+	/**
+	 * Replace clock used by time subsystem (NULL restores system clocks).
+	 * Ownership is not transferred.
+	 */
+	static void setInstance(TimeClock* clock);
+};
+
+#endif
@@ -25,14 +25,19 @@
 #include <glib.h>
 
 #include "PrefsHandler.h"
+#include "MccZoneIndex.h"
+#include "NitzChain.h"
 #include "SignalSlot.h"
+#include "SystemTimeReply.h"
 #include "BroadcastTime.h"
 #include "NTPClock.h"
+#include "TimeSyncStats.h"
+#include "ZoneTransitionTimer.h"
 
 #define		DEFAULT_NTP_SERVER	"us.pool.ntp.org"
 
-class TimeZoneInfo;
-class PreferredZones;
+struct TimeZoneInfo;
+struct PreferredZones;
 
 //a container only
 class NitzParameters
@@ -81,6 +86,7 @@ public:
 	virtual bool validate(const std::string& key, json_object* value);
 	virtual void valueChanged(const std::string& key, json_object* value);
 	virtual json_object* valuesForKey(const std::string& key);
+	virtual bool valuesReplyForKey(const std::string& key, json_object* request, std::string& reply);
 
 	static TimePrefsHandler *instance() { return s_inst; }
 	json_object * timeZoneListAsJson();
@@ -93,6 +99,21 @@ public:
 	
 	const TimeZoneInfo* currentTimeZone() const { return m_cpCurrentTimeZone; }
 	time_t offsetToUtcSecs() const;	
+
+	/**
+	 * Switch to zone pack and timezone catalog currently on disk (e.g. after
+	 * tzdata update) without restart. Nothing changes if new data can't be
+	 * loaded.
+	 *
+	 * @return false on error (errorText describes it)
+	 */
+	bool reloadZoneData(std::string& errorText);
+
+	/**
+	 * Use path instead of default for symlink to zoneinfo file of current
+	 * zone (tests); path must stay valid while handler is used
+	 */
+	static void setLocalTimeFile(const char* path);
 	
 	void setHourFormat(const std::string& formatStr);
 	
@@ -120,14 +141,16 @@ public:
 	 */
 	void clockChanged(
 		const std::string &clockTag, int priority,
-		time_t systemOffset, time_t lastUpdate
+		int64_t systemOffset, time_t lastUpdate
 	);
 
 	/**
-	 * Signal emmited when system-wide time changed with time delta (positive
-	 * when time moves forward, i.e. new time is greater than old one)
+	 * Signal emmited when system-wide time changed with time delta in
+	 * nanoseconds (positive when time moves forward, i.e. new time is greater
+	 * than old one). For slewed corrections it is emitted when the
+	 * correction starts.
 	 */
-	Signal<time_t> systemTimeChanged;
+	Signal<int64_t> systemTimeChanged;
 
 	/**
 	 * Signal emmited when user prefers manually set system-wide time.
@@ -137,8 +160,9 @@ public:
 
 	/**
 	 * Signal emmited when deprecated API used to update time-source
+	 * (offset from system time in nanoseconds, clock tag, time-stamp)
 	 */
-	Signal<time_t, const std::string &, time_t> deprecatedClockChange;
+	Signal<int64_t, const std::string &, time_t> deprecatedClockChange;
 
 	static std::string getQualifiedTZIdFromName(const std::string& tzName);
 	static std::string getQualifiedTZIdFromJson(const std::string& jsonTz);
@@ -181,6 +205,15 @@ public:
 	
 	static bool cbConvertDate(LSHandle* lsHandle, LSMessage *message,
 								void *user_data);
+
+	static bool cbConvertDates(LSHandle* lsHandle, LSMessage *message,
+								void *user_data);
+
+	static bool cbReloadZoneData(LSHandle* lsHandle, LSMessage *message,
+								void *user_data);
+
+	static bool cbGetSyncStats(LSHandle* lsHandle, LSMessage *message,
+								void *user_data);
 	
 	static bool cbServiceStateTracker(LSHandle* lsHandle, LSMessage *message,
 								void *user_data);
@@ -193,10 +226,16 @@ public:
 
     static bool cbGetEffectiveBroadcastTime(LSHandle* lsHandle, LSMessage *message,
                                             void *userData);
+
+	static bool cbPowerResume(LSHandle* lsHandle, LSMessage *message,
+								void *user_data);
 	
 	 // timeout for NITZ completion
 	 static gboolean source_periodic(gpointer userData);
 	 static void 	source_periodic_destroy(gpointer userData);
+
+	 // periodic dump of time sync stats
+	 static gboolean source_syncStatsLog(gpointer userData);
 	    
 private:
 
@@ -204,6 +243,18 @@ private:
 	
 	void init();
 	void scanTimeZoneJson();
+
+	/**
+	 * (Re-)arm timer which notifies getSystemTime subscribers at next
+	 * transition (DST or offset change) of current zone
+	 */
+	void armZoneTransitionTimer();
+
+	/**
+	 * Dump time sync stats to log (and start periodic dump if configured)
+	 */
+	void logSyncStats() const;
+	void startSyncStatsLog();
 	
 	const TimeZoneInfo* timeZone_ZoneFromOffset(int offset,int dstValue=1,int mcc=0) const;
 	const TimeZoneInfo* timeZone_GenericZoneFromOffset(int offset) const;
@@ -221,7 +272,7 @@ private:
 	void setTimeZone(const TimeZoneInfo * pZoneInfo);       //this one sets it in the prefs db and then calls systemSetTimeZone
 	void systemSetTimeZone(const std::string &tzFileActual,
 	                       const TimeZoneInfo &zoneInfo);   //this one does the OS work to set the timezone
-	bool systemSetTime(time_t deltaTime, const std::string &source);
+	bool systemSetTime(int64_t deltaTime, const std::string &source);	// deltaTime in nanoseconds
 
     /**
      * Ask system time to be set from one of available time sources
@@ -230,10 +281,16 @@ private:
     void updateSystemTime();
 
 	/**
-	 * Attach system-time information to json object.
-	 * Useful for building getSystemTime response
+	 * Serialized members (without enclosing braces) of getSystemTime response
+	 * for the current second. Cached until second, zone, time source or NITZ
+	 * validity changes.
+	 */
+	const std::string& systemTimeMembers();
+
+	/**
+	 * Drop cached getSystemTime response
 	 */
-	void attachSystemTime(json_object *json);
+	void invalidateSystemTime() { m_systemTimeReply.invalidate(); }
 
 	static bool jsonUtil_ZoneFromJson(json_object * json,TimeZoneInfo& r_zoneInfo);
 	
@@ -250,8 +307,6 @@ private:
 	int  nitzHandlerEntry(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
 	int  nitzHandlerTimeValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
 	int	 nitzHandlerOffsetValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
-	int  nitzHandlerDstValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
-	int  nitzHandlerExit(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
 	
 	void  nitzHandlerSpecialCaseOffsetValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
 
@@ -267,7 +322,24 @@ private:
 	int  timeoutNitzHandlerTimeValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
 	int	 timeoutNitzHandlerOffsetValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
 	int  timeoutNitzHandlerDstValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
-	int  timeoutNitzHandlerExit(NitzParameters& nitz,int& flags,std::string& r_statusMsg);
+
+	/**
+	 * NITZ chains are tables of steps run in order until one fails
+	 * (see s_nitzChain, s_timeoutNitzChain)
+	 */
+	typedef NitzChain<TimePrefsHandler, NitzParameters, NITZHANDLER_RETURN_SUCCESS> NitzSteps;
+	typedef NitzSteps::Step NitzStep;
+	static const NitzStep s_nitzChain[];
+	static const NitzStep s_timeoutNitzChain[];
+
+	bool runNitzChain(const NitzStep* chain, NitzParameters& nitz, int& flags, std::string& r_errorText);
+
+	/**
+	 * NITZHANDLER_FLAGBIT_* flags set by preferences (re-read only when
+	 * preferences db changes)
+	 */
+	int nitzPrefFlags();
+	void applyNitzTimeZone(const TimeZoneInfo* zone);
 	
 	void setPeriodicTimeSetWakeup();
 	bool isNTPAllowed();
@@ -279,6 +351,8 @@ private:
 
 	void signalReceivedNITZUpdate(bool time,bool zone);
 	void slotNetworkConnectionStateChanged(bool connected);
+	void slotNtpPollFinished(bool succeeded, const SntpClient::Sample &sample);
+	void slotZoneTransitionReached();
 
 	static void dbg_time_timevalidOverride(bool&);
 	static void dbg_time_tzvalidOverride(bool&);
@@ -291,25 +365,33 @@ private:
 
 	static TimePrefsHandler * s_inst;			///not a true instance handle. Just points to the first one created
 	
-	typedef std::list<TimeZoneInfo*> TimeZoneInfoList;
-	typedef std::list<TimeZoneInfo*>::iterator TimeZoneInfoListIterator;
-	typedef std::list<TimeZoneInfo*>::const_iterator TimeZoneInfoListConstIterator;
+	typedef std::list<const TimeZoneInfo*> TimeZoneInfoList;
+	typedef std::list<const TimeZoneInfo*>::iterator TimeZoneInfoListIterator;
+	typedef std::list<const TimeZoneInfo*>::const_iterator TimeZoneInfoListConstIterator;
 	
-	typedef std::map<int,TimeZoneInfo*> TimeZoneMap;
-	typedef std::map<int,TimeZoneInfo*>::iterator TimeZoneMapIterator;
-	typedef std::map<int,TimeZoneInfo*>::const_iterator TimeZoneMapConstIterator;
+	typedef std::map<int,const TimeZoneInfo*> TimeZoneMap;
+	typedef std::map<int,const TimeZoneInfo*>::iterator TimeZoneMapIterator;
+	typedef std::map<int,const TimeZoneInfo*>::const_iterator TimeZoneMapConstIterator;
 
-	typedef std::pair<int,TimeZoneInfo*> TimeZonePair;
-	typedef std::multimap<int,TimeZoneInfo*> TimeZoneMultiMap;
-	typedef std::multimap<int,TimeZoneInfo*>::iterator TimeZoneMultiMapIterator;
-	typedef std::multimap<int,TimeZoneInfo*>::const_iterator TimeZoneMultiMapConstIterator;
+	typedef std::pair<int,const TimeZoneInfo*> TimeZonePair;
+	typedef std::multimap<int,const TimeZoneInfo*> TimeZoneMultiMap;
+	typedef std::multimap<int,const TimeZoneInfo*>::iterator TimeZoneMultiMapIterator;
+	typedef std::multimap<int,const TimeZoneInfo*>::const_iterator TimeZoneMultiMapConstIterator;
 	
 	std::list<std::string> m_keyList;
 	
 	TimeZoneInfoList m_zoneList;
 	TimeZoneInfoList m_syszoneList;
 	
+	std::vector<const TimeZoneInfo*> m_zoneNameIndex;	//zones and sys zones sorted by name
+	TimeZoneMap m_genericZoneMap;						//first sys zone for each offset
+
+	SystemTimeReply m_systemTimeReply;	//getSystemTime response for one second
+
 	TimeZoneMap m_mccZoneInfoMap;
+
+	MccZoneIndex m_mccOffsetZones;		//zone choice for NITZ (mcc, offset, dst)
+
 	TimeZoneMap m_preferredTimeZoneMapDST;
 	TimeZoneMap m_preferredTimeZoneMapNoDST;
 	TimeZoneMultiMap m_offsetZoneMultiMap;
@@ -325,19 +407,23 @@ private:
     NitzParameters	*	m_p_lastNitzParameter;
     int					m_lastNitzFlags;
     
-    static json_object * s_timeZonesJson;
-    
     GSource *	m_gsource_periodic;
     guint		m_gsource_periodic_id;
     int			m_timeoutCycleCount;
     
     bool		m_sendWakeupSetToPowerD;
 
-	time_t m_lastNtpUpdate;
-
     bool        m_nitzTimeZoneAvailable;
 
+	int          m_nitzPrefFlags;
+	bool         m_nitzStrictDstErrors;
+	bool         m_nitzPrefsValid;
+	unsigned int m_nitzPrefsGeneration;
+
+	ZoneTransitionTimer m_zoneTransitionTimer;
+
     BroadcastTime m_broadcastTime;
+    EffectiveBroadcastTime m_effectiveBroadcastTime; // last sent to subscribers
 
 	TimeSources m_timeSources;
 	int         m_currentTimeSourcePriority;
@@ -345,6 +431,9 @@ private:
 	std::string m_systemTimeSourceTag;
 
 	NTPClock    m_ntpClock;
+
+	TimeSyncStats m_syncStats;
+	GSource      *m_syncStatsSource;
 };
 
 #endif /* TIMEPREFSHANDLER_H */
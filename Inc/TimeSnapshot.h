@@ -0,0 +1,111 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeSnapshot.h
+ */
+
+#ifndef __TIMESNAPSHOT_H
+#define __TIMESNAPSHOT_H
+
+#include <stdint.h>
+#include <time.h>
+
+class BroadcastTime;
+
+/**
+ * Consistent view of time state owned by main loop for other threads.
+ *
+ * ClockHandler offsets, BroadcastTime and current zone offset are plain
+ * members touched only from main loop. Main loop publishes their copy here
+ * (sequence lock: single writer, readers retry while publish is in
+ * progress), so any thread may read all of them at once without locking
+ * and without ever blocking main loop.
+ *
+ * All service handlers run on main loop, so no reader on other thread
+ * exists yet; TestTimeSnapshot plays one.
+ */
+class TimeSnapshot
+{
+public:
+	struct Data
+	{
+		unsigned long generation;	///< number of publishes so far
+
+		bool    haveSystemOffset;
+		int64_t systemOffset;		///< fused clock minus system time (ns)
+		int64_t systemUncertainty;	///< ns
+
+		bool    haveBroadcast;
+		time_t  broadcastUtcOffset;	///< broadcast UTC minus system time
+		time_t  broadcastLocalOffset;	///< broadcast local minus system time
+		time_t  broadcastStamp;
+
+		bool    haveZone;
+		long    zoneUtcOffset;		///< seconds east of UTC
+		bool    zoneIsDst;
+		time_t  zoneValidUntil;		///< next zone transition (0 - never)
+	};
+
+	static TimeSnapshot* instance();
+
+	/**
+	 * Publishers (main loop only)
+	 */
+	void publishSystemOffset(int64_t offset, int64_t uncertainty);
+	void publishBroadcast(const BroadcastTime& broadcastTime);
+	void publishZone(long utcOffset, bool isDst, time_t validUntil);
+	void resetZone();	///< no zone known (readers get UTC fields, haveZone unset)
+
+	/**
+	 * Read whole snapshot (any thread)
+	 *
+	 * @return false if nothing was published yet
+	 */
+	bool read(Data& data) const;
+
+	/**
+	 * Estimated broadcast time at current system time (any thread)
+	 */
+	bool broadcastTime(time_t& utc, time_t& local) const;
+
+	/**
+	 * Offset of current zone at specified UTC time (any thread)
+	 *
+	 * @return false if zone is unknown or utc is past its next transition
+	 */
+	bool zoneOffset(time_t utc, long& utcOffset) const;
+
+private:
+	TimeSnapshot();
+	TimeSnapshot(const TimeSnapshot &);
+	TimeSnapshot &operator=(const TimeSnapshot &);
+
+	void publish();
+
+	static TimeSnapshot s_instance;
+
+private:
+	volatile unsigned long m_sequence;	// odd while publish is in progress
+	Data                   m_data;		// guarded by m_sequence
+	Data                   m_staging;	// main loop copy
+};
+
+#endif
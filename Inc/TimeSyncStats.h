@@ -0,0 +1,101 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeSyncStats.h
+ */
+
+#ifndef __TIMESYNCSTATS_H
+#define __TIMESYNCSTATS_H
+
+#include <map>
+#include <string>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Cumulative counters of time synchronization quality.
+ *
+ * Only fixed-size histograms and counters are kept, so it is always on.
+ * Maintained by TimePrefsHandler from main loop.
+ */
+struct TimeSyncStats
+{
+	/**
+	 * Histogram of magnitudes with power of two buckets in milliseconds:
+	 * bucket 0 counts values below 1 ms, bucket i - [2^(i-1), 2^i) ms and
+	 * last one everything above
+	 */
+	struct Histogram
+	{
+		enum { bucketCount = 16 };
+
+		Histogram() { reset(); }
+		void reset();
+		void add(int64_t ns);
+
+		static int64_t bucketLimitMs(size_t bucket);	// exclusive (none for last bucket)
+
+		unsigned int buckets[bucketCount];
+		unsigned int count;
+		int64_t      max;	// ns
+	};
+
+	/**
+	 * Run time of a processing step
+	 */
+	struct Cost
+	{
+		Cost() : runs(0), totalNs(0), maxNs(0) {}
+		void add(int64_t ns);
+
+		unsigned int runs;
+		int64_t      totalNs;
+		int64_t      maxNs;
+	};
+
+	TimeSyncStats() { reset(); }
+	void reset();
+
+	int64_t resetStamp;		// boot time of last reset (ns)
+
+	// NTP samples
+	Histogram ntpRoundTrip;
+	Histogram ntpOffset;
+
+	// system time corrections
+	unsigned int steps;
+	unsigned int slews;
+	unsigned int replacedSlews;	// slews cut short by next correction
+	Histogram    stepSize;
+	Histogram    slewSize;
+
+	// system time synchronized with other clock than before
+	unsigned int sourceSwitches;
+	std::map<std::string, unsigned int> sourceUpdates;	// corrections by clock
+
+	// NITZ validity state changes
+	unsigned int nitzValidityChanges;
+
+	// NITZ chain steps by step name (see NitzChain)
+	std::map<std::string, Cost> nitzSteps;
+};
+
+#endif
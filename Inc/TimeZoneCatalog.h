@@ -0,0 +1,217 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeZoneCatalog.h
+ */
+
+#ifndef __TIMEZONECATALOG_H
+#define __TIMEZONECATALOG_H
+
+#include <string>
+#include <vector>
+
+struct json_object;
+
+struct TimeZoneInfo
+{
+	bool operator==(const struct TimeZoneInfo& c) const {
+		return (name == c.name);
+	}
+	std::string name;
+	std::string countryCode;
+	std::string jsonStringValue;
+	int   	dstSupported;
+    int   	offsetToUTC;
+    bool 	preferred;					//if set to true, then pick this TZ is searching by offset vs any others
+    int		howManyZonesForCountry;		//how many offsets (incl. this one) does this country (based on countryCode) span? e.g. USA = 9
+
+};
+
+/**
+ * Orders zones by name (for binary search over sorted zone index)
+ */
+struct TimeZoneNameLess
+{
+	bool operator()(const TimeZoneInfo* a, const TimeZoneInfo* b) const { return a->name < b->name; }
+	bool operator()(const TimeZoneInfo* a, const std::string& b) const { return a->name < b; }
+	bool operator()(const std::string& a, const TimeZoneInfo* b) const { return a < b->name; }
+};
+
+/**
+ * Immutable catalog of zones described by ext-timezones.json.
+ *
+ * JSON document is parsed once and released right after the load. Each
+ * section keeps flat arrays of zone records and their flags; serialized JSON
+ * of every entry is stored once (as jsonStringValue of its record). Values
+ * repeated between entries (country names, descriptions) aren't interned,
+ * since replies hand out that text as is.
+ */
+class TimeZoneCatalog
+{
+public:
+	/**
+	 * Zones sorted by name (stable, so for duplicate names the first
+	 * inserted zone is found)
+	 */
+	typedef std::vector<const TimeZoneInfo*> ZoneIndex;
+
+	enum Section {
+		Zones,		///< "timeZone" - zones for user selection
+		SysZones,	///< "syszones" - generic zones picked by offset only
+		MccZones,	///< "mccInfo" - zones of known mobile country codes
+		SectionCount
+	};
+
+	/**
+	 * Fields present in catalog entry
+	 */
+	enum Flags {
+		HasName      = 1 << 0,	///< "ZoneID"
+		HasOffset    = 1 << 1,	///< "offsetFromUTC"
+		HasDst       = 1 << 2,	///< "supportsDST"
+		HasMcc       = 1 << 3,	///< "mcc"
+		IsDefault    = 1 << 4	///< "default"
+	};
+
+	/**
+	 * Selection of Zones entries for values reply (all of them by default)
+	 */
+	struct ValuesFilter
+	{
+		ValuesFilter();
+
+		const char* countryCode;	///< "CountryCode" to match or NULL
+		const char* prefix;			///< prefix of "ZoneID" to match or NULL
+		bool        filterOffset;	///< match offset
+		int         offset;			///< "offsetFromUTC" to match
+		int         start;			///< first of matched entries to list
+		int         count;			///< number of entries to list, -1 for all
+	};
+
+	TimeZoneCatalog();
+
+	/**
+	 * Load catalog from JSON file
+	 *
+	 * @return false if file can't be read or parsed (catalog stays empty)
+	 */
+	bool load(const char* path);
+
+	/**
+	 * Load catalog from JSON text (e.g. catalog of zone pack)
+	 *
+	 * @return false if text can't be parsed (catalog stays empty)
+	 */
+	bool loadText(const char* text, size_t size);
+
+	/**
+	 * Exchange content with other catalog. Zone records keep their
+	 * addresses, so pointers to them follow the catalog they belong to.
+	 */
+	void swap(TimeZoneCatalog& other);
+
+	bool isLoaded() const { return m_loaded; }
+
+	size_t size(Section section) const { return m_sections[section].zones.size(); }
+	const TimeZoneInfo& zone(Section section, size_t index) const { return m_sections[section].zones[index]; }
+	unsigned flags(Section section, size_t index) const { return m_sections[section].flags[index]; }
+
+	/**
+	 * Value of "mcc" of MccZones entry
+	 */
+	int mcc(size_t index) const { return m_mccs[index]; }
+
+	/**
+	 * Find entry of Zones or SysZones (in that order) with ZoneID == name
+	 *
+	 * @return NULL if there is no such entry
+	 */
+	const TimeZoneInfo* zoneFromName(const std::string& name) const { return findInIndex(m_nameIndex, name); }
+
+	/**
+	 * Sort index built from zones and find zone by name in it
+	 */
+	static void sortIndex(ZoneIndex& index);
+	static const TimeZoneInfo* findInIndex(const ZoneIndex& index, const std::string& name);
+
+	/**
+	 * @return index of first Zones entry marked as default or -1
+	 */
+	int defaultZone() const { return m_defaultZone; }
+
+	/**
+	 * Rebuild JSON document equivalent to loaded one
+	 *
+	 * @return new object (to be released by caller) or NULL if not loaded
+	 */
+	json_object* toJson() const;
+
+	/**
+	 * Append members of JSON document equivalent to loaded one (without
+	 * enclosing braces) to text
+	 */
+	void serializeMembers(std::string& text) const;
+
+	/**
+	 * Serialized reply of timeZone values: for default filter whole
+	 * document (serialized on first request only), else matched Zones
+	 * entries of requested window with "total" number of matches. Both
+	 * include "returnValue".
+	 */
+	void valuesReply(const ValuesFilter& filter, std::string& reply) const;
+
+	/**
+	 * Memory used by catalog (in bytes, without allocator overhead)
+	 */
+	size_t memoryUsage() const;
+
+private:
+	struct SectionData
+	{
+		std::vector<TimeZoneInfo>  zones;
+		std::vector<unsigned char> flags;
+	};
+
+	// top-level member of JSON document: section or serialized value
+	struct Member
+	{
+		std::string key;	// serialized
+		int         section;	// -1 for other members
+		std::string value;	// serialized, for other members only
+	};
+
+	void clear();
+	bool loadJson(json_object* root);	// takes ownership of root
+
+	TimeZoneCatalog(const TimeZoneCatalog &);
+	TimeZoneCatalog &operator=(const TimeZoneCatalog &);
+
+private:
+	bool                m_loaded;
+	SectionData         m_sections[SectionCount];
+	std::vector<int>    m_mccs;
+	int                 m_defaultZone;
+	std::vector<Member> m_members;
+	ZoneIndex           m_nameIndex;
+	mutable std::string m_valuesReply;	// unfiltered values reply
+};
+
+#endif
@@ -20,10 +20,15 @@
 
 #include <luna-service2/lunaservice.h>
 #include <stdint.h>
+#include <sys/types.h>
 #include <cjson/json.h>
 
 #include <list>
+#include <map>
+#include <string>
+#include <vector>
 
+class TzZone;
 
 class TimeZoneService
 {
@@ -38,7 +43,22 @@ public:
 	static bool cbGetTimeZoneFromEasData(LSHandle* lshandle, LSMessage *message,
 										 void *user_data);
 
-private:
+	/**
+	 * Find first of timeZones (all having specified offset in minutes) which
+	 * has DST transitions matching EAS dates (wall clock seconds since epoch
+	 * of DST end in daylight time and DST start in standard time)
+	 *
+	 * @return NULL if there is no such zone
+	 */
+	const std::string* findEasZone(int offset, int year,
+								   const std::list<std::string>& timeZones,
+								   int64_t standardDate, int64_t daylightDate);
+
+	/**
+	 * Drop EAS zone index. Has to be called when zone data is replaced
+	 * without changing zoneinfo files (e.g. new zone pack).
+	 */
+	void clearEasZones();
 
 	typedef std::list<int> IntList;
 
@@ -47,6 +67,16 @@ private:
 		IntList years;
 	};
 
+	typedef std::list<TimeZoneEntry> TimeZoneEntryList;
+
+	/**
+	 * Reply of getTimeZoneRules for parsed request (each zone is loaded once
+	 * per request however many entries refer to it)
+	 */
+	std::string getTimeZoneRules(const TimeZoneEntryList& entries);
+
+private:
+
 	struct TimeZoneResult {
 		std::string tz;
 		int year;
@@ -68,24 +98,59 @@ private:
 		int second;
 	};	
 
-	typedef std::list<TimeZoneEntry> TimeZoneEntryList;
 	typedef std::list<TimeZoneResult> TimeZoneResultList;
 
+	struct EasZoneStamp {
+		std::string path;
+		time_t mtime;
+		ino_t ino;
+		off_t size;
+	};
+
+	// (DST end in daylight time, DST start in standard time) as wall clock
+	// seconds since epoch
+	typedef std::pair<int64_t, int64_t> EasZoneKey;
+	typedef std::map<EasZoneKey, std::string> EasZoneMap;
+	typedef std::vector<EasZoneStamp> EasZoneStampList;
+
+	/**
+	 * DST rules of all zones sharing the same UTC offset for a single year
+	 */
+	struct EasZoneGroup {
+		EasZoneGroup() : year(0), lastCheck(0) {}
+
+		int year;
+		time_t lastCheck;	// monotonic time of last zoneinfo files check
+		std::list<std::string> timeZones;	// zones index was built from
+		EasZoneMap zones;
+		EasZoneStampList stamps;
+	};
+
+	typedef std::map<int, EasZoneGroup> EasZoneGroupMap;
+
 private:
 
 	TimeZoneService();
 	~TimeZoneService();
 
-	std::string getTimeZoneRules(const TimeZoneEntryList& entries);
-	TimeZoneResultList getTimeZoneRuleOne(const TimeZoneEntry& entry);
+	void getTimeZoneRuleOne(const TimeZoneEntry& entry, const TzZone* zone,
+							TimeZoneResultList& results);
 	static void readEasDate(json_object* obj, EasSystemTime& time);
 	static void updateEasDateDayOfMonth(EasSystemTime& time, int year);
+	static int64_t easDateToSeconds(const EasSystemTime& time, int year);
+
+	bool isEasZoneGroupStale(EasZoneGroup& group, int year,
+							 const std::list<std::string>& timeZones);
+	void buildEasZoneGroup(EasZoneGroup& group, int offset, int year,
+						   const std::list<std::string>& timeZones);
 
 private:
 
 	LSPalmService* m_service;
 	LSHandle* m_serviceHandlePublic;
 	LSHandle* m_serviceHandlePrivate;
+
+	EasZoneGroupMap m_easZoneGroups;
 };	
 
 
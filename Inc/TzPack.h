@@ -0,0 +1,152 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TzPack.h
+ */
+
+#ifndef __TZPACK_H
+#define __TZPACK_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+
+class TzPackRef;
+
+/**
+ * Read-only view of a zone pack: zoneinfo files of all zones and the
+ * timezone catalog (ext-timezones.json) compiled by tzpack tool into a
+ * single indexed file.
+ *
+ * Pack is mmap'ed as a whole, so zones are looked up by binary search over
+ * its index and their data is never copied. Packs are immutable once
+ * written (tool replaces pack file atomically), so zones loaded from a pack
+ * keep it alive through reference counting while a newer pack becomes
+ * current.
+ *
+ * Layout (integers are 32-bit big-endian):
+ *   header:  magic "TZpk", version, zone count, catalog offset, catalog size
+ *   index:   zone count records of { name offset, data offset, data size }
+ *            sorted by name
+ *   data:    NUL-terminated zone names, zoneinfo files and catalog as is
+ */
+class TzPack
+{
+public:
+	/**
+	 * Map pack file
+	 *
+	 * @return new pack with zero references or NULL if file is not a valid pack
+	 */
+	static TzPack* load(const char* path);
+
+	/**
+	 * Write pack of all zoneinfo files found under zoneInfoDir (except
+	 * "posix/" and "right/" variants) and catalog file to path. Pack is
+	 * written to temporary file and renamed to path.
+	 *
+	 * @return false on error (errorText describes it)
+	 */
+	static bool build(const char* zoneInfoDir, const char* catalogPath,
+	                  const char* path, std::string& errorText);
+
+	/**
+	 * Pack used for zone lookups by TzFile (may be NULL)
+	 */
+	static TzPackRef current();
+	static void setCurrent(const TzPackRef& pack);
+
+	void ref() const;
+	void unref() const;
+
+	/**
+	 * Find zoneinfo data of zone
+	 *
+	 * @return false if pack has no such zone
+	 */
+	bool find(const char* tzName, const char*& data, size_t& size) const;
+
+	size_t zoneCount() const { return m_zoneCount; }
+	const char* zoneName(size_t index) const;
+
+	/**
+	 * Content of ext-timezones.json (not NUL-terminated)
+	 */
+	const char* catalog() const { return m_map + m_catalogOffset; }
+	size_t catalogSize() const { return m_catalogSize; }
+
+	const std::string& filePath() const { return m_filePath; }
+	const struct stat& fileStat() const { return m_fileStat; }
+	size_t mappedSize() const { return m_size; }
+
+private:
+	TzPack();
+	~TzPack();
+	TzPack(const TzPack &);
+	TzPack &operator=(const TzPack &);
+
+	uint32_t word(size_t offset) const;
+
+private:
+	const char* m_map;
+	size_t      m_size;
+	size_t      m_zoneCount;
+	size_t      m_catalogOffset;
+	size_t      m_catalogSize;
+	std::string m_filePath;
+	struct stat m_fileStat;
+
+	mutable int m_refCount;
+};
+
+/**
+ * Simple wrapper for shared pack handling
+ */
+class TzPackRef
+{
+public:
+	TzPackRef(const TzPack *pack = NULL) : m_pack(pack)
+	{ if (m_pack) m_pack->ref(); }
+
+	TzPackRef(const TzPackRef &packRef) : m_pack(packRef.m_pack)
+	{ if (m_pack) m_pack->ref(); }
+
+	~TzPackRef()
+	{ if (m_pack) m_pack->unref(); }
+
+	TzPackRef &operator=(const TzPackRef &packRef)
+	{
+		if (packRef.m_pack) packRef.m_pack->ref();
+		if (m_pack) m_pack->unref();
+		m_pack = packRef.m_pack;
+		return *this;
+	}
+
+	const TzPack *get() const { return m_pack; }
+	const TzPack *operator->() const { return m_pack; }
+	bool isNull() const { return m_pack == NULL; }
+
+private:
+	const TzPack *m_pack;
+};
+
+#endif
@@ -1,6 +1,6 @@
 /**
- *  Copyright (c) 2010-2013 LG Electronics, Inc.
- * 
+ *  Copyright (c) 2010-2014 LG Electronics, Inc.
+ *
  *  Licensed under the Apache License, Version 2.0 (the "License");
  *  you may not use this file except in compliance with the License.
  *  You may obtain a copy of the License at
@@ -18,11 +18,16 @@
 #ifndef TZPARSER_H
 #define TZPARSER_H
 
-#include <list>
+#include <string>
+#include <vector>
+#include <stdint.h>
 #include <time.h>
+#include <sys/stat.h>
 
 #define TZ_ABBR_MAX_LEN	16
 
+class TzPack;
+
 struct TzTransition
 {
 	time_t time;
@@ -32,8 +37,108 @@ struct TzTransition
 	char   abbrName[TZ_ABBR_MAX_LEN];
 };
 
-typedef std::list<TzTransition> TzTransitionList;
+/**
+ * Local time type (ttinfo record) of a zoneinfo file
+ */
+struct TzLocalTimeType
+{
+	long          utcOffset;
+	bool          isDst;
+	unsigned char abbrIndex;
+};
+
+/**
+ * Read-only view of a zoneinfo (TZif) file.
+ *
+ * File (or zone pack) is mmap'ed and records of the widest data section
+ * available (64-bit for version 2+ files) are decoded only when accessed,
+ * so lookups touch only pages they need. Files must be updated by writing
+ * a new file and renaming it over the old one, as zic and tzpack do
+ * (truncating a mapped file in place faults readers with SIGBUS).
+ */
+class TzFile
+{
+public:
+	TzFile();
+	~TzFile();
+
+	/**
+	 * Open zoneinfo file for tzName (relative to the zoneinfo directory, with
+	 * fallback to its Etc/ sub-directory). Zones of current zone pack (see
+	 * TzPack) are used in favour of files.
+	 *
+	 * @return false if file was not found or is not a valid TZif file
+	 */
+	bool open(const char* tzName);
+	void close();
 
-TzTransitionList parseTimeZone(const char* tzName);
+	/**
+	 * Directory zoneinfo files are looked up in (/usr/share/zoneinfo by
+	 * default). Must be set before zones are opened (e.g. by tests).
+	 */
+	static void setZoneInfoDir(const std::string& dir);
+
+	bool isOpen() const { return m_map != NULL; }
+
+	/**
+	 * Pack zone data comes from (NULL for zoneinfo file). In that case
+	 * filePath() and fileStat() describe the pack file.
+	 */
+	const TzPack* pack() const { return m_pack; }
+
+	/**
+	 * Transitions (sorted ascending by time)
+	 */
+	size_t transitionCount() const { return m_timeCount; }
+	int64_t transitionTime(size_t index) const;
+	unsigned char transitionType(size_t index) const { return m_transitionTypes[index]; }
+
+	/**
+	 * Find first transition with time greater than specified one
+	 *
+	 * @return transitionCount() if there is no such transition
+	 */
+	size_t upperBound(int64_t time) const;
+
+	/**
+	 * Local time types (ttinfo records)
+	 */
+	size_t typeCount() const { return m_typeCount; }
+	TzLocalTimeType type(size_t index) const;
+	const char* abbr(unsigned char abbrIndex) const;
+
+	/**
+	 * POSIX TZ rule from footer of v2+ files (may be empty)
+	 */
+	const std::string& footer() const { return m_footer; }
+
+	const std::string& filePath() const { return m_filePath; }
+	const struct stat& fileStat() const { return m_fileStat; }
+	size_t mappedSize() const { return m_size; }
+
+private:
+	bool openPacked(const TzPack* pack, const char* tzName);
+	bool parse();
+	bool locateSection(size_t& index, int timeSize);
+
+	TzFile(const TzFile &);
+	TzFile &operator=(const TzFile &);
+
+private:
+	const char*          m_map;
+	size_t               m_size;
+	const TzPack*        m_pack;	// referenced while open
+	int                  m_timeSize;
+	size_t               m_timeCount;
+	size_t               m_typeCount;
+	size_t               m_charCount;
+	const char*          m_transitionTimes;
+	const unsigned char* m_transitionTypes;
+	const char*          m_types;
+	const char*          m_abbrChars;
+	std::string          m_footer;
+	std::string          m_filePath;
+	struct stat          m_fileStat;
+};
 
 #endif /* TZPARSER_H */
@@ -0,0 +1,218 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TzZone.h
+ */
+
+#ifndef __TZZONE_H
+#define __TZZONE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+
+#include "TzParser.h"
+
+/**
+ * In-memory time zone built on top of mapped zoneinfo file.
+ *
+ * Replaces setenv("TZ")/tzset()/mktime() round-trips: conversions never
+ * touch process-global libc state. Object is immutable after load() so it
+ * can be shared between threads without locking. Lifetime is controlled by
+ * reference counting (see TzZoneRef).
+ */
+class TzZone
+{
+public:
+	/**
+	 * Local time rules in effect at some moment
+	 */
+	struct LocalTimeInfo
+	{
+		long        utcOffset;	// seconds east of UTC
+		bool        isDst;
+		const char* abbr;		// owned by zone
+	};
+
+	/**
+	 * Load zone by its name (e.g. "Europe/Helsinki")
+	 *
+	 * Note that most of users should get zones through TzZoneCache.
+	 *
+	 * @return new zone with zero references or NULL if zone can't be loaded
+	 */
+	static TzZone* load(const char* tzName);
+
+	void ref() const;
+	void unref() const;
+
+	const std::string& name() const { return m_name; }
+
+	/**
+	 * Stat of zoneinfo file at the moment of load
+	 */
+	const struct stat& fileStat() const { return m_file.fileStat(); }
+	const std::string& filePath() const { return m_file.filePath(); }
+
+	/**
+	 * Zone pack zone was loaded from (NULL for zoneinfo file)
+	 */
+	const TzPack* pack() const { return m_file.pack(); }
+
+	/**
+	 * Approximate memory usage of this zone including mapped zoneinfo file
+	 * (in bytes)
+	 */
+	size_t memoryUsage() const;
+
+	/**
+	 * Transitions recorded in zoneinfo file (sorted by time)
+	 */
+	size_t transitionCount() const { return m_file.transitionCount(); }
+	void transitionAt(size_t index, TzTransition& transition) const;
+
+	/**
+	 * Range [first, last) of transitions which occur during specified year
+	 * (in UTC). Constant time for years covered by zoneinfo file.
+	 */
+	void yearTransitions(int year, size_t& first, size_t& last) const;
+
+	/**
+	 * DST rules of POSIX TZ footer for year after last transition
+	 *
+	 * @return false if there is no DST in effect by rules for that year
+	 */
+	bool yearRule(int year, long& stdOffset, long& dstOffset,
+	              int64_t& dstStart, int64_t& dstEnd) const;
+
+	/**
+	 * Find first transition (from zoneinfo file or from POSIX TZ footer
+	 * rule) after specified UTC time which changes offset, DST flag or
+	 * abbreviation
+	 *
+	 * @return false if local time rules never change after that time
+	 */
+	bool nextTransition(time_t utc, time_t& next) const;
+
+	/**
+	 * Find local time rules in effect at specified UTC time
+	 */
+	void lookup(time_t utc, LocalTimeInfo& info) const;
+
+	/**
+	 * Analog of localtime_r() for this zone
+	 *
+	 * Note that tm_zone of result points to storage owned by zone.
+	 */
+	bool toLocal(time_t utc, struct tm& local) const;
+
+	/**
+	 * Analog of mktime() for this zone
+	 *
+	 * Fields of local are normalized like mktime() does. tm_isdst resolves
+	 * ambiguous local times (0 - standard, positive - DST, negative - any).
+	 * Non-existing local times (inside DST gap) are shifted forward.
+	 */
+	bool toUtc(const struct tm& local, time_t& utc) const;
+
+private:
+	struct RuleDate
+	{
+		enum Kind { Julian1, Julian0, MonthWeekDay } kind;
+		int  day;
+		int  week;
+		int  month;
+		long time;	// local time of day in seconds
+	};
+
+	/**
+	 * POSIX TZ rule (footer of v2+ files) used after last transition
+	 */
+	struct PosixRule
+	{
+		bool        valid;
+		bool        hasDst;
+		long        stdOffset;
+		long        dstOffset;
+		std::string stdAbbr;
+		std::string dstAbbr;
+		RuleDate    start;
+		RuleDate    end;
+	};
+
+	TzZone(const std::string& name);
+	~TzZone() {}
+	TzZone(const TzZone &);
+	TzZone &operator=(const TzZone &);
+
+	static bool parsePosixRule(const char* p, PosixRule& rule);
+	void ruleTransitions(int year, int64_t& dstStart, int64_t& dstEnd) const;
+	void ruleLookup(int64_t utc, LocalTimeInfo& info) const;
+	void typeLookup(int type, LocalTimeInfo& info) const;
+	void lookupAt(int64_t utc, LocalTimeInfo& info) const;
+	bool recordedTransition(int64_t utc, int64_t& next) const;
+	void buildYearIndex();
+
+private:
+	std::string m_name;
+	TzFile      m_file;
+	PosixRule   m_rule;
+
+	mutable int m_refCount;
+
+	// m_yearIndex[year - m_yearBase] is the first transition in that year
+	int                       m_yearBase;
+	std::vector<unsigned int> m_yearIndex;
+};
+
+/**
+ * Simple wrapper for shared zone handling
+ */
+class TzZoneRef
+{
+public:
+	TzZoneRef(const TzZone *zone = NULL) : m_zone(zone)
+	{ if (m_zone) m_zone->ref(); }
+
+	TzZoneRef(const TzZoneRef &zoneRef) : m_zone(zoneRef.m_zone)
+	{ if (m_zone) m_zone->ref(); }
+
+	~TzZoneRef()
+	{ if (m_zone) m_zone->unref(); }
+
+	TzZoneRef &operator=(const TzZoneRef &zoneRef)
+	{
+		if (zoneRef.m_zone) zoneRef.m_zone->ref();
+		if (m_zone) m_zone->unref();
+		m_zone = zoneRef.m_zone;
+		return *this;
+	}
+
+	const TzZone *get() const { return m_zone; }
+	const TzZone *operator->() const { return m_zone; }
+	bool isNull() const { return m_zone == NULL; }
+
+private:
+	const TzZone *m_zone;
+};
+
+#endif
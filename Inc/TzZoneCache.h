@@ -0,0 +1,109 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TzZoneCache.h
+ */
+
+#ifndef __TZZONECACHE_H
+#define __TZZONECACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <pthread.h>
+
+#include "TzZone.h"
+
+/**
+ * Process-wide cache of loaded zones keyed by zone name.
+ *
+ * Least recently used zones are evicted once memory limit is exceeded.
+ * Zoneinfo files of cached zones are re-checked from time to time, so
+ * tzdata updates are picked up without restart. Zones loaded from a zone
+ * pack are re-loaded once other pack becomes current. Safe to use from any
+ * thread.
+ */
+class TzZoneCache
+{
+public:
+	struct Stats
+	{
+		unsigned long hits;
+		unsigned long misses;
+		unsigned long evictions;
+		unsigned long invalidations;
+		size_t        zones;
+		size_t        memoryUsage;
+		size_t        memoryLimit;
+	};
+
+	static TzZoneCache* instance();
+
+	/**
+	 * Get zone by name, loading it on cache miss
+	 *
+	 * @return null reference if zone can't be loaded
+	 */
+	TzZoneRef get(const std::string& tzName);
+
+	/**
+	 * Set memory limit (in bytes) for cached zones
+	 */
+	void setMemoryLimit(size_t limit);
+
+	/**
+	 * Drop all cached zones (zones in use stay alive until released)
+	 */
+	void clear();
+
+	Stats stats() const;
+
+private:
+	typedef std::list<std::string> LruList;
+
+	struct Entry
+	{
+		TzZoneRef         zone;
+		size_t            memoryUsage;
+		time_t            lastCheck;	// monotonic time of last file check
+		LruList::iterator lruPos;
+	};
+
+	typedef std::map<std::string, Entry> EntryMap;
+
+	TzZoneCache();
+	~TzZoneCache();
+
+	bool isStale(Entry& entry, time_t now);
+	void insert(const std::string& tzName, const TzZoneRef& zone, time_t now);
+	void remove(EntryMap::iterator it);
+	void evict();
+
+private:
+	mutable pthread_mutex_t m_mutex;
+	EntryMap m_entries;
+	LruList  m_lru;	// most recently used first
+	size_t   m_memoryUsage;
+	size_t   m_memoryLimit;
+	Stats    m_stats;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file ZoneTransitionTimer.h
+ */
+
+#ifndef __ZONETRANSITIONTIMER_H
+#define __ZONETRANSITIONTIMER_H
+
+#include <string>
+#include <time.h>
+#include <glib.h>
+
+#include "SignalSlot.h"
+
+/**
+ * Wake-up at next transition (DST change) of current zone.
+ *
+ * Keeps zone part of TimeSnapshot up to date and fires reached once wall
+ * clock passes the transition. Timeouts of TimeClock follow monotonic
+ * clock, which stands still during suspend, so waits are split into at
+ * most maxWaitMs pieces and resume() must be called once device wakes up
+ * to catch a transition passed while suspended.
+ */
+class ZoneTransitionTimer
+{
+public:
+	static const guint maxWaitMs = 3600 * 1000;
+
+	ZoneTransitionTimer();
+	~ZoneTransitionTimer();
+
+	/**
+	 * Publish state of zone at current wall time and wait for its next
+	 * transition (empty name just stops the timer)
+	 */
+	void arm(const std::string& zoneName);
+
+	void stop();
+
+	/**
+	 * Re-check wall clock after suspend (transition may have been passed
+	 * while monotonic timeouts were stopped)
+	 */
+	void resume();
+
+	/**
+	 * UTC time of transition we wait for (0 if none)
+	 */
+	time_t nextTransition() const { return m_next; }
+
+	/**
+	 * Fired once wall clock reached next transition (timer is re-armed for
+	 * the following one before that)
+	 */
+	Signal<> reached;
+
+private:
+	static gboolean cbTimeout(gpointer data);
+
+	void schedule();
+	void check();
+	void cancel();
+
+	ZoneTransitionTimer(const ZoneTransitionTimer &);
+	ZoneTransitionTimer &operator=(const ZoneTransitionTimer &);
+
+private:
+	std::string m_zoneName;
+	GSource*    m_source;	// pending timeout
+	time_t      m_next;
+};
+
+#endif
@@ -17,6 +17,7 @@
 #include <ctime>
 
 #include "BroadcastTime.h"
+#include "TimeClock.h"
 
 BroadcastTime::BroadcastTime() :
     m_type(None),
@@ -28,7 +29,7 @@ bool BroadcastTime::set(time_t utc, time_t local, time_t stamp)
     // ensure that stamp only increases
     if (stamp < m_stamp) return false;
 
-    time_t currentTime = time(0);
+    time_t currentTime = TimeClock::instance()->wallSeconds();
     m_type = UtcAndLocal;
     m_utcOffset = utc - currentTime;
     m_localOffset = local - currentTime;
@@ -39,7 +40,7 @@ bool BroadcastTime::set(time_t utc, time_t local, time_t stamp)
 bool BroadcastTime::get(time_t &utc, time_t &local) const
 {
     if (m_type == None) return false;
-    time_t currentTime = time(0);
+    time_t currentTime = TimeClock::instance()->wallSeconds();
     utc = m_utcOffset + currentTime;
     local = m_localOffset + currentTime;
 	return true;
@@ -52,3 +53,25 @@ bool BroadcastTime::adjust(time_t offset)
     m_localOffset -= offset;
 	return true;
 }
+
+EffectiveBroadcastTime::EffectiveBroadcastTime() :
+    valid(false),
+    systemTimeUsed(false),
+    adjustedUtc(0),
+    local(0),
+    monotonicMs(0)
+{}
+
+bool EffectiveBroadcastTime::predicts(const EffectiveBroadcastTime &actual, int64_t toleranceMs) const
+{
+    if (!valid || !actual.valid) return false;
+    if (systemTimeUsed != actual.systemTimeUsed) return false;
+    if (systemTimeUsed && systemTimeSource != actual.systemTimeSource) return false;
+
+    int64_t elapsedMs = actual.monotonicMs - monotonicMs;
+    int64_t localErrorMs = (int64_t)(actual.local - local) * 1000 - elapsedMs;
+    int64_t utcErrorMs = (int64_t)(actual.adjustedUtc - adjustedUtc) * 1000 - elapsedMs;
+
+    return localErrorMs >= -toleranceMs && localErrorMs <= toleranceMs &&
+           utcErrorMs >= -toleranceMs && utcErrorMs <= toleranceMs;
+}
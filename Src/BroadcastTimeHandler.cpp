@@ -25,12 +25,11 @@
 #include <stdint.h>
 #include <pbnjson.hpp>
 
+#include "ClockHandler.h"
 #include "JSONUtils.h"
+#include "TimeClock.h"
 #include "TimePrefsHandler.h"
-
-// double macro extension to pre-process content
-#define STRINGIFY(content...) #content
-#define JSON(content...) STRINGIFY(content)
+#include "TimeSnapshot.h"
 
 #define SCHEMA_LOCALTIME { \
                     "type": "object", \
@@ -49,7 +48,9 @@
 
 namespace {
     const char *effectiveBroadcastKey = "effectiveBroadcastKey";
-    pbnjson::JSchemaFragment schemaGeneric("{}");
+    // subscribers extrapolate effective broadcast time from the last reply,
+    // so it is re-sent only once extrapolation is that much off
+    const int64_t effectiveTimeToleranceMs = 1000;
     pbnjson::JSchemaFragment schemaEmptyObject(JSON({"additionalProperties": false}));
     pbnjson::JSchemaFragment schemaSubscribeRequest(JSON({
         "properties": {
@@ -111,6 +112,10 @@ namespace {
                 "systemTimeSource": {
                     "type": "string",
                     "description": "Tag for clock system-time were synchronized with"
+                },
+                "monotonicMs": {
+                    "type": "integer",
+                    "description": "CLOCK_MONOTONIC time (in milliseconds) at which adjustedUtc and local were exact (it stops in suspend, so subscribers get new reply after resume)"
                 }
             },
             "required": [ "returnValue", "local" ],
@@ -118,28 +123,6 @@ namespace {
         }
     ));
 
-    bool reply(LSHandle* handle, LSMessage *message, const pbnjson::JValue &response, const pbnjson::JSchema &schema = schemaGeneric)
-    {
-        std::string serialized;
-
-        pbnjson::JGenerator serializer(NULL);
-        if (!serializer.toString(response, schema, serialized)) {
-            qCritical() << "JGenerator failed";
-            return false;
-        }
-
-        LSError lsError;
-        LSErrorInit(&lsError);
-        if (!LSMessageReply(handle, message, serialized.c_str(), &lsError))
-        {
-            qCritical() << "LSMessageReply failed, Error:" << lsError.message;
-            LSErrorFree (&lsError);
-            return false;
-        }
-
-        return true;
-    }
-
     time_t toLocal(time_t utc)
     {
         // this is unusual for Unix to store local time in time_t
@@ -166,32 +149,7 @@ namespace {
         return timelocal(&localTm);
     }
 
-    time_t toTimeT(const pbnjson::JValue &value)
-    {
-        // this check will be compiled-out due to static condition
-        if (sizeof(time_t) <= sizeof(int32_t))
-        {
-            return value.asNumber<int32_t>();
-        }
-        else
-        {
-            return value.asNumber<int64_t>();
-        }
-    }
-
-    pbnjson::JValue toJValue(time_t value)
-    {
-        // this check will be compiled-out due to static condition
-        if (sizeof(time_t) <= sizeof(int32_t))
-        {
-            return static_cast<int32_t>(value);
-        }
-        else
-        {
-            return static_cast<int64_t>(value);
-        }
-    }
-    pbnjson::JValue toJValue(struct tm &tmValue)
+    pbnjson::JValue localTimeToJValue(struct tm &tmValue)
     {
         pbnjson::JValue jValue = pbnjson::Object();
         jValue.put("year", tmValue.tm_year + 1900);
@@ -215,38 +173,48 @@ namespace {
         }
         else
         {
-            root.put("localtime", toJValue(tmLocal));
+            root.put("localtime", localTimeToJValue(tmLocal));
         }
     }
 
     /**
      * Builds JValue which represents answer to getEffectiveBroadcastTime
+     * and fills effective with what was answered
      *
      * @return false if error met and as result answer contains error info
      */
     bool answerEffectiveBroadcastTime(pbnjson::JValue &answer, const TimePrefsHandler &timePrefsHandler,
-                                                               const BroadcastTime &broadcastTime)
+                                                               const BroadcastTime &broadcastTime,
+                                                               EffectiveBroadcastTime &effective)
     {
+        // wall and monotonic clocks are sampled together so reply can be
+        // extrapolated by clients with sub-second precision
+        struct timespec wall, monotonic;
+        TimeClock::instance()->wallTime(wall);
+        TimeClock::instance()->monotonicTime(monotonic);
+        effective.monotonicMs = (int64_t)monotonic.tv_sec * 1000 + (monotonic.tv_nsec - wall.tv_nsec) / 1000000;
+
         time_t adjustedUtc, local;
         bool systemTimeUsed = false;
         if (timePrefsHandler.isSystemTimeBroadcastEffective())
         {
             // just use system local time (set by user)
-            adjustedUtc = time(0);
+            adjustedUtc = wall.tv_sec;
             local = toLocal(adjustedUtc);
             systemTimeUsed = true;
         }
         else
         {
-            if (!broadcastTime.get(adjustedUtc, local))
+            if (!broadcastTime.avail())
             {
                 qWarning() << "Internal logic error (failed to get broadcast time while it is reported avaialble)";
-                adjustedUtc = time(0);
+                adjustedUtc = wall.tv_sec;
                 local = toLocal(adjustedUtc);
                 systemTimeUsed = true;
             }
             else
             {
+                local = wall.tv_sec + broadcastTime.localOffset();
                 // Broadcast sends correct utc and local time (with correct time-zone).
                 // User may set time-zone in an incorrect value.
                 // So instead of using UTC from broadcast we convert broadcast
@@ -266,12 +234,19 @@ namespace {
 
         answer.put("adjustedUtc", toJValue(adjustedUtc));
         answer.put("local", toJValue(local));
+        answer.put("monotonicMs", effective.monotonicMs);
         addLocalTime(answer, local);
 
+        effective.valid = true;
+        effective.systemTimeUsed = systemTimeUsed;
+        effective.adjustedUtc = adjustedUtc;
+        effective.local = local;
+        effective.systemTimeSource.clear();
         if (systemTimeUsed)
         {
             // add additional information associated with system time
-            answer.put("systemTimeSource", TimePrefsHandler::instance()->getSystemTimeSource());
+            effective.systemTimeSource = TimePrefsHandler::instance()->getSystemTimeSource();
+            answer.put("systemTimeSource", effective.systemTimeSource);
         }
 
         return true;
@@ -292,11 +267,11 @@ bool TimePrefsHandler::cbSetBroadcastTime(LSHandle* handle, LSMessage *message,
     time_t utc = toTimeT(request["utc"]);
     time_t local = toTimeT(request["local"]);
 
-    time_t utcCurrent = time(0);
+    time_t utcCurrent = TimeClock::instance()->wallSeconds();
     time_t utcOffset = utc - utcCurrent;
 
     // assume that broadcast local time is correct and allow user to set wrong time-zone
-    time_t adjustedUtcOffset = toUtc(local) - time(0);
+    time_t adjustedUtcOffset = toUtc(local) - TimeClock::instance()->wallSeconds();
 
     PmLogInfo(sysServiceLogContext(), "SET_BROADCAST_TIME", 3,
         PMLOGKS("SENDER", LSMessageGetSenderServiceName(message)),
@@ -308,15 +283,16 @@ bool TimePrefsHandler::cbSetBroadcastTime(LSHandle* handle, LSMessage *message,
 
     if (!broadcastTime.set( utc, local, timePrefsHandler->currentStamp()))
     {
-        return reply(handle, message, createJsonReply(false, -2, "Failed to update broadcast time offsets"));
+        return replyJson(handle, message, createJsonReply(false, -2, "Failed to update broadcast time offsets"));
     }
+    TimeSnapshot::instance()->publishBroadcast(broadcastTime);
     if (!timePrefsHandler->isManualTimeUsed()) timePrefsHandler->postBroadcastEffectiveTimeChange();
 
     // TODO: add handling of local clocks in ClockHandler
-    timePrefsHandler->deprecatedClockChange.fire(adjustedUtcOffset, "broadcast-adjusted", utcCurrent);
-    timePrefsHandler->deprecatedClockChange.fire(utcOffset, "broadcast", utcCurrent);
+    timePrefsHandler->deprecatedClockChange.fire(ClockHandler::secondsOffset(adjustedUtcOffset), ClockHandler::broadcastAdjusted, utcCurrent);
+    timePrefsHandler->deprecatedClockChange.fire(ClockHandler::secondsOffset(utcOffset), "broadcast", utcCurrent);
 
-    return reply(handle, message, createJsonReply(true));
+    return replyJson(handle, message, createJsonReply(true));
 }
 
 bool TimePrefsHandler::cbGetBroadcastTime(LSHandle* handle, LSMessage *message,
@@ -330,7 +306,7 @@ bool TimePrefsHandler::cbGetBroadcastTime(LSHandle* handle, LSMessage *message,
     time_t utc, local;
     if (!broadcastTime.get(utc, local))
     {
-        return reply(handle, message, createJsonReply(false, -2, "No information available"));
+        return replyJson(handle, message, createJsonReply(false, -2, "No information available"));
     }
 
     pbnjson::JValue answer = pbnjson::Object();
@@ -339,7 +315,7 @@ bool TimePrefsHandler::cbGetBroadcastTime(LSHandle* handle, LSMessage *message,
     answer.put("local", toJValue(local));
     addLocalTime(answer, local);
 
-    return reply(handle, message, answer, schemaGetBroadcastTimeReply);
+    return replyJson(handle, message, answer, schemaGetBroadcastTimeReply);
 }
 
 bool TimePrefsHandler::cbGetEffectiveBroadcastTime(LSHandle* handle, LSMessage *message,
@@ -354,11 +330,12 @@ bool TimePrefsHandler::cbGetEffectiveBroadcastTime(LSHandle* handle, LSMessage *
     pbnjson::JValue request = parser.get();
 
     pbnjson::JValue answer = pbnjson::Object();
-    if (!answerEffectiveBroadcastTime(answer, *timePrefsHandler, broadcastTime))
+    EffectiveBroadcastTime effective;
+    if (!answerEffectiveBroadcastTime(answer, *timePrefsHandler, broadcastTime, effective))
     {
         // error?
         answer.put("returnValue", false);
-        return reply(handle, message, answer);
+        return replyJson(handle, message, answer);
     }
     answer.put("returnValue", true);
 
@@ -374,22 +351,37 @@ bool TimePrefsHandler::cbGetEffectiveBroadcastTime(LSHandle* handle, LSMessage *
         }
         LSErrorFree(&lsError);
         answer.put("subscribed", subscribed);
+
+        // first subscriber sets what following changes are compared with
+        if (subscribed && !timePrefsHandler->m_effectiveBroadcastTime.valid)
+        {
+            timePrefsHandler->m_effectiveBroadcastTime = effective;
+        }
     }
 
-    return reply(handle, message, answer, schemaGetBroadcastTimeReply);
+    return replyJson(handle, message, answer, schemaGetBroadcastTimeReply);
 }
 
 void TimePrefsHandler::postBroadcastEffectiveTimeChange()
 {
     pbnjson::JValue answer = pbnjson::Object();
+    EffectiveBroadcastTime effective;
 
     // ignore error (will be reported as one of the reply
-    if (!answerEffectiveBroadcastTime(answer, *this, m_broadcastTime))
+    if (!answerEffectiveBroadcastTime(answer, *this, m_broadcastTime, effective))
     {
         qWarning() << "Failed to prepare post answer for getEffectiveBroadcastTime subscription (ignoring)";
         return;
     }
 
+    // subscribers already know this time from extrapolation of last reply
+    if (m_effectiveBroadcastTime.predicts(effective, effectiveTimeToleranceMs))
+    {
+        PmLogDebug(sysServiceLogContext(), "Effective broadcast time is predicted by subscribers (not sent)");
+        return;
+    }
+    m_effectiveBroadcastTime = effective;
+
     std::string serialized;
 
     pbnjson::JGenerator serializer(NULL);
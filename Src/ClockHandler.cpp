@@ -22,12 +22,20 @@
  *  @file ClockHandler.cpp
  */
 
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <luna-service2/lunaservice.h>
 
 #include "Logging.h"
 #include "JSONUtils.h"
 
 #include "ClockHandler.h"
+#include "TimeClock.h"
+#include "TimeSnapshot.h"
 #include "TimePrefsHandler.h"
 
 namespace {
@@ -41,22 +49,249 @@ namespace {
 		{ 0, 0 },
 	};
 
+	const int64_t nsecPerSec = 1000000000LL;
+
+	// history of clock keeps that many samples not older than historyWindow
+	const size_t historySize = 8;
+	const int64_t historyWindow = 60 * 60 * nsecPerSec;
+
+	// sample that far from history (beyond its jitter) starts it anew
+	const int64_t historyBreak = 2 * nsecPerSec;
+
+	// clocks not updated for that long are not fused
+	const int64_t staleAge = 48 * 60 * 60 * nsecPerSec;
+
+	// how fast clock offset is assumed to go away with time since update
+	const double assumedDrift = 50e-6;
+
+	// error of rounding to whole seconds (or to milliseconds otherwise)
+	const double coarseVariance = 1e18 / 12;
+	const double fineVariance = 1e12 / 12;
+
+	// clocks farther than that (in standard deviations) from median are
+	// rejected
+	const double outlierSigmas = 4.0;
+
+	const char *journalPath = WEBOS_INSTALL_SYSMGR_LOCALSTATEDIR "/preferences/clockjournal";
+
+	int64_t bootStamp()
+	{
+		struct timespec ts;
+		TimeClock::instance()->bootTime(ts);
+		return ts.tv_sec * nsecPerSec + ts.tv_nsec;
+	}
+
+	double toSeconds(int64_t ns)
+	{
+		return (double)ns / nsecPerSec;
+	}
+
+	struct Candidate {
+		const std::string *tag;
+		int     priority;
+		time_t  lastUpdate;
+		int64_t estimate;
+		double  variance;
+		double  weight;
+
+		bool operator<(const Candidate &other) const { return estimate < other.estimate; }
+	};
+
 } // anonymous namespace
 
 const std::string ClockHandler::manual = "manual";
 const std::string ClockHandler::micom = "micom";
 const std::string ClockHandler::system = "system";
+const std::string ClockHandler::journal = "journal";
+const std::string ClockHandler::broadcastAdjusted = "broadcast-adjusted";
 const time_t ClockHandler::invalidTime = (time_t)-1;
-const time_t ClockHandler::invalidOffset = (time_t)LONG_MIN;
+const int64_t ClockHandler::invalidOffset = std::numeric_limits<int64_t>::min();
+
+time_t ClockHandler::offsetSeconds(int64_t offset)
+{
+	const int64_t halfSecond = 500000000LL;
+	return (offset + (offset < 0 ? -halfSecond : halfSecond)) / 1000000000LL;
+}
+
+bool ClockHandler::isFused(const std::string &clockTag)
+{
+	// manual is what user asked for, while micom and broadcast-adjusted only
+	// hold time of some other clock, so they never take part in fusion
+	return clockTag != manual && clockTag != micom && clockTag != system &&
+	       clockTag != broadcastAdjusted;
+}
+
+void ClockHandler::quality(const Clock &clock, int64_t now, Quality &quality)
+{
+	const std::deque<Sample> &history = clock.history;
+
+	quality.samples = history.size();
+	quality.estimate = clock.systemOffset;
+	quality.jitter = 0;
+	quality.age = 0;
+	quality.variance = 0;
+	quality.stale = true;
+	if (history.empty()) return;
+
+	// deviations from the newest sample are small even if offsets are not
+	const int64_t base = history.back().offset;
+	double sum = 0;
+	bool wholeSeconds = true;
+	for (size_t i = 0; i < history.size(); ++i)
+	{
+		sum += (double)(history[i].offset - base);
+		wholeSeconds = wholeSeconds && history[i].wholeSeconds;
+	}
+	double mean = sum / history.size();
+
+	double squares = 0;
+	for (size_t i = 0; i < history.size(); ++i)
+	{
+		double d = (double)(history[i].offset - base) - mean;
+		squares += d * d;
+	}
+	double jitterVariance = history.size() > 1 ? squares / (history.size() - 1) : 0;
+
+	quality.estimate = base + (int64_t)mean;
+	quality.jitter = (int64_t)sqrt(jitterVariance);
+	quality.age = now - history.back().stamp;
+
+	double driftError = quality.age * assumedDrift;
+	quality.variance = ((wholeSeconds ? coarseVariance : fineVariance) + jitterVariance) / history.size()
+	                 + driftError * driftError + clock.restoredVariance;
+	quality.stale = quality.age > staleAge;
+}
+
+bool ClockHandler::quality(const std::string &clockTag, Quality &quality) const
+{
+	ClocksMap::const_iterator it = m_clocks.find(clockTag);
+	if (it == m_clocks.end() || it->second.history.empty()) return false;
+
+	ClockHandler::quality(it->second, bootStamp(), quality);
+	return true;
+}
+
+bool ClockHandler::fuse(Fusion &fusion) const
+{
+	int64_t now = bootStamp();
+
+	std::vector<Candidate> candidates;
+	for (ClocksMap::const_iterator it = m_clocks.begin();
+	     it != m_clocks.end(); ++it)
+	{
+		const Clock &clock = it->second;
+		if (!isFused(it->first) || clock.systemOffset == invalidOffset) continue;
+
+		Quality q;
+		ClockHandler::quality(clock, now, q);
+		if (q.samples == 0 || q.stale) continue;
+
+		Candidate candidate;
+		candidate.tag = &it->first;
+		candidate.priority = clock.priority;
+		candidate.lastUpdate = clock.lastUpdate;
+		candidate.estimate = q.estimate;
+		candidate.variance = std::max(q.variance, 1.0);
+		candidate.weight = (std::max(clock.priority, 0) + 1) / candidate.variance;
+		candidates.push_back(candidate);
+	}
+
+	if (candidates.empty()) return false;
+
+	// weighted median is what most (by weight) of clocks agree with
+	std::sort(candidates.begin(), candidates.end());
+
+	double totalWeight = 0;
+	for (size_t i = 0; i < candidates.size(); ++i) totalWeight += candidates[i].weight;
+
+	size_t median = 0;
+	for (double weight = 0; median < candidates.size(); ++median)
+	{
+		weight += candidates[median].weight;
+		if (weight * 2 >= totalWeight) break;
+	}
+	if (median == candidates.size()) median = candidates.size() - 1;
+
+	const Candidate &reference = candidates[median];
+	double referenceSigma = sqrt(reference.variance);
+
+	double weights = 0, shift = 0, precision = 0;
+	const Candidate *dominant = 0;
+	fusion.sources.clear();
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		const Candidate &candidate = candidates[i];
+		double distance = (double)(candidate.estimate - reference.estimate);
+		if (fabs(distance) > outlierSigmas * (sqrt(candidate.variance) + referenceSigma))
+		{
+			PmLogDebug(sysServiceLogContext(),
+				"Clock %s rejected as %lld ns away from %s",
+				candidate.tag->c_str(), (long long)distance, reference.tag->c_str()
+			);
+			continue;
+		}
+
+		weights += candidate.weight;
+		shift += candidate.weight * distance;
+		precision += 1 / candidate.variance;
+		if (!dominant || candidate.weight > dominant->weight) dominant = &candidate;
+		fusion.sources.push_back(*candidate.tag);
+	}
+
+	// reference itself is never rejected
+	assert( dominant );
+
+	fusion.offset = reference.estimate + (int64_t)(shift / weights);
+	fusion.uncertainty = (int64_t)sqrt(1 / precision);
+	fusion.tag = *dominant->tag;
+	fusion.priority = dominant->priority;
+	fusion.lastUpdate = dominant->lastUpdate;
+	return true;
+}
+
+void ClockHandler::fireFused()
+{
+	Fusion fusion;
+	if (!fuse(fusion)) return;
+
+	PmLogDebug(sysServiceLogContext(),
+		"Fused %zu clocks to %lld +/- %lld ns on behalf of %s",
+		fusion.sources.size(), (long long)fusion.offset,
+		(long long)fusion.uncertainty, fusion.tag.c_str()
+	);
+
+	TimeSnapshot::instance()->publishSystemOffset(fusion.offset, fusion.uncertainty);
+
+	// offset we can't tell from zero is not worth touching system time
+	int64_t offset = fusion.offset;
+	if (offset > -fusion.uncertainty && offset < fusion.uncertainty) offset = 0;
+
+	clockChanged.fire(fusion.tag, fusion.priority, offset, fusion.lastUpdate);
+}
 
 ClockHandler::ClockHandler() :
-	m_manualOverride( false )
+	m_manualOverride( false ),
+	m_service( NULL ),
+	m_pushSource( 0 ),
+	m_systemShift( 0 ),
+	m_systemChanges( 0 ),
+	m_journal( journalPath )
 {
 	// we always have manual time-source
 	// assume priority 0 (the lowest non-negative)
 	setup(manual, 0);
 }
 
+ClockHandler::~ClockHandler()
+{
+	if (m_pushSource) g_source_remove(m_pushSource);
+}
+
+void ClockHandler::setJournalPath(const char* path)
+{
+	journalPath = path;
+}
+
 bool ClockHandler::setServiceHandle(LSPalmService* service)
 {
 	LSError lsError;
@@ -72,21 +307,48 @@ bool ClockHandler::setServiceHandle(LSPalmService* service)
 		return false;
 	}
 
+	LSHandle *handles[] = { LSPalmServiceGetPublicConnection(service),
+	                        LSPalmServiceGetPrivateConnection(service) };
+	for (size_t i = 0; i < sizeof(handles)/sizeof(handles[0]); ++i)
+	{
+		if (!LSSubscriptionSetCancelFunction(handles[i], &ClockHandler::cbCancel, this, &lsError))
+		{
+			PmLogError( sysServiceLogContext(), "CLOCK_CANCEL_REGISTER_FAIL", 1,
+			            PMLOGKS("MESSAGE", lsError.message),
+			            "Failed to register /clock/getTime subscription cancel handler" );
+			LSErrorFree(&lsError);
+		}
+	}
+
+	m_service = service;
 	return true;
 }
 
-void ClockHandler::adjust(time_t offset)
+void ClockHandler::adjust(int64_t offset)
 {
+	m_systemShift += offset;
+	++m_systemChanges;
+	allClocksChanged();
+
 	for (ClocksMap::iterator it = m_clocks.begin();
 	     it != m_clocks.end(); ++it)
 	{
 		if (it->second.systemOffset == invalidOffset) continue;
 		it->second.systemOffset -= offset; // maintain absolute time presented in diff from current one
+		std::deque<Sample> &history = it->second.history;
+		for (size_t i = 0; i < history.size(); ++i)
+		{
+			history[i].offset -= offset;
+		}
 		if (it->second.lastUpdate != invalidTime)
 		{
-			it->second.lastUpdate += offset; // maintain same distance from current time
+			it->second.lastUpdate += offsetSeconds(offset); // maintain same distance from current time
 		}
 	}
+
+	// readers on other threads see fused offset against new system time
+	Fusion fusion;
+	if (fuse(fusion)) TimeSnapshot::instance()->publishSystemOffset(fusion.offset, fusion.uncertainty);
 }
 void ClockHandler::manualOverride(bool enabled)
 {
@@ -96,6 +358,7 @@ void ClockHandler::manualOverride(bool enabled)
 	}
 
 	m_manualOverride = enabled;
+	clockChangedFor(manual);
 
 	if (!enabled)
 	{
@@ -107,21 +370,26 @@ void ClockHandler::manualOverride(bool enabled)
 			// even if they have initial offset set
 			if (it->second.lastUpdate == invalidTime) continue;
 
+			// automatic clocks are sent fused below
+			if (isFused(it->first)) continue;
+
 			const Clock &clock = it->second;
 
 			assert( clock.lastUpdate == invalidTime ||
 			        clock.systemOffset != invalidOffset ); // invariant of Clock
 
 			PmLogDebug(sysServiceLogContext(),
-				"Re-sending %s with %ld offset and %ld last update mark",
-				it->first.c_str(), clock.systemOffset, clock.lastUpdate
+				"Re-sending %s with %lld ns offset and %ld last update mark",
+				it->first.c_str(), (long long)clock.systemOffset, clock.lastUpdate
 			);
 			clockChanged.fire(it->first, clock.priority, clock.systemOffset, clock.lastUpdate);
 		}
+
+		fireFused();
 	}
 }
 
-void ClockHandler::setup(const std::string &clockTag, int priority, time_t offset /* = invalidOffset */)
+void ClockHandler::setup(const std::string &clockTag, int priority, int64_t offset /* = invalidOffset */)
 {
 	ClocksMap::iterator it = m_clocks.find(clockTag);
 	if (it != m_clocks.end())
@@ -129,7 +397,7 @@ void ClockHandler::setup(const std::string &clockTag, int priority, time_t offse
 		PmLogWarning( sysServiceLogContext(), "CLOCK_SETUP_OVERRIDE", 3,
 		              PMLOGKS("CLOCK_TAG", clockTag.c_str()),
 		              PMLOGKFV("PRIORITY", "%d", priority),
-		              PMLOGKFV("OFFSET", "%ld", offset),
+		              PMLOGKFV("OFFSET", "%lld", (long long)offset),
 		              "Trying to register already existing clock (overriding old params)" );
 
 		it->second.priority = priority;
@@ -139,22 +407,24 @@ void ClockHandler::setup(const std::string &clockTag, int priority, time_t offse
 			// That's a good question what time to set for lastUpdate.
 			// Follow rule that if we specified offset than we want it to be
 			// considered so set it to current time.
-			it->second.lastUpdate = time(0);
+			it->second.lastUpdate = TimeClock::instance()->wallSeconds();
 		}
 	}
 	else
 	{
-		m_clocks.insert(ClocksMap::value_type(clockTag, (Clock){ priority, offset, invalidTime }));
+		m_clocks.insert(ClocksMap::value_type(clockTag, Clock(priority, offset)));
 	}
 
+	clockChangedFor(clockTag);
+
 	PmLogDebug(sysServiceLogContext(), "Registered clock %s with priority %d", clockTag.c_str(), priority);
 }
 
-bool ClockHandler::update(time_t offset, const std::string &clockTag /* = manual */, time_t timeStamp /* = invalidTime */)
+bool ClockHandler::update(int64_t offset, const std::string &clockTag /* = manual */, time_t timeStamp /* = invalidTime */)
 {
 	PmLogInfo(sysServiceLogContext(), "CLOCK_UPDATE", 2,
 		PMLOGKS("SOURCE", clockTag.c_str()),
-		PMLOGKFV("SYSTEM_OFFSET", "%ld", offset),
+		PMLOGKFV("SYSTEM_OFFSET", "%lld", (long long)offset),
 		"ClockHandler::update() with time-stamp %ld",
 		timeStamp
 	);
@@ -163,7 +433,7 @@ bool ClockHandler::update(time_t offset, const std::string &clockTag /* = manual
 	if (it == m_clocks.end())
 	{
 		PmLogWarning( sysServiceLogContext(), "WRONG_CLOCK_UPDATE", 2,
-		              PMLOGKFV("OFFSET", "%ld", offset),
+		              PMLOGKFV("OFFSET", "%lld", (long long)offset),
 		              PMLOGKS("CLOCK_TAG", clockTag.c_str()),
 		              "Trying to update clock that is not registered" );
 		return false;
@@ -172,13 +442,13 @@ bool ClockHandler::update(time_t offset, const std::string &clockTag /* = manual
 	time_t prevTimeStamp = it->second.lastUpdate;
 	if (timeStamp == invalidTime)
 	{
-		timeStamp = time(0);
+		timeStamp = TimeClock::instance()->wallSeconds();
 	}
 	else if (prevTimeStamp != invalidTime && prevTimeStamp >= timeStamp)
 	{
 		PmLogInfo( sysServiceLogContext(), "CLOCK_UPDATE_OUTDATED", 2,
 		           PMLOGKS("SOURCE", clockTag.c_str()),
-		           PMLOGKFV("SYSTEM_OFFSET", "%ld", offset),
+		           PMLOGKFV("SYSTEM_OFFSET", "%lld", (long long)offset),
 		           "ClockHandler::update() silently ignores updates with outdated time-stamp %ld < %ld",
 		           timeStamp, it->second.lastUpdate );
 		return true;
@@ -188,11 +458,70 @@ bool ClockHandler::update(time_t offset, const std::string &clockTag /* = manual
 	clock.lastUpdate = timeStamp;
 	clock.systemOffset = offset;
 
-	clockChanged.fire( it->first, clock.priority, offset, clock.lastUpdate );
+	int64_t now = bootStamp();
+	Quality q;
+	quality(clock, now, q);
+	if (q.samples > 0 && llabs(offset - q.estimate) > historyBreak + (int64_t)(outlierSigmas * q.jitter))
+	{
+		// source changed its mind (e.g. was re-synchronized)
+		clock.history.clear();
+	}
+
+	Sample sample = { offset, now, offset % nsecPerSec == 0 };
+	clock.history.push_back(sample);
+	while ( clock.history.size() > historySize ||
+	        now - clock.history.front().stamp > historyWindow )
+	{
+		clock.history.pop_front();
+	}
+
+	clockChangedFor(it->first);
+	clockChangedFor(system);	// its time source may change
+
+	if (!isFused(it->first))
+	{
+		clockChanged.fire( it->first, clock.priority, offset, clock.lastUpdate );
+		return true;
+	}
+
+	if (it->first != journal)
+	{
+		quality(clock, now, q);
+		m_journal.record(it->first, q.estimate, (int64_t)sqrt(q.variance));
+	}
+
+	fireFused();
 
 	return true;
 }
 
+bool ClockHandler::restoreJournal()
+{
+	std::map<std::string, ClockJournal::Estimate> estimates;
+	ClockJournal::Estimate estimate;
+	if (!m_journal.restore(estimates) || !ClockJournal::best(estimates, estimate))
+	{
+		PmLogDebug(sysServiceLogContext(), "Nothing to restore from clock journal");
+		return false;
+	}
+
+	PmLogInfo(sysServiceLogContext(), "CLOCK_JOURNAL_RESTORE", 5,
+		PMLOGKS("SOURCE", estimate.tag.c_str()),
+		PMLOGKFV("SYSTEM_OFFSET", "%lld", (long long)estimate.offset),
+		PMLOGKFV("UNCERTAINTY", "%lld", (long long)estimate.uncertainty),
+		PMLOGKFV("SAME_BOOT", "%d", estimate.sameBoot),
+		PMLOGKFV("LOWER_BOUND", "%d", estimate.lowerBound),
+		"Restoring clock offset from journal"
+	);
+
+	// lowest priority of automatic clocks, so any real time-source wins
+	if (m_clocks.find(journal) == m_clocks.end()) setup(journal, 0);
+
+	Clock &clock = m_clocks.find(journal)->second;
+	clock.restoredVariance = (double)estimate.uncertainty * estimate.uncertainty;
+	return update(estimate.offset, journal);
+}
+
 // service handlers
 bool ClockHandler::cbSetTime(LSHandle* lshandle, LSMessage *message, void *user_data)
 {
@@ -216,12 +545,13 @@ bool ClockHandler::cbSetTime(LSHandle* lshandle, LSMessage *message, void *user_
 	(void) parser.get("source", source);
 	(void) parser.get("utc", utcInteger);
 
-	time_t systemOffset = (time_t)utcInteger - time(0);
+	// utc has whole seconds precision only
+	int64_t systemOffset = secondsOffset((time_t)utcInteger - TimeClock::instance()->wallSeconds());
 
 	PmLogInfo(sysServiceLogContext(), "SET_TIME", 3,
 		PMLOGKS("SENDER", LSMessageGetSenderServiceName(message)),
 		PMLOGKS("SOURCE", source.c_str()),
-		PMLOGKFV("UTC_OFFSET", "%ld", systemOffset),
+		PMLOGKFV("UTC_OFFSET", "%lld", (long long)systemOffset),
 		"/clock/setTime received with %s",
 		parser.getPayload()
 	);
@@ -257,38 +587,98 @@ bool ClockHandler::cbGetTime(LSHandle* lshandle, LSMessage *message, void *user_
 	assert( user_data );
 
 	LSMessageJsonParser parser( message, STRICT_SCHEMA(
-		PROPS_3(
+		PROPS_4(
 			WITHDEFAULT(source, string, "system"),
 			WITHDEFAULT(manualOverride, boolean, false),
-			OPTIONAL(fallback, string)
+			OPTIONAL(fallback, string),
+			WITHDEFAULT(subscribe, boolean, false)
 		)
 	));
 
 	if (!parser.parse(__FUNCTION__, lshandle, EValidateAndErrorAlways))
 		return true;
 
-	std::string source;
-	bool manualOverride;
+	TimeRequest request;
+	bool subscribe;
 	// rely on schema validation
-	(void) parser.get("source", source);
-	(void) parser.get("manualOverride", manualOverride);
+	(void) parser.get("source", request.source);
+	(void) parser.get("manualOverride", request.manualOverride);
+	(void) parser.get("subscribe", subscribe);
+	request.haveFallback = parser.get("fallback", request.fallback);
+
+	ClockHandler &handler = *static_cast<ClockHandler*>(user_data);
+
+	pbnjson::JValue reply;
+	std::string state;
+	handler.answerTime(request, reply, state);
+
+	if (subscribe)
+	{
+		// subscribers with same request share key (and replies)
+		std::string key = subscriptionKey(request);
+
+		LSError lsError;
+		LSErrorInit(&lsError);
+		bool subscribed = LSSubscriptionAdd(lshandle, key.c_str(), message, &lsError);
+		if (!subscribed)
+		{
+			PmLogError( sysServiceLogContext(), "GETTIME_SUBSCRIBE_FAIL", 1,
+			            PMLOGKS("REASON", lsError.message),
+			            "Failed to subscribe on /clock/getTime" );
+			LSErrorFree(&lsError);
+		}
+		else
+		{
+			handler.addSubscription(key, request, state);
+		}
+		reply.put("subscribed", subscribed);
+	}
+
+	LSError lsError;
+	LSErrorInit(&lsError);
+	if (!LSMessageReply(lshandle, message, jsonToString(reply,"{}").c_str(), &lsError))
+	{
+		PmLogError( sysServiceLogContext(), "GETTIME_REPLY_FAIL", 1,
+		            PMLOGKS("REASON", lsError.message),
+		            "Failed to send reply on /clock/getTime" );
+		LSErrorFree(&lsError);
+		return false;
+	}
+
+	return true;
+}
+
+bool ClockHandler::cbCancel(LSHandle* lshandle, LSMessage *message, void *user_data)
+{
+	assert( user_data );
 
-	std::string fallback;
-	bool haveFallback = parser.get("fallback", fallback);
+	// called for subscriptions of any category on that handle
+	const char *category = LSMessageGetCategory(message);
+	const char *method = LSMessageGetMethod(message);
+	if (!category || !method || strcmp(category, "/clock") != 0 || strcmp(method, "getTime") != 0)
+		return true;
 
+	// subscriber is still counted here, so drop keys left without
+	// subscribers from idle callback
 	ClockHandler &handler = *static_cast<ClockHandler*>(user_data);
+	handler.allClocksChanged();
+	return true;
+}
 
-	pbnjson::JValue reply = pbnjson::Object();
+void ClockHandler::answerTime(const TimeRequest &request, pbnjson::JValue &reply, std::string &state) const
+{
+	std::string source = request.source;
+	bool haveFallback = request.haveFallback;
 
 	bool isSystem = (source == system);
-	ClockHandler::ClocksMap::const_iterator it = handler.m_clocks.end();
+	ClocksMap::const_iterator it = m_clocks.end();
 
 	// override any source if manual override requested and system-wide user time selected
-	if (manualOverride && handler.m_manualOverride)
+	if (request.manualOverride && m_manualOverride)
 	{
-		it = handler.m_clocks.find(manual);
+		it = m_clocks.find(manual);
 		// if manual time is registered and set to some value
-		if (it != handler.m_clocks.end() && it->second.systemOffset != invalidOffset)
+		if (it != m_clocks.end() && it->second.systemOffset != invalidOffset)
 		{
 			// override if we have user time
 			source = manual;
@@ -298,25 +688,25 @@ bool ClockHandler::cbGetTime(LSHandle* lshandle, LSMessage *message, void *user_
 		else
 		{
 			// override found clock for "manual"
-			it = handler.m_clocks.end();
+			it = m_clocks.end();
 		}
 	}
 
-	if (it == handler.m_clocks.end())
+	if (it == m_clocks.end())
 	{
 		// find requested clock (if not overriden)
-		it = handler.m_clocks.find(source);
+		it = m_clocks.find(source);
 	}
 
 	// fallback logic
 	if ( haveFallback &&
-	     (it == handler.m_clocks.end() || it->second.systemOffset == invalidOffset) &&
+	     (it == m_clocks.end() || it->second.systemOffset == invalidOffset) &&
 	     !isSystem )
 	{
 		// lets replace our source with fallback
-		it = handler.m_clocks.find(fallback);
-		source = fallback;
-		isSystem = (fallback == system);
+		it = m_clocks.find(request.fallback);
+		source = request.fallback;
+		isSystem = (request.fallback == system);
 	}
 
 	if (isSystem) // special case
@@ -327,10 +717,32 @@ bool ClockHandler::cbGetTime(LSHandle* lshandle, LSMessage *message, void *user_
 		offset.put("value", 0);
 		offset.put("source", system);
 		reply.put("offset", offset);
-		reply.put("utc", (int64_t)time(0));
+		reply.put("utc", (int64_t)TimeClock::instance()->wallSeconds());
 		reply.put("systemTimeSource", TimePrefsHandler::instance()->getSystemTimeSource());
+
+		Fusion fusion;
+		if (fuse(fusion))
+		{
+			pbnjson::JValue sources = pbnjson::Array();
+			for (size_t i = 0; i < fusion.sources.size(); ++i)
+			{
+				sources.append(fusion.sources[i]);
+			}
+
+			pbnjson::JValue fused = pbnjson::Object();
+			fused.put("offset", toSeconds(fusion.offset));
+			fused.put("uncertainty", toSeconds(fusion.uncertainty));
+			fused.put("source", fusion.tag);
+			fused.put("sources", sources);
+			reply.put("fusion", fused);
+		}
+
+		// steps from same source change system time too
+		char changesState[16];
+		snprintf(changesState, sizeof(changesState), "%u", m_systemChanges);
+		state = system + "|" + TimePrefsHandler::instance()->getSystemTimeSource() + "|" + changesState;
 	}
-	else if (it == handler.m_clocks.end())
+	else if (it == m_clocks.end())
 	{
 		PmLogError( sysServiceLogContext(), "WRONG_CLOCK_GETTIME", 2,
 		            PMLOGKS("CLOCK_TAG", source.c_str()),
@@ -338,36 +750,176 @@ bool ClockHandler::cbGetTime(LSHandle* lshandle, LSMessage *message, void *user_
 		            "Trying to fetch clock that is not registered" );
 		reply = createJsonReply(false, 0, "Requested clock is not registered");
 		reply.put("source", source);
+
+		state = "|" + source;
 	}
 	else
 	{
+		char offsetState[32];
 		if (it->second.systemOffset == invalidOffset)
 		{
 			reply = createJsonReply(false, 0, "No time available for that clock");
+			offsetState[0] = '\0';
 		}
 		else
 		{
+			struct timespec now;
+			TimeClock::instance()->wallTime(now);
+			int64_t utc = secondsOffset(now.tv_sec) + now.tv_nsec + it->second.systemOffset;
+
 			reply = createJsonReply(true);
 			pbnjson::JValue offset = pbnjson::Object();
-			offset.put("value", (int64_t)it->second.systemOffset);
+			offset.put("value", (int64_t)offsetSeconds(it->second.systemOffset));
 			offset.put("source", system);
 			reply.put("offset", offset);
-			reply.put("utc", (int64_t)(time(0) + it->second.systemOffset));
+			reply.put("utc", (int64_t)(utc / 1000000000LL - (utc % 1000000000LL < 0 ? 1 : 0)));
+			// offset which only follows system time changes is same clock
+			snprintf(offsetState, sizeof(offsetState), "%lld", (long long)(it->second.systemOffset + m_systemShift));
 		}
 		reply.put("source", it->first);
 		reply.put("priority", it->second.priority);
+
+		Quality quality;
+		if (ClockHandler::quality(it->first, quality))
+		{
+			pbnjson::JValue q = pbnjson::Object();
+			q.put("samples", (int64_t)quality.samples);
+			q.put("estimate", toSeconds(quality.estimate));
+			q.put("jitter", toSeconds(quality.jitter));
+			q.put("age", toSeconds(quality.age));
+			q.put("error", sqrt(quality.variance) / nsecPerSec);
+			q.put("stale", quality.stale);
+			reply.put("quality", q);
+		}
+
+		char priorityState[16];
+		snprintf(priorityState, sizeof(priorityState), "%d", it->second.priority);
+		state = it->first + "|" + offsetState + "|" + priorityState;
 	}
+}
 
-	LSError lsError;
-	LSErrorInit(&lsError);
-	if (!LSMessageReply(lshandle, message, jsonToString(reply,"{}").c_str(), &lsError))
+std::string ClockHandler::subscriptionKey(const TimeRequest &request)
+{
+	std::string key = "/clock/getTime|" + request.source;
+	if (request.manualOverride) key += "|manualOverride";
+	if (request.haveFallback) key += "|fallback=" + request.fallback;
+	return key;
+}
+
+void ClockHandler::addSubscription(const std::string &key, const TimeRequest &request, const std::string &state)
+{
+	std::pair<Subscriptions::iterator, bool> inserted =
+		m_subscriptions.insert(Subscriptions::value_type(key, Subscription()));
+
+	Subscription &subscription = inserted.first->second;
+	subscription.request = request;
+	subscription.state = state;	// just sent to new subscriber
+
+	if (!inserted.second) return;
+
+	// clocks reply may depend on
+	m_subscriptionIndex[request.source].insert(key);
+	if (request.haveFallback) m_subscriptionIndex[request.fallback].insert(key);
+	if (request.manualOverride) m_subscriptionIndex[manual].insert(key);
+}
+
+void ClockHandler::removeSubscription(const std::string &key)
+{
+	Subscriptions::iterator it = m_subscriptions.find(key);
+	if (it == m_subscriptions.end()) return;
+
+	const TimeRequest &request = it->second.request;
+	const std::string *tags[] = { &request.source, &request.fallback, &manual };
+	for (size_t i = 0; i < sizeof(tags)/sizeof(tags[0]); ++i)
 	{
-		PmLogError( sysServiceLogContext(), "SETTIME_REPLY_FAIL", 1,
-		            PMLOGKS("REASON", lsError.message),
-		            "Failed to send reply on /clock/setTime" );
-		LSErrorFree(&lsError);
-		return false;
+		SubscriptionIndex::iterator index = m_subscriptionIndex.find(*tags[i]);
+		if (index == m_subscriptionIndex.end()) continue;
+
+		index->second.erase(key);
+		if (index->second.empty()) m_subscriptionIndex.erase(index);
 	}
 
-	return true;
+	m_subscriptions.erase(it);
+}
+
+void ClockHandler::clockChangedFor(const std::string &clockTag)
+{
+	if (m_subscriptions.empty()) return;
+
+	SubscriptionIndex::const_iterator index = m_subscriptionIndex.find(clockTag);
+	if (index == m_subscriptionIndex.end()) return;
+
+	m_changedSubscriptions.insert(index->second.begin(), index->second.end());
+	schedulePush();
+}
+
+void ClockHandler::allClocksChanged()
+{
+	if (m_subscriptions.empty()) return;
+
+	for (Subscriptions::const_iterator it = m_subscriptions.begin();
+	     it != m_subscriptions.end(); ++it)
+	{
+		m_changedSubscriptions.insert(it->first);
+	}
+	schedulePush();
+}
+
+void ClockHandler::schedulePush()
+{
+	// changes which come within same main loop iteration are sent at once
+	if (m_pushSource == 0)
+	{
+		m_pushSource = g_idle_add(&ClockHandler::cbPush, this);
+	}
+}
+
+gboolean ClockHandler::cbPush(gpointer user_data)
+{
+	ClockHandler &handler = *static_cast<ClockHandler*>(user_data);
+	handler.m_pushSource = 0;
+	handler.pushChanges();
+	return FALSE;
+}
+
+void ClockHandler::pushChanges()
+{
+	std::set<std::string> changed;
+	changed.swap(m_changedSubscriptions);
+
+	for (std::set<std::string>::const_iterator key = changed.begin();
+	     key != changed.end(); ++key)
+	{
+		Subscriptions::iterator it = m_subscriptions.find(*key);
+		if (it == m_subscriptions.end()) continue;
+
+		// all subscribers of that key are gone
+		if (m_service &&
+		    LSSubscriptionGetHandleSubscribersCount(LSPalmServiceGetPublicConnection(m_service), key->c_str()) == 0 &&
+		    LSSubscriptionGetHandleSubscribersCount(LSPalmServiceGetPrivateConnection(m_service), key->c_str()) == 0)
+		{
+			removeSubscription(*key);
+			continue;
+		}
+
+		pbnjson::JValue reply;
+		std::string state;
+		answerTime(it->second.request, reply, state);
+
+		// push only changes of clock (not just time passing by)
+		if (state == it->second.state) continue;
+		it->second.state = state;
+
+		reply.put("subscribed", true);
+
+		LSError lsError;
+		LSErrorInit(&lsError);
+		if (!LSSubscriptionRespond(m_service, key->c_str(), jsonToString(reply,"{}").c_str(), &lsError))
+		{
+			PmLogError( sysServiceLogContext(), "GETTIME_RESPOND_FAIL", 1,
+			            PMLOGKS("REASON", lsError.message),
+			            "Failed to send /clock/getTime subscription reply" );
+			LSErrorFree(&lsError);
+		}
+	}
 }
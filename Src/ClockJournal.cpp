@@ -0,0 +1,265 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file ClockJournal.cpp
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ClockJournal.h"
+#include "Logging.h"
+#include "TimeClock.h"
+
+namespace {
+	const uint32_t recordMagic = 0x4e524a43;	// "CJRN"
+
+	// ring of records (enough for latest records of all clocks)
+	const uint32_t slotCount = 32;
+
+	const int64_t nsecPerSec = 1000000000LL;
+
+	// same clock is recorded not more often than that unless offset moved
+	const int64_t recordInterval = 10 * 60 * nsecPerSec;
+	const int64_t recordJump = nsecPerSec / 10;
+
+	// offset drift within single boot (see ClockHandler)
+	const double assumedDrift = 50e-6;
+
+	// RTC keeping time while device is off (and reading it back in whole
+	// seconds)
+	const double rtcDrift = 100e-6;
+	const int64_t rtcError = nsecPerSec;
+
+	// uncertainty of time known to be not earlier than restored one
+	const int64_t lowerBoundUncertainty = 24 * 60 * 60 * nsecPerSec;
+
+	const char* bootIdPath = "/proc/sys/kernel/random/boot_id";
+
+	int64_t toNs(const struct timespec& ts)
+	{
+		return (int64_t)ts.tv_sec * nsecPerSec + ts.tv_nsec;
+	}
+
+	// sequence numbers may wrap
+	bool isNewer(uint32_t a, uint32_t b)
+	{
+		return (int32_t)(a - b) > 0;
+	}
+}
+
+ClockJournal::ClockJournal(const char* path) :
+	m_path( path ),
+	m_fd( -1 ),
+	m_scanned( false ),
+	m_sequence( 0 )
+{
+	m_haveBootId = readBootId(m_bootId);
+}
+
+ClockJournal::~ClockJournal()
+{
+	if (m_fd >= 0) close(m_fd);
+}
+
+uint32_t ClockJournal::checksum(const Record& record)
+{
+	// FNV-1a over everything before checksum
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(&record);
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < offsetof(Record, checksum); ++i)
+	{
+		hash = (hash ^ p[i]) * 16777619u;
+	}
+	return hash;
+}
+
+bool ClockJournal::readBootId(char bootId[36])
+{
+	memset(bootId, 0, 36);
+
+	FILE* f = fopen(bootIdPath, "r");
+	if (!f) return false;
+	size_t n = fread(bootId, 1, 36, f);
+	fclose(f);
+	return n == 36;
+}
+
+bool ClockJournal::open()
+{
+	if (m_fd >= 0) return true;
+
+	m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (m_fd < 0)
+	{
+		PmLogError(sysServiceLogContext(), "CLOCK_JOURNAL_OPEN_FAIL", 2,
+		           PMLOGKS("PATH", m_path.c_str()),
+		           PMLOGKS("REASON", strerror(errno)),
+		           "Failed to open clock journal");
+		return false;
+	}
+	return true;
+}
+
+void ClockJournal::record(const std::string& tag, int64_t offset, int64_t uncertainty)
+{
+	struct timespec wall, boot;
+	if (!TimeClock::instance()->wallTime(wall) ||
+	    !TimeClock::instance()->bootTime(boot)) return;
+
+	std::map<std::string, Recorded>::iterator it = m_recorded.find(tag);
+	if (it != m_recorded.end() &&
+	    toNs(boot) - it->second.boot < recordInterval &&
+	    llabs(offset - it->second.offset) < recordJump)
+	{
+		return; // nothing new to tell after restart
+	}
+
+	if (!open()) return;
+
+	if (!m_scanned)
+	{
+		// continue sequence of records left by previous runs
+		std::map<std::string, Estimate> estimates;
+		(void) restore(estimates);
+	}
+
+	Record record;
+	memset(&record, 0, sizeof(record));
+	record.magic = recordMagic;
+	record.sequence = m_sequence + 1;
+	strncpy(record.tag, tag.c_str(), sizeof(record.tag) - 1);
+	record.offset = offset;
+	record.uncertainty = uncertainty;
+	record.wall = toNs(wall);
+	record.boot = toNs(boot);
+	memcpy(record.bootId, m_bootId, sizeof(record.bootId));
+	record.checksum = checksum(record);
+
+	off_t position = (off_t)(record.sequence % slotCount) * sizeof(Record);
+	if (pwrite(m_fd, &record, sizeof(record), position) != (ssize_t)sizeof(record))
+	{
+		PmLogError(sysServiceLogContext(), "CLOCK_JOURNAL_WRITE_FAIL", 1,
+		           PMLOGKS("REASON", strerror(errno)),
+		           "Failed to write clock journal record");
+		return;
+	}
+
+	m_sequence = record.sequence;
+	Recorded recorded = { offset, record.boot };
+	m_recorded[tag] = recorded;
+}
+
+bool ClockJournal::restore(std::map<std::string, Estimate>& estimates)
+{
+	estimates.clear();
+	if (!open()) return false;
+
+	std::vector<Record> records(slotCount);
+	ssize_t size = pread(m_fd, &records[0], slotCount * sizeof(Record), 0);
+	if (size < 0) size = 0;
+	records.resize(size / sizeof(Record));
+
+	// latest valid record of every clock
+	std::map<std::string, const Record*> latest;
+	bool haveSequence = false;
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		const Record& record = records[i];
+		if (record.magic != recordMagic || record.checksum != checksum(record)) continue;
+		if (record.tag[sizeof(record.tag) - 1] != '\0') continue;
+
+		if (!m_scanned && (!haveSequence || isNewer(record.sequence, m_sequence)))
+		{
+			m_sequence = record.sequence;
+			haveSequence = true;
+		}
+
+		const Record*& newest = latest[record.tag];
+		if (!newest || isNewer(record.sequence, newest->sequence)) newest = &record;
+	}
+	m_scanned = true;
+
+	struct timespec wallTs, bootTs;
+	if (!TimeClock::instance()->wallTime(wallTs) ||
+	    !TimeClock::instance()->bootTime(bootTs)) return false;
+	int64_t wall = toNs(wallTs);
+	int64_t boot = toNs(bootTs);
+
+	for (std::map<std::string, const Record*>::const_iterator it = latest.begin();
+	     it != latest.end(); ++it)
+	{
+		const Record& record = *it->second;
+		int64_t sourceTime = record.wall + record.offset;	// when recorded
+
+		Estimate estimate;
+		estimate.tag = it->first;
+		estimate.sameBoot = m_haveBootId && boot >= record.boot &&
+		                    memcmp(record.bootId, m_bootId, sizeof(record.bootId)) == 0;
+		estimate.lowerBound = false;
+
+		if (estimate.sameBoot)
+		{
+			// boot time kept counting (even in suspend) since record
+			int64_t elapsed = boot - record.boot;
+			estimate.offset = sourceTime + elapsed - wall;
+			estimate.uncertainty = record.uncertainty + (int64_t)(elapsed * assumedDrift);
+		}
+		else if (wall - record.wall >= boot)
+		{
+			// RTC kept system time through reboot (at least our uptime passed)
+			int64_t elapsed = wall - record.wall;
+			estimate.offset = record.offset;
+			estimate.uncertainty = record.uncertainty + rtcError + (int64_t)(elapsed * rtcDrift);
+		}
+		else
+		{
+			// RTC lost time, so we only know it is not earlier than record
+			estimate.offset = sourceTime + boot - wall;
+			estimate.uncertainty = lowerBoundUncertainty;
+			estimate.lowerBound = true;
+		}
+
+		estimates[estimate.tag] = estimate;
+	}
+
+	return !estimates.empty();
+}
+
+bool ClockJournal::best(const std::map<std::string, Estimate>& estimates, Estimate& estimate)
+{
+	const Estimate* best = NULL;
+	for (std::map<std::string, Estimate>::const_iterator it = estimates.begin();
+	     it != estimates.end(); ++it)
+	{
+		if (!best || it->second.uncertainty < best->uncertainty) best = &it->second;
+	}
+	if (!best) return false;
+
+	estimate = *best;
+	return true;
+}
@@ -76,6 +76,28 @@ std::string	jsonToString(pbnjson::JValue & reply, const char * schema)
 	return serialized;
 }
 
+pbnjson::JSchemaFragment schemaGeneric(SCHEMA_ANY);
+
+bool replyJson(LSHandle * handle, LSMessage * message, const pbnjson::JValue & response, const pbnjson::JSchema & schema)
+{
+	std::string serialized;
+
+	pbnjson::JGenerator serializer(NULL);
+	if (!serializer.toString(response, schema, serialized)) {
+		qCritical() << "JGenerator failed";
+		return false;
+	}
+
+	CLSError lserror;
+	if (!LSMessageReply(handle, message, serialized.c_str(), &lserror))
+	{
+		qCritical() << "LSMessageReply failed, Error:" << lserror.message;
+		lserror.Free();
+		return false;
+	}
+	return true;
+}
+
 LSMessageJsonParser::LSMessageJsonParser(LSMessage * message, const char * schema)
     : mMessage(message)
     , mSchemaText(schema)
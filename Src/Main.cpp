@@ -17,6 +17,8 @@
 
 #include <stdio.h>
 #include <glib.h>
+#include <glib-unix.h>
+#include <signal.h>
 #include <strings.h>
 #include <time.h>
 #include <syslog.h>
@@ -37,6 +39,7 @@
 #include "Mainloop.h"
 #include "ImageServices.h"
 #include "TimeZoneService.h"
+#include "TzZoneCache.h"
 #include "OsInfoService.h"
 #include "DeviceInfoService.h"
 
@@ -87,6 +90,19 @@ namespace {
 			int priority = sources.size()-1 - i + basePriority;
 			clockHandler.setup(sources[i], priority);
 		}
+
+		// plausible time right away rather than after bootstrap of real
+		// time-sources
+		(void) clockHandler.restoreJournal();
+	}
+
+	// SIGHUP picks up updated zone data (zone pack and timezone catalog)
+	gboolean onReloadZoneData(gpointer)
+	{
+		std::string errorText;
+		if (!TimePrefsHandler::instance()->reloadZoneData(errorText))
+			qWarning("zone data reload failed: %s", errorText.c_str());
+		return TRUE;
 	}
 } // anonymous namespace
 
@@ -346,8 +362,10 @@ int main(int argc, char ** argv)
 	}
 
 	//init the timezone service;
+	TzZoneCache::instance()->setMemoryLimit((size_t) Settings::settings()->m_zoneCacheSize * 1024);
 	TimeZoneService *tzSvc = TimeZoneService::instance();
 	tzSvc->setServiceHandle(serviceHandle);
+	(void) g_unix_signal_add(SIGHUP, onReloadZoneData, NULL);
 
         //init the osinfo service;
 	OsInfoService *osiSvc = OsInfoService::instance();
@@ -0,0 +1,111 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file MccZoneIndex.cpp
+ */
+
+#include <algorithm>
+#include <string>
+
+#include "MccZoneIndex.h"
+#include "TimeZoneCatalog.h"
+
+void MccZoneIndex::build(const ZoneList& zones, const MccZoneMap& mccZones)
+{
+	m_choices.clear();
+
+	//zones of each country per offset, in zone list order
+	typedef std::map<int, Candidates> OffsetZones;
+	std::map<std::string, OffsetZones> countryZones;
+	for (ZoneList::const_iterator it = zones.begin(); it != zones.end(); ++it)
+		countryZones[(*it)->countryCode][(*it)->offsetToUTC].push_back(*it);
+
+	for (MccZoneMap::const_iterator mccIt = mccZones.begin(); mccIt != mccZones.end(); ++mccIt) {
+		if (mccIt->second->countryCode.empty())
+			continue;
+
+		std::map<std::string, OffsetZones>::const_iterator country = countryZones.find(mccIt->second->countryCode);
+		if (country == countryZones.end())
+			continue;
+
+		for (OffsetZones::const_iterator it = country->second.begin(); it != country->second.end(); ++it) {
+			const Candidates& candidates = it->second;
+			Choice& choice = m_choices[Key(mccIt->first, it->first)];
+
+			//dst value only matters when some candidate has the same dstSupported value
+			int otherDst = 0;
+			for (size_t i = 0; i < candidates.size(); i++) {
+				int dst = candidates[i]->dstSupported;
+				otherDst = std::max(otherDst, dst + 1);
+
+				bool known = false;
+				for (size_t j = 0; j < choice.byDst.size(); j++)
+					known = known || (choice.byDst[j].first == dst);
+				if (!known)
+					choice.byDst.push_back(std::make_pair(dst, pick(candidates, dst)));
+			}
+			choice.otherDst = pick(candidates, otherDst);
+		}
+	}
+}
+
+const TimeZoneInfo* MccZoneIndex::find(int mcc, int offset, int dstValue) const
+{
+	std::map<Key,Choice>::const_iterator choice = m_choices.find(Key(mcc, offset));
+	if (choice == m_choices.end())
+		return NULL;
+
+	for (size_t i = 0; i < choice->second.byDst.size(); i++) {
+		if (choice->second.byDst[i].first == dstValue)
+			return choice->second.byDst[i].second;
+	}
+	return choice->second.otherDst;
+}
+
+const TimeZoneInfo* MccZoneIndex::pick(const Candidates& candidates, int dstValue)
+{
+	// First iteration: preferred and DST enabled
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (candidates[i]->preferred && candidates[i]->dstSupported == dstValue)
+			return candidates[i];
+	}
+
+	// Second iteration: DST enabled
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (candidates[i]->dstSupported == 1)
+			return candidates[i];
+	}
+
+	// Third iteration: just preferred
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (candidates[i]->preferred)
+			return candidates[i];
+	}
+
+	//  Fourth iteration: just matching DST
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (candidates[i]->dstSupported == dstValue)
+			return candidates[i];
+	}
+
+	// Finally: just the first in the list
+	return candidates.front();
+}
@@ -28,40 +28,52 @@
 #include "TimePrefsHandler.h"
 #include "ClockHandler.h"
 #include "NTPClock.h"
+#include "TimeClock.h"
 
+namespace {
+	const int64_t nsecPerSec = 1000000000LL;
 
-void NTPClock::postNTP(time_t offset)
-{
-	PmLogDebug(sysServiceLogContext(), "post NTP offset %ld", offset);
+	// for how long NTP time is reused if "NTPCacheTimeout" isn't set
+	const int defaultCacheTimeout = 60; // seconds
 
-	// send replies if any request waits for some
-	if (!requestMessages.empty())
+	unsigned short s_serverPort = 123;
+
+	int64_t bootStamp()
+	{
+		struct timespec ts;
+		TimeClock::instance()->bootTime(ts);
+		return ts.tv_sec * nsecPerSec + ts.tv_nsec;
+	}
+
+	std::string timeReply(time_t utc)
 	{
 		struct json_object *jsonOutput = json_object_new_object();
 		json_object_object_add(jsonOutput, "subscribed", json_object_new_boolean(false));  //no subscriptions on this; make that explicit!
 		json_object_object_add(jsonOutput, "returnValue", json_object_new_boolean(true));
-		json_object_object_add(jsonOutput, "utc", json_object_new_int(time(0) + offset));
-		const char *reply = json_object_to_json_string(jsonOutput);
+		json_object_object_add(jsonOutput, "utc", json_object_new_int(utc));
+		std::string reply = json_object_to_json_string(jsonOutput);
+		json_object_put(jsonOutput);
+		return reply;
+	}
+} // anonymous namespace
 
-		PmLogDebug(sysServiceLogContext(), "NTP reply: %s", reply);
+void NTPClock::setServerPort(unsigned short port)
+{
+	s_serverPort = port;
+}
 
-		// for each request
-		for (RequestMessages::iterator it = requestMessages.begin();
-			 it != requestMessages.end(); ++it)
-		{
-			PmLogDebug(sysServiceLogContext(), "post response on %p", it->get());
-			LS::Error lsError;
+void NTPClock::postNTP(int64_t offset)
+{
+	PmLogDebug(sysServiceLogContext(), "post NTP offset %lld ns", (long long)offset);
 
-			if (!LSMessageRespond(it->get(), reply, &lsError))
-			{
-				PmLogError(sysServiceLogContext(), "NTP_RESPOND_FAIL", 1,
-					PMLOGKS("REASON", lsError.message),
-					"Failed to send response for NTP query call"
-				);
-			}
-		}
-		json_object_put(jsonOutput);
-		requestMessages.clear();
+	// send replies if any request waits for some
+	if (!requestMessages.empty())
+	{
+		std::string reply = timeReply(TimeClock::instance()->wallSeconds() + ClockHandler::offsetSeconds(offset));
+
+		PmLogDebug(sysServiceLogContext(), "NTP reply: %s", reply.c_str());
+
+		respond(reply.c_str());
 	}
 
 	// post as a new value for "ntp"
@@ -75,18 +87,25 @@ void NTPClock::postError()
 	// nothing to do if no requests
 	if (requestMessages.empty()) return;
 
-	const char *reply = "{\"subscribed\":false,\"returnValue\":false,\"errorText\":\"Failed to get NTP time response\"}";
+	respond("{\"subscribed\":false,\"returnValue\":false,\"errorText\":\"Failed to get NTP time response\"}");
+}
+
+void NTPClock::respond(const char *reply)
+{
+	// requests which come while we respond belong to the next query
+	RequestMessages messages;
+	messages.swap(requestMessages);
 
 	// for each request
-	for (RequestMessages::iterator it = requestMessages.begin();
-		 it != requestMessages.end(); ++it)
+	for (RequestMessages::iterator it = messages.begin();
+		 it != messages.end(); ++it)
 	{
-		PmLogDebug(sysServiceLogContext(), "post error response on %p", it->get());
+		PmLogDebug(sysServiceLogContext(), "post response on %p", it->get());
 		LS::Error lsError;
 
 		if (!LSMessageRespond(it->get(), reply, &lsError))
 		{
-			PmLogError(sysServiceLogContext(), "NTP_ERROR_RESPOND_FAIL", 1,
+			PmLogError(sysServiceLogContext(), "NTP_RESPOND_FAIL", 1,
 				PMLOGKS("REASON", lsError.message),
 				"Failed to send response for NTP query call"
 			);
@@ -94,15 +113,53 @@ void NTPClock::postError()
 	}
 }
 
+bool NTPClock::cachedTime(int64_t &ntpTime) const
+{
+	if (!haveSample) return false;
+
+	int64_t age = bootStamp() - sampleStamp;
+	if (age < 0 || age >= sampleTtl) return false;
+
+	ntpTime = sampleTime + age;
+	return true;
+}
+
 bool NTPClock::requestNTP(LSMessage *message /* = NULL */)
 {
 	if (message)
 	{
+		++stats.requests;
+
+		int64_t ntpTime;
+		if (cachedTime(ntpTime))
+		{
+			++stats.cacheHits;
+
+			// round down to whole seconds
+			time_t utc = ntpTime / nsecPerSec - (ntpTime % nsecPerSec < 0 ? 1 : 0);
+			std::string reply = timeReply(utc);
+
+			PmLogDebug(sysServiceLogContext(), "NTP reply from cache: %s", reply.c_str());
+
+			LS::Error lsError;
+			if (!LSMessageRespond(message, reply.c_str(), &lsError))
+			{
+				PmLogError(sysServiceLogContext(), "NTP_RESPOND_FAIL", 1,
+					PMLOGKS("REASON", lsError.message),
+					"Failed to send response for NTP query call"
+				);
+				return false;
+			}
+			return true;
+		}
+
+		if (sntpClient.isActive()) ++stats.coalesced;
+
 		// postpone for further NTP time post
 		requestMessages.push_back(message);
 	}
 
-	if (sntpPid != -1)
+	if (sntpClient.isActive())
 	{
 		// already requested update
 		return true;
@@ -114,149 +171,99 @@ bool NTPClock::requestNTP(LSMessage *message /* = NULL */)
 		ntpServer = DEFAULT_NTP_SERVER;
 	}
 
-	std::string ntpServerTimeout;
-	if (!PrefsDb::instance()->getPref("NTPServerTimeout", ntpServerTimeout))
+	// several servers (separated by spaces or commas) are queried in parallel
+	std::vector<std::string> servers;
+	gchar **names = g_strsplit_set(ntpServer.c_str(), " ,", -1);
+	for (gchar **name = names; *name; ++name)
 	{
-		ntpServerTimeout = "2"; // seconds
+		if (**name) servers.push_back(*name);
 	}
+	g_strfreev(names);
 
-	gchar *argv[] = {
-		(gchar *)"sntp",
-		(gchar *)"-t",
-		(gchar *)ntpServerTimeout.c_str(),
-		(gchar *)"-d",
-		(gchar *)ntpServer.c_str(),
-		0
-	};
+	guint timeoutMs = 2000;
+	std::string ntpServerTimeout;
+	if (PrefsDb::instance()->getPref("NTPServerTimeout", ntpServerTimeout))
+	{
+		int seconds = atoi(ntpServerTimeout.c_str());
+		if (seconds > 0) timeoutMs = seconds * 1000;
+	}
 
 	PmLogDebug(sysServiceLogContext(),
-		"%s: running sntp on %s (timeout %s)",
+		"%s: querying %s (timeout %u ms)",
 		__FUNCTION__,
 		ntpServer.c_str(),
-		ntpServerTimeout.c_str()
-	);
-
-	gchar **envp = g_get_environ();
-
-	// override all locale related variables (LC_*)
-	envp = g_environ_setenv(envp, "LC_ALL", "C", true);
-
-	int fdOut;
-	GError *error;
-	gboolean ret = g_spawn_async_with_pipes(
-		/* workdir */ 0, argv, envp,
-		GSpawnFlags (G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD),
-		/* child_setup */ 0,
-		this, &sntpPid,
-		/* stdin */ 0, /* stdout */ &fdOut, /* stderr */ 0,
-		&error
+		timeoutMs
 	);
 
-	g_strfreev(envp);
-
-	if (!ret)
+	++stats.queries;
+	if (!sntpClient.query(servers, timeoutMs, s_serverPort))
 	{
-		PmLogError(sysServiceLogContext(), "SNTP_SPAWN_FAIL", 0,
-			"Failed to spawn sntp"
+		++stats.failures;
+		PmLogError(sysServiceLogContext(), "SNTP_QUERY_FAIL", 0,
+			"Failed to start SNTP query"
 		);
+		// retried with backoff like a query without answer
+		pollScheduler.failed();
 		postError();
 		return false;
 	}
 
-	g_child_watch_add( sntpPid, (GChildWatchFunc)cbChild, this);
-
-	GIOChannel *chOut = g_io_channel_unix_new(fdOut);
-	g_io_add_watch( chOut, GIOCondition (G_IO_IN | G_IO_HUP), (GIOFunc)cbStdout, this);
-
 	return true;
 }
 
 // callbacks
-void NTPClock::cbChild(GPid pid, gint status, NTPClock *ntpClock)
+void NTPClock::sntpFinished(bool succeeded, const SntpClient::Sample &sample)
 {
-	// move to new state
-	ntpClock->sntpPid = -1;
-	g_spawn_close_pid(pid);
-
-
-	std::string &sntpOutput = ntpClock->sntpOutput;
-
-	if (status != 0)
+	if (!succeeded)
 	{
-		PmLogDumpDataDebug(sysServiceLogContext(),
-			sntpOutput.data(), sntpOutput.size(),
-			kPmLogDumpFormatDefault
-		);
-		ntpClock->postError();
+		PmLogDebug(sysServiceLogContext(), "No valid answer from NTP servers");
+		++stats.failures;
+		logStats();
+		pollScheduler.failed();
+		postError();
 		return;
 	}
 
-	//success, maybe...parse the output
-
-	//sntp -d us.pool.ntp.org returns below offset.
-	//
-	//15 Aug 21:41:33 sntp[5529]: Started sntp
-	//Starting to read KoD file /var/db/ntp-kod...
-	//sntp sendpkt: Sending packet to 173.49.198.27... Packet sent.
-	//sntp recvpkt: packet received from 173.49.198.27 is not authentic. Authentication not enforced.
-	//sntp handle_pkt: Received 48 bytes from 173.49.198.27
-	//sntp offset_calculation:	t21: 0.099049		 t34: -0.110320
-	//        delta: 0.209369	 offset: -0.005636
-	//get time offset from sntp's return output : "offset: -0.005636"
-
-	static const char * const offsetStr = "offset: ";
-
-	size_t offsetIndex = sntpOutput.find(offsetStr);
-	if (offsetIndex == std::string::npos) {
-		//the query failed in some way
-		ntpClock->postError();
-		return;
-	}
+	PmLogDebug(sysServiceLogContext(),
+		"NTP sample from %s (%s): offset %lld ns, delay %lld ns, stratum %d",
+		sample.server.c_str(), sample.address.c_str(),
+		(long long) sample.offset, (long long) sample.delay, sample.stratum
+	);
 
-	const char *startptr = sntpOutput.c_str() + offsetIndex + strlen(offsetStr);
-	char *endptr = 0;
+	// before posting offset which results in correction of system time
+	pollScheduler.sampled(sample.offset);
 
-	PmLogDebug(sysServiceLogContext(), "offset: \"%.*s\"...", 20, startptr);
+	struct timespec now;
+	TimeClock::instance()->wallTime(now);
+	haveSample = true;
+	sampleTime = now.tv_sec * nsecPerSec + now.tv_nsec + sample.offset;
+	sampleStamp = bootStamp();
+	sampleTtl = defaultCacheTimeout * nsecPerSec;
 
-	time_t offsetValue = strtol(startptr, &endptr, /* base = */ 10);
-	if ( endptr == startptr ||
-	     (*endptr != '\0' && strchr(" \t#.", *endptr) == NULL) )
-	{
-		// either empty string interpreted as a number
-		// or string ends with unexpedted char
-		// consider that as error
-		ntpClock->postError();
-	}
-	else
+	std::string cacheTimeout;
+	if (PrefsDb::instance()->getPref("NTPCacheTimeout", cacheTimeout))
 	{
-		ntpClock->postNTP(offsetValue);
+		int seconds = atoi(cacheTimeout.c_str());
+		if (seconds >= 0) sampleTtl = seconds * nsecPerSec;
 	}
 
-	sntpOutput.clear();
-}
+	logStats();
 
-gboolean NTPClock::cbStdout(GIOChannel *channel, GIOCondition cond, NTPClock *ntpClock)
-{
-	if (cond == G_IO_HUP)
-	{
-		g_io_channel_unref(channel);
-		return false;
-	}
+	PmLogDebug(sysServiceLogContext(),
+		"NTP drift %.3f ppm (%s), poll interval %ld s",
+		pollScheduler.drift(),
+		pollScheduler.hasDrift() ? "estimated" : "unknown",
+		pollScheduler.interval()
+	);
 
-	while (true)
-	{
-		char buf[4096];
-		gsize bytesRead;
-		GIOStatus status = g_io_channel_read_chars(channel, buf, sizeof(buf), &bytesRead, 0);
-		if (status == G_IO_STATUS_AGAIN) continue;
-		else if (status == G_IO_STATUS_EOF) break;
-		else if (status == G_IO_STATUS_ERROR)
-		{
-			PmLogDebug(sysServiceLogContext(), "Error during read");
-			return false;
-		}
+	postNTP(sample.offset);
+}
 
-		ntpClock->sntpOutput.append(buf, bytesRead);
-	}
-	return true;
+void NTPClock::logStats() const
+{
+	PmLogDebug(sysServiceLogContext(),
+		"NTP requests: %u (%u from cache, %u joined query), queries: %u (%u failed)",
+		stats.requests, stats.cacheHits, stats.coalesced,
+		stats.queries, stats.failures
+	);
 }
@@ -0,0 +1,213 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file NTPPollScheduler.cpp
+ */
+
+#include <math.h>
+
+#include "NTPPollScheduler.h"
+#include "TimeClock.h"
+
+namespace {
+	const int64_t nsecPerSec = 1000000000LL;
+
+	// Error allowed to accumulate between polls. Half of the threshold below
+	// which corrections are slewed, so that regular corrections never step.
+	const double tolerance = 0.064; // seconds
+
+	// Samples closer than that are dominated by measurement noise and are
+	// not used for drift estimation
+	const time_t minDriftSpacing = 60;
+
+	// Error of offset predicted with estimated drift above that means
+	// drift itself has changed rather than measurement noise
+	const double driftChangeError = tolerance / 2; // seconds
+
+	// Quartz clocks are within that, so anything above means that time was
+	// changed without notice (or server is wrong)
+	const double maxDrift = 500.0; // ppm
+
+	// Drift below that is not measurable with interval we can afford
+	const double minDrift = 0.5; // ppm
+
+	// First retry after failed poll (doubled on each further failure)
+	const time_t retryInterval = 60;
+
+	// Poll is considered due when less than that is left (timers used for
+	// polling are not precise)
+	const time_t pollSlack = 10;
+
+	const time_t defaultMinInterval = 300;
+	const time_t defaultMaxInterval = 86399;
+} // anonymous namespace
+
+NTPPollScheduler::NTPPollScheduler() :
+	m_minInterval(defaultMinInterval),
+	m_maxInterval(defaultMaxInterval),
+	m_interval(defaultMinInterval),
+	m_synced(false),
+	m_expired(false),
+	m_lastSample(0),
+	m_lastOffset(0),
+	m_corrections(0),
+	m_lastPoll(0),
+	m_drift(0),
+	m_driftSamples(0),
+	m_failures(0),
+	m_lastFailure(0)
+{
+}
+
+void NTPPollScheduler::setLimits(time_t minInterval, time_t maxInterval)
+{
+	m_minInterval = minInterval > 0 ? minInterval : 1;
+	m_maxInterval = maxInterval > m_minInterval ? maxInterval : m_minInterval;
+
+	if (m_interval < m_minInterval) m_interval = m_minInterval;
+	if (m_interval > m_maxInterval) m_interval = m_maxInterval;
+}
+
+void NTPPollScheduler::sampled(int64_t offset)
+{
+	int64_t t = now();
+
+	m_failures = 0;
+	m_expired = false;
+	m_lastPoll = t;
+
+	if (m_synced)
+	{
+		int64_t elapsed = t - m_lastSample;
+		if (elapsed < minDriftSpacing * nsecPerSec)
+		{
+			// keep older sample as a reference for drift estimation
+			return;
+		}
+
+		// offset we would see now if system time wasn't corrected since
+		// last sample
+		double sample = (double)(offset - m_lastOffset + m_corrections) * 1e6 / elapsed;
+
+		// Start estimation from scratch if time was changed without notice
+		// or drift has changed (e.g. warm-up): averaging would lag behind
+		// with too long interval, and this sample mixes old and new drift.
+		if (fabs(sample) > maxDrift ||
+		    (m_driftSamples > 0 &&
+		     fabs(sample - m_drift) * 1e-6 * elapsed / nsecPerSec > driftChangeError))
+		{
+			m_drift = 0;
+			m_driftSamples = 0;
+		}
+		else
+		{
+			// average first samples, then follow changes (e.g. temperature)
+			unsigned int weight = m_driftSamples < 3 ? m_driftSamples + 1 : 4;
+			m_drift += (sample - m_drift) / weight;
+			++m_driftSamples;
+		}
+	}
+
+	m_synced = true;
+	m_lastSample = t;
+	m_lastOffset = offset;
+	m_corrections = 0;
+
+	updateInterval();
+}
+
+void NTPPollScheduler::failed()
+{
+	m_expired = false;
+	++m_failures;
+	m_lastFailure = now();
+}
+
+void NTPPollScheduler::corrected(int64_t delta)
+{
+	if (m_synced) m_corrections += delta;
+}
+
+void NTPPollScheduler::expire()
+{
+	m_expired = true;
+}
+
+time_t NTPPollScheduler::nextPollIn() const
+{
+	int64_t due;
+	if (m_expired)
+	{
+		return 0;
+	}
+	else if (m_failures > 0)
+	{
+		time_t backoff = m_interval;
+		if (m_failures <= 16 && (retryInterval << (m_failures - 1)) < backoff)
+		{
+			backoff = retryInterval << (m_failures - 1);
+		}
+		due = m_lastFailure + backoff * nsecPerSec;
+	}
+	else if (!m_synced)
+	{
+		return 0;
+	}
+	else
+	{
+		due = m_lastPoll + m_interval * nsecPerSec;
+	}
+
+	int64_t left = due - now();
+	if (left <= pollSlack * nsecPerSec) return 0;
+	return (time_t)((left + nsecPerSec - 1) / nsecPerSec);
+}
+
+int64_t NTPPollScheduler::now()
+{
+	struct timespec ts;
+	TimeClock::instance()->bootTime(ts);
+	return ts.tv_sec * nsecPerSec + ts.tv_nsec;
+}
+
+void NTPPollScheduler::updateInterval()
+{
+	if (!hasDrift())
+	{
+		// poll often until we know how clock behaves
+		m_interval = m_minInterval;
+		return;
+	}
+
+	double rate = fabs(m_drift);
+	if (rate < minDrift) rate = minDrift;
+
+	double target = tolerance * 1e6 / rate;
+
+	// shrink right away, but grow step by step as estimation of drift gets
+	// better with longer intervals
+	time_t interval = target < (double)m_maxInterval ? (time_t)target : m_maxInterval;
+	if (interval > m_interval * 2) interval = m_interval * 2;
+
+	if (interval < m_minInterval) interval = m_minInterval;
+	if (interval > m_maxInterval) interval = m_maxInterval;
+	m_interval = interval;
+}
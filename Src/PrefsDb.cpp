@@ -90,6 +90,7 @@ PrefsDb::PrefsDb()
 , m_standalone(false)
 , m_dbFilename(s_prefsDbPath)
 , m_deleteOnDestroy(false)
+, m_generation(0)
 {
     s_instance = this;
 	openPrefsDb();
@@ -100,6 +101,7 @@ PrefsDb::PrefsDb(const std::string& standaloneDbFilename)
 , m_standalone(true)
 , m_dbFilename(standaloneDbFilename)
 , m_deleteOnDestroy(false)
+, m_generation(0)
 {
 	openPrefsDb();
 }
@@ -149,6 +151,7 @@ bool PrefsDb::setPref(const std::string& key, const std::string& value)
 	}
 
 	sqlite3_free(queryStr);
+	++m_generation;
 
 	qDebug("set ( [%s] , [---, length %zu] )", key.c_str(), value.size());
 	return true;    
@@ -399,8 +402,10 @@ bool PrefsDb::runSqlCommand(const std::string& cmdStr)
         qWarning() << "Failed to execute cmd [" << queryStr << "] - extended error: [" << (pErrMsg ? pErrMsg : "<none>") << "]";
 		rc = false;
 	}
-	else
+	else {
 		rc = true;
+		++m_generation;
+	}
 
 	if (queryStr)
 		sqlite3_free(queryStr);
@@ -466,6 +471,9 @@ void PrefsDb::openPrefsDb()
 		return;
 	}
 
+	// defaults may be (re-)loaded and file itself may be replaced by now
+	++m_generation;
+
 	gchar* prefsDirPath = g_path_get_dirname(m_dbFilename.c_str());
 	g_mkdir_with_parents(prefsDirPath, 0755);
 	g_free(prefsDirPath);
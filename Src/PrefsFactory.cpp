@@ -674,11 +674,24 @@ Retrieve the list of valid values for the specified key. If the key is of a type
 \subsection com_palm_systemservice_get_preference_values_syntax Syntax:
 \code
 {
-    "key": string
+    "key": string,
+    "countryCode": string,
+    "offsetFromUTC": integer,
+    "prefix": string,
+    "start": integer,
+    "count": integer
 }
 \endcode
 
 \param key Key name.
+\param countryCode Only for "timeZone". Return only zones with this country code. Optional.
+\param offsetFromUTC Only for "timeZone". Return only zones with this offset (in minutes). Optional.
+\param prefix Only for "timeZone". Return only zones with ZoneID starting with this prefix. Optional.
+\param start Only for "timeZone". Index of first zone (among matching ones) to return. Optional, defaults to 0.
+\param count Only for "timeZone". Maximum number of zones to return. Optional, defaults to all.
+
+If any of the "timeZone" only parameters is specified, reply contains only
+matching entries of "timeZone" list and "total" number of matching entries.
 
 \subsection com_palm_systemservice_get_preference_value_returns Returns:
 \code
@@ -694,6 +707,7 @@ Retrieve the list of valid values for the specified key. If the key is of a type
 \subsection com_palm_systemservice_get_preference_value_examples Examples:
 \code
 luna-send -n 1 -f luna://com.palm.systemservice/getPreferenceValues '{"key": "wallpaper" }'
+luna-send -n 1 -f luna://com.palm.systemservice/getPreferenceValues '{"key": "timeZone", "countryCode": "FI", "start": 0, "count": 10 }'
 \endcode
 
 Example responses for succesful calls:
@@ -718,6 +732,23 @@ Example responses for succesful calls:
     "returnValue": true
 }
 \endcode
+\code
+{
+    "timeZone": [
+        {
+            "Country": "Finland",
+            "CountryCode": "FI",
+            "ZoneID": "Europe\/Helsinki",
+            "City": "Helsinki",
+            "Description": "Eastern European Time",
+            "offsetFromUTC": 120,
+            "supportsDST": 1
+        }
+    ],
+    "total": 1,
+    "returnValue": true
+}
+\endcode
 
 Example response for a failed call:
 \code
@@ -729,14 +760,15 @@ Example response for a failed call:
 static bool cbGetPreferenceValues(LSHandle* lsHandle, LSMessage* message,
 								  void* user_data)
 {
-    // {"key": string}
+    // {"key": string, "countryCode": string, "offsetFromUTC": integer, "prefix": string, "start": integer, "count": integer}
     VALIDATE_SCHEMA_AND_RETURN(lsHandle,
                                message,
-                               SCHEMA_1(REQUIRED(key, string)));
+                               SCHEMA_6(REQUIRED(key, string), OPTIONAL(countryCode, string), OPTIONAL(offsetFromUTC, integer), OPTIONAL(prefix, string), OPTIONAL(start, integer), OPTIONAL(count, integer)));
 
     bool retVal;
 	LSError lsError;
 	const char* reply = 0;
+	std::string serializedReply;
 	json_object* root = 0;
 	json_object* label = 0;
 	json_object* replyRoot = 0;
@@ -763,6 +795,12 @@ static bool cbGetPreferenceValues(LSHandle* lsHandle, LSMessage* message,
 	if (!handler)
 		goto Done;
 
+	if (handler->valuesReplyForKey(key, root, serializedReply)) {
+		reply = serializedReply.c_str();
+		success = true;
+		goto Done;
+	}
+
 	replyRoot = handler->valuesForKey(key);
 	if (!replyRoot || is_error(replyRoot))
 		goto Done;
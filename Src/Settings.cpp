@@ -46,6 +46,9 @@ bool Settings::initValues()
 	m_useComPalmImage2 = false;
 	m_image2svcAvailable = false;
 	m_comPalmImage2BinaryFile = ("/usr/bin/acuteimaging");
+	m_zoneCacheSize = 256;
+	m_zonePackFile = WEBOS_INSTALL_WEBOS_PREFIX "/tzdata.pack";
+	m_syncStatsLogInterval = 6 * 60 * 60;
 	return true;
 }
 
@@ -116,6 +119,11 @@ bool Settings::load(const char* settingsFile)
 	KEY_BOOLEAN("ImageService","useComPalmImage2",m_useComPalmImage2);
 	KEY_STRING("ImageService","comPalmImage2Binary",m_comPalmImage2BinaryFile);
 
+	KEY_INTEGER("TimeZone","zoneCacheSize",m_zoneCacheSize);
+	KEY_STRING("TimeZone","zonePack",m_zonePackFile);
+
+	KEY_INTEGER("Time","syncStatsLogInterval",m_syncStatsLogInterval);
+
     KEY_INTEGER("General", "schemaValidationOption", schemaValidationOption);
 
 	g_key_file_free( keyfile );
@@ -124,6 +132,18 @@ bool Settings::load(const char* settingsFile)
 
 bool Settings::postLoad()
 {
+	// zone cache keeps at least the zone in use; limit is applied in bytes
+	// so keep KiB value small enough for size_t on 32-bit targets
+	static const int maxZoneCacheSize = 64 * 1024;
+	if (m_zoneCacheSize < 0) {
+		g_warning("Invalid TimeZone/zoneCacheSize %d, using 256", m_zoneCacheSize);
+		m_zoneCacheSize = 256;
+	}
+	else if (m_zoneCacheSize > maxZoneCacheSize) {
+		g_warning("TimeZone/zoneCacheSize %d is too big, using %d", m_zoneCacheSize, maxZoneCacheSize);
+		m_zoneCacheSize = maxZoneCacheSize;
+	}
+
 	return true;
 }
 
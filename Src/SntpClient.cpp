@@ -0,0 +1,441 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file SntpClient.cpp
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "SntpClient.h"
+#include "TimeClock.h"
+
+namespace {
+	const size_t   packetSize = 48;
+	const size_t   maxAddressesPerServer = 4;	// e.g. for pool names
+	const int64_t  nsPerSecond = 1000000000LL;
+	const int64_t  ntpEpochOffset = 2208988800LL;	// 1900-01-01 to 1970-01-01 (s)
+
+	// packet fields
+	const size_t   rootDelayField = 4;
+	const size_t   rootDispersionField = 8;
+	const size_t   originateField = 24;
+	const size_t   receiveField = 32;
+	const size_t   transmitField = 40;
+
+	uint32_t word(const unsigned char* p)
+	{
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+	}
+
+	void putWord(unsigned char* p, uint32_t value)
+	{
+		p[0] = value >> 24;
+		p[1] = value >> 16;
+		p[2] = value >> 8;
+		p[3] = value;
+	}
+
+	/**
+	 * NTP timestamp (32.32 fixed point seconds since 1900) to nanoseconds
+	 * since Unix epoch. Seconds with MSB clear are in era 1 (from 2036).
+	 */
+	int64_t fromTimestamp(const unsigned char* p)
+	{
+		int64_t seconds = word(p);
+		if (seconds < 0x80000000LL)
+			seconds += 0x100000000LL;
+		return (seconds - ntpEpochOffset) * nsPerSecond + ((int64_t(word(p + 4)) * nsPerSecond) >> 32);
+	}
+
+	void toTimestamp(int64_t ns, unsigned char* p)
+	{
+		int64_t seconds = ns / nsPerSecond;
+		int64_t fraction = ns % nsPerSecond;
+		putWord(p, uint32_t(seconds + ntpEpochOffset));
+		putWord(p + 4, uint32_t((fraction << 32) / nsPerSecond));
+	}
+
+	/**
+	 * NTP short format (16.16 fixed point seconds) to nanoseconds
+	 */
+	int64_t fromShort(const unsigned char* p)
+	{
+		return (int64_t(word(p)) * nsPerSecond) >> 16;
+	}
+
+	int64_t nanoseconds(const struct timespec& ts)
+	{
+		return int64_t(ts.tv_sec) * nsPerSecond + ts.tv_nsec;
+	}
+
+	std::string numericAddress(const struct sockaddr* addr, socklen_t length)
+	{
+		char host[NI_MAXHOST];
+		if (getnameinfo(addr, length, host, sizeof(host), NULL, 0, NI_NUMERICHOST) != 0)
+			return std::string();
+		return host;
+	}
+
+	/**
+	 * Sample a is better than b: lower root distance, then lower stratum,
+	 * then lower delay. Root distances closer than 1 ms are considered
+	 * equal, so jitter of nearby servers doesn't outweigh stratum.
+	 */
+	bool isBetter(const SntpClient::Sample& a, const SntpClient::Sample& b)
+	{
+		const int64_t distanceTolerance = 1000000;
+		if (a.distance + distanceTolerance < b.distance)
+			return true;
+		if (b.distance + distanceTolerance < a.distance)
+			return false;
+		if (a.stratum != b.stratum)
+			return a.stratum < b.stratum;
+		return a.delay < b.delay;
+	}
+} // anonymous namespace
+
+/**
+ * Name resolution shared by client (main loop) and resolver thread
+ */
+struct SntpClient::Resolve
+{
+	struct Address
+	{
+		size_t                  server;
+		struct sockaddr_storage addr;
+		socklen_t               length;
+	};
+
+	volatile int             refCount;
+	SntpClient*              client;	// NULL once cancelled (main loop only)
+	unsigned short           port;
+	std::vector<std::string> servers;
+	std::vector<Address>     addresses;	// filled by resolver thread
+
+	void unref()
+	{
+		if (__sync_sub_and_fetch(&refCount, 1) == 0)
+			delete this;
+	}
+
+	static gpointer run(gpointer data)
+	{
+		Resolve* resolve = static_cast<Resolve*>(data);
+
+		char service[8];
+		snprintf(service, sizeof(service), "%u", resolve->port);
+
+		struct addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		hints.ai_flags = AI_ADDRCONFIG;
+
+		for (size_t i = 0; i < resolve->servers.size(); ++i) {
+			struct addrinfo* result = NULL;
+			if (getaddrinfo(resolve->servers[i].c_str(), service, &hints, &result) != 0)
+				continue;
+
+			size_t count = 0;
+			for (struct addrinfo* it = result; it && count < maxAddressesPerServer; it = it->ai_next) {
+				if (it->ai_addrlen > sizeof(struct sockaddr_storage))
+					continue;
+
+				Address address;
+				address.server = i;
+				memcpy(&address.addr, it->ai_addr, it->ai_addrlen);
+				address.length = it->ai_addrlen;
+				resolve->addresses.push_back(address);
+				++count;
+			}
+			freeaddrinfo(result);
+		}
+
+		// reference of this thread is passed to callback
+		g_idle_add(cbResolved, resolve);
+		return NULL;
+	}
+};
+
+/**
+ * Address waiting for answer
+ */
+struct SntpClient::Peer
+{
+	SntpClient*   client;
+	std::string   server;
+	std::string   address;
+	int           fd;
+	GIOChannel*   channel;
+	guint         watch;
+	unsigned char transmit[8];	// as sent, echoed back as originate time
+	int64_t       sentWall;
+	int64_t       sentMonotonic;
+};
+
+SntpClient::SntpClient() :
+	m_resolve( NULL ),
+	m_timeout( NULL )
+{
+}
+
+SntpClient::~SntpClient()
+{
+	cancel();
+}
+
+bool SntpClient::query(const std::vector<std::string>& servers, guint timeoutMs, unsigned short port)
+{
+	cancel();
+	m_samples.clear();
+
+	if (servers.empty())
+		return false;
+
+	Resolve* resolve = new Resolve;
+	resolve->refCount = 2;	// client and resolver thread
+	resolve->client = this;
+	resolve->port = port;
+	resolve->servers = servers;
+
+	GThread* thread = g_thread_try_new("sntp-resolver", Resolve::run, resolve, NULL);
+	if (!thread) {
+		delete resolve;
+		return false;
+	}
+	g_thread_unref(thread);
+	m_resolve = resolve;
+
+	// covers name resolution as well
+	m_timeout = TimeClock::instance()->createTimeout(timeoutMs);
+	g_source_set_callback(m_timeout, cbTimeout, this, NULL);
+	g_source_attach(m_timeout, NULL);
+
+	return true;
+}
+
+void SntpClient::cancel()
+{
+	for (size_t i = 0; i < m_peers.size(); ++i) {
+		Peer* peer = m_peers[i];
+		if (peer->watch)
+			g_source_remove(peer->watch);
+		g_io_channel_unref(peer->channel);
+		::close(peer->fd);
+		delete peer;
+	}
+	m_peers.clear();
+
+	if (m_timeout) {
+		g_source_destroy(m_timeout);
+		g_source_unref(m_timeout);
+		m_timeout = NULL;
+	}
+
+	if (m_resolve) {
+		m_resolve->client = NULL;
+		m_resolve->unref();
+		m_resolve = NULL;
+	}
+}
+
+gboolean SntpClient::cbResolved(gpointer data)
+{
+	Resolve* resolve = static_cast<Resolve*>(data);
+
+	if (resolve->client) {
+		SntpClient* client = resolve->client;
+		client->m_resolve = NULL;
+		resolve->unref();	// reference of client
+		client->start(*resolve);
+	}
+
+	resolve->unref();
+	return FALSE;
+}
+
+void SntpClient::start(const SntpClient::Resolve& resolve)
+{
+	for (size_t i = 0; i < resolve.addresses.size(); ++i) {
+		const Resolve::Address& address = resolve.addresses[i];
+
+		int fd = socket(address.addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			continue;
+
+		// connected socket gets datagrams of that server only
+		if (connect(fd, (const struct sockaddr*) &address.addr, address.length) != 0) {
+			::close(fd);
+			continue;
+		}
+
+		Peer* peer = new Peer;
+		peer->client = this;
+		peer->server = resolve.servers[address.server];
+		peer->address = numericAddress((const struct sockaddr*) &address.addr, address.length);
+		peer->fd = fd;
+
+		// client request: LI 0, version 4, mode 3 (client)
+		unsigned char packet[packetSize];
+		memset(packet, 0, sizeof(packet));
+		packet[0] = (0 << 6) | (4 << 3) | 3;
+
+		struct timespec wall, monotonic;
+		TimeClock::instance()->wallTime(wall);
+		TimeClock::instance()->monotonicTime(monotonic);
+		peer->sentWall = nanoseconds(wall);
+		peer->sentMonotonic = nanoseconds(monotonic);
+		toTimestamp(peer->sentWall, packet + transmitField);
+		memcpy(peer->transmit, packet + transmitField, sizeof(peer->transmit));
+
+		if (send(fd, packet, sizeof(packet), 0) != (ssize_t) sizeof(packet)) {
+			::close(fd);
+			delete peer;
+			continue;
+		}
+
+		peer->channel = g_io_channel_unix_new(fd);
+		peer->watch = g_io_add_watch(peer->channel, GIOCondition(G_IO_IN | G_IO_ERR | G_IO_HUP), cbReadable, peer);
+		m_peers.push_back(peer);
+	}
+
+	// nothing to wait for
+	if (m_peers.empty())
+		finish();
+}
+
+gboolean SntpClient::cbReadable(GIOChannel* channel, GIOCondition condition, gpointer data)
+{
+	Peer* peer = static_cast<Peer*>(data);
+
+	if ((condition & G_IO_IN) && peer->client->receive(*peer))
+		return TRUE;
+
+	// source goes away on return
+	peer->watch = 0;
+	peer->client->drop(peer);
+	return FALSE;
+}
+
+bool SntpClient::receive(SntpClient::Peer& peer)
+{
+	unsigned char packet[512];
+
+	while (true) {
+		ssize_t size = recv(peer.fd, packet, sizeof(packet), 0);
+		if (size < 0) {
+			// e.g. ICMP port unreachable reported on connected socket
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+
+		struct timespec monotonic;
+		TimeClock::instance()->monotonicTime(monotonic);
+
+		// stray datagram (e.g. late answer to previous request)
+		if ((size_t) size < packetSize ||
+			memcmp(packet + originateField, peer.transmit, sizeof(peer.transmit)) != 0)
+			continue;
+
+		int leap = packet[0] >> 6;
+		int version = (packet[0] >> 3) & 7;
+		int mode = packet[0] & 7;
+		int stratum = packet[1];
+
+		// unsynchronized server or kiss-o'-death (stratum 0) - no sample
+		if (mode != 4 || version < 1 || version > 4 || leap == 3 ||
+			stratum < 1 || stratum > 15 || word(packet + transmitField) == 0)
+			return false;
+
+		// wall clock is extrapolated by monotonic one, so clock steps
+		// during query don't affect result
+		int64_t t1 = peer.sentWall;
+		int64_t t2 = fromTimestamp(packet + receiveField);
+		int64_t t3 = fromTimestamp(packet + transmitField);
+		int64_t t4 = t1 + (nanoseconds(monotonic) - peer.sentMonotonic);
+
+		Sample sample;
+		sample.server = peer.server;
+		sample.address = peer.address;
+		sample.stratum = stratum;
+		sample.offset = ((t2 - t1) + (t3 - t4)) / 2;
+		sample.delay = (t4 - t1) - (t3 - t2);
+		if (sample.delay < 0)
+			sample.delay = 0;
+		sample.distance = (fromShort(packet + rootDelayField) + sample.delay) / 2 +
+		                  fromShort(packet + rootDispersionField);
+
+		m_samples.push_back(sample);
+		return false;
+	}
+}
+
+void SntpClient::drop(SntpClient::Peer* peer)
+{
+	for (size_t i = 0; i < m_peers.size(); ++i) {
+		if (m_peers[i] == peer) {
+			m_peers.erase(m_peers.begin() + i);
+			break;
+		}
+	}
+
+	if (peer->watch)
+		g_source_remove(peer->watch);
+	g_io_channel_unref(peer->channel);
+	::close(peer->fd);
+	delete peer;
+
+	// all answered
+	if (m_peers.empty() && !m_resolve)
+		finish();
+}
+
+gboolean SntpClient::cbTimeout(gpointer data)
+{
+	static_cast<SntpClient*>(data)->finish();
+	return FALSE;
+}
+
+void SntpClient::finish()
+{
+	cancel();
+
+	size_t best = m_samples.size();
+	for (size_t i = 0; i < m_samples.size(); ++i) {
+		if (best == m_samples.size() || isBetter(m_samples[i], m_samples[best]))
+			best = i;
+	}
+
+	// receivers may start next query right away
+	if (best == m_samples.size()) {
+		Sample none = Sample();
+		finished.fire(false, none);
+	}
+	else {
+		Sample sample = m_samples[best];
+		finished.fire(true, sample);
+	}
+}
@@ -0,0 +1,113 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file SystemTimeReply.cpp
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <cjson/json.h>
+
+#include "SystemTimeReply.h"
+#include "TimeClock.h"
+
+SystemTimeReply::SystemTimeReply() :
+	m_valid( false ),
+	m_utc( (time_t)-1 ),
+	m_offset( 0 ),
+	m_formatCount( 0 )
+{
+	memset(&m_local, 0, sizeof(m_local));
+}
+
+void SystemTimeReply::setTail(const std::string& tail)
+{
+	m_tail = tail;
+	m_zoneMembers.clear();
+	m_utc = (time_t)-1;
+	m_valid = true;
+}
+
+const std::string& SystemTimeReply::members(const char* zoneName)
+{
+	time_t utctime = TimeClock::instance()->wallSeconds();
+
+	if (m_utc == utctime)
+		return m_members;
+
+	// tzset() already called on initialization
+	struct tm localTm;
+	struct tm * pLocalTm = localtime_r(&utctime, &localTm);
+	assert( pLocalTm == &localTm );
+	(void) pLocalTm; // unused variable (in release)
+
+	// timegm() normalizes its argument as UTC (zone name, dst flag)
+	struct tm asUtc = localTm;
+	long offset = timegm(&asUtc) - utctime;
+
+	//zone abbreviation may only change along with offset or dst flag
+	if (m_zoneMembers.empty() || offset != m_offset || localTm.tm_isdst != m_local.tm_isdst) {
+		m_zoneMembers.clear();
+		if (zoneName) {
+			appendMember(m_zoneMembers, "timezone", json_object_new_string(zoneName));
+			//get current time zone abbreviation
+			char tzoneabbr_cstr[16];
+			strftime(tzoneabbr_cstr, 16,"%Z", &localTm);
+			appendMember(m_zoneMembers, "TZ", json_object_new_string(tzoneabbr_cstr));
+		}
+		else {
+			//default to something
+			appendMember(m_zoneMembers, "timezone", json_object_new_string("UTC"));
+			appendMember(m_zoneMembers, "TZ", json_object_new_string("UTC"));
+		}
+	}
+
+	m_utc = utctime;
+	m_local = localTm;
+	m_offset = offset;
+
+	char timeMembers[256];
+	snprintf(timeMembers, sizeof(timeMembers),
+			 "\"utc\":%ld,\"localtime\":{\"year\":%d,\"month\":%d,\"day\":%d,"
+			 "\"hour\":%d,\"minute\":%d,\"second\":%d},\"offset\":%ld,",
+			 (long)utctime, localTm.tm_year + 1900, localTm.tm_mon + 1, localTm.tm_mday,
+			 localTm.tm_hour, localTm.tm_min, localTm.tm_sec, offset / 60);
+
+	m_members = timeMembers;
+	m_members += m_zoneMembers;
+	m_members += ",";
+	m_members += m_tail;
+
+	++m_formatCount;
+	return m_members;
+}
+
+void SystemTimeReply::appendMember(std::string& text, const char* key, json_object* value)
+{
+	if (!text.empty())
+		text += ",";
+	text += "\"";
+	text += key;
+	text += "\":";
+	text += json_object_to_json_string(value);
+	json_object_put(value);
+}
@@ -0,0 +1,112 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+
+/**
+ *  @file TimeClock.cpp
+ */
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "TimeClock.h"
+
+namespace {
+	class SystemTimeClock : public TimeClock
+	{
+	public:
+		virtual bool wallTime(struct timespec& ts) const
+		{ return read(CLOCK_REALTIME, ts); }
+
+		virtual bool setWallTime(const struct timespec& ts)
+		{
+			struct timeval tv;
+			tv.tv_sec = ts.tv_sec;
+			tv.tv_usec = ts.tv_nsec / 1000;
+			return settimeofday(&tv, 0) == 0;
+		}
+
+		virtual bool slewWallTime(const struct timespec& delta, struct timespec* remaining)
+		{
+			// normalized timespec keeps tv_nsec non-negative and so does
+			// timeval expected by adjtime()
+			struct timeval tv;
+			tv.tv_sec = delta.tv_sec;
+			tv.tv_usec = delta.tv_nsec / 1000;
+
+			// adjtime() reports replaced correction only through olddelta
+			struct timeval old;
+			if (adjtime(&tv, &old) != 0)
+				return false;
+
+			if (remaining)
+			{
+				// olddelta may have both fields negative
+				int64_t usec = (int64_t) old.tv_sec * 1000000 + old.tv_usec;
+				remaining->tv_sec = usec / 1000000;
+				remaining->tv_nsec = (usec % 1000000) * 1000;
+				if (remaining->tv_nsec < 0)
+				{
+					remaining->tv_sec -= 1;
+					remaining->tv_nsec += 1000000000;
+				}
+			}
+			return true;
+		}
+
+		virtual bool monotonicTime(struct timespec& ts) const
+		{ return read(CLOCK_MONOTONIC, ts); }
+
+		virtual bool bootTime(struct timespec& ts) const
+		{ return read(CLOCK_BOOTTIME, ts); }
+
+		virtual GSource* createTimeout(guint intervalMs, bool coalesce) const
+		{
+			// rounded up, so coalesced timeout never fires before asked
+			if (coalesce && intervalMs >= 1000)
+				return g_timeout_source_new_seconds((intervalMs + 999) / 1000);
+			return g_timeout_source_new(intervalMs);
+		}
+
+	private:
+		static bool read(clockid_t clock, struct timespec& ts)
+		{
+			if (clock_gettime(clock, &ts) == 0)
+				return true;
+
+			ts.tv_sec = 0;
+			ts.tv_nsec = 0;
+			return false;
+		}
+	};
+
+	SystemTimeClock s_systemClock;
+	TimeClock* s_clock = &s_systemClock;
+} // anonymous namespace
+
+TimeClock* TimeClock::instance()
+{
+	return s_clock;
+}
+
+void TimeClock::setInstance(TimeClock* clock)
+{
+	s_clock = clock ? clock : &s_systemClock;
+}
@@ -0,0 +1,352 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeConversionHandler.cpp
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pbnjson.hpp>
+
+#include "JSONUtils.h"
+#include "Logging.h"
+#include "TimePrefsHandler.h"
+#include "TzZoneCache.h"
+
+namespace {
+	// keeps single reply within reasonable size
+	const ssize_t maxDates = 1000;
+
+	// schema for /time/convertDates
+	pbnjson::JSchemaFragment schemaConvertDates(JSON(
+		{
+			"type": "object",
+			"properties": {
+				"dates": {
+					"type": "array",
+					"items": { "type": [ "integer", "string" ] },
+					"description": "UTC times in seconds since epoch or local times of source_tz as strings"
+				},
+				"source_tz": {
+					"type": "string",
+					"optional": true
+				},
+				"dest_tz": {
+					"type": "string"
+				}
+			},
+			"required": [ "dates", "dest_tz" ],
+			"additionalProperties": false
+		}
+	));
+
+	/**
+	 * Zone by name (only names relative to zoneinfo directory are accepted)
+	 */
+	TzZoneRef zoneFromName(const std::string &name)
+	{
+		if (name.size() < 2 || name[0] == '/' || name[0] == '.' ||
+		    name.find("..") != std::string::npos)
+		{
+			return TzZoneRef();
+		}
+		return TzZoneCache::instance()->get(name);
+	}
+
+	bool parseNumber(const char *&p, int digits, int &value)
+	{
+		value = 0;
+		for (int i = 0; i < digits; ++i, ++p)
+		{
+			if (*p < '0' || *p > '9') return false;
+			value = value * 10 + (*p - '0');
+		}
+		return true;
+	}
+
+	/**
+	 * Parse "YYYY-MM-DD HH:MM:SS" or ISO 8601 "YYYY-MM-DDTHH:MM:SS[Z|+hh:mm|-hh:mm]"
+	 *
+	 * @param offset set to UTC offset (in seconds) of date if it has one
+	 * @param hasOffset set if date is UTC or has explicit UTC offset
+	 */
+	bool parseDate(const std::string &text, struct tm &local, bool &hasOffset, long &offset)
+	{
+		const char *p = text.c_str();
+		int year, month, day, hour, minute, second;
+
+		if (!parseNumber(p, 4, year) || *p++ != '-' ||
+		    !parseNumber(p, 2, month) || *p++ != '-' ||
+		    !parseNumber(p, 2, day) || (*p != 'T' && *p != ' '))
+		{
+			return false;
+		}
+		++p;
+		if (!parseNumber(p, 2, hour) || *p++ != ':' ||
+		    !parseNumber(p, 2, minute) || *p++ != ':' ||
+		    !parseNumber(p, 2, second))
+		{
+			return false;
+		}
+
+		hasOffset = false;
+		offset = 0;
+		if (*p == 'Z')
+		{
+			hasOffset = true;
+			++p;
+		}
+		else if (*p == '+' || *p == '-')
+		{
+			int sign = (*p++ == '-') ? -1 : 1;
+			int offsetHours, offsetMinutes;
+			if (!parseNumber(p, 2, offsetHours) || *p++ != ':' ||
+			    !parseNumber(p, 2, offsetMinutes) ||
+			    offsetHours > 23 || offsetMinutes > 59)
+			{
+				return false;
+			}
+			hasOffset = true;
+			offset = sign * (offsetHours * 3600L + offsetMinutes * 60L);
+		}
+		if (*p != '\0') return false;
+
+		if (month < 1 || month > 12 || day < 1 || day > 31 ||
+		    hour > 23 || minute > 59 || second > 60)
+		{
+			return false;
+		}
+
+		memset(&local, 0, sizeof(local));
+		local.tm_year = year - 1900;
+		local.tm_mon = month - 1;
+		local.tm_mday = day;
+		local.tm_hour = hour;
+		local.tm_min = minute;
+		local.tm_sec = second;
+		local.tm_isdst = -1;
+		return true;
+	}
+} // anonymous namespace
+
+/*!
+\page com_palm_systemservice_time
+\n
+\section com_palm_systemservice_time_convert_dates convertDates
+
+\e Public.
+
+com.palm.systemservice/time/convertDates
+
+Converts a batch of dates to local time of a timezone.
+
+\subsection com_palm_systemservice_time_convert_dates_syntax Syntax:
+\code
+{
+    "dates": [ int | string ],
+    "source_tz": string,
+    "dest_tz": string
+}
+\endcode
+
+\param dates Up to 1000 dates. Each is either UTC time in seconds since epoch
+             or local time of source_tz as string in format "Y-m-d H:M:S" or
+             "Y-m-dTH:M:S" (trailing "Z" marks UTC time, trailing "+hh:mm"
+             or "-hh:mm" gives explicit UTC offset). Required.
+\param source_tz Source timezone. Required only for local time strings.
+\param dest_tz Destination timezone. Required.
+
+\subsection com_palm_systemservice_time_convert_dates_returns Returns:
+\code
+{
+    "returnValue": boolean,
+    "utc": [ int ],
+    "dates": [ string ],
+    "offsets": [ int ],
+    "errors": [ { "index": int, "errorText": string } ],
+    "errorText": string
+}
+\endcode
+
+\param returnValue Indicates if the call was succesful.
+\param utc UTC time in seconds since epoch of each date (null if that date can't be converted).
+\param dates Local time of each date in dest_tz as "Y-m-dTH:M:S" (null if that date can't be converted).
+\param offsets Offset from UTC (in minutes) of dest_tz at each date (null if that date can't be converted).
+\param errors Dates which can't be converted (only present if any).
+\param errorText Description of the error if call was not succesful.
+
+\subsection com_palm_systemservice_time_convert_dates_examples Examples:
+\code
+luna-send -n 1 -f luna://com.palm.systemservice/time/convertDates '{ "dates": [ 408072333, "1982-12-06 17:25:33", "2014-13-01 00:00:00" ], "source_tz": "America/Los_Angeles", "dest_tz": "Europe/Helsinki" }'
+\endcode
+
+Example response for a succesful call:
+\code
+{
+    "returnValue": true,
+    "utc": [ 408072333, 408072333, null ],
+    "dates": [ "1982-12-07T03:25:33", "1982-12-07T03:25:33", null ],
+    "offsets": [ 120, 120, null ],
+    "errors": [
+        {
+            "index": 2,
+            "errorText": "unrecognized date format: '2014-13-01 00:00:00'"
+        }
+    ]
+}
+\endcode
+
+Example response for a failed call:
+\code
+{
+    "returnValue": false,
+    "errorCode": -1,
+    "errorText": "timezone not found: 'Finland'"
+}
+\endcode
+*/
+bool TimePrefsHandler::cbConvertDates(LSHandle* handle, LSMessage *message, void *userData)
+{
+	LSMessageJsonParser parser(message, schemaConvertDates);
+	if (!parser.parse("cbConvertDates", handle, EValidateAndErrorAlways)) return true;
+
+	pbnjson::JValue request = parser.get();
+	pbnjson::JValue dates = request["dates"];
+
+	if (dates.arraySize() > maxDates)
+	{
+		return replyJson(handle, message, createJsonReply(false, -1, "too many dates in one request"));
+	}
+
+	std::string destName = request["dest_tz"].asString();
+	TzZoneRef destZone = zoneFromName(destName);
+	if (destZone.isNull())
+	{
+		std::string errorText = "timezone not found: '" + destName + "'";
+		return replyJson(handle, message, createJsonReply(false, -1, errorText.c_str()));
+	}
+
+	// source zone matters only for local time strings
+	std::string sourceName;
+	TzZoneRef sourceZone;
+	if (parser.get("source_tz", sourceName))
+	{
+		sourceZone = zoneFromName(sourceName);
+		if (sourceZone.isNull())
+		{
+			std::string errorText = "timezone not found: '" + sourceName + "'";
+			return replyJson(handle, message, createJsonReply(false, -1, errorText.c_str()));
+		}
+	}
+
+	pbnjson::JValue utcList = pbnjson::Array();
+	pbnjson::JValue dateList = pbnjson::Array();
+	pbnjson::JValue offsetList = pbnjson::Array();
+	pbnjson::JValue errors = pbnjson::Array();
+
+	for (ssize_t i = 0; i < dates.arraySize(); ++i)
+	{
+		pbnjson::JValue date = dates[i];
+		std::string errorText;
+		time_t utc = 0;
+
+		if (date.isNumber())
+		{
+			utc = toTimeT(date);
+		}
+		else
+		{
+			std::string text = date.asString();
+			struct tm local;
+			bool hasOffset;
+			long offset;
+
+			if (!parseDate(text, local, hasOffset, offset))
+			{
+				errorText = "unrecognized date format: '" + text + "'";
+			}
+			else if (hasOffset)
+			{
+				// fields are range-checked by parseDate so -1 is a valid
+				// result (1969-12-31T23:59:59Z) unless errno reports overflow
+				errno = 0;
+				utc = timegm(&local);
+				if (utc == (time_t)-1 && errno != 0)
+				{
+					errorText = "date out of range: '" + text + "'";
+				}
+				else
+				{
+					utc -= offset;
+				}
+			}
+			else if (sourceZone.isNull())
+			{
+				errorText = "no source_tz for local date: '" + text + "'";
+			}
+			else if (!sourceZone->toUtc(local, utc))
+			{
+				errorText = "date out of range: '" + text + "'";
+			}
+		}
+
+		struct tm destTm;
+		if (errorText.empty() && !destZone->toLocal(utc, destTm))
+		{
+			errorText = "date out of range";
+		}
+
+		if (!errorText.empty())
+		{
+			pbnjson::JValue error = pbnjson::Object();
+			error.put("index", (int32_t)i);
+			error.put("errorText", errorText);
+			errors.append(error);
+
+			utcList.append(pbnjson::JValue());
+			dateList.append(pbnjson::JValue());
+			offsetList.append(pbnjson::JValue());
+			continue;
+		}
+
+		char destDate[32];
+		snprintf(destDate, sizeof(destDate), "%04d-%02d-%02dT%02d:%02d:%02d",
+		         destTm.tm_year + 1900, destTm.tm_mon + 1, destTm.tm_mday,
+		         destTm.tm_hour, destTm.tm_min, destTm.tm_sec);
+
+		utcList.append(toJValue(utc));
+		dateList.append(std::string(destDate));
+		offsetList.append((int32_t)(destTm.tm_gmtoff / 60));
+	}
+
+	pbnjson::JValue response = createJsonReply(true);
+	response.put("utc", utcList);
+	response.put("dates", dateList);
+	response.put("offsets", offsetList);
+	if (errors.arraySize() > 0)
+	{
+		response.put("errors", errors);
+	}
+
+	return replyJson(handle, message, response);
+}
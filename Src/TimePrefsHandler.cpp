@@ -27,7 +27,6 @@
 #include <string.h>
 #include <errno.h>
 #include <memory.h>
-#include <set>
 
 #if defined(HAVE_LUNA_PREFS)
 #include <lunaprefs.h>
@@ -37,6 +36,13 @@
 #include "PrefsDb.h"
 #include "PrefsFactory.h"
 #include "ClockHandler.h"
+#include "TimeClock.h"
+#include "TimeSnapshot.h"
+#include "TimeZoneCatalog.h"
+#include "TimeZoneService.h"
+#include "TzPack.h"
+#include "TzZoneCache.h"
+#include "Settings.h"
 #include "Logging.h"
 #include "Utils.h"
 #include "JSONUtils.h"
@@ -50,6 +56,8 @@ static const char*    s_zoneInfoFolder = "/usr/share/zoneinfo/";
 static const int      s_sysTimeNotificationThreshold = 3000; // 5 mins
 static const char*    s_logChannel = "TimePrefsHandler";
 static const char*    s_factoryTimeSource = "factory";
+static const time_t   s_minNtpPollInterval = 300;	// 5 mins
+static const time_t   s_minNtpWakeupInterval = 60;
 
 #define				  	ORIGIN_NITZ			"nitz"
 #define					HOURFORMAT_12		"HH12"
@@ -75,7 +83,8 @@ namespace {
 	const int lowestTimeSourcePriority = INT_MIN; // mark for overriding
 } // anonymous namespace
 
-json_object * TimePrefsHandler::s_timeZonesJson = NULL;
+static TimeZoneCatalog s_timeZoneCatalog;
+
 TimePrefsHandler * TimePrefsHandler::s_inst = NULL;
 
 extern GMainLoop * g_gmainLoop;
@@ -128,34 +137,14 @@ namespace {
 	time_t bootStart()
 	{
 		timespec ts_epoch, ts_boot;
-		bool haveTimes = (clock_gettime(CLOCK_REALTIME, &ts_epoch) == 0) &&
-		                 (clock_gettime(CLOCK_BOOTTIME, &ts_boot) == 0);
+		bool haveTimes = TimeClock::instance()->wallTime(ts_epoch) &&
+		                 TimeClock::instance()->bootTime(ts_boot);
 		// Note: we use beginning of epoch as a fake boot time if no way to get
 		//       one of required clocks
 		return haveTimes ? (ts_epoch.tv_sec - ts_boot.tv_sec) : (time_t)0;
 	}
 } // anonymous namespace
 
-static void
-print_tzvars (void)
-{
-    qDebug ("tzname[0]='%s' tzname[1]='%s' daylight='%d' timezone='%ld'", tzname[0], tzname[1], daylight, timezone);
-}
-
-
-static void
-set_tz(const char * tz) {
-    static gchar * env = NULL;
-    g_free(env);
-    env = g_strdup_printf("TZ=%s", tz);
-    putenv(env);
-    tzset();
-    
-    qDebug("%s: tz set to %s", __func__, tz);
-
-    print_tzvars();
-}
-
 static bool
 tz_exists(const char* tz_name) {
 #define ZONEINFO_PATH_PREFIX "/usr/share/zoneinfo/"
@@ -165,12 +154,78 @@ tz_exists(const char* tz_name) {
     g_return_val_if_fail(tz_name[0] != '.', false);
     g_return_val_if_fail(strstr(tz_name, "..") == NULL, false);
 
+    TzPackRef pack = TzPack::current();
+    const char* data;
+    size_t size;
+    if (!pack.isNull() && pack->find(tz_name, data, size))
+        return true;
+
     char *path = g_build_filename(ZONEINFO_PATH_PREFIX, tz_name, NULL);
     bool ret = g_file_test(path, G_FILE_TEST_IS_REGULAR);
     g_free(path);
     return ret;
 }
 
+/**
+ * Map zone pack (if any) configured by "TimeZone/zonePack" setting
+ */
+static TzPackRef
+loadZonePack()
+{
+	const std::string& path = Settings::settings()->m_zonePackFile;
+	TzPackRef pack(TzPack::load(path.c_str()));
+	if (!pack.isNull())
+		qDebug("%zu zones loaded from pack [%s]", pack->zoneCount(), path.c_str());
+	else if (access(path.c_str(), F_OK) == 0)
+		qWarning("invalid zone pack [%s], using zoneinfo files", path.c_str());
+	return pack;
+}
+
+/**
+ * Load timezone catalog from zone pack or from ext-timezones.json if there is
+ * no catalog in pack
+ */
+static bool
+loadTimeZoneCatalog(TimeZoneCatalog& catalog, const TzPackRef& pack)
+{
+	const char* source;
+	bool loaded;
+	if (!pack.isNull() && pack->catalogSize() > 0) {
+		source = pack->filePath().c_str();
+		loaded = catalog.loadText(pack->catalog(), pack->catalogSize());
+	}
+	else {
+		source = s_tzFile;
+		loaded = catalog.load(s_tzFile);
+	}
+
+	if (!loaded) {
+		qWarning("failed to load timezones from [%s]", source);
+		return false;
+	}
+
+	qDebug("%zu timezones loaded from [%s]",
+		   catalog.size(TimeZoneCatalog::Zones), source);
+	qDebug("%zu sys timezones loaded from [%s]",
+		   catalog.size(TimeZoneCatalog::SysZones), source);
+	qDebug("timezone catalog uses %zu bytes", catalog.memoryUsage());
+	return true;
+}
+
+/**
+ * Longest interval between automatic NTP polls (in seconds) configured by
+ * ".sysservice-time-autoNtpInterval" preference
+ */
+static uint32_t
+autoNtpInterval()
+{
+	std::string interval = PrefsDb::instance()->getPref(".sysservice-time-autoNtpInterval");
+	uint32_t timev = strtoul(interval.c_str(),NULL,10);
+	if ((timev < 300) || (timev > 86400))
+		timev = 86399;							//24 hour default (23h.59m.59s actually)
+	return timev;
+}
+
 static const char *
 _json_get_string(struct json_object *object, const char *label)
 {
@@ -185,21 +240,6 @@ _json_get_string(struct json_object *object, const char *label)
 }
 
 
-struct TimeZoneInfo
-{
-	bool operator==(const struct TimeZoneInfo& c) const {
-		return (name == c.name);
-	}
-	std::string name;
-	std::string countryCode;
-	std::string jsonStringValue;
-	int   	dstSupported;
-    int   	offsetToUTC;
-    bool 	preferred;					//if set to true, then pick this TZ is searching by offset vs any others
-    int		howManyZonesForCountry;		//how many offsets (incl. this one) does this country (based on countryCode) span? e.g. USA = 9
-
-};
-
 namespace {
 	TimeZoneInfo buildFailsafeDefaultZone()
 	{
@@ -231,10 +271,10 @@ struct PreferredZones
 	/* PreferredZones& operator=(const PreferredZones& c) = default; */
 
 	int 		   offset;
-	TimeZoneInfo * dstPref;
-	TimeZoneInfo * nonDstPref;
-	TimeZoneInfo * dstFallback;
-	TimeZoneInfo * nonDstFallback;
+	const TimeZoneInfo * dstPref;
+	const TimeZoneInfo * nonDstPref;
+	const TimeZoneInfo * dstFallback;
+	const TimeZoneInfo * nonDstFallback;
 };
 
 NitzParameters::NitzParameters()
@@ -262,12 +302,12 @@ NitzParameters::NitzParameters(struct tm& timeStruct,int offset,int dst,int mcc,
     , _localtimeStamp(remotetimeStamp)
 {
 	memcpy(&_timeStruct,&timeStruct,sizeof(timeStruct));
-	_localtimeStamp = time(NULL);
+	_localtimeStamp = TimeClock::instance()->wallSeconds();
 }
 
 void NitzParameters::stampTime()
 {
-	_localtimeStamp = time(NULL);
+	_localtimeStamp = TimeClock::instance()->wallSeconds();
 }
 
 bool NitzParameters::valid(uint32_t threshold)
@@ -313,6 +353,8 @@ static void tzsetWorkaround(const char * newTZ) __attribute__((unused));
  *   - \ref com_palm_systemservice_time_get_ntp_time
  *   - \ref com_palm_systemservice_time_set_time_with_ntp
  *   - \ref com_palm_systemservice_time_convert_date
+ *   - \ref com_palm_systemservice_time_convert_dates
+ *   - \ref com_palm_systemservice_time_reload_zone_data
  */
 static LSMethod s_methods[]  = {
 	{ "getSystemTime",     TimePrefsHandler::cbGetSystemTime },
@@ -323,6 +365,7 @@ static LSMethod s_methods[]  = {
 	{ "launchTimeChangeApps", TimePrefsHandler::cbLaunchTimeChangeApps},
 	{ "getNTPTime",			TimePrefsHandler::cbGetNTPTime},
 	{ "convertDate",		TimePrefsHandler::cbConvertDate},
+	{ "convertDates",		TimePrefsHandler::cbConvertDates},
     { 0, 0 },
 };
 
@@ -331,6 +374,8 @@ static LSMethod s_private_methods[]  = {
 	{ "setSystemNetworkTime", TimePrefsHandler::cbSetSystemNetworkTime },
 	{ "setBroadcastTime",     TimePrefsHandler::cbSetBroadcastTime },
 	{ "setTimeWithNTP",       TimePrefsHandler::cbSetTimeWithNTP },
+	{ "reloadZoneData",       TimePrefsHandler::cbReloadZoneData },
+	{ "getSyncStats",         TimePrefsHandler::cbGetSyncStats },
 	{ 0, 0 },
 };
 
@@ -358,16 +403,8 @@ static inline bool isSpaceOrNull(char v) {
 
 time_t TimePrefsHandler::currentStamp()
 {
-#if !defined(DESKTOP)
 	// FIXME: CLOCK_UPTIME doesn't work
-	struct timespec currTime;
-	::clock_gettime(CLOCK_MONOTONIC, &currTime);
-	return currTime.tv_sec;
-#else	
-	struct timespec currTime;
-	::clock_gettime(CLOCK_MONOTONIC, &currTime);
-	return currTime.tv_sec;
-#endif
+	return TimeClock::instance()->monotonicSeconds();
 }
 
 
@@ -385,12 +422,16 @@ TimePrefsHandler::TimePrefsHandler(LSPalmService* service)
     , m_gsource_periodic_id(0)
     , m_timeoutCycleCount(0)
     , m_sendWakeupSetToPowerD(true)
-	, m_lastNtpUpdate(0)
     , m_nitzTimeZoneAvailable(true)
+	, m_nitzPrefFlags(0)
+	, m_nitzStrictDstErrors(false)
+	, m_nitzPrefsValid(false)
+	, m_nitzPrefsGeneration(0)
 	, m_currentTimeSourcePriority(lowestTimeSourcePriority)
 	, m_nextSyncTime(0)
 	, m_systemTimeSourceTag(s_factoryTimeSource)
 	, m_ntpClock(*this)
+	, m_syncStatsSource(NULL)
 {
 	if (!s_inst)
 		s_inst=this;
@@ -400,7 +441,7 @@ TimePrefsHandler::TimePrefsHandler(LSPalmService* service)
 
 TimePrefsHandler::~TimePrefsHandler()
 {
-
+	if (m_syncStatsSource) g_source_destroy(m_syncStatsSource);
 }
 
 std::list<std::string> TimePrefsHandler::keys() const
@@ -553,71 +594,47 @@ json_object* TimePrefsHandler::valuesForKey(const std::string& key)
 	return ro;	
 }
 
-json_object * TimePrefsHandler::timeZoneListAsJson()
-{
-	if (TimePrefsHandler::s_timeZonesJson != NULL)
-		return json_object_get(TimePrefsHandler::s_timeZonesJson);		//"copy" it!
-
-	return (NULL);
-}
-
-bool TimePrefsHandler::isValidTimeZoneName(const std::string& tzName)
+bool TimePrefsHandler::valuesReplyForKey(const std::string& key, json_object* request, std::string& reply)
 {
-	if (TimePrefsHandler::s_timeZonesJson == NULL)
+	if ((key != "timeZone") || !s_timeZoneCatalog.isLoaded())
 		return false;
 
-	json_object * label = json_object_object_get(TimePrefsHandler::s_timeZonesJson, "timeZone");
-	if (!label || is_error(label)) {
-		return false;
-	}
+	TimeZoneCatalog::ValuesFilter filter;
 
-	array_list * srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-		return false;
-	}
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
+	json_object * label = json_object_object_get(request, "countryCode");
+	if (label && !is_error(label))
+		filter.countryCode = json_object_get_string(label);
 
-		//parse out the TZ name
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if (!label) {
-			continue;
-		}
-		const char * tzname = json_object_get_string(label);
-		if (tzname == NULL) {
-			continue;
-		}
-		if (tzName == tzname)
-			return true;
+	label = json_object_object_get(request, "offsetFromUTC");
+	if (label && !is_error(label)) {
+		filter.filterOffset = true;
+		filter.offset = json_object_get_int(label);
 	}
 
-	label = json_object_object_get(TimePrefsHandler::s_timeZonesJson, "syszones");
-	if (!label || is_error(label)) {
-		return false;
-	}
+	label = json_object_object_get(request, "prefix");
+	if (label && !is_error(label))
+		filter.prefix = json_object_get_string(label);
 
-	srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-		return false;
-	}
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
+	label = json_object_object_get(request, "start");
+	if (label && !is_error(label))
+		filter.start = json_object_get_int(label);
 
-		//parse out the TZ name
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if (!label) {
-			continue;
-		}
-		const char * tzname = json_object_get_string(label);
-		if (tzname == NULL) {
-			continue;
-		}
-		if (tzName == tzname)
-			return true;
-	}
+	label = json_object_object_get(request, "count");
+	if (label && !is_error(label))
+		filter.count = json_object_get_int(label);
 
-	return false;
+	s_timeZoneCatalog.valuesReply(filter, reply);
+	return true;
+}
+
+json_object * TimePrefsHandler::timeZoneListAsJson()
+{
+	return s_timeZoneCatalog.toJson();
+}
 
+bool TimePrefsHandler::isValidTimeZoneName(const std::string& tzName)
+{
+	return (s_timeZoneCatalog.zoneFromName(tzName) != NULL);
 }
 
 static json_object * presetValues_boolean()
@@ -700,54 +717,29 @@ static bool validateFor_timeZone( TimePrefsHandler * pTimePrefsHandler,const jso
  */
 std::string TimePrefsHandler::getDefaultTZFromJson(TimeZoneInfo * r_pZoneInfo)
 {
-	if (s_timeZonesJson == NULL)
+	//look for "default" boolean
+	//I actually don't care if it's true or false...its mere existence is enough to
+	//consider this a default.
+	int index = s_timeZoneCatalog.defaultZone();
+	if (index < 0)
 	{
 		if (r_pZoneInfo)
 			*r_pZoneInfo = s_failsafeDefaultZone;
 		return s_failsafeDefaultZone.jsonStringValue;
 	}
 
-	json_object * label = json_object_object_get(s_timeZonesJson, "timeZone");
-	if (!label || is_error(label)) {
-        qWarning() << "error on json object: it doesn't contain a timezones array";
-		if (r_pZoneInfo)
-			*r_pZoneInfo = s_failsafeDefaultZone;
-		return s_failsafeDefaultZone.jsonStringValue;
-	}
-
-	array_list * srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-        qWarning("error on json object: it doesn't contain a timezones array");
+	const unsigned required = TimeZoneCatalog::HasName | TimeZoneCatalog::HasOffset | TimeZoneCatalog::HasDst;
+	if ((s_timeZoneCatalog.flags(TimeZoneCatalog::Zones, index) & required) != required)
+	{
 		if (r_pZoneInfo)
 			*r_pZoneInfo = s_failsafeDefaultZone;
-		return s_failsafeDefaultZone.jsonStringValue;
-	}
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
-
-		//look for "default" boolean
-		label = json_object_object_get(obj,(char*)"default");
-		if (!label)
-			continue;
-
-		//found it - I actually don't care if it's true or false...its mere existence is enough to 
-		//consider this a default. 
-
-		if (r_pZoneInfo)
-		{
-			if (TimePrefsHandler::jsonUtil_ZoneFromJson(obj,*r_pZoneInfo) == false)
-			{
-				*r_pZoneInfo = s_failsafeDefaultZone;
-				return (s_failsafeDefaultZone.jsonStringValue);
-			}
-			else
-			    return (r_pZoneInfo->jsonStringValue);
-		}
+		return (s_failsafeDefaultZone.jsonStringValue);
 	}
 
+	const TimeZoneInfo& zone = s_timeZoneCatalog.zone(TimeZoneCatalog::Zones, index);
 	if (r_pZoneInfo)
-		*r_pZoneInfo = s_failsafeDefaultZone;
-	return s_failsafeDefaultZone.jsonStringValue;
+		*r_pZoneInfo = zone;
+	return zone.jsonStringValue;
 }
 
 //static
@@ -786,6 +778,11 @@ std::string TimePrefsHandler::transitionNITZValidState(bool nitzValid,bool userS
 	}
 
 	PrefsDb::instance()->setPref("nitzValidity",nextState);
+	if (s_inst)
+	{
+		if (nextState != currentState) ++s_inst->m_syncStats.nitzValidityChanges;
+		s_inst->invalidateSystemTime();
+	}
 	qDebug("transitioning [%s] -> [%s]",currentState.c_str(),nextState.c_str());
 
 	return currentState;
@@ -847,23 +844,10 @@ void TimePrefsHandler::init()
     m_serviceHandlePublic = LSPalmServiceGetPublicConnection(m_service);
     m_serviceHandlePrivate = LSPalmServiceGetPrivateConnection(m_service);
 
-	if (!s_timeZonesJson) {		//or else I'll leak
-		s_timeZonesJson = json_object_from_file(const_cast<char*>(s_tzFile));
-		if ((!s_timeZonesJson) || is_error(s_timeZonesJson))
-			s_timeZonesJson = NULL;
-		else {
-			json_object* ja = json_object_object_get(s_timeZonesJson,(char *)"timeZone");
-			if ((ja) && (!is_error(ja))) {
-				int s = json_object_array_length(ja);
-				qDebug("%d timezones loaded from [%s]",s,s_tzFile);
-			}
-			json_object* jsa = json_object_object_get(s_timeZonesJson,(char *)"syszones");
-			if ((jsa) && (!is_error(jsa))) {
-				int s = json_object_array_length(jsa);
-				qDebug("%d sys timezones loaded from [%s]",s,s_tzFile);
-			}
-
-		}
+	if (!s_timeZoneCatalog.isLoaded()) {
+		TzPackRef pack = loadZonePack();
+		TzPack::setCurrent(pack);
+		(void) loadTimeZoneCatalog(s_timeZoneCatalog, pack);
 	}
 
 	//load the default
@@ -933,6 +917,19 @@ void TimePrefsHandler::init()
 	NetworkConnectionListener::instance()->signalConnectionStateChanged.
 		connect(this, &TimePrefsHandler::slotNetworkConnectionStateChanged);
 
+	// NTPClock is connected first, so schedule is already updated here
+	m_ntpClock.sntpClient.finished.connect(this, &TimePrefsHandler::slotNtpPollFinished);
+
+	// zone transition timer doesn't run while suspended
+	m_zoneTransitionTimer.reached.connect(this, &TimePrefsHandler::slotZoneTransitionReached);
+	if (LSCall(m_serviceHandlePrivate, "palm://com.palm.lunabus/signal/addmatch",
+	           "{\"category\":\"/com/palm/power\", \"method\":\"resume\"}",
+	           cbPowerResume, this, NULL, &lsError) == false)
+	{
+		LSErrorFree(&lsError);
+	}
+
+	startSyncStatsLog();
 
     //kick off an initial timeout for time setting, for cases where TIL/modem won't be there
     startBootstrapCycle();
@@ -1049,71 +1046,26 @@ std::string TimePrefsHandler::tzNameFromJsonString(const std::string& TZJson)
 }
 
 /**
- * Scans s_timeZonesJson for ZoneID == tzName. Returns that json object as a string, or "" if none found
+ * Scans the zone catalog for ZoneID == tzName. Returns that json object as a string, or "" if none found
  * 
  * 
  */
 
 std::string TimePrefsHandler::getQualifiedTZIdFromName(const std::string& tzName)
 {
-	if ((tzName.length() == 0) || (s_timeZonesJson == NULL))
+	if (tzName.length() == 0)
 		return std::string("");
 
-	json_object * label = json_object_object_get(s_timeZonesJson, "timeZone");
-	if (!label || is_error(label)) {
-        qWarning() << "error on json object: it doesn't contain a timezones array";
+	const TimeZoneInfo * zone = s_timeZoneCatalog.zoneFromName(tzName);
+	if (zone == NULL)
 		return std::string("");
-	}
 
-	array_list * srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-        qWarning() << "error on json object: it doesn't contain a timezones array";
-		return std::string("");
-	}
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
-
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if ((!label) || (is_error(label)))
-			continue;
-
-		std::string zoneId = json_object_get_string(label);
-		if (zoneId == tzName)
-			return (std::string(json_object_to_json_string(obj)));
-
-	}
-
-	//try the sys zones
-
-	label = json_object_object_get(s_timeZonesJson, "syszones");
-	if (!label || is_error(label)) {
-        qWarning() << "error on json object: it doesn't contain a syszones array";
-		return std::string("");
-	}
-
-	srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-        qWarning() << "error on json object: it doesn't contain a syszones array";
-		return std::string("");
-	}	
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
-
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if ((!label) || (is_error(label)))
-			continue;
-
-		std::string zoneId = json_object_get_string(label);
-		if (zoneId == tzName)
-			return (std::string(json_object_to_json_string(obj)));
-	}
-		
-	return std::string("");
+	return zone->jsonStringValue;
 }
 
 std::string TimePrefsHandler::getQualifiedTZIdFromJson(const std::string& jsonTz)
 {
-	if ((jsonTz.length() == 0) || (s_timeZonesJson == NULL))
+	if (jsonTz.length() == 0)
 		return std::string("");
 
 	std::string tzName;
@@ -1134,142 +1086,45 @@ std::string TimePrefsHandler::getQualifiedTZIdFromJson(const std::string& jsonTz
 	}
 	json_object_put(jsontzRoot);
 
-	label = json_object_object_get(s_timeZonesJson, "timeZone");
-	if (!label || is_error(label)) {
-        qWarning() << "error on json object: it doesn't contain a timezones array";
-		return std::string("");
-	}
-
-	array_list * srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-        qWarning() << "error on json object: it doesn't contain a timezones array";
-		return std::string("");
-	}
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
-
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if ((!label) || (is_error(label)))
-			continue;
-
-		std::string zoneId = json_object_get_string(label);
-		if (zoneId == tzName)
-			return (std::string(json_object_to_json_string(obj)));
-
-	}
-
-	//try the sys zones
-
-	label = json_object_object_get(s_timeZonesJson, "syszones");
-	if (!label || is_error(label)) {
-        qWarning() << "error on json object: it doesn't contain a syszones array";
-		return std::string("");
-	}
-
-	srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-        qWarning() << "error on json object: it doesn't contain a syszones array";
+	const TimeZoneInfo * zone = s_timeZoneCatalog.zoneFromName(tzName);
+	if (zone == NULL)
 		return std::string("");
-	}	
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
 
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if ((!label) || (is_error(label)))
-			continue;
-
-		std::string zoneId = json_object_get_string(label);
-		if (zoneId == tzName)
-			return (std::string(json_object_to_json_string(obj)));
-	}
-
-	return std::string("");
+	return zone->jsonStringValue;
 }
 
-//a replacement for the scanTimeZoneFile so that I only need to deal with 1 file...see init() for where the json obj is created
+//a replacement for the scanTimeZoneFile so that I only need to deal with 1 file...see init() for where the catalog is loaded
 void TimePrefsHandler::scanTimeZoneJson()
 {
-	std::string name;
-	std::string countryCode;
-	int offset;
-	bool pref;
-	int supportsDst;
-	int mcc;
 	std::map<int,PreferredZones> tmpPrefZoneMap;
 	std::map<int,PreferredZones>::iterator tmpPrefZoneMapIter;
-	std::map<std::string,std::set<int> > tmpCountryZoneCounterMap;
 
-	if (s_timeZonesJson == NULL) {
+	//catalog may be re-scanned after reload (see reloadZoneData())
+	m_zoneList.clear();
+	m_syszoneList.clear();
+	m_zoneNameIndex.clear();
+	m_genericZoneMap.clear();
+	m_mccZoneInfoMap.clear();
+	m_mccOffsetZones.clear();
+	m_preferredTimeZoneMapDST.clear();
+	m_preferredTimeZoneMapNoDST.clear();
+	m_offsetZoneMultiMap.clear();
+
+	if (!s_timeZoneCatalog.isLoaded()) {
 	    qWarning () << "no json loaded";
 		return;
 	}
 
-	json_object * label = json_object_object_get(TimePrefsHandler::s_timeZonesJson, "timeZone");
-	if (!label || is_error(label)) {
-        qWarning() << "invalid json; missing timeZone array";
-		return;
-	}
-	else if (!(json_object_is_type(label,json_type_array))) {
-        qWarning() << "invalid json; timeZone is not an array";
-		return;
-	}
+	const unsigned zoneFields = TimeZoneCatalog::HasName | TimeZoneCatalog::HasOffset | TimeZoneCatalog::HasDst;
 
-	array_list * srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-        qWarning() << "invalid json; timeZone array invalid";
-		return;
-	}
-
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
-
-		if ((!obj) || (is_error(obj)))
-			continue;
-
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if ((!label) || (is_error(label))) {
-			continue;
-		}
-
-		name = json_object_get_string(label);
-
-		label = json_object_object_get(obj,(char*)"offsetFromUTC");
-		if ((!label) || (is_error(label))) {
-			continue;
-		}
-
-		offset = json_object_get_int(label);
-
-		label = json_object_object_get(obj,(char*)"supportsDST");
-		if ((!label) || (is_error(label))) {
+	for (size_t i = 0; i < s_timeZoneCatalog.size(TimeZoneCatalog::Zones); i++) {
+		if ((s_timeZoneCatalog.flags(TimeZoneCatalog::Zones, i) & zoneFields) != zoneFields)
 			continue;
-		}
-
-		supportsDst = json_object_get_int(label);
 
-		label = json_object_object_get(obj,(char*)"preferred");
-		if ((!label) || (is_error(label))) {
-			pref=false;
-		}
-		else
-			pref = json_object_get_boolean(label);
-
-		label = json_object_object_get(obj, (char*)"CountryCode");
-		if (label && !is_error(label))
-			countryCode = json_object_get_string(label);
-		else
-			countryCode = "";
-
-		//update "counter map"
-		tmpCountryZoneCounterMap[countryCode].insert(offset);
-
-		TimeZoneInfo* tz = new TimeZoneInfo;
-		tz->offsetToUTC = offset;
-		tz->preferred = pref;
-		tz->dstSupported = supportsDst;
-		tz->name = name;
-		tz->countryCode = countryCode;
-		tz->jsonStringValue = json_object_to_json_string(obj);
+		const TimeZoneInfo* tz = &s_timeZoneCatalog.zone(TimeZoneCatalog::Zones, i);
+		int offset = tz->offsetToUTC;
+		bool pref = tz->preferred;
+		int supportsDst = tz->dstSupported;
 
 		tmpPrefZoneMapIter = tmpPrefZoneMap.find(tz->offsetToUTC);
 		if (tmpPrefZoneMapIter == tmpPrefZoneMap.end()) {
@@ -1303,12 +1158,6 @@ void TimePrefsHandler::scanTimeZoneJson()
 
 	}
 
-	//go through the whole zone list and assign offset-per-country counter values
-	for (TimeZoneInfoList::iterator it = m_zoneList.begin(); it != m_zoneList.end();++it)
-	{
-		(*it)->howManyZonesForCountry = tmpCountryZoneCounterMap[(*it)->countryCode].size();
-	}
-
 	//go through the temp map and assign values to the final dst and non-dst maps
 	for (tmpPrefZoneMapIter = tmpPrefZoneMap.begin();tmpPrefZoneMapIter != tmpPrefZoneMap.end();++tmpPrefZoneMapIter) {
 		int off_key = (*tmpPrefZoneMapIter).second.offset;
@@ -1353,130 +1202,80 @@ void TimePrefsHandler::scanTimeZoneJson()
 
 	//now grab the "syszones"...these are the default, generic, timezones that get set in case NITZ supplies "dstinvalid"
 
-	label = json_object_object_get(s_timeZonesJson, "syszones");
-	if (!label || is_error(label)) {
-        qWarning() << "invalid json; missing syszones array";
-		return;
-	}
-	else if (!(json_object_is_type(label,json_type_array))) {
-        qWarning() << "invalid json; syszones is not an array";
-		return;
-	}
-
-	srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-        qWarning() << "invalid json; syszones array invalid";
-		return;
-	}
-
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
+	const unsigned sysZoneFields = TimeZoneCatalog::HasName | TimeZoneCatalog::HasOffset;
 
-		if ((!obj) || (is_error(obj)))
+	for (size_t i = 0; i < s_timeZoneCatalog.size(TimeZoneCatalog::SysZones); i++) {
+		if ((s_timeZoneCatalog.flags(TimeZoneCatalog::SysZones, i) & sysZoneFields) != sysZoneFields)
 			continue;
 
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if ((!label) || (is_error(label))) {
-			continue;
-		}
-
-		name = json_object_get_string(label);
-
-		label = json_object_object_get(obj,(char*)"offsetFromUTC");
-		if ((!label) || (is_error(label))) {
-			continue;
-		}
-
-		offset = json_object_get_int(label);
-
-		TimeZoneInfo* tz = new TimeZoneInfo;
-		tz->offsetToUTC = offset;
-		tz->preferred = false;
-		tz->dstSupported = 0;
-		//setTZIName(tz,name.c_str());
-		tz->name = name;
-		tz->jsonStringValue = json_object_to_json_string(obj);
-
+		const TimeZoneInfo* tz = &s_timeZoneCatalog.zone(TimeZoneCatalog::SysZones, i);
 		m_syszoneList.push_back(tz);
+
+		//first generic zone with the offset wins
+		m_genericZoneMap.insert(TimeZonePair(tz->offsetToUTC, tz));
 	}
 
+	//name index: zones first, so they win over sys zones with the same name
+	m_zoneNameIndex.assign(m_zoneList.begin(), m_zoneList.end());
+	m_zoneNameIndex.insert(m_zoneNameIndex.end(), m_syszoneList.begin(), m_syszoneList.end());
+	TimeZoneCatalog::sortIndex(m_zoneNameIndex);
+
 	//now grab the time zone info for known MCCs...
 	// This is used to correct problems in many networks' NITZ data
 
-	label = json_object_object_get(s_timeZonesJson, "mccInfo");
-	if (!label || is_error(label)) {
-        qWarning() << "invalid json; missing mccInfo array";
-		return;
-	}
-	else if (!(json_object_is_type(label,json_type_array))) {
-        qWarning() << "invalid json; mccInfo is not an array";
-		return;
-	}
-	
-	srcJsonArray = json_object_get_array(label);
-	if ((!srcJsonArray) || (is_error(srcJsonArray))) {
-        qWarning() << "invalid json; mccInfo array invalid";
-		return;
-	}
-
-	for (int i = 0; i < array_list_length(srcJsonArray); i++) {
-		json_object* obj = static_cast<json_object*>(array_list_get_idx(srcJsonArray, i));
+	const unsigned mccFields = TimeZoneCatalog::HasOffset | TimeZoneCatalog::HasDst | TimeZoneCatalog::HasMcc;
 
-		if ((!obj) || (is_error(obj)))
+	for (size_t i = 0; i < s_timeZoneCatalog.size(TimeZoneCatalog::MccZones); i++) {
+		if ((s_timeZoneCatalog.flags(TimeZoneCatalog::MccZones, i) & mccFields) != mccFields)
 			continue;
 
-		label = json_object_object_get(obj,(char*)"ZoneID");
-		if ((label) && (!is_error(label))) {
-			name = json_object_get_string(label);
-		}
-		else
-			name = "";
+		m_mccZoneInfoMap[s_timeZoneCatalog.mcc(i)] = &s_timeZoneCatalog.zone(TimeZoneCatalog::MccZones, i);
+	}
 
-		label = json_object_object_get(obj, (char*)"CountryCode");
-		if (label && !is_error(label))
-			countryCode = json_object_get_string(label);
-		else
-			countryCode = "";
-			
-		label = json_object_object_get(obj,(char*)"offsetFromUTC");
-		if ((!label) || (is_error(label))) {
-			continue;
-		}
+	m_mccOffsetZones.build(m_zoneList, m_mccZoneInfoMap);
+	qDebug("%zu MCC/offset zone choices", m_mccOffsetZones.size());
+}
 
-		offset = json_object_get_int(label);
-		
-		label = json_object_object_get(obj,(char*)"supportsDST");
-		if ((!label) || (is_error(label))) {
-			continue;
-		}
+//static
+void TimePrefsHandler::setLocalTimeFile(const char* path)
+{
+	s_tzFilePath = path;
+}
 
-		supportsDst = json_object_get_int(label);
-				
-		label = json_object_object_get(obj,(char*)"mcc");
-		if ((!label) || (is_error(label))) {
-			continue;
-		}
+bool TimePrefsHandler::reloadZoneData(std::string& errorText)
+{
+	TzPackRef pack = loadZonePack();
+	TimeZoneCatalog catalog;
+	if (!loadTimeZoneCatalog(catalog, pack)) {
+		errorText = "failed to load timezone catalog";
+		return false;
+	}
 
-		mcc = json_object_get_int(label);
-
-		TimeZoneInfo* tz = new TimeZoneInfo;
-		tz->offsetToUTC = offset;
-		tz->preferred = false;
-		tz->dstSupported = supportsDst;
-		tz->countryCode = countryCode;
-		if (name.size()) {
-			//setTZIName(tz,name.c_str());
-			tz->name = name;
-			tz->jsonStringValue = json_object_to_json_string(obj);
-		}
-		else {
-			tz->name = "";
-			tz->jsonStringValue = "";
-		}
-		m_mccZoneInfoMap[mcc] = tz;
-		
+	//current zone record goes away with previous catalog
+	std::string currentName = m_cpCurrentTimeZone ? m_cpCurrentTimeZone->name : std::string();
+	bool failsafe = (m_cpCurrentTimeZone == &s_failsafeDefaultZone);
+
+	TzPack::setCurrent(pack);
+	TzZoneCache::instance()->clear();
+	TimeZoneService::instance()->clearEasZones();
+	s_timeZoneCatalog.swap(catalog);
+	scanTimeZoneJson();
+	(void) getDefaultTZFromJson(m_pDefaultTimeZone);
+
+	const TimeZoneInfo* zone = failsafe ? &s_failsafeDefaultZone : timeZone_ZoneFromName(currentName);
+	if (!zone) {
+		qWarning("zone [%s] is gone after zone data reload, picking default zone", currentName.c_str());
+		zone = timeZone_GetDefaultZoneFailsafe();
 	}
 
+	//re-applied as offsets of the zone may have been changed
+	setTimeZone(zone);
+
+	PmLogInfo(sysServiceLogContext(), "ZONE_DATA_RELOADED", 2,
+	          PMLOGKS("PACK", pack.isNull() ? "none" : pack->filePath().c_str()),
+	          PMLOGKS("ZONE", m_cpCurrentTimeZone->name.c_str()),
+	          "zone data reloaded");
+	return true;
 }
 
 void TimePrefsHandler::setTimeZone(const TimeZoneInfo * pZoneInfo)
@@ -1501,6 +1300,19 @@ void TimePrefsHandler::setTimeZone(const TimeZoneInfo * pZoneInfo)
 	m_cpCurrentTimeZone = pZoneInfo;
 	PrefsDb::instance()->setPref("timeZone",pZoneInfo->jsonStringValue);
 	systemSetTimeZone(tzFileActual, *pZoneInfo);
+	invalidateSystemTime();
+	armZoneTransitionTimer();
+}
+
+void TimePrefsHandler::armZoneTransitionTimer()
+{
+	m_zoneTransitionTimer.arm(m_cpCurrentTimeZone ? m_cpCurrentTimeZone->name : std::string());
+}
+
+void TimePrefsHandler::slotZoneTransitionReached()
+{
+	postSystemTimeChange();
+	postBroadcastEffectiveTimeChange();	// local time moved (sent only if not predicted)
 }
 
 void TimePrefsHandler::systemSetTimeZone(const std::string &tzFileActual, const TimeZoneInfo &zoneInfo)
@@ -1526,34 +1338,114 @@ void TimePrefsHandler::systemSetTimeZone(const std::string &tzFileActual, const
     __qMessage("TZ env is now [%s]", getenv("TZ"));
 }
 
-bool TimePrefsHandler::systemSetTime(time_t deltaTime, const std::string &source)
+bool TimePrefsHandler::systemSetTime(int64_t deltaTime, const std::string &source)
 {
-	struct timeval timeVal;
-	timeVal.tv_sec = time(0) + deltaTime;
-	timeVal.tv_usec = 0;
-	qDebug("%s: settimeofday: %u",__FUNCTION__,(unsigned int)timeVal.tv_sec);
+	const int64_t nsecPerSec = 1000000000LL;
+
+	// Offsets below that are slewed (like ntpd does) so that clock never
+	// jumps. With maximum kernel slew rate (500 ppm) it takes about 4 minutes.
+	const int64_t slewThreshold = 128000000LL; // 128 ms
+
+	// normalized (tv_nsec is non-negative even for negative delta)
+	struct timespec delta;
+	delta.tv_sec = deltaTime / nsecPerSec;
+	delta.tv_nsec = deltaTime % nsecPerSec;
+	if (delta.tv_nsec < 0)
+	{
+		delta.tv_sec -= 1;
+		delta.tv_nsec += nsecPerSec;
+	}
+
+	bool slew = deltaTime != 0 && deltaTime > -slewThreshold && deltaTime < slewThreshold;
+
+	// part of previous slew dropped by this correction (not applied yet)
+	struct timespec remaining = { 0, 0 };
+
+	int rc = 0;
+	if (slew)
+	{
+		qDebug("%s: adjtime: %lld ns",__FUNCTION__,(long long)deltaTime);
+		rc = TimeClock::instance()->slewWallTime(delta, &remaining) ? 0 : -1;
+		qDebug("adjtime %s", ( rc == 0 ? "succeeded" : "failed"));
+	}
+	else if (deltaTime != 0)
+	{
+		// slew still in progress would keep moving stepped clock
+		struct timespec none = { 0, 0 };
+		if (!TimeClock::instance()->slewWallTime(none, &remaining))
+		{
+			remaining.tv_sec = 0;
+			remaining.tv_nsec = 0;
+		}
+
+		struct timespec timeVal;
+		TimeClock::instance()->wallTime(timeVal);
+		timeVal.tv_sec += delta.tv_sec;
+		timeVal.tv_nsec += delta.tv_nsec;
+		if (timeVal.tv_nsec >= nsecPerSec)
+		{
+			timeVal.tv_sec += 1;
+			timeVal.tv_nsec -= nsecPerSec;
+		}
+		qDebug("%s: settimeofday: %u",__FUNCTION__,(unsigned int)timeVal.tv_sec);
+
+		rc = TimeClock::instance()->setWallTime(timeVal) ? 0 : -1;
+		qDebug("settimeofday %s", ( rc == 0 ? "succeeded" : "failed"));
+	}
 
-	int rc = deltaTime == 0 ? 0 : settimeofday(&timeVal, 0);
-	qDebug("settimeofday %s", ( rc == 0 ? "succeeded" : "failed"));
     if (rc == 0)
     {
+		// deltaTime is measured against current system time, while clocks
+		// and poll scheduler already account for whole previous slew, so
+		// time we converge to moves by difference only
+		int64_t replacedSlew = (int64_t) remaining.tv_sec * nsecPerSec + remaining.tv_nsec;
+		int64_t netChange = deltaTime - replacedSlew;
+
+		if (replacedSlew != 0) ++m_syncStats.replacedSlews;
+		if (slew)
+		{
+			++m_syncStats.slews;
+			m_syncStats.slewSize.add(netChange);
+		}
+		else if (deltaTime != 0)
+		{
+			++m_syncStats.steps;
+			m_syncStats.stepSize.add(deltaTime);
+		}
+		if (source != m_systemTimeSourceTag) ++m_syncStats.sourceSwitches;
+		++m_syncStats.sourceUpdates[source];
+
 		// remember last synchronized with time
 		m_systemTimeSourceTag = source;
 		PrefsDb::instance()->setPref("lastSystemTimeSource", m_systemTimeSourceTag);
+		invalidateSystemTime();
 		// next time "micom" will come we'll use this clock tag instead
 
-		// TODO: drop direct broadcastTime adjust in favor of signal and clocks
-		m_broadcastTime.adjust(deltaTime);
+		// clocks compare their offsets with time we converge to
+		systemTimeChanged.fire(netChange);
 
-		systemTimeChanged.fire(deltaTime);
+		m_ntpClock.pollScheduler.corrected(netChange);
+		if (deltaTime != 0 && source != "ntp")
+		{
+			// if we had valid NTP in our system-time we destroy it here
+			m_ntpClock.pollScheduler.expire();
+		}
+
+		// slewed time never jumps, so there is nothing to notify about
+		if (!slew)
+		{
+			// TODO: drop direct broadcastTime adjust in favor of signal and clocks
+			m_broadcastTime.adjust(ClockHandler::offsetSeconds(deltaTime));
+			TimeSnapshot::instance()->publishBroadcast(m_broadcastTime);
 
-		postSystemTimeChange();
-		if (isSystemTimeBroadcastEffective()) postBroadcastEffectiveTimeChange();
-		launchAppsOnTimeChange();
+			armZoneTransitionTimer();
+
+			postSystemTimeChange();
+			if (isSystemTimeBroadcastEffective()) postBroadcastEffectiveTimeChange();
+			launchAppsOnTimeChange();
+		}
     }
 
-	// if we had valid NTP in our system-time we destroy it here
-	m_lastNtpUpdate = 0;
 	return (rc == 0);
 }
 
@@ -1568,7 +1460,13 @@ void TimePrefsHandler::updateSystemTime()
     }
 
 	bool isAnyRequestSent = false;
-	if (isNTPAllowed())
+	time_t ntpPollIn = m_ntpClock.pollScheduler.nextPollIn();
+	if (isNTPAllowed() && ntpPollIn > 0)
+	{
+		PmLogDebug(sysServiceLogContext(),
+			"System time follows NTP, next poll in %ld seconds", ntpPollIn);
+	}
+	else if (isNTPAllowed())
 	{
 		(void) m_ntpClock.requestNTP( 0 );
 		isAnyRequestSent = true;
@@ -1643,74 +1541,42 @@ void TimePrefsHandler::postSystemTimeChange()
 	if (!m_cpCurrentTimeZone)
 		return;
 
-	LSError lsError;
-	json_object* json = 0;
-	LSErrorInit(&lsError);
-
-	json = json_object_new_object();
-	attachSystemTime(json);
+	std::string reply = "{";
+	reply += systemTimeMembers();
 
 	//the new "sub"keys for nitz validity...
-	//the new "sub"keys for nitz validity...
-	if (isNITZTimeEnabled())
-		json_object_object_add(json,(char*) "NITZValidTime", json_object_new_boolean(m_immNitzTimeValid));
-	if (isNITZTZEnabled())
-		json_object_object_add(json,(char*) "NITZValidZone", json_object_new_boolean(m_immNitzZoneValid));
-
-	const char * reply = json_object_to_json_string(json);
+	if (isNITZTimeEnabled()) {
+		reply += ",\"NITZValidTime\":";
+		reply += m_immNitzTimeValid ? "true" : "false";
+	}
+	if (isNITZTZEnabled()) {
+		reply += ",\"NITZValidZone\":";
+		reply += m_immNitzZoneValid ? "true" : "false";
+	}
+	reply += "}";
 
 	std::string subKeyStr = std::string("getSystemTime");
-	std::string subValStr = std::string(reply);
-	PrefsFactory::instance()->postPrefChangeValueIsCompleteString(subKeyStr,subValStr);
-
-	json_object_put(json);    
+	PrefsFactory::instance()->postPrefChangeValueIsCompleteString(subKeyStr,reply);
 }
 
-void TimePrefsHandler::attachSystemTime(json_object *json)
+const std::string& TimePrefsHandler::systemTimeMembers()
 {
-	time_t utctime = time(NULL);
-	struct tm localTm;
-
-	// tzset() already called on initialization
-	struct tm * pLocalTm = localtime_r(&utctime, &localTm);
-	assert( pLocalTm == &localTm );
-	(void) pLocalTm; // unused variable (in release)
+	if (m_systemTimeReply.needsTail()) {
+		//zone, time source and nitz validity only change along with invalidateSystemTime()
+		std::string tail;
+		SystemTimeReply::appendMember(tail, "timeZoneFile", json_object_new_string(s_tzFilePath));
+		SystemTimeReply::appendMember(tail, "systemTimeSource", json_object_new_string(getSystemTimeSource().c_str()));
 
-	json_object_object_add(json, "utc", json_object_new_int(utctime));
-	json_object *localtime_json = json_object_new_object();
-	json_object_object_add(localtime_json, "year", json_object_new_int(localTm.tm_year + 1900));
-	json_object_object_add(localtime_json, "month", json_object_new_int(localTm.tm_mon + 1));
-	json_object_object_add(localtime_json, "day", json_object_new_int(localTm.tm_mday));
-	json_object_object_add(localtime_json, "hour", json_object_new_int(localTm.tm_hour));
-	json_object_object_add(localtime_json, "minute", json_object_new_int(localTm.tm_min));
-	json_object_object_add(localtime_json, "second", json_object_new_int(localTm.tm_sec));
-	json_object_object_add(json, "localtime", localtime_json);
+		std::string nitzValidity = PrefsDb::instance()->getPref("nitzValidity");
+		if (nitzValidity == NITZVALIDITY_STATE_NITZVALID)
+			SystemTimeReply::appendMember(tail, "NITZValid", json_object_new_boolean(true));
+		else if (nitzValidity == NITZVALIDITY_STATE_NITZINVALIDUSERNOTSET)
+			SystemTimeReply::appendMember(tail, "NITZValid", json_object_new_boolean(false));
 
-	json_object_object_add(json, "offset", json_object_new_int(offsetToUtcSecs()/60));
-
-	if (currentTimeZone()) {
-		json_object_object_add(json, "timezone", json_object_new_string(currentTimeZone()->name.c_str()));
-		//get current time zone abbreviation
-		char tzoneabbr_cstr[16];
-		strftime(tzoneabbr_cstr, 16,"%Z", &localTm);
-		json_object_object_add(json, "TZ", json_object_new_string(tzoneabbr_cstr));
-	}
-	else {
-		//default to something
-		json_object_object_add(json, "timezone", json_object_new_string("UTC"));
-		json_object_object_add(json, "TZ", json_object_new_string("UTC"));
+		m_systemTimeReply.setTail(tail);
 	}
 
-	json_object_object_add(json, "timeZoneFile", json_object_new_string(s_tzFilePath));
-
-	json_object_object_add(json, "systemTimeSource", json_object_new_string(getSystemTimeSource().c_str()));
-
-	std::string nitzValidity = PrefsDb::instance()->getPref("nitzValidity");
-
-	if (nitzValidity == NITZVALIDITY_STATE_NITZVALID)
-		json_object_object_add(json, "NITZValid", json_object_new_boolean(true));
-	else if (nitzValidity == NITZVALIDITY_STATE_NITZINVALIDUSERNOTSET)
-		json_object_object_add(json, "NITZValid", json_object_new_boolean(false));
+	return m_systemTimeReply.members(currentTimeZone() ? currentTimeZone()->name.c_str() : NULL);
 }
 
 
@@ -1806,7 +1672,7 @@ time_t TimePrefsHandler::offsetToUtcSecs() const
 	struct tm lt;
 
 	// UTC time
-    currTime = time(NULL);
+    currTime = TimeClock::instance()->wallSeconds();
 
 	// Local time
 	localtime_r(&currTime, &lt);
@@ -1842,7 +1708,7 @@ bool TimePrefsHandler::setNITZTimeEnable(bool time_en) {	//returns old value
 
 		// assume that NTP is no more stored in system-time useful to force
 		// update from NTP server through turning off/on useNetworkTime
-		m_lastNtpUpdate = 0;
+		m_ntpClock.pollScheduler.expire();
 	}
 
 	// assume that current time isn't automatically synchronized and should be
@@ -1874,87 +1740,16 @@ const TimeZoneInfo* TimePrefsHandler::timeZone_ZoneFromOffset(int offset,int dst
 {
 	if (mcc != 0) {
 
-		const TimeZoneInfo* tzMcc = timeZone_ZoneFromMCC(mcc, 0);
-		if (tzMcc && !tzMcc->countryCode.empty()) {
-
-            qDebug("MCC code: %d, Offset: %d, DstValue: %d, TZ Entry: %s", mcc, offset, dstValue,
-					  tzMcc->jsonStringValue.c_str());
-
-			std::string countryCode = tzMcc->countryCode;
-
-			// All timezones wih matching offset
-			std::pair<TimeZoneMultiMapConstIterator, TimeZoneMultiMapConstIterator> iterPair
-				= m_offsetZoneMultiMap.equal_range(offset);
-
-			// narrow down list to those matching the MCC code
-			TimeZoneInfoList mccMatchingTzList;			
-			for (TimeZoneMultiMapConstIterator iter = iterPair.first; iter != iterPair.second; ++iter) {
-				if (iter->second->countryCode == countryCode) {
-					mccMatchingTzList.push_back(iter->second);
-				}
-			}
-
-			if (!mccMatchingTzList.empty()) {
-
-//				if (dstValue == 1) {
-					
-					// First iteration: preferred and DST enabled
-					for (TimeZoneInfoListConstIterator iter = mccMatchingTzList.begin();
-						 iter != mccMatchingTzList.end(); ++iter) {
-
-						TimeZoneInfo* z = (*iter);
-//						if (z->preferred && z->dstSupported == 1) {
-						if (z->preferred && z->dstSupported == dstValue) {
-						PMLOG_TRACE("Found match in first iteration: %s", z->jsonStringValue.c_str());
-							return z;
-						}
-					}
-
-					// Second iteration: DST enabled
-					for (TimeZoneInfoListConstIterator iter = mccMatchingTzList.begin();
-						 iter != mccMatchingTzList.end(); ++iter) {
-
-						TimeZoneInfo* z = (*iter);
-						if (z->dstSupported == 1) {
-						PMLOG_TRACE("Found match in second iteration: %s", z->jsonStringValue.c_str());
-							return z;
-						}
-					}
-//				}
-
-				// Third iteration: just preferred
-				for (TimeZoneInfoListConstIterator iter = mccMatchingTzList.begin();
-					 iter != mccMatchingTzList.end(); ++iter) {
-
-					TimeZoneInfo* z = (*iter);
-					if (z->preferred) {
-					PMLOG_TRACE("Found match in third iteration: %s", z->jsonStringValue.c_str());
-						return z;
-					}
-				}
-
-				//  Fourth iteration: just matching DST
-				for (TimeZoneInfoListConstIterator iter = mccMatchingTzList.begin();
-					 iter != mccMatchingTzList.end(); ++iter) {
-
-					TimeZoneInfo* z = (*iter);
-					if (z->dstSupported == dstValue) {
-					PMLOG_TRACE("Found match in fourth iteration: %s", z->jsonStringValue.c_str());
-						return z;
-					}
-				}
-
-				// Finally: just the first in the list
-				TimeZoneInfo* z = mccMatchingTzList.front();
-				if (z) {
-					qDebug("Found match in fifth iteration: %s", z->jsonStringValue.c_str());
-					return z;
-				}
-			}
+		//zones of the MCC's country with matching offset
+		const TimeZoneInfo* z = m_mccOffsetZones.find(mcc, offset, dstValue);
+		if (z) {
+			qDebug("MCC code: %d, Offset: %d, DstValue: %d, found match: %s", mcc, offset, dstValue,
+				   z->jsonStringValue.c_str());
+			return z;
 		}
 	}
 
-	TimeZoneInfo * z = NULL;
+	const TimeZoneInfo * z = NULL;
 	TimeZoneMapConstIterator it;
 	if (dstValue == 0) {
 		it = m_preferredTimeZoneMapNoDST.find(offset);
@@ -1972,17 +1767,10 @@ const TimeZoneInfo* TimePrefsHandler::timeZone_ZoneFromOffset(int offset,int dst
 
 const TimeZoneInfo* TimePrefsHandler::timeZone_GenericZoneFromOffset(int offset) const
 {
-
-	//scan the sys zones list
-	for (TimeZoneInfoListConstIterator 	it = m_syszoneList.begin();
-									it != m_syszoneList.end();
-									it++) 
-	{
-		TimeZoneInfo * zc = *it;
-		if (zc->offsetToUTC == offset)
-			return zc;
-	}
-	return NULL;
+	TimeZoneMapConstIterator it = m_genericZoneMap.find(offset);
+	if (it == m_genericZoneMap.end())
+		return NULL;
+	return it->second;
 }
 
 const TimeZoneInfo* TimePrefsHandler::timeZone_ZoneFromMCC(int mcc,int mnc) const
@@ -1998,23 +1786,7 @@ const TimeZoneInfo* TimePrefsHandler::timeZone_ZoneFromName(const std::string& n
 	if (name.empty())
 		return 0;
 
-	for (TimeZoneInfoList::const_iterator it = m_zoneList.begin();
-		 it != m_zoneList.end(); ++it) {
-		TimeZoneInfo* z = (TimeZoneInfo*) (*it);
-
-		if (z->name == name)
-			return z;
-	}
-
-	for (TimeZoneInfoList::const_iterator it = m_syszoneList.begin();
-	it != m_syszoneList.end(); ++it) {
-		TimeZoneInfo* z = (TimeZoneInfo*) (*it);
-
-		if (z->name == name)
-			return z;
-	}
-
-	return 0;
+	return TimeZoneCatalog::findInIndex(m_zoneNameIndex, name);
 }
 
 const TimeZoneInfo* TimePrefsHandler::timeZone_GetDefaultZoneFailsafe()
@@ -2182,9 +1954,9 @@ bool TimePrefsHandler::cbSetSystemTime(LSHandle* lshandle, LSMessage *message,
 	// boot or whatever.
 	// But right now we can't distinguish them, so assume that this is manual
 	// set time.
-	currentTime = time(0);
+	currentTime = TimeClock::instance()->wallSeconds();
 	th->deprecatedClockChange.fire(
-		utcTimeInSecs - currentTime,
+		ClockHandler::secondsOffset(utcTimeInSecs - currentTime),
 		th->isManualTimeUsed() ? ClockHandler::manual : ClockHandler::micom,
 		currentTime
 	);
@@ -2369,7 +2141,6 @@ bool TimePrefsHandler::cbSetSystemNetworkTime(LSHandle * lshandle, LSMessage *me
 	time_t remotetimeStamp = 0;
 	NitzParameters nitzParam;
 	int nitzFlags = 0;
-	std::string nitzFnMsg;
 
 	TimePrefsHandler* th = (TimePrefsHandler*)user_data;
 
@@ -2484,39 +2255,16 @@ bool TimePrefsHandler::cbSetSystemNetworkTime(LSHandle * lshandle, LSMessage *me
 	label = json_object_object_get(root, "tilIgnore");
 	if ((label) && (!is_error(label)))
 	{
-		if (json_object_get_boolean(label))
-			nitzFlags |= NITZHANDLER_FLAGBIT_IGNORE_TIL_SET;
-	}
-
-	nitzParam = NitzParameters(timeStruct,utcOffset,dst,mcc,mnc,timeValid,tzValid,dstValid,remotetimeStamp);	//wasteful copy but this fn isn't called much
-
-	//run the nitz chain
-	if (th->nitzHandlerEntry(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "nitz message failed entry: "+nitzFnMsg;
-		goto Done_cbSetSystemNetworkTime;
-	}
-	if (th->nitzHandlerTimeValue(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "nitz message failed in time-value handler: "+nitzFnMsg;
-		goto Done_cbSetSystemNetworkTime;
-	}
-	if (th->nitzHandlerOffsetValue(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "nitz message failed in timeoffset-value handler: "+nitzFnMsg;
-		goto Done_cbSetSystemNetworkTime;
-	}
-	if (th->nitzHandlerDstValue(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "nitz message failed in timedst-value handler: "+nitzFnMsg;
-		goto Done_cbSetSystemNetworkTime;
-	}
-	if (th->nitzHandlerExit(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "nitz message failed exit: "+nitzFnMsg;
-		goto Done_cbSetSystemNetworkTime;
+		if (json_object_get_boolean(label))
+			nitzFlags |= NITZHANDLER_FLAGBIT_IGNORE_TIL_SET;
 	}
 
+	nitzParam = NitzParameters(timeStruct,utcOffset,dst,mcc,mnc,timeValid,tzValid,dstValid,remotetimeStamp);	//wasteful copy but this fn isn't called much
+
+	//run the nitz chain
+	if (!th->runNitzChain(s_nitzChain,nitzParam,nitzFlags,errorText))
+		goto Done_cbSetSystemNetworkTime;
+
 	//if successfully completed, then reset the last nitz parameter member and flags
 	if (th->m_p_lastNitzParameter == NULL)
 		th->m_p_lastNitzParameter = new NitzParameters(nitzParam);
@@ -2558,6 +2306,74 @@ Done_cbSetSystemNetworkTime:
 
 }
 
+const TimePrefsHandler::NitzStep TimePrefsHandler::s_nitzChain[] = {
+	{ &TimePrefsHandler::nitzHandlerEntry,       "entry",  "nitz message failed entry: " },
+	{ &TimePrefsHandler::nitzHandlerTimeValue,   "time",   "nitz message failed in time-value handler: " },
+	{ &TimePrefsHandler::nitzHandlerOffsetValue, "offset", "nitz message failed in timeoffset-value handler: " },
+	{ 0, 0, 0 },
+};
+
+const TimePrefsHandler::NitzStep TimePrefsHandler::s_timeoutNitzChain[] = {
+	{ &TimePrefsHandler::timeoutNitzHandlerEntry,       "timeout-entry",  "timeout-nitz message failed entry: " },
+	{ &TimePrefsHandler::timeoutNitzHandlerTimeValue,   "timeout-time",   "timeout-nitz message failed in time-value handler: " },
+	{ &TimePrefsHandler::timeoutNitzHandlerOffsetValue, "timeout-offset", "timeout-nitz message failed in timeoffset-value handler: " },
+	{ &TimePrefsHandler::timeoutNitzHandlerDstValue,    "timeout-dst",    "timeout-nitz message failed in timedst-value handler: " },
+	{ 0, 0, 0 },
+};
+
+bool TimePrefsHandler::runNitzChain(const NitzStep* chain, NitzParameters& nitz, int& flags, std::string& r_errorText)
+{
+	int64_t chainStart = NitzSteps::monotonicNs();
+	if (!NitzSteps::run(*this, chain, nitz, flags, r_errorText, m_syncStats.nitzSteps))
+		return false;
+
+	PmLogDebug(sysServiceLogContext(), "NITZ chain [%s] took %lld us",
+	           chain->name, (long long) ((NitzSteps::monotonicNs() - chainStart) / 1000));
+	return true;
+}
+
+int TimePrefsHandler::nitzPrefFlags()
+{
+	unsigned int generation = PrefsDb::instance()->generation();
+	if (m_nitzPrefsValid && generation == m_nitzPrefsGeneration)
+		return m_nitzPrefFlags;
+
+	std::list<std::string> keys;
+	keys.push_back("timeZonesUseGenericExclusively");
+	keys.push_back("AllowGenericTimezones");
+	keys.push_back("AllowMCCAssistedTimezones");
+	keys.push_back("AllowNTPTime");
+	keys.push_back(".sysservice-time-strictDstErrors");
+	std::map<std::string, std::string> prefs = PrefsDb::instance()->getPrefs(keys);
+
+	m_nitzPrefFlags = 0;
+	if (prefs["timeZonesUseGenericExclusively"] == "true")
+		m_nitzPrefFlags |= NITZHANDLER_FLAGBIT_GZONEFORCE;
+	if (prefs["AllowGenericTimezones"] == "true")
+		m_nitzPrefFlags |= NITZHANDLER_FLAGBIT_GZONEALLOW;
+	if (prefs["AllowMCCAssistedTimezones"] == "true")
+		m_nitzPrefFlags |= NITZHANDLER_FLAGBIT_MCCALLOW;
+	if (prefs["AllowNTPTime"] == "true")
+		m_nitzPrefFlags |= NITZHANDLER_FLAGBIT_NTPALLOW;
+	m_nitzStrictDstErrors = (prefs[".sysservice-time-strictDstErrors"] == "true");
+
+	m_nitzPrefsValid = true;
+	m_nitzPrefsGeneration = generation;
+	return m_nitzPrefFlags;
+}
+
+void TimePrefsHandler::applyNitzTimeZone(const TimeZoneInfo* zone)
+{
+	//repeated NITZ messages mostly confirm zone which is already set
+	if (zone && zone == m_cpCurrentTimeZone)
+	{
+		qDebug("NITZ zone [%s] is already set", zone->name.c_str());
+		return;
+	}
+
+	setTimeZone(zone);					///setTimeZone() has a failsafe against NULLs being passed in so this is safe
+}
+
 int  TimePrefsHandler::nitzHandlerEntry(NitzParameters& nitz,int& flags,std::string& r_statusMsg)
 {
 	//check the validity of the received nitz message
@@ -2567,14 +2383,7 @@ int  TimePrefsHandler::nitzHandlerEntry(NitzParameters& nitz,int& flags,std::str
 		return NITZHANDLER_RETURN_ERROR;
 	}
 	//set up the flags
-	if (PrefsDb::instance()->getPref("timeZonesUseGenericExclusively") == "true")
-		flags |= NITZHANDLER_FLAGBIT_GZONEFORCE;
-	if (PrefsDb::instance()->getPref("AllowGenericTimezones") == "true")
-		flags |= NITZHANDLER_FLAGBIT_GZONEALLOW;
-	if (PrefsDb::instance()->getPref("AllowMCCAssistedTimezones") == "true")
-		flags |= NITZHANDLER_FLAGBIT_MCCALLOW;
-	if (PrefsDb::instance()->getPref("AllowNTPTime") == "true")
-		flags |= NITZHANDLER_FLAGBIT_NTPALLOW;
+	flags |= nitzPrefFlags();
 
 	return NITZHANDLER_RETURN_SUCCESS;
 }
@@ -2595,8 +2404,8 @@ int  TimePrefsHandler::nitzHandlerTimeValue(NitzParameters& nitz,int& flags,std:
 		else
 		{
 			// route to proper handler
-			time_t currentTime = time(0);
-			deprecatedClockChange.fire(utc - currentTime, "nitz", currentTime);
+			time_t currentTime = TimeClock::instance()->wallSeconds();
+			deprecatedClockChange.fire(ClockHandler::secondsOffset(utc - currentTime), "nitz", currentTime);
 			nitz._timevalid = true;
 		}
 	}
@@ -2635,7 +2444,7 @@ int	 TimePrefsHandler::nitzHandlerOffsetValue(NitzParameters& nitz,int& flags,st
 	{
 		//pick a generic zone
 		selectedZone = timeZone_GenericZoneFromOffset(nitz._offset);
-		setTimeZone(selectedZone);					///setTimeZone() has a failsafe against NULLs being passed in so this is safe 
+		applyNitzTimeZone(selectedZone);					///setTimeZone() has a failsafe against NULLs being passed in so this is safe 
 		signalReceivedNITZUpdate(false,true);
 		return NITZHANDLER_RETURN_SUCCESS;
 	}
@@ -2660,59 +2469,11 @@ int	 TimePrefsHandler::nitzHandlerOffsetValue(NitzParameters& nitz,int& flags,st
 		}
 	}
 
-	setTimeZone(selectedZone);					///setTimeZone() has a failsafe against NULLs being passed in so this is safe 
+	applyNitzTimeZone(selectedZone);					///setTimeZone() has a failsafe against NULLs being passed in so this is safe 
 	signalReceivedNITZUpdate(false,true);
 	return NITZHANDLER_RETURN_SUCCESS;			
 }
 
-int  TimePrefsHandler::nitzHandlerDstValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg)
-{
-	
-	// enforcing rules for dst according to some test cases that need to be passed with explicit assumptions on dstvalid <-> dst=x implications. Therefore
-	// 					 	will handle everything in the nitzHandlerOffsetValue() fn
-	
-//	if (isNITZTZEnabled() == false)
-//		return NITZHANDLER_RETURN_SUCCESS;
-//	
-//	if (nitz._dstvalid == false)
-//		return NITZHANDLER_RETURN_SUCCESS;		//this is not a message with a dst value...return (not an error)
-//	
-//	if (flags & NITZHANDLER_FLAGBIT_SKIP_DST_SELECT)
-//		return NITZHANDLER_RETURN_SUCCESS;		//something up the chain already figured dst into the mix...skip all this to avoid reselecting a TZ
-//	
-//	//take the currently set timezone's offset, and this NitzParameter's dst value, and run the timezone selection sequence
-//	
-//	
-//	const TimeZoneInfo * selectedZone = NULL;
-//	//check to see if I've been told to use generic timezones exclusively
-//	if( flags & NITZHANDLER_FLAGBIT_GZONEFORCE )
-//	{
-//		//pick a generic zone
-//		selectedZone = timeZone_GenericZoneFromOffset(m_cpCurrentTimeZone->offsetToUTC);
-//		setTimeZone(selectedZone);					///setTimeZone() has a failsafe against NULLs being passed in so this is safe 
-//		return NITZHANDLER_RETURN_SUCCESS;
-//	}
-//	
-//	selectedZone = timeZone_ZoneFromOffset(m_cpCurrentTimeZone->offsetToUTC,nitz._dst);
-//	if (selectedZone == NULL)
-//	{
-//		//couldn't get one with this combination...if generic zones are allowed, pick one of those
-//		if ( flags & NITZHANDLER_FLAGBIT_GZONEALLOW )
-//		{
-//			//pick a generic zone
-//			selectedZone = timeZone_GenericZoneFromOffset(m_cpCurrentTimeZone->offsetToUTC);
-//		}
-//	}
-//	setTimeZone(selectedZone);					///setTimeZone() has a failsafe against NULLs being passed in so this is safe 
-	return NITZHANDLER_RETURN_SUCCESS;
-}
-
-int  TimePrefsHandler::nitzHandlerExit(NitzParameters& nitz,int& flags,std::string& r_statusMsg)
-{
-	//nothing special to do here at this time...just a hook to allow future post-process
-	return NITZHANDLER_RETURN_SUCCESS;
-}
-	
 void  TimePrefsHandler::nitzHandlerSpecialCaseOffsetValue(NitzParameters& nitz,int& flags,std::string& r_statusMsg)
 {
 	//Special Case #1:  If the MCC is France (208), and the offset value is 120, then flip that to offset 60, tzvalid=true, dst=1, dstvalid=true
@@ -2751,35 +2512,12 @@ int TimePrefsHandler::timeoutFunc()
 	//else, timeout needs to do work
 	//run the nitz chain
 	int nitzFlags = 0;
-	std::string errorText,nitzFnMsg;
+	std::string errorText;
 	NitzParameters nitzParam;		//this will be the "working copy" that the handlers will modify
 
 	qDebug("Running the NITZ chain...");
-	if (timeoutNitzHandlerEntry(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "timeout-nitz message failed entry: "+nitzFnMsg;
-		goto Done_timeoutFunc;
-	}
-	if (timeoutNitzHandlerTimeValue(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "timeout-nitz message failed in time-value handler: "+nitzFnMsg;
-		goto Done_timeoutFunc;
-	}
-	if (timeoutNitzHandlerOffsetValue(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "timeout-nitz message failed in timeoffset-value handler: "+nitzFnMsg;
-		goto Done_timeoutFunc;
-	}
-	if (timeoutNitzHandlerDstValue(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "timeout-nitz message failed in timedst-value handler: "+nitzFnMsg;
-		goto Done_timeoutFunc;
-	}
-	if (timeoutNitzHandlerExit(nitzParam,nitzFlags,nitzFnMsg) != NITZHANDLER_RETURN_SUCCESS)
-	{
-		errorText = "timeout-nitz message failed exit: "+nitzFnMsg;
+	if (!runNitzChain(s_timeoutNitzChain,nitzParam,nitzFlags,errorText))
 		goto Done_timeoutFunc;
-	}
 
 	//if successfully completed, then reset the last nitz parameter member and flags
 	if (m_p_lastNitzParameter == NULL)
@@ -2824,7 +2562,7 @@ Done_timeoutFunc:
 	else
 	{
 		bool totallyGoodNitz = (nitzParam._timevalid) && (nitzParam._tzvalid) && (nitzParam._dstvalid);
-		time_t dbg_time_outp = time(NULL);
+		time_t dbg_time_outp = TimeClock::instance()->wallSeconds();
 		qDebug("NITZ FINAL: At least something was ok (timevalid = %s,tzvalid = %s,dstvalid = %s), time is now %s",
 			(nitzParam._timevalid ? "true" : "false"),
 				(nitzParam._tzvalid ? "true" : "false"),
@@ -2897,7 +2635,7 @@ void TimePrefsHandler::startTimeoutCycle(unsigned int timeoutInSeconds)
 			timeoutInSeconds = TIMEOUT_INTERVAL_SEC;
 	}
 
-	m_gsource_periodic = g_timeout_source_new_seconds(timeoutInSeconds);
+	m_gsource_periodic = TimeClock::instance()->createTimeout(timeoutInSeconds * 1000, true);
 	if (m_gsource_periodic == NULL) 
 	{
         qWarning() << "Failed to create periodic source";
@@ -2942,14 +2680,7 @@ int  TimePrefsHandler::timeoutNitzHandlerEntry(NitzParameters& nitz,int& flags,s
 	else
 	{
 		//rescan from prefs
-		if (PrefsDb::instance()->getPref("timeZonesUseGenericExclusively") == "true")
-			flags |= NITZHANDLER_FLAGBIT_GZONEFORCE;
-		if (PrefsDb::instance()->getPref("AllowGenericTimezones") == "true")
-			flags |= NITZHANDLER_FLAGBIT_GZONEALLOW;
-		if (PrefsDb::instance()->getPref("AllowMCCAssistedTimezones") == "true")
-			flags |= NITZHANDLER_FLAGBIT_MCCALLOW;
-		if (PrefsDb::instance()->getPref("AllowNTPTime") == "true")
-			flags |= NITZHANDLER_FLAGBIT_NTPALLOW;
+		flags |= nitzPrefFlags();
 	}
 	
 	return NITZHANDLER_RETURN_SUCCESS;
@@ -3017,7 +2748,7 @@ int	 TimePrefsHandler::timeoutNitzHandlerOffsetValue(NitzParameters& nitz,int& f
 			}
 			nitz._tzvalid = true;
 			nitz._dstvalid = true;
-			setTimeZone(tz);
+			applyNitzTimeZone(tz);
 			signalReceivedNITZUpdate(false,true);
 			return NITZHANDLER_RETURN_SUCCESS;
 		}
@@ -3035,17 +2766,13 @@ int  TimePrefsHandler::timeoutNitzHandlerDstValue(NitzParameters& nitz,int& flag
 
 	///However, some networks  seem to be sending dstvalid = false even when it shouldn't be. This hidden setting defaults to ignoring that
 	//				but if it's set "true", then dstvalid = false will result in it being considered a NITZ TZ set failure
-	if (PrefsDb::instance()->getPref(".sysservice-time-strictDstErrors") != "true")
+	nitzPrefFlags();
+	if (!m_nitzStrictDstErrors)
 		nitz._dstvalid = true;
 
 	return NITZHANDLER_RETURN_SUCCESS;
 }
 
-int  TimePrefsHandler::timeoutNitzHandlerExit(NitzParameters& nitz,int& flags,std::string& r_statusMsg)
-{
-	return NITZHANDLER_RETURN_SUCCESS;
-}
-
 void TimePrefsHandler::setPeriodicTimeSetWakeup()
 {
     qDebug("%s called",__FUNCTION__);
@@ -3066,10 +2793,15 @@ void TimePrefsHandler::setPeriodicTimeSetWakeup()
 		LSError lserror;
 		LSErrorInit(&lserror);
 
-		std::string interval = PrefsDb::instance()->getPref(".sysservice-time-autoNtpInterval");
-		uint32_t timev = strtoul(interval.c_str(),NULL,10);
-		if ((timev < 300) || (timev > 86400))
-			timev = 86399;							//24 hour default (23h.59m.59s actually)
+		// poll as often as measured drift of system clock requires (but
+		// not less often than configured)
+		uint32_t timev = autoNtpInterval();
+		if (isNTPAllowed())
+		{
+			m_ntpClock.pollScheduler.setLimits(s_minNtpPollInterval, timev);
+			time_t pollIn = m_ntpClock.pollScheduler.nextPollIn();
+			timev = pollIn < s_minNtpWakeupInterval ? s_minNtpWakeupInterval : pollIn;
+		}
 
 		std::string timeStr;
 
@@ -3123,7 +2855,7 @@ void TimePrefsHandler::setPeriodicTimeSetWakeup()
 
 bool TimePrefsHandler::isNTPAllowed()
 {
-	return (PrefsDb::instance()->getPref("AllowNTPTime") == "true");
+	return (nitzPrefFlags() & NITZHANDLER_FLAGBIT_NTPALLOW);
 }
 
 void TimePrefsHandler::signalReceivedNITZUpdate(bool time,bool zone)
@@ -3280,6 +3012,402 @@ bool TimePrefsHandler::cbSetTimeWithNTP(LSHandle* lsHandle, LSMessage *message,
 	return true;
 }
 
+/*!
+\page com_palm_systemservice_time
+\n
+\section com_palm_systemservice_time_reload_zone_data reloadZoneData
+
+\e Private.
+
+com.palm.systemservice/time/reloadZoneData
+
+Switch to zone pack and timezone catalog currently on disk (e.g. after tzdata
+update and rebuild of zone pack with tzpack tool) without service restart.
+Sending SIGHUP to the service does the same.
+
+\subsection com_palm_systemservice_time_reload_zone_data_syntax Syntax:
+\code
+{
+}
+\endcode
+
+\subsection com_palm_systemservice_time_reload_zone_data_returns Returns:
+\code
+{
+    "returnValue": boolean,
+    "zonePack": string,
+    "zones": int,
+    "errorCode": int,
+    "errorText": string
+}
+\endcode
+
+\param returnValue Indicates if the call was succesful.
+\param zonePack Path of zone pack in use (absent if zoneinfo files are used).
+\param zones Number of zones in zone pack.
+\param errorCode Code for the error in case the call was not succesful.
+\param errorText Describes the error if call was not succesful.
+
+\subsection com_palm_systemservice_time_reload_zone_data_examples Examples:
+\code
+luna-send -n 1 -f luna://com.palm.systemservice/time/reloadZoneData '{}'
+\endcode
+
+Example response for a succesful call:
+\code
+{
+    "returnValue": true,
+    "zonePack": "/usr/palm/tzdata.pack",
+    "zones": 594
+}
+\endcode
+*/
+//static
+bool TimePrefsHandler::cbReloadZoneData(LSHandle* lsHandle, LSMessage *message,
+                                        void *user_data)
+{
+	LSMessageJsonParser parser(message, SCHEMA_0);
+
+	ESchemaErrorOptions schErrOption = static_cast<ESchemaErrorOptions>(Settings::settings()->schemaValidationOption);
+	if (!parser.parse(__FUNCTION__, lsHandle, schErrOption))
+		return true;
+
+	TimePrefsHandler* th = (TimePrefsHandler*) user_data;
+
+	// category associated with this callback should be registered correctly
+	assert( th );
+
+	pbnjson::JValue reply;
+	std::string errorText;
+	if (th->reloadZoneData(errorText)) {
+		reply = createJsonReply(true);
+
+		TzPackRef pack = TzPack::current();
+		if (!pack.isNull()) {
+			reply.put("zonePack", pack->filePath());
+			reply.put("zones", (int32_t) pack->zoneCount());
+		}
+	}
+	else {
+		reply = createJsonReply(false, -1, errorText.c_str());
+	}
+
+	LSError lsError;
+	LSErrorInit(&lsError);
+	if (!LSMessageReply(lsHandle, message, jsonToString(reply).c_str(), &lsError))
+	{
+		PmLogError(sysServiceLogContext(), "LSMESSAGEREPLY_FAILURE",
+		           1, PMLOGKS("MESSAGE", lsError.message),
+		           "LSMessageReply failed");
+		LSErrorFree(&lsError);
+		return false;
+	}
+
+	return true;
+}
+
+namespace {
+	pbnjson::JValue histogramToJson(const TimeSyncStats::Histogram &histogram)
+	{
+		pbnjson::JValue buckets = pbnjson::Array();
+		pbnjson::JValue limits = pbnjson::Array();
+		for (size_t i = 0; i < TimeSyncStats::Histogram::bucketCount; ++i)
+		{
+			buckets.append((int32_t) histogram.buckets[i]);
+			if (i + 1 < TimeSyncStats::Histogram::bucketCount)
+				limits.append(TimeSyncStats::Histogram::bucketLimitMs(i));
+		}
+
+		pbnjson::JValue json = pbnjson::Object();
+		json.put("count", (int32_t) histogram.count);
+		json.put("maxMs", (double) histogram.max / 1000000);
+		json.put("buckets", buckets);
+		json.put("limitsMs", limits);
+		return json;
+	}
+
+	pbnjson::JValue costsToJson(const std::map<std::string, TimeSyncStats::Cost> &costs)
+	{
+		pbnjson::JValue json = pbnjson::Object();
+		for (std::map<std::string, TimeSyncStats::Cost>::const_iterator it = costs.begin();
+		     it != costs.end(); ++it)
+		{
+			pbnjson::JValue cost = pbnjson::Object();
+			cost.put("runs", (int32_t) it->second.runs);
+			cost.put("totalUs", it->second.totalNs / 1000);
+			cost.put("maxUs", it->second.maxNs / 1000);
+			json.put(it->first, cost);
+		}
+		return json;
+	}
+
+	std::string costsToString(const std::map<std::string, TimeSyncStats::Cost> &costs)
+	{
+		std::string text;
+		char buf[96];
+		for (std::map<std::string, TimeSyncStats::Cost>::const_iterator it = costs.begin();
+		     it != costs.end(); ++it)
+		{
+			snprintf(buf, sizeof(buf), "%s%s %u/%lld/%lld", text.empty() ? "" : ", ",
+			         it->first.c_str(), it->second.runs,
+			         (long long) (it->second.totalNs / 1000), (long long) (it->second.maxNs / 1000));
+			text += buf;
+		}
+		return text;
+	}
+
+	std::string histogramToString(const TimeSyncStats::Histogram &histogram)
+	{
+		std::string text;
+		char buf[32];
+		for (size_t i = 0; i < TimeSyncStats::Histogram::bucketCount; ++i)
+		{
+			snprintf(buf, sizeof(buf), i ? " %u" : "%u", histogram.buckets[i]);
+			text += buf;
+		}
+		return text;
+	}
+}
+
+/*!
+\page com_palm_systemservice_time
+\n
+\section com_palm_systemservice_time_get_sync_stats getSyncStats
+
+\e Private.
+
+com.palm.systemservice/time/getSyncStats
+
+Get counters of time synchronization quality accumulated since start of the
+service (or since last reset).
+
+Histograms count magnitudes in power of two buckets of milliseconds: bucket 0
+counts values below 1 ms, bucket i counts values in [2^(i-1), 2^i) ms and the
+last one everything above.
+
+\subsection com_palm_systemservice_time_get_sync_stats_syntax Syntax:
+\code
+{
+    "reset": boolean
+}
+\endcode
+
+\param reset Reset counters after reply. Defaults to false.
+
+\subsection com_palm_systemservice_time_get_sync_stats_returns Returns:
+\code
+{
+    "returnValue": boolean,
+    "period": int,
+    "ntp": {
+        "requests": int,
+        "cacheHits": int,
+        "coalesced": int,
+        "queries": int,
+        "failures": int,
+        "pollInterval": int,
+        "driftPpm": double,
+        "roundTrip": histogram,
+        "offset": histogram
+    },
+    "systemTime": {
+        "source": string,
+        "steps": int,
+        "slews": int,
+        "replacedSlews": int,
+        "stepSize": histogram,
+        "slewSize": histogram,
+        "sourceSwitches": int,
+        "sourceUpdates": object
+    },
+    "nitz": {
+        "validity": string,
+        "validityChanges": int,
+        "steps": object
+    },
+    "zoneCache": {
+        "hits": int,
+        "misses": int,
+        "evictions": int,
+        "invalidations": int,
+        "zones": int,
+        "memoryUsage": int,
+        "memoryLimit": int
+    }
+}
+\endcode
+
+\param returnValue Indicates if the call was succesful.
+\param period Seconds counters were accumulated for.
+\param ntp NTP queries and samples (both counted since start or last reset). driftPpm is absent while drift is not estimated.
+\param systemTime Corrections of system time by stepping and slewing, and by time-source. replacedSlews counts slews replaced or cancelled by next correction before completion; slewSize has net change of each slew (minus what was left of replaced one).
+\param zoneCache Lookups of parsed zones (counted since start, not cleared by reset), zones cached now and their memory usage and limit in bytes.
+\param nitz Changes of NITZ validity state. steps has an object with "runs", "totalUs" and "maxUs" for each step of NITZ processing run.
+
+Each histogram is an object with "count", "maxMs", "buckets" (array of
+counts) and "limitsMs" (exclusive upper limit of each bucket but the last).
+
+\subsection com_palm_systemservice_time_get_sync_stats_examples Examples:
+\code
+luna-send -n 1 -f luna://com.palm.systemservice/time/getSyncStats '{}'
+\endcode
+*/
+//static
+bool TimePrefsHandler::cbGetSyncStats(LSHandle* lsHandle, LSMessage *message,
+                                      void *user_data)
+{
+	LSMessageJsonParser parser(message, SCHEMA_1(WITHDEFAULT(reset, boolean, false)));
+
+	ESchemaErrorOptions schErrOption = static_cast<ESchemaErrorOptions>(Settings::settings()->schemaValidationOption);
+	if (!parser.parse(__FUNCTION__, lsHandle, schErrOption))
+		return true;
+
+	TimePrefsHandler* th = (TimePrefsHandler*) user_data;
+
+	// category associated with this callback should be registered correctly
+	assert( th );
+
+	bool reset = false;
+	(void) parser.get("reset", reset);
+
+	const TimeSyncStats &stats = th->m_syncStats;
+	const NTPClock::Stats &ntpStats = th->m_ntpClock.stats;
+	const NTPPollScheduler &scheduler = th->m_ntpClock.pollScheduler;
+
+	struct timespec now;
+	TimeClock::instance()->bootTime(now);
+	int64_t period = (int64_t) now.tv_sec - stats.resetStamp / 1000000000LL;
+
+	pbnjson::JValue ntp = pbnjson::Object();
+	ntp.put("requests", (int32_t) ntpStats.requests);
+	ntp.put("cacheHits", (int32_t) ntpStats.cacheHits);
+	ntp.put("coalesced", (int32_t) ntpStats.coalesced);
+	ntp.put("queries", (int32_t) ntpStats.queries);
+	ntp.put("failures", (int32_t) ntpStats.failures);
+	ntp.put("pollInterval", (int64_t) scheduler.interval());
+	if (scheduler.hasDrift()) ntp.put("driftPpm", scheduler.drift());
+	ntp.put("roundTrip", histogramToJson(stats.ntpRoundTrip));
+	ntp.put("offset", histogramToJson(stats.ntpOffset));
+
+	pbnjson::JValue sourceUpdates = pbnjson::Object();
+	for (std::map<std::string, unsigned int>::const_iterator it = stats.sourceUpdates.begin();
+	     it != stats.sourceUpdates.end(); ++it)
+	{
+		sourceUpdates.put(it->first, (int32_t) it->second);
+	}
+
+	pbnjson::JValue systemTime = pbnjson::Object();
+	systemTime.put("source", th->m_systemTimeSourceTag);
+	systemTime.put("steps", (int32_t) stats.steps);
+	systemTime.put("slews", (int32_t) stats.slews);
+	systemTime.put("replacedSlews", (int32_t) stats.replacedSlews);
+	systemTime.put("stepSize", histogramToJson(stats.stepSize));
+	systemTime.put("slewSize", histogramToJson(stats.slewSize));
+	systemTime.put("sourceSwitches", (int32_t) stats.sourceSwitches);
+	systemTime.put("sourceUpdates", sourceUpdates);
+
+	pbnjson::JValue nitz = pbnjson::Object();
+	nitz.put("validity", PrefsDb::instance()->getPref("nitzValidity"));
+	nitz.put("validityChanges", (int32_t) stats.nitzValidityChanges);
+	nitz.put("steps", costsToJson(stats.nitzSteps));
+
+	TzZoneCache::Stats cacheStats = TzZoneCache::instance()->stats();
+	pbnjson::JValue zoneCache = pbnjson::Object();
+	zoneCache.put("hits", (int64_t) cacheStats.hits);
+	zoneCache.put("misses", (int64_t) cacheStats.misses);
+	zoneCache.put("evictions", (int64_t) cacheStats.evictions);
+	zoneCache.put("invalidations", (int64_t) cacheStats.invalidations);
+	zoneCache.put("zones", (int64_t) cacheStats.zones);
+	zoneCache.put("memoryUsage", (int64_t) cacheStats.memoryUsage);
+	zoneCache.put("memoryLimit", (int64_t) cacheStats.memoryLimit);
+
+	pbnjson::JValue reply = createJsonReply(true);
+	reply.put("period", period);
+	reply.put("ntp", ntp);
+	reply.put("systemTime", systemTime);
+	reply.put("nitz", nitz);
+	reply.put("zoneCache", zoneCache);
+
+	if (reset)
+	{
+		th->logSyncStats();
+		th->m_syncStats.reset();
+		th->m_ntpClock.stats = NTPClock::Stats();
+	}
+
+	LSError lsError;
+	LSErrorInit(&lsError);
+	if (!LSMessageReply(lsHandle, message, jsonToString(reply).c_str(), &lsError))
+	{
+		PmLogError(sysServiceLogContext(), "LSMESSAGEREPLY_FAILURE",
+		           1, PMLOGKS("MESSAGE", lsError.message),
+		           "LSMessageReply failed");
+		LSErrorFree(&lsError);
+		return false;
+	}
+
+	return true;
+}
+
+void TimePrefsHandler::logSyncStats() const
+{
+	const TimeSyncStats &stats = m_syncStats;
+	TzZoneCache::Stats cacheStats = TzZoneCache::instance()->stats();
+
+	PmLogInfo(sysServiceLogContext(), "TIME_SYNC_STATS", 9,
+		PMLOGKS("SOURCE", m_systemTimeSourceTag.c_str()),
+		PMLOGKFV("STEPS", "%u", stats.steps),
+		PMLOGKFV("SLEWS", "%u", stats.slews),
+		PMLOGKFV("REPLACED_SLEWS", "%u", stats.replacedSlews),
+		PMLOGKFV("SOURCE_SWITCHES", "%u", stats.sourceSwitches),
+		PMLOGKFV("NITZ_VALIDITY_CHANGES", "%u", stats.nitzValidityChanges),
+		PMLOGKFV("NTP_SAMPLES", "%u", stats.ntpOffset.count),
+		PMLOGKFV("NTP_FAILURES", "%u", m_ntpClock.stats.failures),
+		PMLOGKFV("NTP_POLL_INTERVAL", "%ld", (long) m_ntpClock.pollScheduler.interval()),
+		"Time sync stats (histograms in log2 ms buckets): "
+		"NTP round-trip [%s], NTP offset [%s], steps [%s], slews [%s], "
+		"NITZ steps (runs/total us/max us) [%s], "
+		"zone cache hits/misses/evictions/invalidations [%lu/%lu/%lu/%lu], "
+		"zones %zu using %zu of %zu bytes",
+		histogramToString(stats.ntpRoundTrip).c_str(),
+		histogramToString(stats.ntpOffset).c_str(),
+		histogramToString(stats.stepSize).c_str(),
+		histogramToString(stats.slewSize).c_str(),
+		costsToString(stats.nitzSteps).c_str(),
+		cacheStats.hits, cacheStats.misses, cacheStats.evictions, cacheStats.invalidations,
+		cacheStats.zones, cacheStats.memoryUsage, cacheStats.memoryLimit
+	);
+}
+
+void TimePrefsHandler::startSyncStatsLog()
+{
+	int interval = Settings::settings()->m_syncStatsLogInterval;
+	if (interval <= 0) return;
+
+	// interval in ms must fit guint (about 49 days)
+	if ((guint) interval > G_MAXUINT / 1000) interval = G_MAXUINT / 1000;
+
+	m_syncStatsSource = TimeClock::instance()->createTimeout((guint) interval * 1000, true);
+	g_source_set_callback(m_syncStatsSource, TimePrefsHandler::source_syncStatsLog, this, NULL);
+
+	GMainContext *context = g_main_loop_get_context(g_gmainLoop);
+	if (g_source_attach(m_syncStatsSource, context) == 0)
+	{
+		qWarning() << "Failed to attach time sync stats source";
+		g_source_destroy(m_syncStatsSource);
+		m_syncStatsSource = NULL;
+		return;
+	}
+	g_source_unref(m_syncStatsSource);		//it's owned now by the context
+}
+
+//static
+gboolean TimePrefsHandler::source_syncStatsLog(gpointer userData)
+{
+	static_cast<TimePrefsHandler*>(userData)->logSyncStats();
+	return TRUE;
+}
+
 //static
 bool TimePrefsHandler::cbSetPeriodicWakeupPowerDResponse(LSHandle* lsHandle, LSMessage *message,
 							void *user_data)
@@ -3400,6 +3528,25 @@ bool TimePrefsHandler::cbServiceStateTracker(LSHandle* lsHandle, LSMessage *mess
 
 }
 
+//static
+bool TimePrefsHandler::cbPowerResume(LSHandle* lsHandle, LSMessage *message,
+								void *user_data)
+{
+	TimePrefsHandler * th = (TimePrefsHandler *)user_data;
+	if (th == NULL)
+		return true;
+
+	// transition of zone may have been passed while we were suspended (extra
+	// re-check on reply to addmatch itself is harmless)
+	th->m_zoneTransitionTimer.resume();
+
+	// monotonicMs of last effective broadcast time stood still while wall
+	// clock went on, so subscribers can't extrapolate it over suspend
+	// (sent only if not predicted, so nothing goes out without suspend)
+	if (!th->isManualTimeUsed()) th->postBroadcastEffectiveTimeChange();
+	return true;
+}
+
 /*!
 \page com_palm_systemservice_time
 \n
@@ -3411,6 +3558,9 @@ com.palm.systemservice/time/getSystemTime
 
 Get system time.
 
+Subscribers are notified when system time or time zone changes and at the
+moment of every transition (DST start/end, offset change) of current zone.
+
 \subsection com_palm_systemservice_time_get_system_time_syntax Syntax:
 \code
 {
@@ -3485,7 +3635,7 @@ bool TimePrefsHandler::cbGetSystemTime(LSHandle* lsHandle, LSMessage *message,
     bool        retVal;
 	LSError     lsError;
 	const char* reply = 0;
-	json_object* json = 0;
+	std::string systemTimeReply;
 	
 	TimePrefsHandler* th = (TimePrefsHandler*) user_data;
 
@@ -3507,10 +3657,11 @@ bool TimePrefsHandler::cbGetSystemTime(LSHandle* lsHandle, LSMessage *message,
 			subscribed=true;
 	}
 
-	json = json_object_new_object();
-	th->attachSystemTime(json);
+	systemTimeReply = "{";
+	systemTimeReply += th->systemTimeMembers();
+	systemTimeReply += "}";
 
-	reply = json_object_to_json_string(json);
+	reply = systemTimeReply.c_str();
 
 	//**DEBUG validate for correct UTF-8 output
 	 if (!g_utf8_validate (reply, -1, NULL))
@@ -3524,9 +3675,6 @@ Done:
 	if (!retVal)
 		LSErrorFree (&lsError);
 
-	if (json)
-		json_object_put(json);
-
 	return true;
 }
 
@@ -3860,6 +4008,10 @@ com.palm.systemservice/time/getNTPTime
 
 Get NTP time.
 
+Concurrent calls share one query to NTP servers. Time received from them is
+reused (advanced by time passed since) for calls that come within
+"NTPCacheTimeout" seconds (60 by default, 0 disables) after it.
+
 \subsection com_palm_systemservice_time_get_ntp_time_syntax Syntax:
 \code
 {
@@ -4000,8 +4152,12 @@ bool TimePrefsHandler::cbConvertDate(LSHandle* pHandle, LSMessage* pMessage, voi
 	char *error_text = NULL;
 	bool ret = false;
 	struct tm local_tm;
+	struct tm dest_tm;
+	char dest_date[64];
 	char * bad_char = NULL;
 	time_t local_time;
+	TzZoneRef source_zone;
+	TzZoneRef dest_zone;
 	const char * str = LSMessageGetPayload(pMessage);
 	if (str == NULL)
 		return false;
@@ -4044,6 +4200,8 @@ bool TimePrefsHandler::cbConvertDate(LSHandle* pHandle, LSMessage* pMessage, voi
 
 	qDebug("%s: converting %s from %s to %s", __func__, date, source_tz, dest_tz);
 	
+	memset(&local_tm, 0, sizeof(local_tm));
+	local_tm.tm_isdst = -1;
 	bad_char = (char *) strptime(date, "%Y-%m-%d %H:%M:%S", &local_tm);
 	if (NULL == bad_char) {
 		error_text = g_strdup_printf("unrecognized date format: '%s'", date);
@@ -4053,30 +4211,30 @@ bool TimePrefsHandler::cbConvertDate(LSHandle* pHandle, LSMessage* pMessage, voi
 		goto respond;
 	}
 
-	if (!tz_exists(source_tz)) {
+	if (tz_exists(source_tz))
+		source_zone = TzZoneCache::instance()->get(source_tz);
+	if (source_zone.isNull()) {
 		error_text = g_strdup_printf("timezone not found: '%s'", source_tz);
 		goto respond;
 	}
 
-	if (!tz_exists(dest_tz)) {
+	if (tz_exists(dest_tz))
+		dest_zone = TzZoneCache::instance()->get(dest_tz);
+	if (dest_zone.isNull()) {
 		error_text = g_strdup_printf("timezone not found: '%s'", dest_tz);
 		goto respond;
 	}
 
-	set_tz(source_tz);
-
-	local_time = mktime(&local_tm);
-    qDebug("0 date='%s' ctime='%s' local_time=%ld timezone=%ld", date, ctime(&local_time), local_time, timezone);
-
-	if (!tz_exists(dest_tz)) {
-		error_text = g_strdup_printf("timezone not found: '%s'", dest_tz);
+	// convert in memory (without touching process-wide TZ)
+	if (!source_zone->toUtc(local_tm, local_time) ||
+		!dest_zone->toLocal(local_time, dest_tm) ||
+		!asctime_r(&dest_tm, dest_date)) {
+		error_text = g_strdup_printf("date out of range: '%s'", date);
+		goto respond;
 	}
+	qDebug("date='%s' local_time=%ld converted='%s'", date, local_time, dest_date);
 
-	set_tz(dest_tz);
-    qDebug("1 date='%s' ctime='%s' local_time=%ld timezone=%ld", date, ctime(&local_time), local_time, timezone);
-
-	g_assert(!error_text);
-	status = g_strdup_printf("{\"returnValue\":true,\"date\":\"%s\"}", ctime(&local_time));
+	status = g_strdup_printf("{\"returnValue\":true,\"date\":\"%s\"}", dest_date);
 
 respond:
 	if (!status) {
@@ -4250,21 +4408,34 @@ void TimePrefsHandler::slotNetworkConnectionStateChanged(bool connected)
 	if (!isNITZTimeEnabled())
 		return;
 
-	std::string interval = PrefsDb::instance()->getPref(".sysservice-time-autoNtpInterval");
-	uint32_t timev = strtoul(interval.c_str(),NULL,10);
-	if ((timev < 300) || (timev > 86400))
-		timev = 86399; //24 hour default (23h.59m.59s actually)
+	NTPPollScheduler &scheduler = m_ntpClock.pollScheduler;
+	scheduler.setLimits(s_minNtpPollInterval, autoNtpInterval());
+
+	// failed polls were probably waiting for connection
+	if (scheduler.failures() > 0)
+		scheduler.expire();
 
-	time_t currTime = currentStamp();
-	qDebug("currTime: %d, lastNtpUpdate: %d, interval: %d",
-           (int)currTime, (int)m_lastNtpUpdate, timev);
-	if ((m_lastNtpUpdate > 0) && (time_t)(m_lastNtpUpdate + timev) > currTime)
+	qDebug("next NTP poll in: %ld, interval: %ld",
+           scheduler.nextPollIn(), scheduler.interval());
+	if (!scheduler.isPollDue())
 		return;
 
 	PMLOG_TRACE("startBootstrapCycle");
     startBootstrapCycle(0);
 }
 
+void TimePrefsHandler::slotNtpPollFinished(bool succeeded, const SntpClient::Sample &sample)
+{
+	if (succeeded)
+	{
+		m_syncStats.ntpRoundTrip.add(sample.delay);
+		m_syncStats.ntpOffset.add(sample.offset);
+	}
+
+	// next periodic poll is picked by NTP schedule
+	setPeriodicTimeSetWakeup();
+}
+
 bool TimePrefsHandler::cbTelephonyPlatformQuery(LSHandle* lsHandle, LSMessage *message,
                                                 void *userData)
 {
@@ -4322,7 +4493,7 @@ bool TimePrefsHandler::cbTelephonyPlatformQuery(LSHandle* lsHandle, LSMessage *m
     return false;
 }
 
-void TimePrefsHandler::clockChanged(const std::string &clockTag, int priority, time_t systemOffset, time_t lastUpdate)
+void TimePrefsHandler::clockChanged(const std::string &clockTag, int priority, int64_t systemOffset, time_t lastUpdate)
 {
 	if (clockTag == ClockHandler::micom)
 	{
@@ -4362,7 +4533,7 @@ void TimePrefsHandler::clockChanged(const std::string &clockTag, int priority, t
 			PmLogInfo(sysServiceLogContext(), "IGNORE_AUTO_CLOCK", 3,
 			          PMLOGKS("SOURCE", clockTag.c_str()),
 			          PMLOGKFV("PRIORITY", "%d", priority),
-			          PMLOGKFV("UTC_OFFSET", "%ld", systemOffset),
+			          PMLOGKFV("UTC_OFFSET", "%lld", (long long)systemOffset),
 			          "In manual mode we ignore external time sources");
 			return;
 		}
@@ -4374,7 +4545,7 @@ void TimePrefsHandler::clockChanged(const std::string &clockTag, int priority, t
 		return;
 	}
 
-	time_t currentTime = time(0);
+	time_t currentTime = TimeClock::instance()->wallSeconds();
 
 	// note that we only allow to increase priority or re-sync time if we
 	// already passed through nextSyncTime
@@ -4385,7 +4556,7 @@ void TimePrefsHandler::clockChanged(const std::string &clockTag, int priority, t
 		          PMLOGKS("SOURCE", clockTag.c_str()),
 		          PMLOGKFV("PRIORITY", "%d", priority),
 		          PMLOGKFV("HIGHER_PRIORITY", "%d", m_currentTimeSourcePriority),
-		          PMLOGKFV("UTC_OFFSET", "%ld", systemOffset),
+		          PMLOGKFV("UTC_OFFSET", "%lld", (long long)systemOffset),
 		          "Ignoring time-source with lower priority");
 		return;
 	}
@@ -4394,7 +4565,7 @@ void TimePrefsHandler::clockChanged(const std::string &clockTag, int priority, t
 	          PMLOGKS("SOURCE", clockTag.c_str()),
 	          PMLOGKFV("PRIORITY", "%d", priority),
 	          PMLOGKFV("CURRENT_PRIORITY", "%d", m_currentTimeSourcePriority),
-	          PMLOGKFV("UTC_OFFSET", "%ld", systemOffset),
+	          PMLOGKFV("UTC_OFFSET", "%lld", (long long)systemOffset),
 	          "Applying time from time-source update");
 
 	// so we actually going to apply this update to our system time
@@ -4403,7 +4574,7 @@ void TimePrefsHandler::clockChanged(const std::string &clockTag, int priority, t
 	{
 		m_currentTimeSourcePriority = priority;
 		// note that lastUpdate is outdated already so we need to adjust it
-		m_nextSyncTime = lastUpdate + systemOffset + timeDriftPeriod; // when we should sync our time again
+		m_nextSyncTime = lastUpdate + ClockHandler::offsetSeconds(systemOffset) + timeDriftPeriod; // when we should sync our time again
 
 		PmLogInfo(sysServiceLogContext(), "SYSTEM_TIME_UPDATED", 3,
 		          PMLOGKS("SOURCE", clockTag.c_str()),
@@ -0,0 +1,142 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeSnapshot.cpp
+ */
+
+#include <string.h>
+#include <sched.h>
+
+#include "BroadcastTime.h"
+#include "TimeClock.h"
+#include "TimeSnapshot.h"
+
+namespace {
+	// reader spins that long on publish in progress before yielding CPU
+	const int spinsBeforeYield = 64;
+}
+
+TimeSnapshot TimeSnapshot::s_instance;
+
+TimeSnapshot* TimeSnapshot::instance()
+{
+	return &s_instance;
+}
+
+TimeSnapshot::TimeSnapshot() :
+	m_sequence( 0 )
+{
+	memset(&m_data, 0, sizeof(m_data));
+	memset(&m_staging, 0, sizeof(m_staging));
+}
+
+void TimeSnapshot::publishSystemOffset(int64_t offset, int64_t uncertainty)
+{
+	m_staging.haveSystemOffset = true;
+	m_staging.systemOffset = offset;
+	m_staging.systemUncertainty = uncertainty;
+	publish();
+}
+
+void TimeSnapshot::publishBroadcast(const BroadcastTime& broadcastTime)
+{
+	m_staging.haveBroadcast = broadcastTime.avail();
+	if (m_staging.haveBroadcast)
+	{
+		m_staging.broadcastUtcOffset = broadcastTime.utcOffset();
+		m_staging.broadcastLocalOffset = broadcastTime.localOffset();
+	}
+	m_staging.broadcastStamp = broadcastTime.stamp();
+	publish();
+}
+
+void TimeSnapshot::publishZone(long utcOffset, bool isDst, time_t validUntil)
+{
+	m_staging.haveZone = true;
+	m_staging.zoneUtcOffset = utcOffset;
+	m_staging.zoneIsDst = isDst;
+	m_staging.zoneValidUntil = validUntil;
+	publish();
+}
+
+void TimeSnapshot::resetZone()
+{
+	m_staging.haveZone = false;
+	m_staging.zoneUtcOffset = 0;
+	m_staging.zoneIsDst = false;
+	m_staging.zoneValidUntil = 0;
+	publish();
+}
+
+void TimeSnapshot::publish()
+{
+	++m_staging.generation;
+
+	// there is only one writer (main loop), so plain increments are enough;
+	// barriers order them against copy of data for readers on other CPUs
+	m_sequence = m_sequence + 1;
+	__sync_synchronize();
+	m_data = m_staging;
+	__sync_synchronize();
+	m_sequence = m_sequence + 1;
+}
+
+bool TimeSnapshot::read(Data& data) const
+{
+	for (int spins = 0; ; ++spins)
+	{
+		unsigned long sequence = m_sequence;
+		if (sequence & 1)
+		{
+			// writer is in the middle of publish
+			if (spins >= spinsBeforeYield) sched_yield();
+			continue;
+		}
+		__sync_synchronize();
+		data = m_data;
+		__sync_synchronize();
+		if (m_sequence == sequence) break;
+	}
+	return data.generation != 0;
+}
+
+bool TimeSnapshot::broadcastTime(time_t& utc, time_t& local) const
+{
+	Data data;
+	if (!read(data) || !data.haveBroadcast) return false;
+
+	time_t currentTime = TimeClock::instance()->wallSeconds();
+	utc = currentTime + data.broadcastUtcOffset;
+	local = currentTime + data.broadcastLocalOffset;
+	return true;
+}
+
+bool TimeSnapshot::zoneOffset(time_t utc, long& utcOffset) const
+{
+	Data data;
+	if (!read(data) || !data.haveZone) return false;
+
+	// main loop re-publishes zone once transition is reached
+	if (data.zoneValidUntil != 0 && utc >= data.zoneValidUntil) return false;
+
+	utcOffset = data.zoneUtcOffset;
+	return true;
+}
@@ -0,0 +1,85 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeSyncStats.cpp
+ */
+
+#include <stdlib.h>
+
+#include "TimeClock.h"
+#include "TimeSyncStats.h"
+
+namespace {
+	const int64_t nsecPerMsec = 1000000;
+}
+
+void TimeSyncStats::Histogram::reset()
+{
+	for (size_t i = 0; i < bucketCount; ++i) buckets[i] = 0;
+	count = 0;
+	max = 0;
+}
+
+void TimeSyncStats::Histogram::add(int64_t ns)
+{
+	if (ns < 0) ns = -ns;
+
+	size_t bucket = 0;
+	for (int64_t ms = ns / nsecPerMsec; ms > 0 && bucket < bucketCount - 1; ms >>= 1)
+	{
+		++bucket;
+	}
+
+	++buckets[bucket];
+	++count;
+	if (ns > max) max = ns;
+}
+
+int64_t TimeSyncStats::Histogram::bucketLimitMs(size_t bucket)
+{
+	return (int64_t)1 << bucket;
+}
+
+void TimeSyncStats::Cost::add(int64_t ns)
+{
+	++runs;
+	totalNs += ns;
+	if (ns > maxNs) maxNs = ns;
+}
+
+void TimeSyncStats::reset()
+{
+	struct timespec ts;
+	TimeClock::instance()->bootTime(ts);
+	resetStamp = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+	ntpRoundTrip.reset();
+	ntpOffset.reset();
+	steps = 0;
+	slews = 0;
+	replacedSlews = 0;
+	stepSize.reset();
+	slewSize.reset();
+	sourceSwitches = 0;
+	sourceUpdates.clear();
+	nitzValidityChanges = 0;
+	nitzSteps.clear();
+}
@@ -0,0 +1,378 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeZoneCatalog.cpp
+ */
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+
+#include <cjson/json.h>
+#include <cjson/json_util.h>
+
+#include "TimeZoneCatalog.h"
+
+namespace {
+	const char* sectionKeys[TimeZoneCatalog::SectionCount] = {
+		"timeZone",
+		"syszones",
+		"mccInfo"
+	};
+
+	json_object* member(json_object* obj, const char* key)
+	{
+		json_object* label = json_object_object_get(obj, key);
+		if (!label || is_error(label))
+			return NULL;
+		return label;
+	}
+
+	/**
+	 * Heap memory held by string: short strings (like country codes) are
+	 * stored inside std::string object itself by C++11 ABI
+	 */
+	size_t heapSize(const std::string& str)
+	{
+		const char* object = reinterpret_cast<const char*>(&str);
+		if (str.data() >= object && str.data() < object + sizeof(str))
+			return 0;
+		return str.capacity() + 1;
+	}
+
+	std::string serializeKey(const char* key)
+	{
+		json_object* str = json_object_new_string(key);
+		std::string text = json_object_to_json_string(str);
+		json_object_put(str);
+		return text;
+	}
+} // anonymous namespace
+
+TimeZoneCatalog::ValuesFilter::ValuesFilter() :
+	countryCode( NULL ),
+	prefix( NULL ),
+	filterOffset( false ),
+	offset( 0 ),
+	start( 0 ),
+	count( -1 )
+{
+}
+
+TimeZoneCatalog::TimeZoneCatalog() :
+	m_loaded( false ),
+	m_defaultZone( -1 )
+{
+}
+
+void TimeZoneCatalog::clear()
+{
+	for (int i = 0; i < SectionCount; ++i) {
+		m_sections[i].zones.clear();
+		m_sections[i].flags.clear();
+	}
+	m_mccs.clear();
+	m_members.clear();
+	m_nameIndex.clear();
+	m_valuesReply.clear();
+	m_defaultZone = -1;
+	m_loaded = false;
+}
+
+bool TimeZoneCatalog::load(const char* path)
+{
+	clear();
+
+	return loadJson(json_object_from_file(const_cast<char*>(path)));
+}
+
+bool TimeZoneCatalog::loadText(const char* text, size_t size)
+{
+	clear();
+
+	// tokener needs NUL-terminated text
+	std::string copy(text, size);
+	return loadJson(json_tokener_parse(copy.c_str()));
+}
+
+bool TimeZoneCatalog::loadJson(json_object* root)
+{
+	if (!root || is_error(root))
+		return false;
+
+	if (!json_object_is_type(root, json_type_object)) {
+		json_object_put(root);
+		return false;
+	}
+
+	json_object_object_foreach(root, key, val) {
+		Member m;
+		m.key = serializeKey(key);
+		m.section = -1;
+
+		for (int i = 0; i < SectionCount; ++i) {
+			if (val && strcmp(key, sectionKeys[i]) == 0 &&
+				json_object_is_type(val, json_type_array))
+				m.section = i;
+		}
+
+		if (m.section == -1) {
+			m.value = val ? json_object_to_json_string(val) : "null";
+			m_members.push_back(m);
+			continue;
+		}
+
+		SectionData& section = m_sections[m.section];
+		int count = json_object_array_length(val);
+		section.zones.reserve(count);
+		section.flags.reserve(count);
+
+		for (int i = 0; i < count; ++i) {
+			json_object* obj = json_object_array_get_idx(val, i);
+
+			TimeZoneInfo zone;
+			zone.dstSupported = 0;
+			zone.offsetToUTC = 0;
+			zone.preferred = false;
+			zone.howManyZonesForCountry = 0;
+			zone.jsonStringValue = obj ? json_object_to_json_string(obj) : "null";
+
+			unsigned char flags = 0;
+			int mcc = 0;
+
+			if (obj && json_object_is_type(obj, json_type_object)) {
+				json_object* label;
+
+				if ((label = member(obj, "ZoneID"))) {
+					zone.name = json_object_get_string(label);
+					flags |= HasName;
+				}
+				if ((label = member(obj, "offsetFromUTC"))) {
+					zone.offsetToUTC = json_object_get_int(label);
+					flags |= HasOffset;
+				}
+				if ((label = member(obj, "supportsDST"))) {
+					zone.dstSupported = json_object_get_int(label);
+					flags |= HasDst;
+				}
+				if ((label = member(obj, "preferred")))
+					zone.preferred = json_object_get_boolean(label);
+				if ((label = member(obj, "CountryCode")))
+					zone.countryCode = json_object_get_string(label);
+				if ((label = member(obj, "mcc"))) {
+					mcc = json_object_get_int(label);
+					flags |= HasMcc;
+				}
+				if (member(obj, "default"))
+					flags |= IsDefault;
+			}
+
+			// generic zones are never preferred and never observe DST
+			if (m.section == SysZones) {
+				zone.countryCode.clear();
+				zone.dstSupported = 0;
+				zone.preferred = false;
+			}
+
+			if (m.section == Zones && (flags & IsDefault) && m_defaultZone == -1)
+				m_defaultZone = section.zones.size();
+
+			if (m.section == MccZones)
+				m_mccs.push_back(mcc);
+
+			section.zones.push_back(zone);
+			section.flags.push_back(flags);
+		}
+
+		m_members.push_back(m);
+	}
+
+	json_object_put(root);
+
+	// how many offsets each country spans (counting zones usable for
+	// selection by offset only)
+	const unsigned zoneFlags = HasName | HasOffset | HasDst;
+	SectionData& zones = m_sections[Zones];
+	std::map<std::string, std::set<int> > countryOffsets;
+	for (size_t i = 0; i < zones.zones.size(); ++i) {
+		if ((zones.flags[i] & zoneFlags) == zoneFlags)
+			countryOffsets[zones.zones[i].countryCode].insert(zones.zones[i].offsetToUTC);
+	}
+	for (size_t i = 0; i < zones.zones.size(); ++i)
+		zones.zones[i].howManyZonesForCountry = countryOffsets[zones.zones[i].countryCode].size();
+
+	// records don't move anymore, so they can be indexed
+	const Section namedSections[] = { Zones, SysZones };
+	for (size_t i = 0; i < sizeof(namedSections)/sizeof(namedSections[0]); ++i) {
+		const SectionData& section = m_sections[namedSections[i]];
+		for (size_t j = 0; j < section.zones.size(); ++j) {
+			if (section.flags[j] & HasName)
+				m_nameIndex.push_back(&section.zones[j]);
+		}
+	}
+	sortIndex(m_nameIndex);
+
+	m_loaded = true;
+	return true;
+}
+
+void TimeZoneCatalog::swap(TimeZoneCatalog& other)
+{
+	// vectors exchange buffers, so records keep their addresses
+	std::swap(m_loaded, other.m_loaded);
+	for (int i = 0; i < SectionCount; ++i) {
+		m_sections[i].zones.swap(other.m_sections[i].zones);
+		m_sections[i].flags.swap(other.m_sections[i].flags);
+	}
+	m_mccs.swap(other.m_mccs);
+	std::swap(m_defaultZone, other.m_defaultZone);
+	m_members.swap(other.m_members);
+	m_nameIndex.swap(other.m_nameIndex);
+	m_valuesReply.swap(other.m_valuesReply);
+}
+
+void TimeZoneCatalog::sortIndex(TimeZoneCatalog::ZoneIndex& index)
+{
+	std::stable_sort(index.begin(), index.end(), TimeZoneNameLess());
+}
+
+const TimeZoneInfo* TimeZoneCatalog::findInIndex(const TimeZoneCatalog::ZoneIndex& index,
+												 const std::string& name)
+{
+	ZoneIndex::const_iterator it = std::lower_bound(index.begin(), index.end(), name, TimeZoneNameLess());
+	if (it == index.end() || (*it)->name != name)
+		return NULL;
+	return *it;
+}
+
+void TimeZoneCatalog::serializeMembers(std::string& text) const
+{
+	for (size_t i = 0; i < m_members.size(); ++i) {
+		const Member& m = m_members[i];
+
+		if (i > 0)
+			text += ",";
+		text += m.key;
+		text += ":";
+
+		if (m.section == -1) {
+			text += m.value;
+			continue;
+		}
+
+		const SectionData& section = m_sections[m.section];
+		text += "[";
+		for (size_t j = 0; j < section.zones.size(); ++j) {
+			if (j > 0)
+				text += ",";
+			text += section.zones[j].jsonStringValue;
+		}
+		text += "]";
+	}
+}
+
+void TimeZoneCatalog::valuesReply(const ValuesFilter& filter, std::string& reply) const
+{
+	if (!filter.countryCode && !filter.prefix && !filter.filterOffset &&
+		(filter.start <= 0) && (filter.count < 0)) {
+		// the whole list never changes, so serialize it only once
+		if (m_valuesReply.empty()) {
+			m_valuesReply = "{";
+			serializeMembers(m_valuesReply);
+			if (m_valuesReply.size() > 1)
+				m_valuesReply += ",";
+			m_valuesReply += "\"returnValue\":true}";
+		}
+		reply = m_valuesReply;
+		return;
+	}
+
+	// start + count could overflow, so window is checked as
+	// matched - start < count (with start >= 0 that can't overflow)
+	int start = std::max(filter.start, 0);
+	size_t prefixLength = filter.prefix ? strlen(filter.prefix) : 0;
+	int matched = 0;
+
+	const SectionData& section = m_sections[Zones];
+	reply = "{\"timeZone\":[";
+	for (size_t i = 0; i < section.zones.size(); i++) {
+		const TimeZoneInfo& zone = section.zones[i];
+		unsigned flags = section.flags[i];
+
+		if (filter.countryCode && (zone.countryCode != filter.countryCode))
+			continue;
+		if (filter.filterOffset && (!(flags & HasOffset) || (zone.offsetToUTC != filter.offset)))
+			continue;
+		if (filter.prefix && (!(flags & HasName) || (zone.name.compare(0, prefixLength, filter.prefix) != 0)))
+			continue;
+
+		if ((matched >= start) && ((filter.count < 0) || (matched - start < filter.count))) {
+			if (reply[reply.size() - 1] != '[')
+				reply += ",";
+			reply += zone.jsonStringValue;
+		}
+		matched++;
+	}
+
+	char tail[64];
+	snprintf(tail, sizeof(tail), "],\"total\":%d,\"returnValue\":true}", matched);
+	reply += tail;
+}
+
+json_object* TimeZoneCatalog::toJson() const
+{
+	if (!m_loaded)
+		return NULL;
+
+	std::string text = "{";
+	serializeMembers(text);
+	text += "}";
+
+	json_object* root = json_tokener_parse(text.c_str());
+	if (!root || is_error(root))
+		return NULL;
+	return root;
+}
+
+size_t TimeZoneCatalog::memoryUsage() const
+{
+	size_t usage = sizeof(*this) + m_mccs.capacity() * sizeof(int);
+
+	for (int i = 0; i < SectionCount; ++i) {
+		const SectionData& section = m_sections[i];
+		usage += section.zones.capacity() * sizeof(TimeZoneInfo) + section.flags.capacity();
+
+		for (size_t j = 0; j < section.zones.size(); ++j) {
+			const TimeZoneInfo& zone = section.zones[j];
+			usage += heapSize(zone.name) + heapSize(zone.countryCode) +
+					 heapSize(zone.jsonStringValue);
+		}
+	}
+
+	for (size_t i = 0; i < m_members.size(); ++i)
+		usage += sizeof(Member) + heapSize(m_members[i].key) + heapSize(m_members[i].value);
+
+	usage += m_nameIndex.capacity() * sizeof(const TimeZoneInfo*) + heapSize(m_valuesReply);
+
+	return usage;
+}
@@ -21,18 +21,54 @@
 #include <time.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include <string>
 #include <list>
+#include <map>
 
 #include "TimeZoneService.h"
 
 #include "PrefsFactory.h"
 #include "TimePrefsHandler.h"
-#include "TzParser.h"
+#include "TzZoneCache.h"
 #include "Logging.h"
 #include "JSONUtils.h"
 
+// how often (in seconds) zoneinfo files of EAS zone index are re-checked
+static const time_t s_easZoneCheckInterval = 60;
+
+/**
+ * UTC offset mktime() applies to local time near utc with tm_isdst set to
+ * isDst: offset in effect if its DST flag matches, otherwise offset of the
+ * closest time with matching flag. Like glibc, times are probed in weekly
+ * steps, earlier time first. That matters for transitions which change
+ * offset without changing DST flag.
+ */
+static long mktimeOffset(const TzZone* zone, int64_t utc, bool isDst)
+{
+	static const int64_t stride = 601200;
+	static const int64_t bound = 536454000 / 2 + stride;
+
+	TzZone::LocalTimeInfo info;
+	zone->lookup(utc, info);
+	if (info.isDst == isDst)
+		return info.utcOffset;
+
+	TzZone::LocalTimeInfo probe;
+	for (int64_t delta = stride; delta < bound; delta += stride) {
+		zone->lookup(utc - delta, probe);
+		if (probe.isDst == isDst)
+			return probe.utcOffset;
+
+		zone->lookup(utc + delta, probe);
+		if (probe.isDst == isDst)
+			return probe.utcOffset;
+	}
+
+	return info.utcOffset;
+}
+
 static LSMethod s_methods[]  = {
 	{ "getTimeZoneRules",  TimeZoneService::cbGetTimeZoneRules },
 	{ "getTimeZoneFromEasData", TimeZoneService::cbGetTimeZoneFromEasData },
@@ -303,11 +339,21 @@ Done:
 
 std::string TimeZoneService::getTimeZoneRules(const TimeZoneService::TimeZoneEntryList& entries)
 {
+	// Same zone is often requested several times (e.g. once per year)
+	typedef std::map<std::string, TzZoneRef> ZoneMap;
+	ZoneMap zones;
+
 	TimeZoneResultList totalResult;
 	for (TimeZoneEntryList::const_iterator it = entries.begin();
 		 it != entries.end(); ++it) {
-		TimeZoneResultList r = getTimeZoneRuleOne(*it);
-		totalResult.splice(totalResult.end(), r);
+		ZoneMap::iterator zoneIt = zones.find(it->tz);
+		if (zoneIt == zones.end())
+			zoneIt = zones.insert(ZoneMap::value_type(it->tz, TzZoneCache::instance()->get(it->tz))).first;
+
+		if (zoneIt->second.isNull())
+			continue;
+
+		getTimeZoneRuleOne(*it, zoneIt->second.get(), totalResult);
 	}
 
 	if (totalResult.empty()) {
@@ -343,11 +389,10 @@ std::string TimeZoneService::getTimeZoneRules(const TimeZoneService::TimeZoneEnt
     return res;
 }
 
-TimeZoneService::TimeZoneResultList TimeZoneService::getTimeZoneRuleOne(const TimeZoneEntry& entry)
+void TimeZoneService::getTimeZoneRuleOne(const TimeZoneEntry& entry, const TzZone* zone,
+										 TimeZoneResultList& results)
 {
-	TimeZoneResultList results;
-
-	TzTransitionList transitionList = parseTimeZone(entry.tz.c_str());
+	const size_t count = zone->transitionCount();
 
 	for (IntList::const_iterator it = entry.years.begin();
 		 it != entry.years.end(); ++it) {
@@ -363,26 +408,17 @@ TimeZoneService::TimeZoneResultList TimeZoneService::getTimeZoneRuleOne(const Ti
 		res.dstStart  = -1;
 		res.dstEnd    = -1;
 
-		// First do a scan to check if there are entries for this year
-		bool hasEntriesForYear = false;
-		for (TzTransitionList::const_iterator iter = transitionList.begin();
-			 iter != transitionList.end(); ++iter) {
+		size_t first, last;
+		zone->yearTransitions(year, first, last);
 
-			const TzTransition& trans = (*iter);
-			if (trans.year == year) {
-				hasEntriesForYear = true;
-				break;
-			}
-		}
+		long stdOffset, dstOffset;
+		int64_t dstStart, dstEnd;
 
-		if (hasEntriesForYear) {
-		
-			for (TzTransitionList::const_iterator iter = transitionList.begin();
-				 iter != transitionList.end(); ++iter) {
+		if (first < last) {
 
-				const TzTransition& trans = (*iter);
-				if (trans.year != year)
-					continue;
+			TzTransition trans;
+			for (size_t i = first; i < last; ++i) {
+				zone->transitionAt(i, trans);
 
 				if (trans.isDst) {
 					res.hasDstChange = true;
@@ -395,25 +431,32 @@ TimeZoneService::TimeZoneResultList TimeZoneService::getTimeZoneRuleOne(const Ti
 				}
 			}
 		}
-		else {
-
-			// Pick the latest year which is < the specified year
-			for (TzTransitionList::const_reverse_iterator iter = transitionList.rbegin();
-				 iter != transitionList.rend(); ++iter) {
-
-				const TzTransition& trans = (*iter);
-				if (trans.year > year)
-					continue;
-
-				res.hasDstChange = false;
-				res.dstOffset    = -1;
-				res.dstStart     = -1;
-				res.dstEnd       = -1;
-				res.utcOffset    = trans.utcOffset;
-
-				break;
+		else if (zone->yearRule(year, stdOffset, dstOffset, dstStart, dstEnd)) {
+
+			// Past the last transition DST follows rules of the zone
+			res.hasDstChange = true;
+			res.utcOffset    = stdOffset;
+			res.dstOffset    = dstOffset;
+			res.dstStart     = dstStart;
+			res.dstEnd       = dstEnd;
+		}
+		else if (count == 0) {
+
+			// Zones which never had a transition time behave as if they had
+			// a single one in 1901
+			if (year >= 1901) {
+				TzZone::LocalTimeInfo info;
+				zone->lookup(0, info);
+				res.utcOffset = info.utcOffset;
 			}
 		}
+		else if (first > 0) {
+
+			// Pick the latest transition before the specified year
+			TzTransition trans;
+			zone->transitionAt(first - 1, trans);
+			res.utcOffset = trans.utcOffset;
+		}
 
 		if (res.utcOffset == -1)
 			continue;
@@ -423,8 +466,6 @@ TimeZoneService::TimeZoneResultList TimeZoneService::getTimeZoneRuleOne(const Ti
 
 		results.push_back(res);
 	}	
-	
-    return results;
 }
 
 /*!
@@ -656,66 +697,23 @@ bool TimeZoneService::cbGetTimeZoneFromEasData(LSHandle* lsHandle, LSMessage *me
 
 			updateEasDateDayOfMonth(easStandardDate, currentYear);
 			updateEasDateDayOfMonth(easDaylightDate, currentYear);
-				
-			
-			for (std::list<std::string>::const_iterator it = timeZones.begin();
-				 it != timeZones.end(); ++it) {
-				TimeZoneEntry tzEntry;
-				tzEntry.tz = (*it);
-				tzEntry.years.push_back(currentYear);
-
-				TimeZoneResultList tzResultList = tzService->getTimeZoneRuleOne(tzEntry);
-				if (tzResultList.empty())
-					continue;
-
-				const TimeZoneResult& tzResult = tzResultList.front();
-	
-				printf("For timezone: %s\n", tzEntry.tz.c_str());
-				printf("year: %d, utcOffset: %"PRIu64", dstOffset: %"PRIu64", dstStart: %"PRIu64", dstEnd: %"PRIu64"\n",
-					   tzResult.year, tzResult.utcOffset, tzResult.dstOffset,
-					   tzResult.dstStart, tzResult.dstEnd);
-
-				// Set this timezone as the current timezone, so that we can calculate when the
-				// DST transitions occurs in seconds for the specified eas data
-				setenv("TZ", tzEntry.tz.c_str(), 1);
-
-				struct tm tzBrokenTime;
-				tzBrokenTime.tm_sec = easStandardDate.second;
-				tzBrokenTime.tm_min = easStandardDate.minute;
-				tzBrokenTime.tm_hour = easStandardDate.hour;
-				tzBrokenTime.tm_mday = easStandardDate.day;
-				tzBrokenTime.tm_mon = easStandardDate.month - 1;
-				tzBrokenTime.tm_year = currentYear - 1900;
-				tzBrokenTime.tm_wday = 0;
-				tzBrokenTime.tm_yday = 0;
-				tzBrokenTime.tm_isdst = 1;
-
-				time_t easStandardDateSeconds = ::mktime(&tzBrokenTime);
-
-				tzBrokenTime.tm_sec = easDaylightDate.second;
-				tzBrokenTime.tm_min = easDaylightDate.minute;
-				tzBrokenTime.tm_hour = easDaylightDate.hour;
-				tzBrokenTime.tm_mday = easDaylightDate.day;
-				tzBrokenTime.tm_mon = easDaylightDate.month - 1;
-				tzBrokenTime.tm_year = currentYear - 1900;
-				tzBrokenTime.tm_wday = 0;
-				tzBrokenTime.tm_yday = 0;
-				tzBrokenTime.tm_isdst = 0;
-
-				time_t easDaylightDateSeconds = ::mktime(&tzBrokenTime);
-
-				printf("eas dstStart: %ld, dstEnd: %ld\n", easDaylightDateSeconds, easStandardDateSeconds);
-				
-				if (easStandardDateSeconds == tzResult.dstEnd &&
-					easDaylightDateSeconds == tzResult.dstStart) {
-					// We have a winner
-					json_object* obj = json_object_new_object();
-					json_object_object_add(obj, "returnValue", json_object_new_boolean(true));
-					json_object_object_add(obj, "timeZone", json_object_new_string(tzEntry.tz.c_str()));
-					reply = json_object_to_json_string(obj);
-					json_object_put(obj);
-					goto Done;
-				}
+
+			// Wall clock times of DST end (in daylight time) and DST start
+			// (in standard time) as seconds since epoch
+			int64_t easStandardDateLocal = easDateToSeconds(easStandardDate, currentYear);
+			int64_t easDaylightDateLocal = easDateToSeconds(easDaylightDate, currentYear);
+
+			const std::string* tz = tzService->findEasZone(-easBias, currentYear, timeZones,
+														   easStandardDateLocal,
+														   easDaylightDateLocal);
+			if (tz) {
+				// We have a winner
+				json_object* obj = json_object_new_object();
+				json_object_object_add(obj, "returnValue", json_object_new_boolean(true));
+				json_object_object_add(obj, "timeZone", json_object_new_string(tz->c_str()));
+				reply = json_object_to_json_string(obj);
+				json_object_put(obj);
+				goto Done;
 			}
 
 			reply = "{\"returnValue\": false, "
@@ -797,6 +795,119 @@ void TimeZoneService::readEasDate(json_object* obj, TimeZoneService::EasSystemTi
 	time.valid = true;
 }
 
+int64_t TimeZoneService::easDateToSeconds(const TimeZoneService::EasSystemTime& time, int year)
+{
+	struct tm brokenTime;
+	memset(&brokenTime, 0, sizeof(brokenTime));
+	brokenTime.tm_sec = time.second;
+	brokenTime.tm_min = time.minute;
+	brokenTime.tm_hour = time.hour;
+	brokenTime.tm_mday = time.day;
+	brokenTime.tm_mon = time.month - 1;
+	brokenTime.tm_year = year - 1900;
+
+	return ::timegm(&brokenTime);
+}
+
+const std::string* TimeZoneService::findEasZone(int offset, int year,
+												const std::list<std::string>& timeZones,
+												int64_t standardDate, int64_t daylightDate)
+{
+	EasZoneGroup& group = m_easZoneGroups[offset];
+	if (isEasZoneGroupStale(group, year, timeZones))
+		buildEasZoneGroup(group, offset, year, timeZones);
+
+	EasZoneMap::const_iterator it = group.zones.find(EasZoneKey(standardDate, daylightDate));
+	if (it == group.zones.end())
+		return NULL;
+
+	return &it->second;
+}
+
+void TimeZoneService::clearEasZones()
+{
+	m_easZoneGroups.clear();
+}
+
+bool TimeZoneService::isEasZoneGroupStale(TimeZoneService::EasZoneGroup& group, int year,
+										  const std::list<std::string>& timeZones)
+{
+	if (group.year != year || group.timeZones != timeZones)
+		return true;
+
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec - group.lastCheck < s_easZoneCheckInterval)
+		return false;
+
+	group.lastCheck = now.tv_sec;
+
+	// Rebuild if zoneinfo file of any zone was updated
+	for (EasZoneStampList::const_iterator it = group.stamps.begin();
+		 it != group.stamps.end(); ++it) {
+		struct stat st;
+		if (stat(it->path.c_str(), &st) != 0 ||
+			st.st_mtime != it->mtime || st.st_ino != it->ino || st.st_size != it->size)
+			return true;
+	}
+
+	return false;
+}
+
+void TimeZoneService::buildEasZoneGroup(TimeZoneService::EasZoneGroup& group, int offset, int year,
+										const std::list<std::string>& timeZones)
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	group.year = year;
+	group.lastCheck = now.tv_sec;
+	group.timeZones = timeZones;
+	group.zones.clear();
+	group.stamps.clear();
+
+	for (std::list<std::string>::const_iterator it = timeZones.begin();
+		 it != timeZones.end(); ++it) {
+
+		// Zones are only needed once, so don't pollute zone cache with them
+		TzZoneRef zone(TzZone::load(it->c_str()));
+		if (zone.isNull())
+			continue;
+
+		EasZoneStamp stamp;
+		stamp.path = zone->filePath();
+		stamp.mtime = zone->fileStat().st_mtime;
+		stamp.ino = zone->fileStat().st_ino;
+		stamp.size = zone->fileStat().st_size;
+		group.stamps.push_back(stamp);
+
+		TimeZoneEntry tzEntry;
+		tzEntry.tz = (*it);
+		tzEntry.years.push_back(year);
+
+		TimeZoneResultList tzResultList;
+		getTimeZoneRuleOne(tzEntry, zone.get(), tzResultList);
+		if (tzResultList.empty())
+			continue;
+
+		const TimeZoneResult& tzResult = tzResultList.front();
+		if (tzResult.dstStart == -1 || tzResult.dstEnd == -1)
+			continue;
+
+		// EAS standard date is the end of DST in daylight time and EAS
+		// daylight date is the start of DST in standard time, both using
+		// offsets mktime() applies to them. First zone in the list wins,
+		// so insert() must not replace existing entries.
+		EasZoneKey key(tzResult.dstEnd + mktimeOffset(zone.get(), tzResult.dstEnd - 1, true),
+					   tzResult.dstStart + mktimeOffset(zone.get(), tzResult.dstStart - 1, false));
+		group.zones.insert(EasZoneMap::value_type(key, tzEntry.tz));
+	}
+
+	qDebug("EAS zone index for offset %d, year %d: %d zones, %d DST rules",
+		   offset, year,
+		   (int) group.stamps.size(), (int) group.zones.size());
+}
+
 // This function figures out the correct day of month based o
 void TimeZoneService::updateEasDateDayOfMonth(TimeZoneService::EasSystemTime& time, int year)
 {	
@@ -0,0 +1,353 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TzPack.cpp
+ */
+
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "TzPack.h"
+
+namespace {
+	const char     packMagic[4] = { 'T', 'Z', 'p', 'k' };
+	const uint32_t packVersion = 1;
+	const size_t   headerSize = 5 * 4;
+	const size_t   recordSize = 3 * 4;
+
+	pthread_mutex_t s_currentMutex = PTHREAD_MUTEX_INITIALIZER;
+	const TzPack*   s_current = NULL;
+
+	struct Lock
+	{
+		Lock(pthread_mutex_t &mutex) : m_mutex(mutex) { pthread_mutex_lock(&m_mutex); }
+		~Lock() { pthread_mutex_unlock(&m_mutex); }
+
+	private:
+		pthread_mutex_t &m_mutex;
+	};
+
+	void putWord(std::string& buffer, uint32_t value)
+	{
+		char bytes[4] = { char(value >> 24), char(value >> 16), char(value >> 8), char(value) };
+		buffer.append(bytes, sizeof(bytes));
+	}
+
+	bool readFile(const std::string& path, std::string& content)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+
+		content.clear();
+		char buffer[4096];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			content.append(buffer, count);
+
+		bool ok = !ferror(file);
+		fclose(file);
+		return ok;
+	}
+
+	typedef std::map<std::string, std::string> ZoneFiles;	// name -> zoneinfo data
+
+	/**
+	 * Collect zoneinfo files under dir (prefix is path of dir relative to
+	 * zoneinfo root). Symlinks to files are followed, symlinks to
+	 * directories are not.
+	 */
+	bool scanZones(const std::string& dir, const std::string& prefix, ZoneFiles& zones, std::string& errorText)
+	{
+		DIR* handle = opendir(dir.c_str());
+		if (!handle) {
+			errorText = "can't read directory " + dir + ": " + strerror(errno);
+			return false;
+		}
+
+		bool ok = true;
+		struct dirent* entry;
+		while (ok && (entry = readdir(handle)) != NULL) {
+			const std::string name = entry->d_name;
+			if (name.empty() || name[0] == '.')
+				continue;
+
+			// variants with POSIX and leap seconds rules duplicate main zones
+			if (prefix.empty() && (name == "posix" || name == "right"))
+				continue;
+
+			const std::string path = dir + "/" + name;
+			struct stat st;
+			if (lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+				ok = scanZones(path, prefix + name + "/", zones, errorText);
+				continue;
+			}
+
+			if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+				continue;
+
+			std::string content;
+			if (!readFile(path, content)) {
+				errorText = "can't read " + path + ": " + strerror(errno);
+				ok = false;
+				continue;
+			}
+
+			// skip zone.tab, iso3166.tab and other non-zone files
+			if (content.size() < 44 || content.compare(0, 4, "TZif") != 0)
+				continue;
+
+			zones[prefix + name].swap(content);
+		}
+
+		closedir(handle);
+		return ok;
+	}
+} // anonymous namespace
+
+TzPack::TzPack() :
+	m_map( NULL ),
+	m_size( 0 ),
+	m_zoneCount( 0 ),
+	m_catalogOffset( 0 ),
+	m_catalogSize( 0 ),
+	m_refCount( 0 )
+{
+	memset(&m_fileStat, 0, sizeof(m_fileStat));
+}
+
+TzPack::~TzPack()
+{
+	if (m_map)
+		munmap((void*) m_map, m_size);
+}
+
+TzPack* TzPack::load(const char* path)
+{
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	TzPack* pack = new TzPack;
+	pack->m_filePath = path;
+
+	if (fstat(fd, &pack->m_fileStat) != 0 || pack->m_fileStat.st_size < (off_t) headerSize) {
+		::close(fd);
+		delete pack;
+		return NULL;
+	}
+
+	void* map = mmap(NULL, pack->m_fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (map == MAP_FAILED) {
+		delete pack;
+		return NULL;
+	}
+
+	pack->m_map = (const char*) map;
+	pack->m_size = pack->m_fileStat.st_size;
+
+	if (memcmp(pack->m_map, packMagic, sizeof(packMagic)) != 0 || pack->word(4) != packVersion) {
+		delete pack;
+		return NULL;
+	}
+
+	pack->m_zoneCount = pack->word(8);
+	pack->m_catalogOffset = pack->word(12);
+	pack->m_catalogSize = pack->word(16);
+
+	bool ok = pack->m_zoneCount <= (pack->m_size - headerSize) / recordSize &&
+	          pack->m_catalogOffset <= pack->m_size &&
+	          pack->m_catalogSize <= pack->m_size - pack->m_catalogOffset;
+
+	// validate index once, so lookups may trust it
+	for (size_t i = 0; ok && i < pack->m_zoneCount; ++i) {
+		size_t record = headerSize + i * recordSize;
+		size_t nameOffset = pack->word(record);
+		size_t dataOffset = pack->word(record + 4);
+		size_t dataSize = pack->word(record + 8);
+
+		ok = nameOffset < pack->m_size &&
+		     memchr(pack->m_map + nameOffset, '\0', pack->m_size - nameOffset) != NULL &&
+		     dataOffset <= pack->m_size && dataSize <= pack->m_size - dataOffset &&
+		     (i == 0 || strcmp(pack->zoneName(i - 1), pack->zoneName(i)) < 0);
+	}
+
+	if (!ok) {
+		delete pack;
+		return NULL;
+	}
+
+	return pack;
+}
+
+bool TzPack::build(const char* zoneInfoDir, const char* catalogPath,
+                   const char* path, std::string& errorText)
+{
+	ZoneFiles zones;
+	if (!scanZones(zoneInfoDir, "", zones, errorText))
+		return false;
+
+	if (zones.empty()) {
+		errorText = std::string("no zoneinfo files found in ") + zoneInfoDir;
+		return false;
+	}
+
+	std::string catalog;
+	if (catalogPath && *catalogPath && !readFile(catalogPath, catalog)) {
+		errorText = std::string("can't read ") + catalogPath + ": " + strerror(errno);
+		return false;
+	}
+
+	// names go right after index, followed by zone data (linked zones
+	// share single copy) and catalog
+	size_t namesOffset = headerSize + zones.size() * recordSize;
+	std::string names;
+	for (ZoneFiles::const_iterator it = zones.begin(); it != zones.end(); ++it)
+		names.append(it->first.c_str(), it->first.size() + 1);
+
+	size_t dataOffset = namesOffset + names.size();
+	std::string index;
+	std::string data;
+	std::map<std::string, size_t> dataOffsets;
+	size_t nameOffset = namesOffset;
+
+	for (ZoneFiles::const_iterator it = zones.begin(); it != zones.end(); ++it) {
+		std::map<std::string, size_t>::iterator shared = dataOffsets.find(it->second);
+		if (shared == dataOffsets.end()) {
+			shared = dataOffsets.insert(std::make_pair(it->second, dataOffset + data.size())).first;
+			data += it->second;
+		}
+
+		putWord(index, nameOffset);
+		putWord(index, shared->second);
+		putWord(index, it->second.size());
+		nameOffset += it->first.size() + 1;
+	}
+
+	std::string header(packMagic, sizeof(packMagic));
+	putWord(header, packVersion);
+	putWord(header, zones.size());
+	putWord(header, dataOffset + data.size());
+	putWord(header, catalog.size());
+
+	const std::string tmpPath = std::string(path) + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (!file) {
+		errorText = "can't create " + tmpPath + ": " + strerror(errno);
+		return false;
+	}
+
+	const std::string* parts[] = { &header, &index, &names, &data, &catalog };
+	bool ok = true;
+	for (size_t i = 0; ok && i < sizeof(parts)/sizeof(parts[0]); ++i)
+		ok = fwrite(parts[i]->data(), 1, parts[i]->size(), file) == parts[i]->size();
+
+	ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+	ok = (fclose(file) == 0) && ok;
+
+	// readers either see old pack or complete new one
+	if (!ok || rename(tmpPath.c_str(), path) != 0) {
+		errorText = "can't write " + std::string(path) + ": " + strerror(errno);
+		unlink(tmpPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+TzPackRef TzPack::current()
+{
+	Lock lock(s_currentMutex);
+	return TzPackRef(s_current);
+}
+
+void TzPack::setCurrent(const TzPackRef& pack)
+{
+	const TzPack* previous;
+	{
+		Lock lock(s_currentMutex);
+		previous = s_current;
+		s_current = pack.get();
+		if (s_current)
+			s_current->ref();
+	}
+
+	// zones loaded from previous pack keep it alive while they are in use
+	if (previous)
+		previous->unref();
+}
+
+void TzPack::ref() const
+{
+	__sync_add_and_fetch(&m_refCount, 1);
+}
+
+void TzPack::unref() const
+{
+	if (__sync_sub_and_fetch(&m_refCount, 1) == 0)
+		delete this;
+}
+
+bool TzPack::find(const char* tzName, const char*& data, size_t& size) const
+{
+	size_t first = 0;
+	size_t count = m_zoneCount;
+
+	while (count > 0) {
+		size_t step = count / 2;
+		if (strcmp(zoneName(first + step), tzName) < 0) {
+			first += step + 1;
+			count -= step + 1;
+		}
+		else {
+			count = step;
+		}
+	}
+
+	if (first == m_zoneCount || strcmp(zoneName(first), tzName) != 0)
+		return false;
+
+	size_t record = headerSize + first * recordSize;
+	data = m_map + word(record + 4);
+	size = word(record + 8);
+	return true;
+}
+
+const char* TzPack::zoneName(size_t index) const
+{
+	return m_map + word(headerSize + index * recordSize);
+}
+
+uint32_t TzPack::word(size_t offset) const
+{
+	const unsigned char* p = (const unsigned char*) (m_map + offset);
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
@@ -0,0 +1,87 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TzPackTool.cpp
+ *
+ *  tzpack - compiles zoneinfo files and timezone catalog into zone pack
+ *  (see TzPack) used by LunaSysService.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "TzPack.h"
+
+namespace {
+	void usage(const char* program)
+	{
+		fprintf(stderr,
+		        "Usage: %s [-z zoneinfo-dir] [-c catalog] pack\n"
+		        "  -z  directory with zoneinfo files (default: /usr/share/zoneinfo)\n"
+		        "  -c  ext-timezones.json to include (default: none)\n",
+		        program);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	const char* zoneInfoDir = "/usr/share/zoneinfo";
+	const char* catalogPath = NULL;
+
+	int option;
+	while ((option = getopt(argc, argv, "z:c:h")) != -1) {
+		switch (option) {
+		case 'z':
+			zoneInfoDir = optarg;
+			break;
+		case 'c':
+			catalogPath = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return option == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	const char* packPath = argv[optind];
+	std::string errorText;
+	if (!TzPack::build(zoneInfoDir, catalogPath, packPath, errorText)) {
+		fprintf(stderr, "tzpack: %s\n", errorText.c_str());
+		return 1;
+	}
+
+	// make sure service will accept it
+	TzPackRef pack(TzPack::load(packPath));
+	if (pack.isNull()) {
+		fprintf(stderr, "tzpack: written pack %s is not valid\n", packPath);
+		return 1;
+	}
+
+	printf("%s: %zu zones, catalog %zu bytes, %zu bytes total\n",
+	       packPath, pack->zoneCount(), pack->catalogSize(), pack->mappedSize());
+	return 0;
+}
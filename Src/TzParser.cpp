@@ -1,5 +1,5 @@
 /**
- *  Copyright (c) 2010-2013 LG Electronics, Inc.
+ *  Copyright (c) 2010-2014 LG Electronics, Inc.
  * 
  *  Licensed under the Apache License, Version 2.0 (the "License");
  *  you may not use this file except in compliance with the License.
@@ -32,12 +32,15 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "TzParser.h"
+#include "TzPack.h"
 
 //#define TRACE 1
 
@@ -52,9 +55,6 @@
 #define TZ_ABBR_CHAR_SET "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 :+-._"
 #define TZ_ABBR_ERR_CHAR  '_'
 
-#define TYPE_SIGNED(type) (((type) -1) < 0)
-#define TYPE_INTEGRAL(type) (((type) 0.5) != 0.5)
-
 struct tzhead {
 	char    tzh_magic[4];       /* TZ_MAGIC */
 	char    tzh_version[1];     /* '\0' or '2' as of 2005 */
@@ -67,21 +67,6 @@ struct tzhead {
 	char    tzh_charcnt[4];     /* coded number of abbr. chars */
 };
 
-struct ttinfo {
-	time_t gmtOffset;
-	bool   isDst;
-	int    abbrIndex;
-};
-
-struct ttentry {	
-	time_t time;
-	int    indexToLocalTime;
-};
-
-
-typedef std::vector<ttentry> ttentrylist;
-typedef std::vector<ttinfo>  ttinfolist;
-
 static long
 detzcode(const char* codep)
 {
@@ -94,10 +79,10 @@ detzcode(const char* codep)
 	return result;
 }
 
-static time_t
+static int64_t
 detzcode64(const char* codep)
 {
-	register time_t	result;
+	register int64_t	result;
 	register int	i;
 
 	result = (codep[0] & 0x80) ?  (~(int64_t) 0) : 0;
@@ -106,64 +91,187 @@ detzcode64(const char* codep)
 	return result;
 }
 
-TzTransitionList parseTimeZone(const char* tzName)
+static std::string s_zoneInfoDir = "/usr/share/zoneinfo/";
+
+// total += count * size unless that overflows size_t
+static bool
+addProduct(size_t& total, size_t count, size_t size)
+{
+	if (size != 0 && count > ((size_t) -1 - total) / size)
+		return false;
+	total += count * size;
+	return true;
+}
+
+TzFile::TzFile() :
+	m_map( NULL ),
+	m_size( 0 ),
+	m_pack( NULL ),
+	m_timeSize( 0 ),
+	m_timeCount( 0 ),
+	m_typeCount( 0 ),
+	m_charCount( 0 ),
+	m_transitionTimes( NULL ),
+	m_transitionTypes( NULL ),
+	m_types( NULL ),
+	m_abbrChars( NULL )
+{
+	memset(&m_fileStat, 0, sizeof(m_fileStat));
+}
+
+TzFile::~TzFile()
+{
+	close();
+}
+
+void TzFile::close()
+{
+	if (m_pack)
+		m_pack->unref();
+	else if (m_map)
+		munmap((void*) m_map, m_size);
+
+	m_map = NULL;
+	m_pack = NULL;
+	m_size = 0;
+	m_timeCount = 0;
+	m_typeCount = 0;
+	m_charCount = 0;
+	m_footer.clear();
+}
+
+void TzFile::setZoneInfoDir(const std::string& dir)
+{
+	s_zoneInfoDir = dir;
+	if (s_zoneInfoDir.empty() || s_zoneInfoDir[s_zoneInfoDir.size() - 1] != '/')
+		s_zoneInfoDir += '/';
+}
+
+bool TzFile::open(const char* tzName)
 {
-	static const char* zoneInfoDir = "/usr/share/zoneinfo/";
-	static const char* etcZoneInfoDir = "/usr/share/zoneinfo/Etc/";
-	std::string filePath = zoneInfoDir;
-	filePath += tzName;
-	
-	struct stat stBuf;
-	FILE* fp = fopen(filePath.c_str(), "r");
-	if (!fp && errno == ENOENT)
+	close();
+
+	TzPackRef pack = TzPack::current();
+	if (!pack.isNull()) {
+		if (openPacked(pack.get(), tzName))
+			return true;
+
+		std::string etcName = std::string("Etc/") + tzName;
+		if (openPacked(pack.get(), etcName.c_str()))
+			return true;
+	}
+
+	m_filePath = s_zoneInfoDir;
+	m_filePath += tzName;
+
+	int fd = ::open(m_filePath.c_str(), O_RDONLY);
+	if (fd < 0 && errno == ENOENT)
 	{
 		// if file not found - try alternative filePath
-		printf("Failed to find file: %s\n", filePath.c_str());
+		printf("Failed to find file: %s\n", m_filePath.c_str());
 
-		filePath = etcZoneInfoDir;
-		filePath += tzName;
+		m_filePath = s_zoneInfoDir + "Etc/";
+		m_filePath += tzName;
 
-		fp = fopen(filePath.c_str(), "r");
-		if (!fp && errno == ENOENT)
+		fd = ::open(m_filePath.c_str(), O_RDONLY);
+		if (fd < 0 && errno == ENOENT)
 		{
-			printf("Failed to find second try file: %s\n", filePath.c_str());
-			return TzTransitionList();
+			printf("Failed to find second try file: %s\n", m_filePath.c_str());
+			return false;
 		}
 	}
-	if (fp)
+	if (fd < 0)
 	{
-		if (fstat(fileno(fp), &stBuf) != 0)
-		{
-			printf("Failed to stat opened file: %s\n", filePath.c_str());
-			fclose(fp);
-			return TzTransitionList();
-		}
+		printf("Failed to open file: %s\n", m_filePath.c_str());
+		return false;
+	}
+
+	if (fstat(fd, &m_fileStat) != 0)
+	{
+		printf("Failed to stat opened file: %s\n", m_filePath.c_str());
+		::close(fd);
+		return false;
+	}
+
+	if (m_fileStat.st_size <= (int) sizeof(tzhead)) {
+		printf("file too short to be a tz file: %s\n", m_filePath.c_str());
+		::close(fd);
+		return false;
+	}
 
-		if (stBuf.st_size <= (int) sizeof(tzhead)) {
-			printf("file too short to be a tz file: %s\n", filePath.c_str());
-			fclose(fp);
-			return TzTransitionList();
+	void* map = mmap(NULL, m_fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (map == MAP_FAILED) {
+		printf("Failed to map file: %s\n", m_filePath.c_str());
+		return false;
+	}
+
+	m_map = (const char*) map;
+	m_size = m_fileStat.st_size;
+
+	return parse();
+}
+
+bool TzFile::openPacked(const TzPack* pack, const char* tzName)
+{
+	const char* data;
+	size_t size;
+	if (!pack->find(tzName, data, size))
+		return false;
+
+	if (size <= sizeof(tzhead)) {
+		printf("Packed zone too short to be a tz file: %s\n", tzName);
+		return false;
+	}
+
+	// data stays mapped as long as pack is referenced
+	pack->ref();
+	m_pack = pack;
+	m_map = data;
+	m_size = size;
+	m_filePath = pack->filePath();
+	m_fileStat = pack->fileStat();
+
+	return parse();
+}
+
+bool TzFile::parse()
+{
+	// Version 1 data always comes first. Version 2+ files repeat the data
+	// with 64-bit transition times, followed by a POSIX TZ footer describing
+	// local time after the last transition.
+	size_t index = 0;
+	bool ok = locateSection(index, 4);
+	if (ok && ((const struct tzhead*) m_map)->tzh_version[0] != '\0') {
+		ok = locateSection(index, 8);
+
+		if (ok && index < m_size && m_map[index] == '\n') {
+			const char* begin = m_map + index + 1;
+			const char* end = (const char*) memchr(begin, '\n', m_size - index - 1);
+			if (end)
+				m_footer.assign(begin, end - begin);
 		}
 	}
-	else
-	{
-		printf("Failed to open file: %s\n", filePath.c_str());
-		return TzTransitionList();
-	}	
-
-	char* buf = (char*) malloc(stBuf.st_size);
-	size_t size = fread(buf, 1, stBuf.st_size, fp);
-	fclose(fp);
-
-	if (size != (size_t) stBuf.st_size) {
-		printf("Short read on file: %s\n", filePath.c_str());
-		free(buf);
-		return TzTransitionList();
+
+	if (!ok) {
+		close();
+		return false;
+	}
+
+	DBG("Total Buffer size parsed: %zu\n", index);
+	return true;
+}
+
+bool TzFile::locateSection(size_t& index, int timeSize)
+{
+	if (index + sizeof(struct tzhead) > m_size ||
+		memcmp(m_map + index, TZ_MAGIC, 4) != 0) {
+		printf("Not a tz file. Header signature mismatch: %s\n", m_filePath.c_str());
+		return false;
 	}
 
-	ttentrylist       ttEntryList;
-	ttinfolist        ttInfoList;
-	std::vector<char> ttAbbrList;
+	const struct tzhead* head = (const struct tzhead*) (m_map + index);
 
 	/*
 	  The  time zone information files used by tzset(3) begin with the
@@ -191,290 +299,154 @@ TzTransitionList parseTimeZone(const char* tzName)
        tzh_charcnt
               The number of characters of "time zone abbreviation strings" stored in the file.
 	*/
-	
-	long leapCnt = 0;
-	long timeCnt = 0;
-	long typeCnt = 0;	
-	long charCnt = 0;
-
-	(void) leapCnt;
-	(void) timeCnt;
-	(void) typeCnt;
-	(void) charCnt;
-	
-	int index = 0;
-	for (int stored = 4; stored <= 8; stored *= 2) {
-
-		DBG("-----------------------------------------------------\n");
-
-		if (memcmp(buf, TZ_MAGIC, 4) != 0) {
-			printf("Not a tz file. Header signature mismatch: %s\n", filePath.c_str());
-			free(buf);
-			return TzTransitionList();
-		}
-		
-		struct tzhead* head = (struct tzhead*) (buf + index);
-
-		leapCnt = detzcode(head->tzh_leapcnt);
-		timeCnt = detzcode(head->tzh_timecnt);
-		typeCnt = detzcode(head->tzh_typecnt);
-		charCnt = detzcode(head->tzh_charcnt);
-
-		ttInfoList.clear();
-		ttInfoList.reserve(timeCnt);
-
-		ttEntryList.clear();
-		ttEntryList.reserve(typeCnt);
-
-		ttAbbrList.clear();
-		ttAbbrList.reserve(charCnt + 1);
-
-		index += sizeof(struct tzhead);
-	
-		DBG("tzh_ttisgmtcnt: %ld\n", detzcode(head->tzh_ttisgmtcnt));
-		DBG("tzh_ttisstdcnt: %ld\n", detzcode(head->tzh_ttisstdcnt));
-		DBG("tzh_leapcnt: %ld\n", leapCnt);
-		DBG("tzh_timecnt: %ld\n", timeCnt);
-		DBG("tzh_typecnt: %ld\n", typeCnt);
-		DBG("tzh_charcnt: %ld\n", charCnt);
-
-		/* The  above  header  is followed by tzh_timecnt four-byte values of type
-		   long, sorted in ascending order.  These values are  written  in  "standard"
-		   byte  order.   Each is used as a transition time (as returned by
-		   time(2)) at which the rules for computing local time change. */
-		for (long i = 0; i < timeCnt; i++) {
-			time_t time;
-			time = (stored == 4) ? detzcode(buf + index) : detzcode64(buf + index);
-			index += stored;
-			
-			ttentry e;
-			e.time = time;
-			ttEntryList.push_back(e);
-
-			DBG("tzh_timecnt: Time: %ld, %s", time, asctime(gmtime(&time)));			
-		}
-
-		/* Next come tzh_timecnt one-byte values of type unsigned char;
-		   each one tells which of the different types of "local time"
-		   types described in the file is associated with the same-indexed
-		   transition time. */
-		for (long i = 0; i < timeCnt; i++) {
-			unsigned char indexToLocalTime = (unsigned char) buf[index];
-			index++;
-
-			ttEntryList[i].indexToLocalTime = indexToLocalTime;
-			
-			DBG("tzh_timecnt: Index: %d\n", indexToLocalTime);			
-		}
-
-		/* These values serve as indices into an  array  of
-		   ttinfo structures that appears next in the file; these structures are
-		   defined as follows:
-
-           struct ttinfo {
-		   long         tt_gmtoff;
-		   int          tt_isdst;
-		   unsigned int tt_abbrind;
-           };
-
-		   Each  structure is written as a four-byte value for tt_gmtoff of type
-		   long, in a standard byte order, followed by a one-byte value
-		   for tt_isdst and a one-byte value for tt_abbrind.  In each structure,
-		   tt_gmtoff gives the number of seconds to be  added  to  UTC,
-		   tt_isdst  tells  whether  tm_isdst  should  be  set by localtime(3),
-		   and tt_abbrind serves as an index into the array of time zone
-		   abbreviation characters that follow the ttinfo structure(s) in the file. */
-		for (long i = 0; i < typeCnt; i++) {
-
-			ttinfo ttInfo;
-			ttInfo.gmtOffset = detzcode(buf + index);
-			index += 4;
-			ttInfo.isDst = (unsigned char) buf[index];
-			index++;
-			ttInfo.abbrIndex = (unsigned char) buf[index];
-			index++;
-
-			ttInfoList.push_back(ttInfo);
-
-			DBG("gmtOff: %ld, isDst: %d, abbrind: %d\n",
-				ttInfo.gmtOffset, ttInfo.isDst, ttInfo.abbrIndex);
-		}
-
-		DBG("abbrev: ");
-		for (long i = 0; i < charCnt; i++) {
-			DBG("%c", buf[index]);
-			ttAbbrList.push_back(buf[index]);
-			index++;
-		}
-		ttAbbrList.push_back(0);
-		DBG("\n");
-
-		/* Then there are tzh_leapcnt pairs of four-byte values,
-		   written in standard byte order; the first value of each
-		   pair gives the  time (as  returned by time(2)) at which a leap
-		   second occurs; the second gives the total number of leap seconds
-		   to be applied after the given time.  The pairs of values are
-		   sorted in ascending order by time. */
-		for (long i = 0; i < leapCnt; i++) {
-
-			long leapTime = (stored == 4) ? detzcode(buf + index)
-							: detzcode64(buf + index);
-			index += stored;
-
-			long leapSeconds = detzcode(buf + index);
-			index += 4;
-
-			(void) leapTime;
-			(void) leapSeconds;
-
-			DBG("leapTime: %ld, leapSeconds: %ld\n",
-				leapTime, leapSeconds);
-		}
+	long ttisgmtCode = detzcode(head->tzh_ttisgmtcnt);
+	long ttisstdCode = detzcode(head->tzh_ttisstdcnt);
+	long leapCode = detzcode(head->tzh_leapcnt);
+	long timeCode = detzcode(head->tzh_timecnt);
+	long typeCode = detzcode(head->tzh_typecnt);
+	long charCode = detzcode(head->tzh_charcnt);
+
+	DBG("tzh_ttisgmtcnt: %ld\n", ttisgmtCode);
+	DBG("tzh_ttisstdcnt: %ld\n", ttisstdCode);
+	DBG("tzh_leapcnt: %ld\n", leapCode);
+	DBG("tzh_timecnt: %ld\n", timeCode);
+	DBG("tzh_typecnt: %ld\n", typeCode);
+	DBG("tzh_charcnt: %ld\n", charCode);
+
+	if (ttisgmtCode < 0 || ttisstdCode < 0 || leapCode < 0 || timeCode < 0 ||
+		typeCode <= 0 || typeCode > 256 || charCode <= 0) {
+		printf("Invalid tz header counts: %s\n", m_filePath.c_str());
+		return false;
+	}
 
-		/*
-		  Then there are tzh_ttisstdcnt standard/wall indicators, each
-		  stored as a one-byte value; they tell whether the  transition
-		  times associated with local time types were specified as standard
-		  time or wall clock time, and are used when a time zone file is
-		  used in handling POSIX-style time zone environment variables.
-		*/
-		for (long i = 0; i < typeCnt; i++) {
+	size_t ttisgmtCnt = ttisgmtCode;
+	size_t ttisstdCnt = ttisstdCode;
+	size_t leapCnt = leapCode;
+	size_t timeCnt = timeCode;
+	size_t typeCnt = typeCode;
+	size_t charCnt = charCode;
+
+	index += sizeof(struct tzhead);
+
+	// counts come from file: size of section is summed with overflow checks
+	// (size_t is only 32 bits wide on some targets)
+	size_t sectionSize = 0;
+	bool sizeOk = addProduct(sectionSize, timeCnt, timeSize + 1) &&
+				  addProduct(sectionSize, typeCnt, 6) &&
+				  addProduct(sectionSize, charCnt, 1) &&
+				  addProduct(sectionSize, leapCnt, timeSize + 4) &&
+				  addProduct(sectionSize, ttisstdCnt, 1) &&
+				  addProduct(sectionSize, ttisgmtCnt, 1);
+	if (!sizeOk || sectionSize > m_size - index) {
+		printf("Short tz data section: %s\n", m_filePath.c_str());
+		return false;
+	}
 
-			int standardOrWallClock = (unsigned char) buf[index];
-			index++;
+	m_timeSize = timeSize;
+	m_timeCount = timeCnt;
+	m_typeCount = typeCnt;
+	m_charCount = charCnt;
+
+	/* The  above  header  is followed by tzh_timecnt four-byte (eight-byte
+	   in v2+ section) values, sorted in ascending order.  These values are
+	   written  in  "standard" byte  order.   Each is used as a transition
+	   time (as returned by time(2)) at which the rules for computing local
+	   time change. */
+	m_transitionTimes = m_map + index;
+	index += timeCnt * timeSize;
+
+	/* Next come tzh_timecnt one-byte values of type unsigned char;
+	   each one tells which of the different types of "local time"
+	   types described in the file is associated with the same-indexed
+	   transition time. */
+	m_transitionTypes = (const unsigned char*) (m_map + index);
+	index += timeCnt;
+
+	/* These values serve as indices into an  array  of
+	   ttinfo structures that appears next in the file; these structures are
+	   defined as follows:
+
+	   struct ttinfo {
+	   long         tt_gmtoff;
+	   int          tt_isdst;
+	   unsigned int tt_abbrind;
+	   };
+
+	   Each  structure is written as a four-byte value for tt_gmtoff of type
+	   long, in a standard byte order, followed by a one-byte value
+	   for tt_isdst and a one-byte value for tt_abbrind.  In each structure,
+	   tt_gmtoff gives the number of seconds to be  added  to  UTC,
+	   tt_isdst  tells  whether  tm_isdst  should  be  set by localtime(3),
+	   and tt_abbrind serves as an index into the array of time zone
+	   abbreviation characters that follow the ttinfo structure(s) in the file. */
+	m_types = m_map + index;
+	index += typeCnt * 6;
+
+	m_abbrChars = m_map + index;
+	index += charCnt;
+
+	/* Then there are tzh_leapcnt pairs of four-byte values,
+	   written in standard byte order; the first value of each
+	   pair gives the  time (as  returned by time(2)) at which a leap
+	   second occurs; the second gives the total number of leap seconds
+	   to be applied after the given time.  The pairs of values are
+	   sorted in ascending order by time. */
+	index += leapCnt * (timeSize + 4);
 
-			(void) standardOrWallClock;
-			DBG("standardOrWallClock: %d\n", standardOrWallClock);
-		}
-	
-
-		/*
-		  Finally, there are tzh_ttisgmtcnt UTC/local indicators,
-		  each stored as a one-byte value; they tell whether  the
-		  transition  times associated  with  local  time  types  were
-		  specified as UTC or local time, and are used when a time zone
-		  file is used in handling POSIX-style time zone environment variables.
-		*/
-		for (long i = 0; i < typeCnt; i++) {
-
-			int utcOrLocalTime = (unsigned char) buf[index];
-			index++;
-
-			(void) utcOrLocalTime;
-			DBG("utcOrLocalTime: %d\n", utcOrLocalTime);
-		}
+	/*
+	  Then there are tzh_ttisstdcnt standard/wall indicators and
+	  tzh_ttisgmtcnt UTC/local indicators, each stored as a one-byte
+	  value. They are used only when a time zone file is used in handling
+	  POSIX-style time zone environment variables.
+	*/
+	index += ttisstdCnt + ttisgmtCnt;
 
-		/*
-		  Localtime uses the first standard-time ttinfo structure in the file
-		  (or simply the first ttinfo structure  in  the  absence  of  a
-		  standard-time structure) if either tzh_timecnt is zero or the time
-		  argument is less than the first transition time recorded in the
-		  file.
-		*/
-
-		/*
-		 * Out-of-sort ats should mean we're running on a
-		 * signed time_t system but using a data file with
-		 * unsigned values (or vice versa).
-		 */
-		for (int i = 0; i < timeCnt - 2; ++i) {
-			if (ttEntryList[i].time > ttEntryList[i+1].time) {
-				++i;
-				if (TYPE_SIGNED(time_t)) {
-					// Ignore the end (easy).
-					timeCnt = i;
-				} else {
-					// Ignore the beginning (harder).
-					int j;
-					for (j = 0; (j + i) < timeCnt; ++j) {
-						ttEntryList[j] = ttEntryList[j+i];
-					}
-					timeCnt = j;
-				}
-				break;
-			}
-		}
+	return true;
+}
 
-		/*
-		 * If this is an old file, we're done.
-		 */
-		if (head->tzh_version[0] == '\0') {
-			DBG("Version 0 file. breaking\n");
-			break;
-		}
+int64_t TzFile::transitionTime(size_t index) const
+{
+	const char* codep = m_transitionTimes + index * m_timeSize;
+	return (m_timeSize == 4) ? (int64_t) detzcode(codep) : detzcode64(codep);
+}
 
-		/*
-		 * If this is a narrow integer time_t system, we're done.
-		 */
-		if ((stored >= (int) sizeof(time_t)) && (TYPE_INTEGRAL(time_t))) {
-			DBG("narrow integer time_t system. breaking\n");
-			break;
+size_t TzFile::upperBound(int64_t time) const
+{
+	size_t first = 0;
+	size_t count = m_timeCount;
+
+	while (count > 0) {
+		size_t step = count / 2;
+		if (transitionTime(first + step) <= time) {
+			first += step + 1;
+			count -= step + 1;
 		}
-	}
-	
-	DBG("Total Buffer size parsed: %d\n", index);
-	
-	free(buf);
-
-	// Dummy entry for standardized timezones which never had
-	// a transition time
-	if (ttEntryList.empty() && !ttInfoList.empty()) {
-		ttentry e;
-		timeCnt = 1;
-		e.time = -2147483648UL;
-		e.indexToLocalTime = 0;
-		ttEntryList.push_back(e);		
-	}
-
-	TzTransitionList result;
-	for (int i = 0; i < timeCnt; i++) {
-		const ttentry& entry = ttEntryList[i];
-		const ttinfo& info   = ttInfoList[entry.indexToLocalTime];
-		struct tm* gmTime    = gmtime(&entry.time);
-		
-		TzTransition trans;
-		trans.time        = entry.time;
-		trans.utcOffset   = info.gmtOffset;
-		trans.isDst       = info.isDst;
-		trans.year        = gmTime->tm_year + 1900;
-		trans.abbrName[0] = 0;
-
-		int j = info.abbrIndex;
-		int k = 0;
-		for (; (j < (int) ttAbbrList.size()) && (k < TZ_ABBR_MAX_LEN);
-			 j++, k++) {
-			trans.abbrName[k] = ttAbbrList[j];
-			if (ttAbbrList[j] == 0)
-				break;
+		else {
+			count = step;
 		}
-		trans.abbrName[TZ_ABBR_MAX_LEN-1] = 0;
-
-		result.push_back(trans);
 	}
-
-	return result;
+	return first;
 }
 
-/*
-int main(int argc, char** argv)
+TzLocalTimeType TzFile::type(size_t index) const
 {
-	if (argc < 2) {
-		printf("Usage: tzparse <tzname>\n");
-		return -1;
-	}
-
-	TzTransitionList result = parseTimeZone(argv[1]);
-	for (TzTransitionList::const_iterator it = result.begin();
-		 it != result.end(); ++it) {
+	// transition types are not validated on open
+	if (index >= m_typeCount)
+		index = 0;
 
-		printf("--------------------------------------------------------------------------------\n");
-		printf("year: %d, time: %ld, utcOffset: %ld, isDst: %s, name: '%s'\n",
-			   it->year, it->time, it->utcOffset, it->isDst ? "true" : "false",
-			   it->abbrName);
-			   
+	const char* record = m_types + index * 6;
 
-	}
+	TzLocalTimeType ttInfo;
+	ttInfo.utcOffset = detzcode(record);
+	ttInfo.isDst = (unsigned char) record[4];
+	ttInfo.abbrIndex = (unsigned char) record[5];
+	return ttInfo;
+}
 
-	return 0;
+const char* TzFile::abbr(unsigned char abbrIndex) const
+{
+	// abbreviations are NUL terminated within tzh_charcnt characters
+	if (abbrIndex >= m_charCount || m_abbrChars[m_charCount - 1] != '\0')
+		return "";
+	return m_abbrChars + abbrIndex;
 }
-*/
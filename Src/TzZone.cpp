@@ -0,0 +1,545 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TzZone.cpp
+ */
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TzZone.h"
+
+namespace {
+	const int64_t secsPerDay = 24 * 60 * 60;
+
+	// POSIX default rule for zones with DST but without explicit rules
+	const char* defaultRule = "M3.2.0,M11.1.0";
+
+	// earlier transitions are not indexed by year (v2+ files may have
+	// "big bang" transitions far in the past)
+	const int minIndexedYear = 1800;
+
+	int64_t floorDiv(int64_t a, int64_t b)
+	{
+		return (a >= 0) ? (a / b) : -((-a + b - 1) / b);
+	}
+
+	bool isLeap(int64_t year)
+	{
+		return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	}
+
+	// days since 1970-01-01 for proleptic Gregorian date (month 1..12)
+	int64_t daysFromCivil(int64_t year, int month, int day)
+	{
+		year -= month <= 2;
+		const int64_t era = floorDiv(year, 400);
+		const int64_t yoe = year - era * 400;
+		const int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+		const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return era * 146097 + doe - 719468;
+	}
+
+	int64_t yearFromDays(int64_t days)
+	{
+		days += 719468;
+		const int64_t era = floorDiv(days, 146097);
+		const int64_t doe = days - era * 146097;
+		const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		const int64_t mp = (5 * doy + 2) / 153;
+		return yoe + era * 400 + (mp >= 10 ? 1 : 0);
+	}
+
+	int yearOf(int64_t time)
+	{
+		return (int) yearFromDays(floorDiv(time, secsPerDay));
+	}
+
+	int daysInMonth(int64_t year, int month)
+	{
+		static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+		return (month == 2 && isLeap(year)) ? 29 : days[month - 1];
+	}
+
+	bool parseNumber(const char*& p, int maxDigits, long& value)
+	{
+		if (!isdigit((unsigned char) *p))
+			return false;
+
+		value = 0;
+		for (int n = 0; n < maxDigits && isdigit((unsigned char) *p); ++n, ++p)
+			value = value * 10 + (*p - '0');
+		return true;
+	}
+
+	// [+-]hh[:mm[:ss]] (hours up to 167 as allowed by RFC 8536)
+	bool parseTime(const char*& p, long& seconds)
+	{
+		long sign = 1;
+		if (*p == '+' || *p == '-')
+			sign = (*p++ == '-') ? -1 : 1;
+
+		long hours, minutes = 0, secs = 0;
+		if (!parseNumber(p, 3, hours) || hours > 167)
+			return false;
+
+		if (*p == ':') {
+			++p;
+			if (!parseNumber(p, 2, minutes) || minutes > 59)
+				return false;
+
+			if (*p == ':') {
+				++p;
+				if (!parseNumber(p, 2, secs) || secs > 59)
+					return false;
+			}
+		}
+
+		seconds = sign * (hours * 3600 + minutes * 60 + secs);
+		return true;
+	}
+
+	bool parseAbbr(const char*& p, std::string& abbr)
+	{
+		const char* begin = p;
+		if (*p == '<') {
+			begin = ++p;
+			while (*p && *p != '>')
+				++p;
+			if (*p != '>')
+				return false;
+			abbr.assign(begin, p - begin);
+			++p;
+		}
+		else {
+			while (isalpha((unsigned char) *p))
+				++p;
+			abbr.assign(begin, p - begin);
+		}
+		return !abbr.empty();
+	}
+} // anonymous namespace
+
+TzZone::TzZone(const std::string& name) :
+	m_name( name ),
+	m_refCount( 0 ),
+	m_yearBase( 0 )
+{
+	m_rule.valid = false;
+	m_rule.hasDst = false;
+}
+
+TzZone* TzZone::load(const char* tzName)
+{
+	TzZone* zone = new TzZone(tzName);
+
+	if (!zone->m_file.open(tzName)) {
+		delete zone;
+		return NULL;
+	}
+
+	if (!zone->m_file.footer().empty())
+		zone->m_rule.valid = parsePosixRule(zone->m_file.footer().c_str(), zone->m_rule);
+
+	zone->buildYearIndex();
+
+	return zone;
+}
+
+void TzZone::buildYearIndex()
+{
+	const size_t count = m_file.transitionCount();
+	if (count == 0)
+		return;
+
+	int firstYear = std::max(yearOf(m_file.transitionTime(0)), minIndexedYear);
+	int lastYear = yearOf(m_file.transitionTime(count - 1));
+	if (lastYear < firstYear)
+		return;
+
+	m_yearBase = firstYear;
+	m_yearIndex.resize(lastYear - firstYear + 2);
+
+	size_t index = 0;
+	for (int year = firstYear; year <= lastYear + 1; ++year) {
+		while (index < count && yearOf(m_file.transitionTime(index)) < year)
+			++index;
+		m_yearIndex[year - firstYear] = index;
+	}
+}
+
+void TzZone::yearTransitions(int year, size_t& first, size_t& last) const
+{
+	const size_t count = m_file.transitionCount();
+
+	if (!m_yearIndex.empty() && year >= m_yearBase) {
+		if (year - m_yearBase + 1 < (int) m_yearIndex.size()) {
+			first = m_yearIndex[year - m_yearBase];
+			last = m_yearIndex[year - m_yearBase + 1];
+		}
+		else {
+			first = last = count;
+		}
+		return;
+	}
+
+	first = m_file.upperBound(daysFromCivil(year, 1, 1) * secsPerDay - 1);
+	last = m_file.upperBound(daysFromCivil(year + 1, 1, 1) * secsPerDay - 1);
+}
+
+bool TzZone::yearRule(int year, long& stdOffset, long& dstOffset,
+                      int64_t& dstStart, int64_t& dstEnd) const
+{
+	if (!m_rule.valid || !m_rule.hasDst)
+		return false;
+
+	const size_t count = m_file.transitionCount();
+	if (count > 0 && year <= yearOf(m_file.transitionTime(count - 1)))
+		return false;
+
+	stdOffset = m_rule.stdOffset;
+	dstOffset = m_rule.dstOffset;
+	ruleTransitions(year, dstStart, dstEnd);
+	return true;
+}
+
+bool TzZone::recordedTransition(int64_t utc, int64_t& next) const
+{
+	size_t index = m_file.upperBound(utc);
+	if (index < m_file.transitionCount()) {
+		next = m_file.transitionTime(index);
+		return true;
+	}
+
+	// after last transition only POSIX rule changes local time
+	if (!m_rule.valid || !m_rule.hasDst)
+		return false;
+
+	for (int year = yearOf(utc); year <= yearOf(utc) + 1; ++year) {
+		int64_t dstStart, dstEnd;
+		ruleTransitions(year, dstStart, dstEnd);
+
+		int64_t first = std::min(dstStart, dstEnd);
+		int64_t second = std::max(dstStart, dstEnd);
+		if (first > utc || second > utc) {
+			next = (first > utc ? first : second);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TzZone::nextTransition(time_t utc, time_t& next) const
+{
+	LocalTimeInfo before, after;
+	lookupAt(utc, before);
+
+	// zoneinfo files contain transitions which change nothing visible (e.g.
+	// only standard/wall indicators), skip them
+	int64_t time = utc;
+	for (size_t i = 0; i <= m_file.transitionCount() + 2; ++i) {
+		if (!recordedTransition(time, time))
+			return false;
+
+		lookupAt(time, after);
+		if (after.utcOffset != before.utcOffset || after.isDst != before.isDst ||
+		    strcmp(after.abbr, before.abbr) != 0) {
+			next = (time_t) time;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TzZone::ref() const
+{
+	__sync_add_and_fetch(&m_refCount, 1);
+}
+
+void TzZone::unref() const
+{
+	if (__sync_sub_and_fetch(&m_refCount, 1) == 0)
+		delete this;
+}
+
+size_t TzZone::memoryUsage() const
+{
+	return sizeof(*this) + m_name.capacity() + m_file.mappedSize() +
+	       m_file.footer().capacity() + m_file.filePath().capacity() +
+	       m_rule.stdAbbr.capacity() + m_rule.dstAbbr.capacity() +
+	       m_yearIndex.capacity() * sizeof(unsigned int);
+}
+
+void TzZone::transitionAt(size_t index, TzTransition& transition) const
+{
+	const TzLocalTimeType localType = m_file.type(m_file.transitionType(index));
+	int64_t time = m_file.transitionTime(index);
+
+	transition.time = (time_t) time;
+	transition.utcOffset = localType.utcOffset;
+	transition.isDst = localType.isDst;
+	transition.year = yearOf(time);
+	strncpy(transition.abbrName, m_file.abbr(localType.abbrIndex), TZ_ABBR_MAX_LEN);
+	transition.abbrName[TZ_ABBR_MAX_LEN-1] = 0;
+}
+
+bool TzZone::parsePosixRule(const char* p, PosixRule& rule)
+{
+	long offset;
+
+	if (!parseAbbr(p, rule.stdAbbr) || !parseTime(p, offset))
+		return false;
+
+	// POSIX offsets are positive west of Greenwich
+	rule.stdOffset = -offset;
+	rule.hasDst = false;
+
+	if (*p == '\0')
+		return true;
+
+	if (!parseAbbr(p, rule.dstAbbr))
+		return false;
+
+	rule.hasDst = true;
+	rule.dstOffset = rule.stdOffset + 3600;
+	if (*p != ',' && *p != '\0') {
+		if (!parseTime(p, offset))
+			return false;
+		rule.dstOffset = -offset;
+	}
+
+	if (*p == '\0')
+		p = defaultRule;
+	else if (*p++ != ',')
+		return false;
+
+	RuleDate* dates[2] = { &rule.start, &rule.end };
+	for (int i = 0; i < 2; ++i) {
+		RuleDate& date = *dates[i];
+		long value;
+
+		if (*p == 'J') {
+			++p;
+			if (!parseNumber(p, 3, value) || value < 1 || value > 365)
+				return false;
+			date.kind = RuleDate::Julian1;
+			date.day = value;
+		}
+		else if (*p == 'M') {
+			long week, day;
+			++p;
+			if (!parseNumber(p, 2, value) || value < 1 || value > 12 || *p++ != '.' ||
+				!parseNumber(p, 1, week) || week < 1 || week > 5 || *p++ != '.' ||
+				!parseNumber(p, 1, day) || day > 6)
+				return false;
+			date.kind = RuleDate::MonthWeekDay;
+			date.month = value;
+			date.week = week;
+			date.day = day;
+		}
+		else {
+			if (!parseNumber(p, 3, value) || value > 365)
+				return false;
+			date.kind = RuleDate::Julian0;
+			date.day = value;
+		}
+
+		date.time = 2 * 3600;
+		if (*p == '/') {
+			++p;
+			if (!parseTime(p, date.time))
+				return false;
+		}
+
+		if (i == 0 && *p++ != ',')
+			return false;
+	}
+
+	return *p == '\0';
+}
+
+void TzZone::ruleTransitions(int year, int64_t& dstStart, int64_t& dstEnd) const
+{
+	const RuleDate* dates[2] = { &m_rule.start, &m_rule.end };
+	int64_t results[2];
+
+	for (int i = 0; i < 2; ++i) {
+		const RuleDate& date = *dates[i];
+		int64_t day = daysFromCivil(year, 1, 1);
+
+		switch (date.kind) {
+		case RuleDate::Julian1:
+			// February 29 is never counted
+			day += date.day - 1;
+			if (isLeap(year) && date.day >= 60)
+				++day;
+			break;
+
+		case RuleDate::Julian0:
+			day += date.day;
+			break;
+
+		case RuleDate::MonthWeekDay:
+			{
+				int64_t first = daysFromCivil(year, date.month, 1);
+				// 1970-01-01 was Thursday
+				int firstWeekDay = (int) ((first % 7 + 11) % 7);
+				int mday = 1 + (date.day - firstWeekDay + 7) % 7 + (date.week - 1) * 7;
+				while (mday > daysInMonth(year, date.month))
+					mday -= 7;
+				day = first + mday - 1;
+			}
+			break;
+		}
+
+		results[i] = day * secsPerDay + date.time;
+	}
+
+	// DST starts at standard local time and ends at daylight local time
+	dstStart = results[0] - m_rule.stdOffset;
+	dstEnd = results[1] - m_rule.dstOffset;
+}
+
+void TzZone::ruleLookup(int64_t utc, LocalTimeInfo& info) const
+{
+	bool isDst = false;
+
+	if (m_rule.hasDst) {
+		int64_t dstStart, dstEnd;
+		ruleTransitions(yearFromDays(floorDiv(utc, secsPerDay)), dstStart, dstEnd);
+
+		if (dstStart < dstEnd)
+			isDst = (utc >= dstStart && utc < dstEnd);	// northern hemisphere
+		else
+			isDst = !(utc >= dstEnd && utc < dstStart);	// southern hemisphere
+	}
+
+	info.isDst = isDst;
+	info.utcOffset = isDst ? m_rule.dstOffset : m_rule.stdOffset;
+	info.abbr = isDst ? m_rule.dstAbbr.c_str() : m_rule.stdAbbr.c_str();
+}
+
+void TzZone::typeLookup(int type, LocalTimeInfo& info) const
+{
+	const TzLocalTimeType localType = m_file.type(type);
+	info.utcOffset = localType.utcOffset;
+	info.isDst = localType.isDst;
+	info.abbr = m_file.abbr(localType.abbrIndex);
+}
+
+void TzZone::lookupAt(int64_t utc, LocalTimeInfo& info) const
+{
+	const size_t count = m_file.transitionCount();
+
+	if (count == 0 || utc >= m_file.transitionTime(count - 1)) {
+		// after last transition POSIX rule (if any) is in effect
+		if (m_rule.valid) {
+			ruleLookup(utc, info);
+			return;
+		}
+		typeLookup(count == 0 ? 0 : m_file.transitionType(count - 1), info);
+		return;
+	}
+
+	size_t index = m_file.upperBound(utc);
+	if (index == 0) {
+		// before first transition first local time type is used
+		typeLookup(0, info);
+		return;
+	}
+
+	typeLookup(m_file.transitionType(index - 1), info);
+}
+
+void TzZone::lookup(time_t utc, LocalTimeInfo& info) const
+{
+	lookupAt(utc, info);
+}
+
+bool TzZone::toLocal(time_t utc, struct tm& local) const
+{
+	LocalTimeInfo info;
+	lookupAt(utc, info);
+
+	time_t localTime = utc + info.utcOffset;
+	if (!gmtime_r(&localTime, &local))
+		return false;
+
+	local.tm_isdst = info.isDst ? 1 : 0;
+	local.tm_gmtoff = info.utcOffset;
+	local.tm_zone = info.abbr;
+	return true;
+}
+
+bool TzZone::toUtc(const struct tm& local, time_t& utc) const
+{
+	// local time as if it were UTC (with mktime-like normalization)
+	int64_t year = (int64_t) local.tm_year + 1900 + floorDiv(local.tm_mon, 12);
+	int month = (int) (local.tm_mon - floorDiv(local.tm_mon, 12) * 12) + 1;
+	int64_t localSecs = (daysFromCivil(year, month, 1) + local.tm_mday - 1) * secsPerDay +
+	                    (int64_t) local.tm_hour * 3600 + (int64_t) local.tm_min * 60 +
+	                    local.tm_sec;
+
+	// Every moment with this wall-clock time is within a day from the
+	// local time interpreted as UTC. Collect offsets in effect around it and
+	// keep only those which map back to the same wall-clock time.
+	const int64_t window = 26 * 3600;
+	LocalTimeInfo probes[3];
+	lookupAt(localSecs - window, probes[0]);
+	lookupAt(localSecs, probes[1]);
+	lookupAt(localSecs + window, probes[2]);
+
+	int64_t best = 0, preferredBest = 0;
+	bool found = false, preferredFound = false;
+	for (int i = 0; i < 3; ++i) {
+		int64_t candidate = localSecs - probes[i].utcOffset;
+
+		LocalTimeInfo info;
+		lookupAt(candidate, info);
+		if (info.utcOffset != probes[i].utcOffset)
+			continue;
+
+		// ambiguous wall-clock time resolves to the earliest moment
+		if (!found || candidate < best)
+			best = candidate;
+		found = true;
+
+		if (local.tm_isdst >= 0 && (local.tm_isdst > 0) == info.isDst) {
+			if (!preferredFound || candidate < preferredBest)
+				preferredBest = candidate;
+			preferredFound = true;
+		}
+	}
+
+	if (preferredFound) {
+		best = preferredBest;
+	}
+	else if (!found) {
+		// wall-clock time skipped by transition: use offset before it
+		best = localSecs - probes[0].utcOffset;
+	}
+
+	utc = (time_t) best;
+	return (int64_t) utc == best;
+}
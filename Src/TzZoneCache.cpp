@@ -0,0 +1,187 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TzZoneCache.cpp
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "TimeClock.h"
+#include "TzPack.h"
+#include "TzZoneCache.h"
+
+namespace {
+	// enough for all zones of a typical device
+	const size_t defaultMemoryLimit = 256 * 1024;
+
+	// how often (in seconds) zoneinfo file of cached zone is re-checked
+	const time_t fileCheckInterval = 60;
+
+	struct Lock
+	{
+		Lock(pthread_mutex_t &mutex) : m_mutex(mutex) { pthread_mutex_lock(&m_mutex); }
+		~Lock() { pthread_mutex_unlock(&m_mutex); }
+
+	private:
+		pthread_mutex_t &m_mutex;
+	};
+} // anonymous namespace
+
+TzZoneCache* TzZoneCache::instance()
+{
+	static TzZoneCache* s_instance = new TzZoneCache;
+	return s_instance;
+}
+
+TzZoneCache::TzZoneCache() :
+	m_memoryUsage( 0 ),
+	m_memoryLimit( defaultMemoryLimit )
+{
+	pthread_mutex_init(&m_mutex, NULL);
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+TzZoneCache::~TzZoneCache()
+{
+	pthread_mutex_destroy(&m_mutex);
+}
+
+TzZoneRef TzZoneCache::get(const std::string& tzName)
+{
+	time_t now = TimeClock::instance()->monotonicSeconds();
+
+	{
+		Lock lock(m_mutex);
+
+		EntryMap::iterator it = m_entries.find(tzName);
+		if (it != m_entries.end()) {
+			if (!isStale(it->second, now)) {
+				++m_stats.hits;
+				m_lru.splice(m_lru.begin(), m_lru, it->second.lruPos);
+				return it->second.zone;
+			}
+
+			++m_stats.invalidations;
+			remove(it);
+		}
+
+		++m_stats.misses;
+	}
+
+	// parse outside of lock to let other threads use cache meanwhile
+	TzZoneRef zone(TzZone::load(tzName.c_str()));
+	if (zone.isNull())
+		return zone;
+
+	Lock lock(m_mutex);
+
+	EntryMap::iterator it = m_entries.find(tzName);
+	if (it != m_entries.end()) {
+		// loaded concurrently by another thread
+		m_lru.splice(m_lru.begin(), m_lru, it->second.lruPos);
+		return it->second.zone;
+	}
+
+	insert(tzName, zone, now);
+	evict();
+
+	return zone;
+}
+
+void TzZoneCache::setMemoryLimit(size_t limit)
+{
+	Lock lock(m_mutex);
+
+	m_memoryLimit = limit;
+	evict();
+}
+
+void TzZoneCache::clear()
+{
+	Lock lock(m_mutex);
+
+	m_entries.clear();
+	m_lru.clear();
+	m_memoryUsage = 0;
+}
+
+TzZoneCache::Stats TzZoneCache::stats() const
+{
+	Lock lock(m_mutex);
+
+	Stats stats = m_stats;
+	stats.zones = m_entries.size();
+	stats.memoryUsage = m_memoryUsage;
+	stats.memoryLimit = m_memoryLimit;
+	return stats;
+}
+
+bool TzZoneCache::isStale(Entry& entry, time_t now)
+{
+	if (now - entry.lastCheck < fileCheckInterval)
+		return false;
+
+	entry.lastCheck = now;
+
+	// packs never change, but newer one may be current already
+	if (entry.zone->pack())
+		return entry.zone->pack() != TzPack::current().get();
+
+	struct stat st;
+	if (stat(entry.zone->filePath().c_str(), &st) != 0)
+		return true;
+
+	const struct stat& loaded = entry.zone->fileStat();
+	return st.st_mtime != loaded.st_mtime ||
+	       st.st_ino != loaded.st_ino ||
+	       st.st_size != loaded.st_size;
+}
+
+void TzZoneCache::insert(const std::string& tzName, const TzZoneRef& zone, time_t now)
+{
+	m_lru.push_front(tzName);
+
+	Entry& entry = m_entries[tzName];
+	entry.zone = zone;
+	entry.memoryUsage = zone->memoryUsage();
+	entry.lastCheck = now;
+	entry.lruPos = m_lru.begin();
+
+	m_memoryUsage += entry.memoryUsage;
+}
+
+void TzZoneCache::remove(EntryMap::iterator it)
+{
+	m_memoryUsage -= it->second.memoryUsage;
+	m_lru.erase(it->second.lruPos);
+	m_entries.erase(it);
+}
+
+void TzZoneCache::evict()
+{
+	// most recently used zone always stays
+	while (m_memoryUsage > m_memoryLimit && m_lru.size() > 1) {
+		remove(m_entries.find(m_lru.back()));
+		++m_stats.evictions;
+	}
+}
@@ -0,0 +1,151 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file ZoneTransitionTimer.cpp
+ */
+
+#include <stdint.h>
+
+#include "ZoneTransitionTimer.h"
+#include "Logging.h"
+#include "TimeClock.h"
+#include "TimeSnapshot.h"
+#include "TzZoneCache.h"
+
+ZoneTransitionTimer::ZoneTransitionTimer() :
+	m_source(NULL),
+	m_next(0)
+{
+}
+
+ZoneTransitionTimer::~ZoneTransitionTimer()
+{
+	cancel();
+}
+
+void ZoneTransitionTimer::arm(const std::string& zoneName)
+{
+	cancel();
+	m_zoneName = zoneName;
+	m_next = 0;
+
+	// readers must not keep offset of previous zone
+	if (m_zoneName.empty())
+	{
+		TimeSnapshot::instance()->resetZone();
+		return;
+	}
+
+	TzZoneRef zone = TzZoneCache::instance()->get(m_zoneName);
+	if (zone.isNull())
+	{
+		qWarning("Can't load zone [%s] to track its transitions", m_zoneName.c_str());
+		TimeSnapshot::instance()->resetZone();
+		return;
+	}
+
+	time_t currentTime = TimeClock::instance()->wallSeconds();
+	TzZone::LocalTimeInfo info;
+	zone->lookup(currentTime, info);
+
+	time_t next;
+	if (!zone->nextTransition(currentTime, next))
+	{
+		qDebug("No transitions ahead in zone [%s]", m_zoneName.c_str());
+		TimeSnapshot::instance()->publishZone(info.utcOffset, info.isDst, 0);
+		return;
+	}
+
+	TimeSnapshot::instance()->publishZone(info.utcOffset, info.isDst, next);
+	m_next = next;
+	schedule();
+}
+
+void ZoneTransitionTimer::stop()
+{
+	cancel();
+	m_zoneName.clear();
+	m_next = 0;
+}
+
+void ZoneTransitionTimer::resume()
+{
+	if (m_next == 0)
+		return;
+
+	cancel();
+	check();
+}
+
+void ZoneTransitionTimer::cancel()
+{
+	if (m_source)
+	{
+		g_source_destroy(m_source);
+		g_source_unref(m_source);
+		m_source = NULL;
+	}
+}
+
+void ZoneTransitionTimer::schedule()
+{
+	struct timespec now;
+	TimeClock::instance()->wallTime(now);
+
+	int64_t delayMs = ((int64_t) m_next - now.tv_sec) * 1000 - now.tv_nsec / 1000000;
+	if (delayMs < 0)
+		delayMs = 0;
+	else if (delayMs > maxWaitMs)
+		delayMs = maxWaitMs;
+
+	m_source = TimeClock::instance()->createTimeout((guint) delayMs);
+	g_source_set_callback(m_source, cbTimeout, this, NULL);
+	g_source_attach(m_source, NULL);
+
+	qDebug("Next transition of zone at %ld, waking up in %lld ms",
+		   (long) m_next, (long long) delayMs);
+}
+
+void ZoneTransitionTimer::check()
+{
+	if (TimeClock::instance()->wallSeconds() < m_next)
+	{
+		schedule();
+		return;
+	}
+
+	qDebug("Zone transition reached at %ld", (long) m_next);
+	arm(m_zoneName);
+	reached.fire();
+}
+
+//static
+gboolean ZoneTransitionTimer::cbTimeout(gpointer data)
+{
+	ZoneTransitionTimer* timer = static_cast<ZoneTransitionTimer*>(data);
+
+	// source is destroyed once we return FALSE
+	g_source_unref(timer->m_source);
+	timer->m_source = NULL;
+
+	timer->check();
+	return FALSE;
+}
@@ -0,0 +1,371 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file FakeLunaService.cpp
+ */
+
+#include <cjson/json.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FakeLunaService.h"
+
+struct LSPalmService
+{
+	int unused;
+};
+
+struct LSHandle
+{
+	bool isPublic;
+};
+
+struct LSMessage
+{
+	std::string category;
+	std::string method;
+	std::string payload;
+	std::vector<std::string> replies;
+};
+
+struct LSSubscriptionIter
+{
+	std::vector<LSMessage*> messages;
+	size_t next;
+};
+
+namespace {
+
+	struct Category
+	{
+		LSMethod* publicMethods;
+		LSMethod* privateMethods;
+		void*     userData;
+	};
+
+	typedef std::map<std::string, Category> CategoryMap;
+	typedef std::multimap<std::string, LSMessage*> SubscriptionMap;
+
+	LSPalmService s_service;
+	LSHandle s_publicHandle = { true };
+	LSHandle s_privateHandle = { false };
+
+	CategoryMap s_categories;
+	SubscriptionMap s_subscriptions;
+	std::vector<LSMessage*> s_messages;
+	std::vector<FakeLunaService::Call> s_calls;
+
+	const char* const senderName = "com.palm.test";
+
+	LSMethodFunction findMethod(LSMethod* methods, const char* name)
+	{
+		for (LSMethod* m = methods; m && m->name; ++m) {
+			if (strcmp(m->name, name) == 0)
+				return m->function;
+		}
+		return NULL;
+	}
+
+	bool recordCall(const char* uri, const char* payload)
+	{
+		FakeLunaService::Call call;
+		call.uri = uri ? uri : "";
+		call.payload = payload ? payload : "";
+		s_calls.push_back(call);
+		return true;
+	}
+
+	LSMessage* dispatch(LSHandle* handle, LSMethodFunction function, const char* category,
+	                    const char* method, const std::string& payload, void* userData)
+	{
+		LSMessage* message = new LSMessage;
+		message->category = category;
+		message->method = method;
+		message->payload = payload;
+		s_messages.push_back(message);
+
+		(void) function(handle, message, userData);
+		return message;
+	}
+
+} // anonymous namespace
+
+namespace FakeLunaService {
+
+LSPalmService* service()
+{
+	return &s_service;
+}
+
+LSMessage* send(const char* category, const char* method, const std::string& payload)
+{
+	CategoryMap::const_iterator it = s_categories.find(category);
+	if (it == s_categories.end())
+		return NULL;
+
+	LSMethodFunction function = findMethod(it->second.publicMethods, method);
+	LSHandle* handle = &s_publicHandle;
+	if (!function) {
+		function = findMethod(it->second.privateMethods, method);
+		handle = &s_privateHandle;
+	}
+	if (!function)
+		return NULL;
+
+	return dispatch(handle, function, category, method, payload, it->second.userData);
+}
+
+LSMessage* invoke(LSMethodFunction function, const std::string& payload, void* userData)
+{
+	return dispatch(&s_publicHandle, function, "", "", payload, userData);
+}
+
+const std::vector<std::string>& replies(LSMessage* message)
+{
+	return message->replies;
+}
+
+std::string call(const char* category, const char* method, const std::string& payload)
+{
+	LSMessage* message = send(category, method, payload);
+	if (!message || message->replies.empty())
+		return std::string();
+	return message->replies.front();
+}
+
+const std::vector<Call>& calls()
+{
+	return s_calls;
+}
+
+size_t countCalls(const char* uri, const char* payload)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < s_calls.size(); ++i) {
+		if (s_calls[i].uri == uri && (!payload || s_calls[i].payload == payload))
+			++count;
+	}
+	return count;
+}
+
+void clearCalls()
+{
+	s_calls.clear();
+}
+
+void reset()
+{
+	s_subscriptions.clear();
+	for (size_t i = 0; i < s_messages.size(); ++i)
+		delete s_messages[i];
+	s_messages.clear();
+}
+
+} // namespace FakeLunaService
+
+// -- luna-service2 functions used by service
+
+bool LSErrorInit(LSError* lserror)
+{
+	memset(lserror, 0, sizeof(*lserror));
+	return true;
+}
+
+void LSErrorFree(LSError* lserror)
+{
+	memset(lserror, 0, sizeof(*lserror));
+}
+
+bool LSErrorIsSet(LSError* lserror)
+{
+	return lserror && lserror->error_code != 0;
+}
+
+void LSErrorPrint(LSError* lserror, FILE* out)
+{
+	fprintf(out, "LSError %d\n", lserror->error_code);
+}
+
+bool LSPalmServiceRegisterCategory(LSPalmService* psh, const char* category,
+                                   LSMethod* methods_public, LSMethod* methods_private,
+                                   LSSignal* langis, void* category_user_data, LSError* lserror)
+{
+	Category c = { methods_public, methods_private, category_user_data };
+	s_categories[category] = c;
+	return true;
+}
+
+bool LSCategorySetData(LSHandle* sh, const char* category, void* user_data, LSError* lserror)
+{
+	CategoryMap::iterator it = s_categories.find(category);
+	if (it == s_categories.end())
+		return false;
+	it->second.userData = user_data;
+	return true;
+}
+
+LSHandle* LSPalmServiceGetPublicConnection(LSPalmService* psh)
+{
+	return &s_publicHandle;
+}
+
+LSHandle* LSPalmServiceGetPrivateConnection(LSPalmService* psh)
+{
+	return &s_privateHandle;
+}
+
+bool LSCall(LSHandle* sh, const char* uri, const char* payload, LSFilterFunc callback,
+            void* ctx, LSMessageToken* ret_token, LSError* lserror)
+{
+	if (ret_token)
+		*ret_token = LSMESSAGE_TOKEN_INVALID;
+	return recordCall(uri, payload);
+}
+
+bool LSCallOneReply(LSHandle* sh, const char* uri, const char* payload, LSFilterFunc callback,
+                    void* ctx, LSMessageToken* ret_token, LSError* lserror)
+{
+	if (ret_token)
+		*ret_token = LSMESSAGE_TOKEN_INVALID;
+	return recordCall(uri, payload);
+}
+
+void LSMessageRef(LSMessage* message)
+{
+	// messages are owned by FakeLunaService until reset()
+}
+
+void LSMessageUnref(LSMessage* message)
+{
+}
+
+bool LSMessageReply(LSHandle* sh, LSMessage* lsmsg, const char* replyPayload, LSError* lserror)
+{
+	lsmsg->replies.push_back(replyPayload);
+	return true;
+}
+
+bool LSMessageRespond(LSMessage* message, const char* reply_payload, LSError* lserror)
+{
+	message->replies.push_back(reply_payload);
+	return true;
+}
+
+const char* LSMessageGetPayload(LSMessage* message)
+{
+	return message ? message->payload.c_str() : NULL;
+}
+
+const char* LSMessageGetSender(LSMessage* message)
+{
+	return senderName;
+}
+
+const char* LSMessageGetSenderServiceName(LSMessage* message)
+{
+	return senderName;
+}
+
+const char* LSMessageGetCategory(LSMessage* message)
+{
+	return message ? message->category.c_str() : NULL;
+}
+
+const char* LSMessageGetMethod(LSMessage* message)
+{
+	return message ? message->method.c_str() : NULL;
+}
+
+const char* LSMessageGetApplicationID(LSMessage* message)
+{
+	return NULL;
+}
+
+bool LSMessageIsHubErrorMessage(LSMessage* message)
+{
+	return false;
+}
+
+bool LSMessageIsSubscription(LSMessage* message)
+{
+	json_object* root = json_tokener_parse(message->payload.c_str());
+	if (!root || is_error(root))
+		return false;
+
+	json_object* subscribe = json_object_object_get(root, "subscribe");
+	bool result = subscribe && json_object_get_boolean(subscribe);
+	json_object_put(root);
+	return result;
+}
+
+bool LSSubscriptionAdd(LSHandle* sh, const char* key, LSMessage* message, LSError* lserror)
+{
+	s_subscriptions.insert(std::make_pair(std::string(key), message));
+	return true;
+}
+
+bool LSSubscriptionAcquire(LSHandle* sh, const char* key, LSSubscriptionIter** ret_iter, LSError* lserror)
+{
+	LSSubscriptionIter* iter = new LSSubscriptionIter;
+	iter->next = 0;
+	std::pair<SubscriptionMap::iterator, SubscriptionMap::iterator> range = s_subscriptions.equal_range(key);
+	for (SubscriptionMap::iterator it = range.first; it != range.second; ++it)
+		iter->messages.push_back(it->second);
+	*ret_iter = iter;
+	return true;
+}
+
+void LSSubscriptionRelease(LSSubscriptionIter* iter)
+{
+	delete iter;
+}
+
+bool LSSubscriptionHasNext(LSSubscriptionIter* iter)
+{
+	return iter->next < iter->messages.size();
+}
+
+LSMessage* LSSubscriptionNext(LSSubscriptionIter* iter)
+{
+	return iter->messages[iter->next++];
+}
+
+bool LSSubscriptionRespond(LSPalmService* psh, const char* key, const char* payload, LSError* lserror)
+{
+	std::pair<SubscriptionMap::iterator, SubscriptionMap::iterator> range = s_subscriptions.equal_range(key);
+	for (SubscriptionMap::iterator it = range.first; it != range.second; ++it)
+		it->second->replies.push_back(payload);
+	return true;
+}
+
+unsigned int LSSubscriptionGetHandleSubscribersCount(LSHandle* sh, const char* key)
+{
+	return s_subscriptions.count(key);
+}
+
+bool LSSubscriptionSetCancelFunction(LSHandle* sh, LSFilterFunc cancelFunction, void* ctx, LSError* lserror)
+{
+	return true;
+}
@@ -0,0 +1,107 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file FakeLunaService.h
+ */
+
+#ifndef __FAKELUNASERVICE_H
+#define __FAKELUNASERVICE_H
+
+#include <string>
+#include <vector>
+
+#include <luna-service2/lunaservice.h>
+
+/**
+ * In-process stand-in for luna-service2 bus, so that handlers of service
+ * can be constructed and driven by tests.
+ *
+ * FakeLunaService.cpp defines luna-service2 functions which service uses
+ * (test executable's definitions take precedence over shared library):
+ * categories registered on service() are kept, calls made by service are
+ * recorded instead of being sent and replies to messages created by
+ * send() are collected on them. Subscriptions added by methods get posts
+ * of service.
+ */
+namespace FakeLunaService {
+
+	struct Call
+	{
+		std::string uri;
+		std::string payload;
+	};
+
+	/**
+	 * Service handle to construct handlers with
+	 */
+	LSPalmService* service();
+
+	/**
+	 * Invoke method registered under category with payload (as if sender
+	 * called it on bus)
+	 *
+	 * @return message holding replies (valid until reset()) or NULL if
+	 *         there is no such method
+	 */
+	LSMessage* send(const char* category, const char* method, const std::string& payload);
+
+	/**
+	 * Invoke function as public method (handlers which are static methods
+	 * can be driven without registering their category)
+	 *
+	 * @return message holding replies (valid until reset())
+	 */
+	LSMessage* invoke(LSMethodFunction function, const std::string& payload, void* userData = NULL);
+
+	/**
+	 * Replies to message (first one is response of method, rest are posts
+	 * to subscription)
+	 */
+	const std::vector<std::string>& replies(LSMessage* message);
+
+	/**
+	 * send() returning first reply ("" if method didn't reply)
+	 */
+	std::string call(const char* category, const char* method, const std::string& payload);
+
+	/**
+	 * Calls made by service (LSCall, LSCallOneReply), oldest first
+	 */
+	const std::vector<Call>& calls();
+
+	/**
+	 * Number of recorded calls to uri with payload (any payload if NULL)
+	 */
+	size_t countCalls(const char* uri, const char* payload = NULL);
+
+	/**
+	 * Forget recorded calls
+	 */
+	void clearCalls();
+
+	/**
+	 * Drop messages sent so far along with their subscriptions
+	 */
+	void reset();
+
+} // namespace FakeLunaService
+
+#endif // __FAKELUNASERVICE_H
@@ -0,0 +1,217 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file FakeTimeClock.cpp
+ */
+
+#include <stdlib.h>
+
+#include "FakeTimeClock.h"
+
+struct FakeTimeClock::Timeout
+{
+	GSource               source;	// must be first (GLib allocates the rest)
+	const FakeTimeClock*  clock;
+	int64_t               interval;
+	int64_t               deadline;	// fake monotonic time
+};
+
+namespace {
+	GSourceFuncs s_timeoutFuncs;
+}
+
+FakeTimeClock::FakeTimeClock(time_t wall) :
+	m_wall((int64_t) wall * nsecPerSec),
+	m_monotonic(3600 * nsecPerSec),
+	m_boot(3600 * nsecPerSec),
+	m_slewed(0),
+	m_slewPending(0),
+	m_drift(0),
+	m_lastTimeoutMs(-1),
+	m_lastCoalesce(false)
+{
+	s_timeoutFuncs.prepare = timeoutPrepare;
+	s_timeoutFuncs.check = timeoutCheck;
+	s_timeoutFuncs.dispatch = timeoutDispatch;
+	s_timeoutFuncs.finalize = timeoutFinalize;
+}
+
+FakeTimeClock::~FakeTimeClock()
+{
+	// timeouts outliving clock won't ever fire
+	for (std::set<Timeout*>::iterator it = m_timeouts.begin(); it != m_timeouts.end(); ++it)
+		(*it)->clock = NULL;
+}
+
+bool FakeTimeClock::wallTime(struct timespec& ts) const
+{
+	toTimespec(m_wall, ts);
+	return true;
+}
+
+bool FakeTimeClock::setWallTime(const struct timespec& ts)
+{
+	m_wall = (int64_t) ts.tv_sec * nsecPerSec + ts.tv_nsec;
+	return true;
+}
+
+bool FakeTimeClock::slewWallTime(const struct timespec& delta, struct timespec* remaining)
+{
+	// like adjtime(), replaces correction in progress (applied in step())
+	if (remaining)
+		toTimespec(m_slewPending, *remaining);
+	int64_t ns = (int64_t) delta.tv_sec * nsecPerSec + delta.tv_nsec;
+	m_slewPending = ns;
+	m_slewed += ns;
+	return true;
+}
+
+bool FakeTimeClock::monotonicTime(struct timespec& ts) const
+{
+	toTimespec(m_monotonic, ts);
+	return true;
+}
+
+bool FakeTimeClock::bootTime(struct timespec& ts) const
+{
+	toTimespec(m_boot, ts);
+	return true;
+}
+
+GSource* FakeTimeClock::createTimeout(guint intervalMs, bool coalesce) const
+{
+	GSource* source = g_source_new(&s_timeoutFuncs, sizeof(Timeout));
+	Timeout* timeout = reinterpret_cast<Timeout*>(source);
+	timeout->clock = this;
+	timeout->interval = (int64_t) intervalMs * nsecPerMs;
+	timeout->deadline = m_monotonic + timeout->interval;
+	m_timeouts.insert(timeout);
+	m_lastTimeoutMs = intervalMs;
+	m_lastCoalesce = coalesce;
+	return source;
+}
+
+void FakeTimeClock::advance(int64_t ms)
+{
+	int64_t target = m_monotonic + ms * nsecPerMs;
+
+	dispatch();
+	int64_t deadline;
+	while (nextDeadline(deadline) && deadline <= target)
+	{
+		if (deadline > m_monotonic)
+			step(deadline - m_monotonic);
+		dispatch();
+	}
+	step(target - m_monotonic);
+	dispatch();
+}
+
+void FakeTimeClock::suspend(int64_t ms)
+{
+	m_wall += ms * nsecPerMs + (int64_t) (ms * nsecPerMs * m_drift / 1e6);
+	m_boot += ms * nsecPerMs;
+}
+
+int FakeTimeClock::dispatch()
+{
+	int count = 0;
+	while (g_main_context_iteration(NULL, FALSE))
+		++count;
+	return count;
+}
+
+bool FakeTimeClock::nextDeadline(int64_t& deadline) const
+{
+	bool found = false;
+	for (std::set<Timeout*>::const_iterator it = m_timeouts.begin(); it != m_timeouts.end(); ++it)
+	{
+		GSource* source = &(*it)->source;
+		if (g_source_is_destroyed(source) || g_source_get_context(source) == NULL)
+			continue;
+		if (!found || (*it)->deadline < deadline)
+			deadline = (*it)->deadline;
+		found = true;
+	}
+	return found;
+}
+
+void FakeTimeClock::step(int64_t ns)
+{
+	int64_t slew = (int64_t) (ns * (slewRatePpm / 1e6));
+	if (slew > llabs(m_slewPending))
+		slew = llabs(m_slewPending);
+	if (m_slewPending < 0)
+		slew = -slew;
+	m_slewPending -= slew;
+
+	m_wall += ns + slew + (int64_t) (ns * m_drift / 1e6);
+	m_monotonic += ns;
+	m_boot += ns;
+}
+
+//static
+void FakeTimeClock::toTimespec(int64_t ns, struct timespec& ts)
+{
+	ts.tv_sec = ns / nsecPerSec;
+	ts.tv_nsec = ns % nsecPerSec;
+	if (ts.tv_nsec < 0)
+	{
+		ts.tv_nsec += nsecPerSec;
+		--ts.tv_sec;
+	}
+}
+
+//static
+gboolean FakeTimeClock::timeoutPrepare(GSource* source, gint* timeout)
+{
+	// time doesn't move while main loop polls, so never wait
+	*timeout = -1;
+	return timeoutCheck(source);
+}
+
+//static
+gboolean FakeTimeClock::timeoutCheck(GSource* source)
+{
+	Timeout* t = reinterpret_cast<Timeout*>(source);
+	return t->clock && t->clock->m_monotonic >= t->deadline;
+}
+
+//static
+gboolean FakeTimeClock::timeoutDispatch(GSource* source, GSourceFunc callback, gpointer data)
+{
+	Timeout* t = reinterpret_cast<Timeout*>(source);
+	if (!callback)
+		return FALSE;
+
+	gboolean again = callback(data);
+	if (again && t->clock)
+		t->deadline = t->clock->m_monotonic + t->interval;
+	return again;
+}
+
+//static
+void FakeTimeClock::timeoutFinalize(GSource* source)
+{
+	Timeout* t = reinterpret_cast<Timeout*>(source);
+	if (t->clock)
+		t->clock->m_timeouts.erase(t);
+}
@@ -0,0 +1,133 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file FakeTimeClock.h
+ */
+
+#ifndef __FAKETIMECLOCK_H
+#define __FAKETIMECLOCK_H
+
+#include <set>
+#include <stdint.h>
+
+#include "TimeClock.h"
+
+/**
+ * Simulated clocks for tests.
+ *
+ * Time only moves through advance() and suspend(), which also dispatch
+ * timeouts created by this clock once their (fake monotonic) deadline is
+ * reached, so hours of service life run instantly and deterministically.
+ * Timeouts are dispatched from default main context.
+ */
+class FakeTimeClock : public TimeClock
+{
+public:
+	static const int64_t nsecPerSec = 1000000000LL;
+	static const int64_t nsecPerMs = 1000000LL;
+	// slews progress at maximum kernel rate
+	static const int64_t slewRatePpm = 500;
+
+	/**
+	 * Start at specified wall time (monotonic and boot clocks start at
+	 * one hour)
+	 */
+	explicit FakeTimeClock(time_t wall);
+	virtual ~FakeTimeClock();
+
+	virtual bool wallTime(struct timespec& ts) const;
+	virtual bool setWallTime(const struct timespec& ts);
+	virtual bool slewWallTime(const struct timespec& delta, struct timespec* remaining);
+	virtual bool monotonicTime(struct timespec& ts) const;
+	virtual bool bootTime(struct timespec& ts) const;
+	virtual GSource* createTimeout(guint intervalMs, bool coalesce) const;
+
+	/**
+	 * Run all clocks for ms milliseconds dispatching timeouts on the way
+	 */
+	void advance(int64_t ms);
+
+	/**
+	 * Suspend for specified time (monotonic clock and its timeouts stand
+	 * still while wall and boot clocks move)
+	 */
+	void suspend(int64_t ms);
+
+	/**
+	 * Make wall clock run faster (positive) or slower than monotonic one
+	 */
+	void setDrift(double ppm) { m_drift = ppm; }
+
+	/**
+	 * Dispatch everything ready in default main context
+	 * @return number of dispatched sources
+	 */
+	int dispatch();
+
+	int64_t wallNs() const { return m_wall; }
+	int64_t monotonicNs() const { return m_monotonic; }
+	int64_t bootNs() const { return m_boot; }
+
+	/**
+	 * Last interval passed to createTimeout() (-1 if none yet)
+	 */
+	int64_t lastTimeoutMs() const { return m_lastTimeoutMs; }
+	bool lastTimeoutCoalesced() const { return m_lastCoalesce; }
+
+	/**
+	 * Total of slewWallTime() deltas
+	 */
+	int64_t slewedNs() const { return m_slewed; }
+
+	/**
+	 * Part of last slewWallTime() delta not applied yet
+	 */
+	int64_t slewPendingNs() const { return m_slewPending; }
+
+	/**
+	 * Normalized timespec (non-negative tv_nsec) of nanoseconds
+	 */
+	static void toTimespec(int64_t ns, struct timespec& ts);
+
+private:
+	struct Timeout;
+
+	static gboolean timeoutPrepare(GSource* source, gint* timeout);
+	static gboolean timeoutCheck(GSource* source);
+	static gboolean timeoutDispatch(GSource* source, GSourceFunc callback, gpointer data);
+	static void timeoutFinalize(GSource* source);
+
+	bool nextDeadline(int64_t& deadline) const;
+	void step(int64_t ns);
+
+private:
+	int64_t m_wall;
+	int64_t m_monotonic;
+	int64_t m_boot;
+	int64_t m_slewed;
+	int64_t m_slewPending;
+	double  m_drift;	// ppm
+	mutable int64_t m_lastTimeoutMs;
+	mutable bool    m_lastCoalesce;
+	mutable std::set<Timeout*> m_timeouts;
+};
+
+#endif
@@ -0,0 +1,138 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file SntpStandIn.cpp
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "FakeTimeClock.h"
+#include "SntpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+	const int64_t ntpEpochOffset = 2208988800LL;
+
+	void putWord(unsigned char* p, uint32_t value)
+	{
+		p[0] = value >> 24;
+		p[1] = value >> 16;
+		p[2] = value >> 8;
+		p[3] = value;
+	}
+
+	void putTimestamp(unsigned char* p, int64_t ns)
+	{
+		putWord(p, uint32_t(ns / FakeTimeClock::nsecPerSec + ntpEpochOffset));
+		putWord(p + 4, uint32_t(((ns % FakeTimeClock::nsecPerSec) << 32) / FakeTimeClock::nsecPerSec));
+	}
+} // anonymous namespace
+
+SntpStandIn::SntpStandIn(const FakeTimeClock& clock, const char* address, unsigned short port) :
+	offsetNs( 0 ),
+	stratum( 2 ),
+	rootDelayMs( 0 ),
+	rootDispersionMs( 0 ),
+	mode( Answer ),
+	requests( 0 ),
+	m_clock( clock ),
+	m_fd( -1 ),
+	m_channel( NULL ),
+	m_watch( 0 ),
+	m_port( 0 )
+{
+	m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_fd < 0)
+		return;
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, address, &addr.sin_addr);
+	socklen_t length = sizeof(addr);
+	if (bind(m_fd, (struct sockaddr*) &addr, length) != 0 ||
+		getsockname(m_fd, (struct sockaddr*) &addr, &length) != 0)
+	{
+		::close(m_fd);
+		m_fd = -1;
+		return;
+	}
+	m_port = ntohs(addr.sin_port);
+
+	m_channel = g_io_channel_unix_new(m_fd);
+	m_watch = g_io_add_watch(m_channel, G_IO_IN, cbReadable, this);
+}
+
+SntpStandIn::~SntpStandIn()
+{
+	if (m_watch)
+		g_source_remove(m_watch);
+	if (m_channel)
+		g_io_channel_unref(m_channel);
+	if (m_fd >= 0)
+		::close(m_fd);
+}
+
+gboolean SntpStandIn::cbReadable(GIOChannel*, GIOCondition, gpointer data)
+{
+	static_cast<SntpStandIn*>(data)->serve();
+	return TRUE;
+}
+
+void SntpStandIn::serve()
+{
+	unsigned char packet[48];
+	struct sockaddr_storage from;
+	socklen_t length = sizeof(from);
+	ssize_t size = recvfrom(m_fd, packet, sizeof(packet), 0, (struct sockaddr*) &from, &length);
+	if (size != (ssize_t) sizeof(packet))
+		return;
+
+	++requests;
+	CHECK_EQUAL(packet[0] & 7, 3);	// client mode
+	if (mode == Silent)
+		return;
+
+	unsigned char reply[48];
+	memset(reply, 0, sizeof(reply));
+	reply[0] = (0 << 6) | (4 << 3) | 4;	// server mode
+	reply[1] = (mode == KissOfDeath) ? 0 : stratum;
+	putWord(reply + 4, uint32_t((int64_t(rootDelayMs) << 16) / 1000));
+	putWord(reply + 8, uint32_t((int64_t(rootDispersionMs) << 16) / 1000));
+	memcpy(reply + 24, packet + 40, 8);	// originate is client transmit
+	putTimestamp(reply + 32, m_clock.wallNs() + offsetNs);
+	putTimestamp(reply + 40, m_clock.wallNs() + offsetNs);
+
+	if (mode == StrayFirst)
+	{
+		unsigned char stray[48];
+		memcpy(stray, reply, sizeof(stray));
+		stray[31] ^= 0xff;
+		putTimestamp(stray + 40, m_clock.wallNs() + offsetNs + 3600 * FakeTimeClock::nsecPerSec);
+		sendto(m_fd, stray, sizeof(stray), 0, (struct sockaddr*) &from, length);
+	}
+	sendto(m_fd, reply, sizeof(reply), 0, (struct sockaddr*) &from, length);
+}
@@ -0,0 +1,80 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file SntpStandIn.h
+ */
+
+#ifndef __SNTPSTANDIN_H
+#define __SNTPSTANDIN_H
+
+#include <glib.h>
+#include <stdint.h>
+
+class FakeTimeClock;
+
+/**
+ * NTP server stand-in bound to loopback address (served from default main
+ * context). Answers come from the same fake wall clock as the client uses,
+ * so offsets are exact and no real network or time server is involved.
+ */
+class SntpStandIn
+{
+public:
+	enum Mode
+	{
+		Answer,
+		Silent,
+		KissOfDeath,	// stratum 0
+		StrayFirst		// answer with wrong originate time, then proper one
+	};
+
+	/**
+	 * Bind to address and port (any free port if 0)
+	 */
+	SntpStandIn(const FakeTimeClock& clock, const char* address, unsigned short port = 0);
+	~SntpStandIn();
+
+	bool isValid() const { return m_fd >= 0; }
+	unsigned short port() const { return m_port; }
+
+	int64_t offsetNs;	// server time minus fake wall time
+	int     stratum;
+	int     rootDelayMs;
+	int     rootDispersionMs;
+	Mode    mode;
+	int     requests;	// received so far
+
+private:
+	static gboolean cbReadable(GIOChannel*, GIOCondition, gpointer data);
+	void serve();
+
+	SntpStandIn(const SntpStandIn&);
+	SntpStandIn& operator=(const SntpStandIn&);
+
+private:
+	const FakeTimeClock& m_clock;
+	int                  m_fd;
+	GIOChannel*          m_channel;
+	guint                m_watch;
+	unsigned short       m_port;
+};
+
+#endif // __SNTPSTANDIN_H
@@ -0,0 +1,494 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestClockJournal.cpp
+ *
+ *  ClockJournal on fake clocks with journal in temporary directory:
+ *  skipping of repeated records, records rejected for checksum, magic,
+ *  unterminated tag or torn/truncated write, sequence numbers wrapping
+ *  around, the three ways restore() carries offsets over (same boot, RTC
+ *  kept time through reboot, RTC lost it) and time from ClockHandler
+ *  construction to plausible clock restored from journal.
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+
+#include "ClockHandler.h"
+#include "ClockJournal.h"
+#include "FakeTimeClock.h"
+#include "TestUtils.h"
+
+namespace {
+	// 2024-02-01 00:00:00 UTC
+	const time_t start = 1706745600;
+
+	// 2000-01-01 00:00:00 UTC (RTC reset)
+	const time_t rtcReset = 946684800;
+
+	const int64_t nsecPerSec = FakeTimeClock::nsecPerSec;
+	const int64_t nsecPerMs = FakeTimeClock::nsecPerMs;
+	const int64_t minuteMs = 60 * 1000;
+	const int64_t hourMs = 60 * minuteMs;
+
+	/**
+	 * On-disk record as ClockJournal writes it (journals written before
+	 * upgrade are read at boot, so layout doesn't change silently)
+	 */
+	struct Record
+	{
+		uint32_t magic;
+		uint32_t sequence;
+		char     tag[16];
+		int64_t  offset;
+		int64_t  uncertainty;
+		int64_t  wall;
+		int64_t  boot;
+		char     bootId[36];
+		uint32_t checksum;
+	};
+	typedef char RecordSizeCheck[sizeof(Record) == 96 ? 1 : -1];
+
+	const uint32_t slotCount = 32;
+
+	std::string s_path;
+
+	// FNV-1a over everything before checksum
+	uint32_t checksum(const Record& record)
+	{
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(&record);
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < offsetof(Record, checksum); ++i)
+			hash = (hash ^ p[i]) * 16777619u;
+		return hash;
+	}
+
+	bool readSlot(uint32_t slot, Record& record)
+	{
+		memset(&record, 0, sizeof(record));
+		int fd = open(s_path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		ssize_t size = pread(fd, &record, sizeof(record), slot * sizeof(Record));
+		close(fd);
+		return size == (ssize_t) sizeof(record);
+	}
+
+	bool writeSlot(uint32_t slot, const void* data, size_t size, size_t at = 0)
+	{
+		int fd = open(s_path.c_str(), O_WRONLY);
+		if (fd < 0)
+			return false;
+		ssize_t written = pwrite(fd, data, size, slot * sizeof(Record) + at);
+		close(fd);
+		return written == (ssize_t) size;
+	}
+
+	/**
+	 * Rewrite record (valid checksum) as sequence in its slot
+	 */
+	bool forge(Record record, uint32_t sequence, int64_t offset)
+	{
+		record.sequence = sequence;
+		record.offset = offset;
+		record.checksum = checksum(record);
+		return writeSlot(sequence % slotCount, &record, sizeof(record));
+	}
+
+	void setWall(FakeTimeClock& clock, time_t wall)
+	{
+		struct timespec ts;
+		FakeTimeClock::toTimespec((int64_t) wall * nsecPerSec, ts);
+		clock.setWallTime(ts);
+	}
+
+	/**
+	 * Offset of clock restored from fresh journal (invalidOffset if none)
+	 */
+	int64_t restored(const std::string& tag)
+	{
+		ClockJournal journal(s_path.c_str());
+		std::map<std::string, ClockJournal::Estimate> estimates;
+		journal.restore(estimates);
+		std::map<std::string, ClockJournal::Estimate>::const_iterator it = estimates.find(tag);
+		return it == estimates.end() ? ClockHandler::invalidOffset : it->second.offset;
+	}
+
+	void testSkipping()
+	{
+		unlink(s_path.c_str());
+		FakeTimeClock clock(start);
+		TimeClock::setInstance(&clock);
+
+		ClockJournal journal(s_path.c_str());
+		journal.record("ntp", 2 * nsecPerSec, 10 * nsecPerMs);
+
+		Record record;
+		CHECK(readSlot(1, record));
+		CHECK_EQUAL(record.sequence, 1u);
+		CHECK_EQUAL(std::string(record.tag), std::string("ntp"));
+		CHECK_EQUAL(record.checksum, checksum(record));
+
+		// nothing new: neither time nor offset moved enough
+		clock.advance(minuteMs);
+		journal.record("ntp", 2 * nsecPerSec + 50 * nsecPerMs, 10 * nsecPerMs);
+		CHECK(!readSlot(2, record));
+
+		// offset jump
+		journal.record("ntp", 2 * nsecPerSec + 150 * nsecPerMs, 10 * nsecPerMs);
+		CHECK(readSlot(2, record));
+		CHECK_EQUAL(record.sequence, 2u);
+
+		// same offset once record gets old (suspend counts)
+		clock.suspend(10 * minuteMs);
+		journal.record("ntp", 2 * nsecPerSec + 150 * nsecPerMs, 10 * nsecPerMs);
+		CHECK(readSlot(3, record));
+		CHECK_EQUAL(record.sequence, 3u);
+
+		// other clock isn't affected by that
+		journal.record("nitz", 0, nsecPerSec);
+		CHECK(readSlot(4, record));
+		CHECK_EQUAL(std::string(record.tag), std::string("nitz"));
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testRejected()
+	{
+		unlink(s_path.c_str());
+		FakeTimeClock clock(start);
+		TimeClock::setInstance(&clock);
+
+		const int64_t first = 1 * nsecPerSec;
+		const int64_t second = 2 * nsecPerSec;
+
+		ClockJournal journal(s_path.c_str());
+		journal.record("ntp", first, 10 * nsecPerMs);
+		journal.record("ntp", second, 10 * nsecPerMs);
+		CHECK_EQUAL(restored("ntp"), second);
+
+		Record good;
+		CHECK(readSlot(2, good));
+
+		// checksum
+		Record bad = good;
+		bad.offset ^= 1;
+		CHECK(writeSlot(2, &bad, sizeof(bad)));
+		CHECK_EQUAL(restored("ntp"), first);
+
+		// magic and tag (both with valid checksum)
+		bad = good;
+		bad.magic ^= 1;
+		bad.checksum = checksum(bad);
+		CHECK(writeSlot(2, &bad, sizeof(bad)));
+		CHECK_EQUAL(restored("ntp"), first);
+
+		bad = good;
+		memset(bad.tag, 'x', sizeof(bad.tag));
+		bad.checksum = checksum(bad);
+		CHECK(writeSlot(2, &bad, sizeof(bad)));
+		CHECK_EQUAL(restored("ntp"), first);
+
+		CHECK(writeSlot(2, &good, sizeof(good)));
+		CHECK_EQUAL(restored("ntp"), second);
+
+		// power lost in the middle of write over older record
+		journal.record("ntp", 3 * nsecPerSec, 10 * nsecPerMs);
+		CHECK_EQUAL(restored("ntp"), 3 * nsecPerSec);
+		const size_t half = sizeof(Record) / 2;
+		Record empty;
+		memset(&empty, 0, sizeof(empty));
+		CHECK(writeSlot(3, reinterpret_cast<const char*>(&empty) + half, sizeof(Record) - half, half));
+		CHECK_EQUAL(restored("ntp"), second);
+
+		// ...or of write which extended file
+		CHECK(truncate(s_path.c_str(), 2 * sizeof(Record) + half) == 0);
+		CHECK_EQUAL(restored("ntp"), first);
+		CHECK(truncate(s_path.c_str(), half) == 0);
+		CHECK_EQUAL(restored("ntp"), ClockHandler::invalidOffset);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testWraparound()
+	{
+		unlink(s_path.c_str());
+		FakeTimeClock clock(start);
+		TimeClock::setInstance(&clock);
+
+		{
+			ClockJournal journal(s_path.c_str());
+			journal.record("ntp", 0, 10 * nsecPerMs);
+		}
+		Record genuine;
+		CHECK(readSlot(1, genuine));
+
+		// last two before wrap, record of sequence 1 dropped
+		Record empty;
+		memset(&empty, 0, sizeof(empty));
+		CHECK(writeSlot(1, &empty, sizeof(empty)));
+		CHECK(forge(genuine, 0xfffffffeu, 1 * nsecPerSec));
+		CHECK(forge(genuine, 0xffffffffu, 2 * nsecPerSec));
+		CHECK_EQUAL(restored("ntp"), 2 * nsecPerSec);
+
+		// next record wraps to 0 and is newer than 0xffffffff
+		{
+			ClockJournal journal(s_path.c_str());
+			journal.record("ntp", 3 * nsecPerSec, 10 * nsecPerMs);
+		}
+		Record record;
+		CHECK(readSlot(0, record));
+		CHECK_EQUAL(record.sequence, 0u);
+		CHECK_EQUAL(record.checksum, checksum(record));
+		CHECK_EQUAL(restored("ntp"), 3 * nsecPerSec);
+
+		// and so are following ones
+		{
+			ClockJournal journal(s_path.c_str());
+			journal.record("ntp", 4 * nsecPerSec, 10 * nsecPerMs);
+		}
+		CHECK(readSlot(1, record));
+		CHECK_EQUAL(record.sequence, 1u);
+		CHECK_EQUAL(restored("ntp"), 4 * nsecPerSec);
+
+		// record from before wrap doesn't win over newer ones
+		CHECK(forge(genuine, 0xffffffe0u, 5 * nsecPerSec));
+		CHECK_EQUAL(restored("ntp"), 4 * nsecPerSec);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void checkEstimate(const std::map<std::string, ClockJournal::Estimate>& estimates,
+	                   const char* tag, int64_t offset, int64_t uncertainty,
+	                   bool sameBoot, bool lowerBound)
+	{
+		std::map<std::string, ClockJournal::Estimate>::const_iterator it = estimates.find(tag);
+		CHECK(it != estimates.end());
+		if (it == estimates.end())
+			return;
+		CHECK_EQUAL(it->second.offset, offset);
+		CHECK(llabs(it->second.uncertainty - uncertainty) <= 1);
+		CHECK_EQUAL(it->second.sameBoot, sameBoot);
+		CHECK_EQUAL(it->second.lowerBound, lowerBound);
+	}
+
+	/**
+	 * Journal of ntp (+2 s) and nitz (+5 s) clocks recorded an hour after
+	 * boot at start
+	 *
+	 * @return boot time of records
+	 */
+	int64_t recordClocks()
+	{
+		unlink(s_path.c_str());
+		FakeTimeClock clock(start - 3600);
+		TimeClock::setInstance(&clock);
+		clock.advance(hourMs);
+
+		ClockJournal journal(s_path.c_str());
+		journal.record("ntp", 2 * nsecPerSec, 10 * nsecPerMs);
+		journal.record("nitz", 5 * nsecPerSec, 500 * nsecPerMs);
+
+		TimeClock::setInstance(NULL);
+		return clock.bootNs();
+	}
+
+	void testSameBoot()
+	{
+		CHECK(access("/proc/sys/kernel/random/boot_id", R_OK) == 0);
+		int64_t recordBoot = recordClocks();
+
+		// service restarted two hours (one of them suspended) later and
+		// system time was set 30 s back meanwhile
+		FakeTimeClock clock(start);
+		TimeClock::setInstance(&clock);
+		clock.advance(recordBoot / nsecPerMs - clock.bootNs() / nsecPerMs + hourMs);
+		clock.suspend(hourMs);
+		setWall(clock, start + 2 * 3600 - 30);
+
+		ClockJournal journal(s_path.c_str());
+		std::map<std::string, ClockJournal::Estimate> estimates;
+		CHECK(journal.restore(estimates));
+		CHECK_EQUAL(estimates.size(), (size_t) 2);
+
+		// 50 ppm of 2 h
+		checkEstimate(estimates, "ntp", 32 * nsecPerSec, 10 * nsecPerMs + 360 * nsecPerMs, true, false);
+		checkEstimate(estimates, "nitz", 35 * nsecPerSec, 500 * nsecPerMs + 360 * nsecPerMs, true, false);
+
+		ClockJournal::Estimate best;
+		CHECK(ClockJournal::best(estimates, best));
+		CHECK_EQUAL(best.tag, std::string("ntp"));
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testRtcKept()
+	{
+		recordClocks();
+
+		// rebooted with RTC counting, two hours later (boot clock starts
+		// over, so it's behind one of records)
+		FakeTimeClock clock(start + 2 * 3600);
+		TimeClock::setInstance(&clock);
+
+		ClockJournal journal(s_path.c_str());
+		std::map<std::string, ClockJournal::Estimate> estimates;
+		CHECK(journal.restore(estimates));
+
+		// 1 s of RTC reading plus 100 ppm of 2 h
+		checkEstimate(estimates, "ntp", 2 * nsecPerSec, 10 * nsecPerMs + nsecPerSec + 720 * nsecPerMs, false, false);
+		checkEstimate(estimates, "nitz", 5 * nsecPerSec, 500 * nsecPerMs + nsecPerSec + 720 * nsecPerMs, false, false);
+
+		// uptime longer than time since record means RTC went back
+		TimeClock::setInstance(NULL);
+		FakeTimeClock early(start + 1800);
+		TimeClock::setInstance(&early);
+		CHECK(journal.restore(estimates));
+		CHECK(estimates["ntp"].lowerBound);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testRtcLost()
+	{
+		recordClocks();
+
+		FakeTimeClock clock(rtcReset);
+		TimeClock::setInstance(&clock);
+
+		ClockJournal journal(s_path.c_str());
+		std::map<std::string, ClockJournal::Estimate> estimates;
+		CHECK(journal.restore(estimates));
+
+		// not earlier than clock at record plus uptime (boot clock of
+		// FakeTimeClock starts at an hour)
+		const int64_t day = 24 * 3600 * nsecPerSec;
+		int64_t sinceReset = ((int64_t) start - rtcReset) * nsecPerSec;
+		checkEstimate(estimates, "ntp", sinceReset + 2 * nsecPerSec + clock.bootNs(), day, false, true);
+		checkEstimate(estimates, "nitz", sinceReset + 5 * nsecPerSec + clock.bootNs(), day, false, true);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	struct Changes : public Trackable
+	{
+		Changes() : count(0), offset(0), stampNs(0) {}
+
+		void changed(const std::string& clockTag, int, int64_t value, time_t)
+		{
+			if (clockTag != ClockHandler::journal)
+				return;
+			if (!count)
+				stampNs = Test::nowNs();
+			++count;
+			offset = value;
+		}
+
+		int         count;
+		int64_t     offset;
+		int64_t     stampNs;
+	};
+
+	/**
+	 * Time from construction of ClockHandler (as at service start) to
+	 * clockChanged carrying restored offset (expected one or, for lower
+	 * bound, not less)
+	 */
+	void measure(const char* what, int64_t expected, bool lowerBound = false)
+	{
+		const int runs = 100;
+		int64_t totalNs = 0;
+		for (int i = 0; i < runs; ++i)
+		{
+			int64_t startNs = Test::nowNs();
+			ClockHandler handler;
+			Changes changes;
+			handler.clockChanged.connect(&changes, &Changes::changed);
+			handler.setup("ntp", 4);
+			handler.setup("nitz", 2);
+			CHECK(handler.restoreJournal());
+			CHECK_EQUAL(changes.count, 1);
+			if (!changes.count)
+				return;
+			totalNs += changes.stampNs - startNs;
+			if (i == 0)
+				CHECK(lowerBound ? changes.offset >= expected : changes.offset == expected);
+		}
+		Test::report(what, runs, totalNs);
+	}
+
+	void benchmark()
+	{
+		ClockHandler::setJournalPath(s_path.c_str());
+
+		int64_t recordBoot = recordClocks();
+		FakeTimeClock sameBoot(start);
+		TimeClock::setInstance(&sameBoot);
+		sameBoot.advance(recordBoot / nsecPerMs - sameBoot.bootNs() / nsecPerMs + minuteMs);
+		setWall(sameBoot, start + 60);
+		// ntp is the most certain one
+		measure("plausible clock after restart", 2 * nsecPerSec);
+		TimeClock::setInstance(NULL);
+
+		recordClocks();
+		FakeTimeClock rtcKept(start + 2 * 3600);
+		TimeClock::setInstance(&rtcKept);
+		measure("plausible clock after reboot", 2 * nsecPerSec);
+		TimeClock::setInstance(NULL);
+
+		recordClocks();
+		FakeTimeClock rtcLost(rtcReset);
+		TimeClock::setInstance(&rtcLost);
+		// lower bounds only
+		measure("plausible clock after RTC reset",
+		        ((int64_t) start - rtcReset) * nsecPerSec + 2 * nsecPerSec + rtcLost.bootNs(), true);
+		TimeClock::setInstance(NULL);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	char dirTemplate[] = "/tmp/TestClockJournal.XXXXXX";
+	const char* dir = mkdtemp(dirTemplate);
+	CHECK(dir != NULL);
+	if (!dir)
+		return Test::result("TestClockJournal");
+	s_path = std::string(dir) + "/clockjournal";
+
+	testSkipping();
+	testRejected();
+	testWraparound();
+	testSameBoot();
+	testRtcKept();
+	testRtcLost();
+	benchmark();
+
+	unlink(s_path.c_str());
+	rmdir(dir);
+
+	return Test::result("TestClockJournal");
+}
@@ -0,0 +1,414 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestConvertDates.cpp
+ *
+ *  Sends /time/convertDates requests to TimePrefsHandler::cbConvertDates()
+ *  on FakeLunaService and checks replies: integer and string dates, "Z" and
+ *  "+hh:mm"/"-hh:mm" suffixes, per-date errors for malformed dates, local
+ *  dates without source_tz and dates timegm() can't represent, and request
+ *  errors (unknown zones, more than 1000 dates). Then benchmarks requests
+ *  of 1000 dates against the same dates sent one by one to convertDate.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cjson/json.h>
+
+#include <string>
+#include <vector>
+
+#include "FakeLunaService.h"
+#include "TestUtils.h"
+#include "TimePrefsHandler.h"
+
+namespace {
+
+// 1982-12-06 17:25:33 in America/Los_Angeles (-08:00)
+const long utcRef = 408072333;
+
+const int maxDates = 1000;
+
+struct Item
+{
+	bool converted;
+	long utc;
+	std::string date;
+	int offset;
+	std::string errorText;	// empty if converted
+};
+
+struct Reply
+{
+	bool returnValue;
+	std::string errorText;
+	std::vector<Item> items;
+	size_t errorCount;
+};
+
+std::string jsonString(const std::string& text)
+{
+	json_object* o = json_object_new_string(text.c_str());
+	std::string result = json_object_to_json_string(o);
+	json_object_put(o);
+	return result;
+}
+
+/**
+ * Request for dates (JSON values) from source (omitted if NULL) to dest
+ */
+std::string request(const std::vector<std::string>& dates, const char* source, const char* dest)
+{
+	std::string payload = "{\"dates\":[";
+	for (size_t i = 0; i < dates.size(); ++i) {
+		if (i > 0)
+			payload += ",";
+		payload += dates[i];
+	}
+	payload += "]";
+	if (source)
+		payload += ",\"source_tz\":" + jsonString(source);
+	payload += ",\"dest_tz\":" + jsonString(dest) + "}";
+	return payload;
+}
+
+std::string convertDates(const std::string& payload)
+{
+	LSMessage* message = FakeLunaService::invoke(TimePrefsHandler::cbConvertDates, payload);
+	const std::vector<std::string>& replies = FakeLunaService::replies(message);
+	return replies.empty() ? std::string() : replies.front();
+}
+
+bool parseReply(const std::string& text, Reply& reply)
+{
+	json_object* root = json_tokener_parse(text.c_str());
+	if (!root || is_error(root))
+		return false;
+
+	reply.returnValue = json_object_get_boolean(json_object_object_get(root, "returnValue"));
+	json_object* errorText = json_object_object_get(root, "errorText");
+	reply.errorText = errorText ? json_object_get_string(errorText) : "";
+	reply.items.clear();
+	reply.errorCount = 0;
+
+	json_object* utc = json_object_object_get(root, "utc");
+	json_object* dates = json_object_object_get(root, "dates");
+	json_object* offsets = json_object_object_get(root, "offsets");
+	json_object* errors = json_object_object_get(root, "errors");
+	bool ok = true;
+	if (reply.returnValue) {
+		ok = utc && dates && offsets &&
+		     json_object_array_length(utc) == json_object_array_length(dates) &&
+		     json_object_array_length(utc) == json_object_array_length(offsets);
+	}
+	for (int i = 0; ok && reply.returnValue && i < json_object_array_length(utc); ++i) {
+		Item item;
+		json_object* u = json_object_array_get_idx(utc, i);
+		json_object* d = json_object_array_get_idx(dates, i);
+		json_object* o = json_object_array_get_idx(offsets, i);
+		item.converted = u != NULL;
+		// null entries go together
+		if ((d != NULL) != item.converted || (o != NULL) != item.converted)
+			ok = false;
+		item.utc = u ? (long) json_object_get_int64(u) : 0;
+		item.date = d ? json_object_get_string(d) : "";
+		item.offset = o ? json_object_get_int(o) : 0;
+		reply.items.push_back(item);
+	}
+	if (ok && errors) {
+		reply.errorCount = json_object_array_length(errors);
+		for (size_t i = 0; i < reply.errorCount; ++i) {
+			json_object* e = json_object_array_get_idx(errors, i);
+			size_t index = json_object_get_int(json_object_object_get(e, "index"));
+			if (index >= reply.items.size() || reply.items[index].converted) {
+				ok = false;
+				break;
+			}
+			reply.items[index].errorText = json_object_get_string(json_object_object_get(e, "errorText"));
+		}
+	}
+
+	json_object_put(root);
+	return ok;
+}
+
+bool convert(const std::vector<std::string>& dates, const char* source, const char* dest, Reply& reply)
+{
+	return parseReply(convertDates(request(dates, source, dest)), reply);
+}
+
+void checkConverted(const Item& item, long utc, const char* date, int offset, int line)
+{
+	if (!item.converted || item.utc != utc || item.date != date || item.offset != offset) {
+		fprintf(stderr, "  got %ld '%s' %d (%s), expected %ld '%s' %d\n", item.utc, item.date.c_str(),
+		        item.offset, item.errorText.c_str(), utc, date, offset);
+		Test::fail(__FILE__, line, "date converted");
+	}
+}
+
+void checkError(const Item& item, const std::string& errorText, int line)
+{
+	if (item.converted || item.errorText != errorText) {
+		fprintf(stderr, "  got '%s', expected '%s'\n", item.errorText.c_str(), errorText.c_str());
+		Test::fail(__FILE__, line, "date rejected");
+	}
+}
+
+void testDates()
+{
+	std::vector<std::string> dates;
+	dates.push_back("408072333");
+	dates.push_back("\"1982-12-06 17:25:33\"");
+	dates.push_back("\"1982-12-06T17:25:33\"");
+	dates.push_back("\"1982-12-07T01:25:33Z\"");
+	dates.push_back("\"1982-12-07T03:25:33+02:00\"");
+	dates.push_back("\"1982-12-06T17:25:33-08:00\"");
+	dates.push_back("\"1982-12-07T06:55:33+05:30\"");
+	dates.push_back("\"1982-12-06 17:25:33-00:00\"");
+
+	Reply reply;
+	CHECK(convert(dates, "America/Los_Angeles", "Europe/Helsinki", reply));
+	CHECK(reply.returnValue);
+	CHECK_EQUAL(reply.items.size(), dates.size());
+	CHECK_EQUAL(reply.errorCount, (size_t) 0);
+	for (size_t i = 0; i + 1 < reply.items.size() && i + 1 < dates.size(); ++i)
+		checkConverted(reply.items[i], utcRef, "1982-12-07T03:25:33", 120, __LINE__);
+	// explicit offset wins over source_tz
+	if (reply.items.size() == dates.size())
+		checkConverted(reply.items.back(), utcRef - 8 * 3600, "1982-12-06T19:25:33", 120, __LINE__);
+
+	// negative offset of destination, in minutes
+	dates.resize(1);
+	CHECK(convert(dates, NULL, "America/St_Johns", reply));
+	CHECK(reply.returnValue && reply.items.size() == 1);
+	if (reply.items.size() == 1)
+		checkConverted(reply.items[0], utcRef, "1982-12-06T21:55:33", -210, __LINE__);
+}
+
+void testMalformed()
+{
+	const char* const malformed[] = {
+		"",
+		"1982-12-06",
+		"82-12-06 17:25:33",
+		"1982-12-06x17:25:33",
+		"1982/12/06 17:25:33",
+		"1982-12-06 17:25",
+		"1982-12-06 17:25:3",
+		"1982-12-06 17:25:33 ",
+		"1982-12-06T17:25:33Zjunk",
+		"1982-12-06T17:25:33z",
+		"1982-12-06T17:25:33+0200",
+		"1982-12-06T17:25:33+02",
+		"1982-12-06T17:25:33+2:00",
+		"1982-12-06T17:25:33+24:00",
+		"1982-12-06T17:25:33+02:60",
+		"1982-12-06T17:25:33 +02:00",
+		"1982-00-06 17:25:33",
+		"2014-13-01 00:00:00",
+		"1982-12-00 17:25:33",
+		"1982-12-32 17:25:33",
+		"1982-12-06 24:00:00",
+		"1982-12-06 17:60:33",
+		"1982-12-06 17:25:61",
+		"+982-12-06 17:25:33",
+	};
+	const size_t count = sizeof(malformed) / sizeof(malformed[0]);
+
+	// each bad date fails alone; valid dates around it are converted
+	std::vector<std::string> dates;
+	for (size_t i = 0; i < count; ++i) {
+		dates.push_back("408072333");
+		dates.push_back(jsonString(malformed[i]));
+	}
+	dates.push_back("408072333");
+
+	Reply reply;
+	CHECK(convert(dates, "America/Los_Angeles", "UTC", reply));
+	CHECK(reply.returnValue);
+	CHECK_EQUAL(reply.items.size(), dates.size());
+	CHECK_EQUAL(reply.errorCount, count);
+	for (size_t i = 0; i < count && 2 * i + 2 < reply.items.size(); ++i) {
+		checkConverted(reply.items[2 * i], utcRef, "1982-12-07T01:25:33", 0, __LINE__);
+		checkError(reply.items[2 * i + 1], std::string("unrecognized date format: '") + malformed[i] + "'", __LINE__);
+	}
+	if (!reply.items.empty())
+		checkConverted(reply.items.back(), utcRef, "1982-12-07T01:25:33", 0, __LINE__);
+
+	// leap second is accepted (as first second of next minute)
+	dates.clear();
+	dates.push_back("\"1982-12-06T17:25:60Z\"");
+	CHECK(convert(dates, NULL, "UTC", reply));
+	CHECK(reply.returnValue && reply.items.size() == 1);
+	if (reply.items.size() == 1)
+		checkConverted(reply.items[0], utcRef - 8 * 3600 + 27, "1982-12-06T17:26:00", 0, __LINE__);
+}
+
+void testPerDateErrors()
+{
+	// local time needs source_tz, UTC and offset dates don't
+	std::vector<std::string> dates;
+	dates.push_back("\"1982-12-06 17:25:33\"");
+	dates.push_back("\"1982-12-07T01:25:33Z\"");
+	dates.push_back("408072333");
+
+	Reply reply;
+	CHECK(convert(dates, NULL, "UTC", reply));
+	CHECK(reply.returnValue);
+	CHECK_EQUAL(reply.errorCount, (size_t) 1);
+	if (reply.items.size() == 3) {
+		checkError(reply.items[0], "no source_tz for local date: '1982-12-06 17:25:33'", __LINE__);
+		checkConverted(reply.items[1], utcRef, "1982-12-07T01:25:33", 0, __LINE__);
+		checkConverted(reply.items[2], utcRef, "1982-12-07T01:25:33", 0, __LINE__);
+	}
+
+	// timegm() gives -1 for the last second of 1969 without setting errno
+	dates.clear();
+	dates.push_back("\"1969-12-31T23:59:59Z\"");
+	dates.push_back("\"1970-01-01T02:00:00+02:00\"");
+	// beyond 2038: representable only with 64-bit time_t
+	dates.push_back("\"2040-01-01T00:00:00Z\"");
+
+	CHECK(convert(dates, NULL, "UTC", reply));
+	CHECK(reply.returnValue);
+	if (reply.items.size() == 3) {
+		checkConverted(reply.items[0], -1, "1969-12-31T23:59:59", 0, __LINE__);
+		checkConverted(reply.items[1], 0, "1970-01-01T00:00:00", 0, __LINE__);
+		if (sizeof(time_t) > 4)
+			checkConverted(reply.items[2], 2208988800L, "2040-01-01T00:00:00", 0, __LINE__);
+		else
+			checkError(reply.items[2], "date out of range: '2040-01-01T00:00:00Z'", __LINE__);
+	}
+}
+
+void testRequestErrors()
+{
+	std::vector<std::string> dates(1, "408072333");
+	Reply reply;
+
+	const char* const badZones[] = { "Finland", "/usr/share/zoneinfo/UTC", "../zoneinfo/UTC", "Europe/../UTC", "U" };
+	for (size_t i = 0; i < sizeof(badZones) / sizeof(badZones[0]); ++i) {
+		std::string errorText = std::string("timezone not found: '") + badZones[i] + "'";
+
+		CHECK(convert(dates, NULL, badZones[i], reply));
+		CHECK(!reply.returnValue);
+		CHECK(reply.errorText == errorText);
+
+		// unknown source_tz fails request even if no date needs it
+		CHECK(convert(dates, badZones[i], "UTC", reply));
+		CHECK(!reply.returnValue);
+		CHECK(reply.errorText == errorText);
+	}
+
+	// up to 1000 dates in one request
+	dates.assign(maxDates, "408072333");
+	CHECK(convert(dates, NULL, "UTC", reply));
+	CHECK(reply.returnValue);
+	CHECK_EQUAL(reply.items.size(), (size_t) maxDates);
+	CHECK_EQUAL(reply.errorCount, (size_t) 0);
+
+	dates.push_back("408072333");
+	CHECK(convert(dates, NULL, "UTC", reply));
+	CHECK(!reply.returnValue);
+	CHECK(reply.errorText == "too many dates in one request");
+	CHECK(reply.items.empty());
+
+	// empty batch is fine
+	dates.clear();
+	CHECK(convert(dates, NULL, "UTC", reply));
+	CHECK(reply.returnValue);
+	CHECK(reply.items.empty());
+}
+
+// requests of maxDates dates against one convertDate call per date
+void benchmark()
+{
+	const char* const source = "America/New_York";
+	const char* const dest = "Asia/Kolkata";
+	const int requests = 20;
+	const time_t base = 1400000000;
+
+	std::vector<std::string> localDates;
+	std::vector<std::string> dates;
+	for (int i = 0; i < maxDates; ++i) {
+		time_t t = base + i * 37 * 60;
+		struct tm tm;
+		gmtime_r(&t, &tm);
+		char text[32];
+		strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+		localDates.push_back(text);
+		if (i % 2)
+			dates.push_back(jsonString(text));
+		else {
+			snprintf(text, sizeof(text), "%ld", (long) t);
+			dates.push_back(text);
+		}
+	}
+	std::string payload = request(dates, source, dest);
+
+	int64_t begin = Test::nowNs();
+	size_t converted = 0;
+	for (int i = 0; i < requests; ++i) {
+		Reply reply;
+		if (parseReply(convertDates(payload), reply) && reply.returnValue)
+			converted += reply.items.size() - reply.errorCount;
+		FakeLunaService::reset();
+	}
+	Test::report("convertDates dates (1000 per request, with reply parsing)", requests * maxDates,
+	             Test::nowNs() - begin);
+	CHECK_EQUAL(converted, (size_t) requests * maxDates);
+
+	begin = Test::nowNs();
+	size_t replied = 0;
+	for (int i = 0; i < requests; ++i) {
+		for (int d = 0; d < maxDates; ++d) {
+			std::string single = "{\"date\":" + jsonString(localDates[d]) + ",\"source_tz\":" +
+			                     jsonString(source) + ",\"dest_tz\":" + jsonString(dest) + "}";
+			LSMessage* message = FakeLunaService::invoke(TimePrefsHandler::cbConvertDate, single);
+			json_object* root = json_tokener_parse(FakeLunaService::replies(message).front().c_str());
+			if (root && !is_error(root)) {
+				if (json_object_get_boolean(json_object_object_get(root, "returnValue")))
+					++replied;
+				json_object_put(root);
+			}
+		}
+		FakeLunaService::reset();
+	}
+	Test::report("convertDate calls (one date per request, with reply parsing)", requests * maxDates,
+	             Test::nowNs() - begin);
+	CHECK_EQUAL(replied, (size_t) requests * maxDates);
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	testDates();
+	testMalformed();
+	testPerDateErrors();
+	testRequestErrors();
+	FakeLunaService::reset();
+
+	benchmark();
+
+	return Test::result("TestConvertDates");
+}
@@ -0,0 +1,248 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestEasZoneIndex.cpp
+ *
+ *  Compares EAS zone index of TimeZoneService with the original matching
+ *  (setenv("TZ") and mktime() of EAS dates for every candidate zone) for
+ *  all zones of zone.tab grouped by standard offset.
+ *
+ *  Usage: TestEasZoneIndex [first year] [last year]
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TimeZoneService.h"
+#include "TzZone.h"
+#include "TestUtils.h"
+
+namespace {
+
+struct Rule {
+	long utcOffset;
+	int64_t dstStart;
+	int64_t dstEnd;
+};
+
+/**
+ * DST rule for year, derived in the same way as getTimeZoneRules does
+ */
+bool yearRule(const TzZone* zone, int year, Rule& rule)
+{
+	rule.utcOffset = -1;
+	rule.dstStart = -1;
+	rule.dstEnd = -1;
+
+	size_t first, last;
+	zone->yearTransitions(year, first, last);
+
+	long stdOffset, dstOffset;
+	int64_t dstStart, dstEnd;
+
+	if (first < last) {
+		TzTransition trans;
+		for (size_t i = first; i < last; ++i) {
+			zone->transitionAt(i, trans);
+			if (trans.isDst) {
+				rule.dstStart = trans.time;
+			}
+			else {
+				rule.utcOffset = trans.utcOffset;
+				rule.dstEnd = trans.time;
+			}
+		}
+	}
+	else if (zone->yearRule(year, stdOffset, dstOffset, dstStart, dstEnd)) {
+		rule.utcOffset = stdOffset;
+		rule.dstStart = dstStart;
+		rule.dstEnd = dstEnd;
+	}
+	else if (zone->transitionCount() == 0) {
+		TzZone::LocalTimeInfo info;
+		zone->lookup(0, info);
+		rule.utcOffset = info.utcOffset;
+	}
+	else if (first > 0) {
+		TzTransition trans;
+		zone->transitionAt(first - 1, trans);
+		rule.utcOffset = trans.utcOffset;
+	}
+
+	if (rule.dstStart == -1)
+		rule.dstEnd = -1;
+
+	return rule.utcOffset != -1;
+}
+
+/**
+ * Original matching: first zone for which mktime() of EAS dates gives its
+ * DST end and start
+ */
+const std::string* findEasZoneByMktime(const std::list<std::string>& timeZones,
+									   const std::map<std::string, Rule>& rules,
+									   int64_t standardDate, int64_t daylightDate)
+{
+	for (std::list<std::string>::const_iterator it = timeZones.begin();
+		 it != timeZones.end(); ++it) {
+		const Rule& rule = rules.find(*it)->second;
+
+		setenv("TZ", it->c_str(), 1);
+
+		time_t date = (time_t) standardDate;
+		struct tm brokenTime;
+		gmtime_r(&date, &brokenTime);
+		brokenTime.tm_isdst = 1;
+		time_t standardSeconds = mktime(&brokenTime);
+
+		date = (time_t) daylightDate;
+		gmtime_r(&date, &brokenTime);
+		brokenTime.tm_isdst = 0;
+		time_t daylightSeconds = mktime(&brokenTime);
+
+		if (standardSeconds == rule.dstEnd && daylightSeconds == rule.dstStart)
+			return &(*it);
+	}
+	return NULL;
+}
+
+/**
+ * Requests for which mktime() result depends on its internal search: DST
+ * start of Samoa 2011 falls into the day skipped when it moved across the
+ * date line, so there is no local time to convert.
+ */
+bool knownDifference(int year, const std::string& tz)
+{
+	return year == 2011 && tz == "Pacific/Apia";
+}
+
+std::vector<std::string> readZoneTab()
+{
+	std::vector<std::string> zones;
+
+	FILE* file = fopen("/usr/share/zoneinfo/zone.tab", "r");
+	if (!file)
+		return zones;
+
+	char line[512];
+	char name[256];
+	while (fgets(line, sizeof(line), file)) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%*s %*s %255s", name) == 1)
+			zones.push_back(name);
+	}
+	fclose(file);
+	return zones;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	int firstYear = argc > 1 ? atoi(argv[1]) : 2000;
+	int lastYear = argc > 2 ? atoi(argv[2]) : 2037;
+
+	std::vector<std::string> names = readZoneTab();
+	CHECK(!names.empty());
+
+	TimeZoneService* service = TimeZoneService::instance();
+	long checks = 0;
+
+	for (int year = firstYear; year <= lastYear; ++year) {
+		// zones grouped by standard offset (in minutes) like
+		// getTimeZonesForOffset() does
+		std::map<int, std::list<std::string> > groups;
+		std::map<std::string, Rule> rules;
+		for (size_t i = 0; i < names.size(); ++i) {
+			TzZoneRef zone(TzZone::load(names[i].c_str()));
+			Rule rule;
+			if (zone.isNull() || !yearRule(zone.get(), year, rule))
+				continue;
+			rules[names[i]] = rule;
+			groups[rule.utcOffset / 60].push_back(names[i]);
+		}
+
+		// requests are DST rules of every zone, exact and shifted
+		for (std::map<std::string, Rule>::const_iterator it = rules.begin();
+			 it != rules.end(); ++it) {
+			const Rule& rule = it->second;
+			if (rule.dstStart == -1 || knownDifference(year, it->first))
+				continue;
+
+			TzZoneRef zone(TzZone::load(it->first.c_str()));
+			TzZone::LocalTimeInfo beforeEnd, beforeStart;
+			zone->lookup(rule.dstEnd - 1, beforeEnd);
+			zone->lookup(rule.dstStart - 1, beforeStart);
+
+			static const int shifts[] = { 0, 3600, -1800 };
+			for (size_t s = 0; s < sizeof(shifts) / sizeof(shifts[0]); ++s) {
+				int64_t standardDate = rule.dstEnd + beforeEnd.utcOffset + shifts[s];
+				int64_t daylightDate = rule.dstStart + beforeStart.utcOffset;
+				const std::list<std::string>& timeZones = groups[rule.utcOffset / 60];
+
+				const std::string* expected = findEasZoneByMktime(timeZones, rules,
+																  standardDate, daylightDate);
+				const std::string* actual = service->findEasZone(rule.utcOffset / 60, year,
+																 timeZones,
+																 standardDate, daylightDate);
+				++checks;
+				if ((expected == NULL) != (actual == NULL) ||
+					(expected && *expected != *actual)) {
+					fprintf(stderr, "  %d %s%+d: %s vs %s\n", year, it->first.c_str(), shifts[s],
+							expected ? expected->c_str() : "none",
+							actual ? actual->c_str() : "none");
+					Test::fail(__FILE__, __LINE__, "findEasZone() matches mktime() search");
+				}
+			}
+		}
+	}
+
+	// index follows changes of zone list
+	std::list<std::string> single(1, "Europe/Helsinki");
+	std::list<std::string> other(1, "Europe/Kiev");
+	Rule rule;
+	TzZoneRef zone(TzZone::load("Europe/Helsinki"));
+	if (!zone.isNull() && yearRule(zone.get(), 2020, rule) && rule.dstStart != -1) {
+		TzZone::LocalTimeInfo beforeEnd, beforeStart;
+		zone->lookup(rule.dstEnd - 1, beforeEnd);
+		zone->lookup(rule.dstStart - 1, beforeStart);
+		int64_t standardDate = rule.dstEnd + beforeEnd.utcOffset;
+		int64_t daylightDate = rule.dstStart + beforeStart.utcOffset;
+
+		const std::string* found = service->findEasZone(120, 2020, single, standardDate, daylightDate);
+		CHECK(found && *found == "Europe/Helsinki");
+		found = service->findEasZone(120, 2020, other, standardDate, daylightDate);
+		CHECK(!found || *found != "Europe/Helsinki");
+
+		service->clearEasZones();
+		found = service->findEasZone(120, 2020, single, standardDate, daylightDate);
+		CHECK(found && *found == "Europe/Helsinki");
+	}
+
+	printf("%ld EAS requests checked\n", checks);
+	return Test::result("TestEasZoneIndex");
+}
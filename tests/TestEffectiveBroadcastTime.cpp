@@ -0,0 +1,243 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestEffectiveBroadcastTime.cpp
+ *
+ *  EffectiveBroadcastTime::predicts() at edges of its tolerance and on
+ *  switches of time source, then getEffectiveBroadcastTime subscription on
+ *  FakeLunaService and fake clock: posts only when extrapolation of last
+ *  reply breaks (broadcast time set or moved), and after resume from
+ *  suspend, which monotonicMs of last reply doesn't cover.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <cjson/json.h>
+
+#include "BroadcastTime.h"
+#include "FakeLunaService.h"
+#include "FakeTimeClock.h"
+#include "PrefsDb.h"
+#include "TestUtils.h"
+#include "TimePrefsHandler.h"
+
+extern GMainLoop* g_gmainLoop;
+
+namespace {
+	// 2023-06-01 00:00:00 UTC
+	const time_t start = 1685577600;
+
+	// what getEffectiveBroadcastTime posts are re-sent for
+	const int64_t toleranceMs = 1000;
+
+	EffectiveBroadcastTime sample(time_t utc, int64_t monotonicMs)
+	{
+		EffectiveBroadcastTime effective;
+		effective.valid = true;
+		effective.adjustedUtc = utc;
+		effective.local = utc + 3 * 3600;
+		effective.monotonicMs = monotonicMs;
+		return effective;
+	}
+
+	void testTolerance()
+	{
+		EffectiveBroadcastTime last = sample(start, 5000);
+
+		// 10 s of local and UTC time in 9..11 s of monotonic time
+		EffectiveBroadcastTime actual = sample(start + 10, 5000 + 9000);
+		CHECK(last.predicts(actual, toleranceMs));
+		actual.monotonicMs = 5000 + 8999;
+		CHECK(!last.predicts(actual, toleranceMs));
+		actual.monotonicMs = 5000 + 11000;
+		CHECK(last.predicts(actual, toleranceMs));
+		actual.monotonicMs = 5000 + 11001;
+		CHECK(!last.predicts(actual, toleranceMs));
+
+		// local and UTC are checked separately
+		actual = sample(start + 10, 5000 + 10000);
+		actual.local += 2;
+		CHECK(!last.predicts(actual, toleranceMs));
+		actual = sample(start + 10, 5000 + 10000);
+		actual.adjustedUtc -= 2;
+		CHECK(!last.predicts(actual, toleranceMs));
+
+		// nothing predicts or is predicted without valid sample
+		actual = sample(start + 10, 5000 + 10000);
+		CHECK(!EffectiveBroadcastTime().predicts(actual, toleranceMs));
+		CHECK(!last.predicts(EffectiveBroadcastTime(), toleranceMs));
+	}
+
+	void testSourceSwitch()
+	{
+		EffectiveBroadcastTime last = sample(start, 5000);
+		EffectiveBroadcastTime actual = sample(start + 10, 15000);
+		CHECK(last.predicts(actual, toleranceMs));
+
+		// broadcast to system time and back
+		actual.systemTimeUsed = true;
+		actual.systemTimeSource = "ntp";
+		CHECK(!last.predicts(actual, toleranceMs));
+		CHECK(!actual.predicts(last, toleranceMs));
+
+		// system time synchronized with other clock
+		last.systemTimeUsed = true;
+		last.systemTimeSource = "nitz";
+		CHECK(!last.predicts(actual, toleranceMs));
+		last.systemTimeSource = "ntp";
+		CHECK(last.predicts(actual, toleranceMs));
+
+		// source tag matters only for system time
+		last.systemTimeUsed = false;
+		actual.systemTimeUsed = false;
+		CHECK(last.predicts(actual, toleranceMs));
+	}
+
+	/**
+	 * Fields of getEffectiveBroadcastTime reply
+	 */
+	struct Reply
+	{
+		Reply() : valid(false), local(0), monotonicMs(0), systemTime(false) {}
+
+		bool valid;
+		long local;
+		int64_t monotonicMs;
+		bool systemTime;	// systemTimeSource present
+	};
+
+	Reply parse(const std::string& text)
+	{
+		Reply reply;
+		json_object* root = json_tokener_parse(text.c_str());
+		CHECK(root && !is_error(root));
+		if (!root || is_error(root))
+			return reply;
+
+		json_object* label = json_object_object_get(root, "returnValue");
+		reply.valid = label && json_object_get_boolean(label);
+		label = json_object_object_get(root, "local");
+		if (label)
+			reply.local = json_object_get_int64(label);
+		label = json_object_object_get(root, "monotonicMs");
+		if (label)
+			reply.monotonicMs = json_object_get_int64(label);
+		reply.systemTime = json_object_object_get(root, "systemTimeSource") != NULL;
+		json_object_put(root);
+		return reply;
+	}
+
+	std::string broadcast(time_t utc, time_t local)
+	{
+		char payload[128];
+		snprintf(payload, sizeof(payload), "{\"utc\":%ld,\"local\":%ld}", (long) utc, (long) local);
+		return payload;
+	}
+
+	void testSubscription(FakeTimeClock& clock, TimePrefsHandler* handler)
+	{
+		LSMessage* subscription = FakeLunaService::send("/time", "getEffectiveBroadcastTime", "{\"subscribe\":true}");
+		CHECK(subscription != NULL);
+		if (!subscription)
+			return;
+		const std::vector<std::string>& replies = FakeLunaService::replies(subscription);
+		CHECK_EQUAL(replies.size(), (size_t) 1);
+
+		// no broadcast time yet: system time
+		Reply first = parse(replies.back());
+		CHECK(first.valid);
+		CHECK(first.systemTime);
+
+		// resume without suspend, extrapolation still holds
+		clock.advance(30000);
+		FakeLunaService::invoke(TimePrefsHandler::cbPowerResume, "{}", handler);
+		CHECK_EQUAL(replies.size(), (size_t) 1);
+
+		// monotonic time stands while suspended
+		clock.suspend(120000);
+		FakeLunaService::invoke(TimePrefsHandler::cbPowerResume, "{}", handler);
+		CHECK_EQUAL(replies.size(), (size_t) 2);
+		Reply resumed = parse(replies.back());
+		CHECK(resumed.systemTime);
+		CHECK_EQUAL(resumed.monotonicMs, first.monotonicMs + 30000);
+		CHECK_EQUAL(resumed.local, first.local + 150);
+
+		// switch to broadcast time
+		time_t utc = clock.wallSeconds() + 600;
+		std::string reply = FakeLunaService::call("/time", "setBroadcastTime", broadcast(utc, utc + 7200));
+		CHECK(parse(reply).valid);
+		CHECK_EQUAL(replies.size(), (size_t) 3);
+		Reply switched = parse(replies.back());
+		CHECK(!switched.systemTime);
+		CHECK_EQUAL(switched.local, (long) (utc + 7200));
+
+		// broadcast time which follows extrapolation (within tolerance)
+		// isn't posted, jump of it is
+		clock.advance(10000);
+		utc = clock.wallSeconds() + 600;
+		FakeLunaService::call("/time", "setBroadcastTime", broadcast(utc + 1, utc + 7200 + 1));
+		CHECK_EQUAL(replies.size(), (size_t) 3);
+		FakeLunaService::call("/time", "setBroadcastTime", broadcast(utc + 2, utc + 7200 + 2));
+		CHECK_EQUAL(replies.size(), (size_t) 4);
+		CHECK_EQUAL(parse(replies.back()).local, (long) (utc + 7200 + 2));
+
+		// suspend breaks extrapolation of broadcast time too
+		clock.suspend(5000);
+		FakeLunaService::invoke(TimePrefsHandler::cbPowerResume, "{}", handler);
+		CHECK_EQUAL(replies.size(), (size_t) 5);
+		CHECK_EQUAL(parse(replies.back()).local, (long) (utc + 7200 + 2 + 5));
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	testTolerance();
+	testSourceSwitch();
+
+	char dirTemplate[] = "/tmp/TestEffectiveBroadcastTime.XXXXXX";
+	const char* dir = mkdtemp(dirTemplate);
+	CHECK(dir != NULL);
+	if (!dir)
+		return Test::result("TestEffectiveBroadcastTime");
+
+	std::string prefsDbPath = std::string(dir) + "/systemprefs.db";
+	std::string localTimePath = std::string(dir) + "/localtime";
+	PrefsDb::s_prefsDbPath = prefsDbPath.c_str();
+	TimePrefsHandler::setLocalTimeFile(localTimePath.c_str());
+
+	FakeTimeClock clock(start);
+	TimeClock::setInstance(&clock);
+	g_gmainLoop = g_main_loop_new(NULL, FALSE);
+
+	TimePrefsHandler* handler = new TimePrefsHandler(FakeLunaService::service());
+	testSubscription(clock, handler);
+
+	TimeClock::setInstance(NULL);
+
+	unlink(prefsDbPath.c_str());
+	unlink(localTimePath.c_str());
+	rmdir(dir);
+
+	return Test::result("TestEffectiveBroadcastTime");
+}
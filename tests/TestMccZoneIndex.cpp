@@ -0,0 +1,246 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestMccZoneIndex.cpp
+ *
+ *  Compares MccZoneIndex with the original NITZ zone selection (five
+ *  ranking passes over zones of the MCC's country with matching offset),
+ *  for a fixed table of cases and for generated catalogs.
+ */
+
+#include <stdlib.h>
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "MccZoneIndex.h"
+#include "TimeZoneCatalog.h"
+#include "TestUtils.h"
+
+namespace {
+
+struct ZoneRow {
+	const char* name;
+	const char* countryCode;
+	int offset;
+	int dst;
+	bool preferred;
+};
+
+const ZoneRow zoneTable[] = {
+	{ "America/New_York",    "US", -300, 1, true  },
+	{ "America/Detroit",     "US", -300, 1, false },
+	{ "America/Indianapolis","US", -300, 0, false },
+	{ "America/Chicago",     "US", -360, 1, true  },
+	{ "America/Phoenix",     "US", -420, 0, false },
+	{ "America/Denver",      "US", -420, 1, true  },
+	{ "America/Regina",      "CA", -360, 0, true  },
+	{ "America/Winnipeg",    "CA", -360, 1, false },
+	{ "America/Sao_Paulo",   "BR", -180, 0, false },
+	{ "America/Bahia",       "BR", -180, 0, true  },
+	{ "Europe/Helsinki",     "FI",  120, 1, true  },
+	{ "Asia/Kolkata",        "IN",  330, 0, false },
+};
+
+struct MccRow {
+	int mcc;
+	const char* countryCode;
+};
+
+const MccRow mccTable[] = {
+	{ 310, "US" },
+	{ 302, "CA" },
+	{ 724, "BR" },
+	{ 244, "FI" },
+	{ 404, "IN" },
+	{ 901, ""   },	// international, no country
+};
+
+struct Case {
+	int mcc;
+	int offset;
+	int dst;
+	const char* expected;	// NULL if MCC's country has no zone with offset
+};
+
+const Case caseTable[] = {
+	{ 310, -300,  1, "America/New_York" },		// preferred with DST
+	{ 310, -300,  0, "America/New_York" },		// DST enabled wins over dst value
+	{ 310, -420,  0, "America/Denver" },
+	{ 310, -420,  1, "America/Denver" },
+	{ 310, -360,  1, "America/Chicago" },
+	{ 310,    0,  1, NULL },
+	{ 302, -360,  0, "America/Regina" },		// preferred with matching dst
+	{ 302, -360,  1, "America/Winnipeg" },		// DST enabled
+	{ 724, -180,  1, "America/Bahia" },			// preferred
+	{ 724, -180,  0, "America/Bahia" },
+	{ 724, -180,  2, "America/Bahia" },			// dst value no zone has
+	{ 244,  120, -1, "Europe/Helsinki" },
+	{ 404,  330,  0, "Asia/Kolkata" },
+	{ 404,  330,  1, "Asia/Kolkata" },			// first one
+	{ 901,    0,  0, NULL },
+	{ 999, -300,  1, NULL },
+};
+
+/**
+ * Original selection from timeZone_ZoneFromOffset()
+ */
+const TimeZoneInfo* originalSelection(const std::multimap<int,const TimeZoneInfo*>& offsetZones,
+									  const std::map<int,const TimeZoneInfo*>& mccZones,
+									  int offset, int dstValue, int mcc)
+{
+	std::map<int,const TimeZoneInfo*>::const_iterator tzMcc = mccZones.find(mcc);
+	if (tzMcc == mccZones.end() || tzMcc->second->countryCode.empty())
+		return NULL;
+
+	std::string countryCode = tzMcc->second->countryCode;
+
+	std::list<const TimeZoneInfo*> matching;
+	typedef std::multimap<int,const TimeZoneInfo*>::const_iterator Iterator;
+	std::pair<Iterator, Iterator> range = offsetZones.equal_range(offset);
+	for (Iterator it = range.first; it != range.second; ++it) {
+		if (it->second->countryCode == countryCode)
+			matching.push_back(it->second);
+	}
+	if (matching.empty())
+		return NULL;
+
+	typedef std::list<const TimeZoneInfo*>::const_iterator ListIterator;
+	for (ListIterator it = matching.begin(); it != matching.end(); ++it)
+		if ((*it)->preferred && (*it)->dstSupported == dstValue)
+			return *it;
+	for (ListIterator it = matching.begin(); it != matching.end(); ++it)
+		if ((*it)->dstSupported == 1)
+			return *it;
+	for (ListIterator it = matching.begin(); it != matching.end(); ++it)
+		if ((*it)->preferred)
+			return *it;
+	for (ListIterator it = matching.begin(); it != matching.end(); ++it)
+		if ((*it)->dstSupported == dstValue)
+			return *it;
+	return matching.front();
+}
+
+TimeZoneInfo makeZone(const std::string& name, const std::string& countryCode,
+					  int offset, int dst, bool preferred)
+{
+	TimeZoneInfo zone;
+	zone.name = name;
+	zone.countryCode = countryCode;
+	zone.offsetToUTC = offset;
+	zone.dstSupported = dst;
+	zone.preferred = preferred;
+	zone.howManyZonesForCountry = 0;
+	return zone;
+}
+
+void checkTable()
+{
+	std::deque<TimeZoneInfo> storage;
+	MccZoneIndex::ZoneList zones;
+	for (size_t i = 0; i < sizeof(zoneTable) / sizeof(zoneTable[0]); ++i) {
+		const ZoneRow& row = zoneTable[i];
+		storage.push_back(makeZone(row.name, row.countryCode, row.offset, row.dst, row.preferred));
+		zones.push_back(&storage.back());
+	}
+
+	MccZoneIndex::MccZoneMap mccZones;
+	for (size_t i = 0; i < sizeof(mccTable) / sizeof(mccTable[0]); ++i) {
+		storage.push_back(makeZone("", mccTable[i].countryCode, 0, 0, false));
+		mccZones[mccTable[i].mcc] = &storage.back();
+	}
+
+	MccZoneIndex index;
+	index.build(zones, mccZones);
+
+	for (size_t i = 0; i < sizeof(caseTable) / sizeof(caseTable[0]); ++i) {
+		const Case& c = caseTable[i];
+		const TimeZoneInfo* zone = index.find(c.mcc, c.offset, c.dst);
+		const char* actual = zone ? zone->name.c_str() : NULL;
+
+		if ((actual == NULL) != (c.expected == NULL) ||
+			(actual && strcmp(actual, c.expected) != 0)) {
+			fprintf(stderr, "  mcc %d offset %d dst %d: expected %s, got %s\n",
+					c.mcc, c.offset, c.dst, c.expected ? c.expected : "none",
+					actual ? actual : "none");
+			Test::fail(__FILE__, __LINE__, "table case");
+		}
+	}
+}
+
+void checkGenerated(int catalogs)
+{
+	srand(1);
+
+	long cases = 0;
+	for (int n = 0; n < catalogs; ++n) {
+		std::deque<TimeZoneInfo> storage;
+		MccZoneIndex::ZoneList zones;
+		std::multimap<int,const TimeZoneInfo*> offsetZones;
+
+		int zoneCount = rand() % 40 + 1;
+		for (int i = 0; i < zoneCount; ++i) {
+			char name[32];
+			snprintf(name, sizeof(name), "Zone%d", i);
+			storage.push_back(makeZone(name, std::string(1, 'A' + rand() % 4),
+									   rand() % 4, rand() % 3, rand() % 3 == 0));
+			zones.push_back(&storage.back());
+			offsetZones.insert(std::make_pair(storage.back().offsetToUTC, &storage.back()));
+		}
+
+		// mcc 0-4 map to countries A-E (E has no zones), mcc 5 to none
+		MccZoneIndex::MccZoneMap mccZones;
+		for (int mcc = 0; mcc < 6; ++mcc) {
+			storage.push_back(makeZone("", mcc < 5 ? std::string(1, 'A' + mcc) : "", 0, 0, false));
+			mccZones[mcc] = &storage.back();
+		}
+
+		MccZoneIndex index;
+		index.build(zones, mccZones);
+
+		for (int mcc = 0; mcc < 7; ++mcc) {
+			for (int offset = -1; offset < 5; ++offset) {
+				for (int dst = -1; dst < 4; ++dst) {
+					++cases;
+					const TimeZoneInfo* expected = originalSelection(offsetZones, mccZones,
+																	 offset, dst, mcc);
+					if (index.find(mcc, offset, dst) != expected) {
+						fprintf(stderr, "  catalog %d: mcc %d offset %d dst %d differs\n",
+								n, mcc, offset, dst);
+						Test::fail(__FILE__, __LINE__, "generated case");
+					}
+				}
+			}
+		}
+	}
+	printf("%ld generated cases checked\n", cases);
+}
+
+} // namespace
+
+int main()
+{
+	checkTable();
+	checkGenerated(2000);
+
+	return Test::result("TestMccZoneIndex");
+}
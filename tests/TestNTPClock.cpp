@@ -0,0 +1,359 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestNTPClock.cpp
+ *
+ *  /time/getNTPTime requests handled by NTPClock::requestNTP() on
+ *  FakeLunaService and fake clock, answered by SntpStandIn on loopback:
+ *  requests which come while query is active join it (single packet, same
+ *  reply for all), answers from cache while "NTPCacheTimeout" (boot clock,
+ *  so suspend counts) hasn't passed, error replies and poll back-off when
+ *  server refuses or query can't even start.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <cjson/json.h>
+
+#include "FakeLunaService.h"
+#include "FakeTimeClock.h"
+#include "NTPClock.h"
+#include "PrefsDb.h"
+#include "SntpStandIn.h"
+#include "TestUtils.h"
+#include "TimePrefsHandler.h"
+
+extern GMainLoop* g_gmainLoop;
+
+namespace {
+	// 2022-01-01 00:00:00 UTC
+	const time_t start = 1640995200;
+
+	// fraction keeps both rounding of replies and truncation of cached
+	// time away from second boundaries
+	const int64_t serverOffsetNs = 7 * FakeTimeClock::nsecPerSec + 250 * FakeTimeClock::nsecPerMs;
+
+	// real time limit for a single query, guards against hanging forever
+	const guint guardMs = 5000;
+
+	const char* const errorText = "Failed to get NTP time response";
+
+	/**
+	 * Reply to /time/getNTPTime
+	 */
+	struct Reply
+	{
+		Reply() : returnValue(false), utc(0) {}
+
+		bool returnValue;
+		long utc;
+		std::string errorText;
+	};
+
+	/**
+	 * "ntp" clock posts of TimePrefsHandler
+	 */
+	struct ClockChanges : public Trackable
+	{
+		ClockChanges() : count(0), offset(0) {}
+
+		void changed(int64_t value, const std::string& source, time_t)
+		{
+			if (source != "ntp")
+				return;
+			++count;
+			offset = value;
+		}
+
+		int     count;
+		int64_t offset;
+	};
+
+	bool cbGetNTPTime(LSHandle*, LSMessage* message, void* data)
+	{
+		return static_cast<NTPClock*>(data)->requestNTP(message);
+	}
+
+	LSMessage* request(NTPClock& ntp)
+	{
+		return FakeLunaService::invoke(cbGetNTPTime, "{}", &ntp);
+	}
+
+	/**
+	 * Single reply to message (returnValue false if none or more than one)
+	 */
+	Reply reply(LSMessage* message)
+	{
+		Reply result;
+		const std::vector<std::string>& replies = FakeLunaService::replies(message);
+		CHECK_EQUAL(replies.size(), (size_t) 1);
+		if (replies.size() != 1)
+			return result;
+
+		json_object* root = json_tokener_parse(replies[0].c_str());
+		CHECK(root && !is_error(root));
+		if (!root || is_error(root))
+			return result;
+		json_object* label = json_object_object_get(root, "returnValue");
+		result.returnValue = label && json_object_get_boolean(label);
+		label = json_object_object_get(root, "utc");
+		if (label)
+			result.utc = json_object_get_int(label);
+		label = json_object_object_get(root, "errorText");
+		if (label)
+			result.errorText = json_object_get_string(label);
+		json_object_put(root);
+		return result;
+	}
+
+	gboolean cbGuard(gpointer data)
+	{
+		*static_cast<bool*>(data) = true;
+		return FALSE;
+	}
+
+	/**
+	 * Run main loop until query finished (or guard expired)
+	 */
+	void wait(const NTPClock& ntp)
+	{
+		bool expired = false;
+		guint guard = g_timeout_add(guardMs, cbGuard, &expired);
+		while (ntp.sntpClient.isActive() && !expired)
+			g_main_context_iteration(NULL, TRUE);
+		if (!expired)
+			g_source_remove(guard);
+		CHECK(!expired);
+	}
+
+	// NTP time as server (and so cache) has it, in whole seconds
+	long serverSeconds(const FakeTimeClock& clock)
+	{
+		return (clock.wallNs() + serverOffsetNs) / FakeTimeClock::nsecPerSec;
+	}
+
+	void testCoalescing(FakeTimeClock& clock, SntpStandIn& server, NTPClock& ntp)
+	{
+		ClockChanges changes;
+		TimePrefsHandler::instance()->deprecatedClockChange.connect(&changes, &ClockChanges::changed);
+
+		// all requests made before answer wait for the same query
+		LSMessage* first = request(ntp);
+		LSMessage* second = request(ntp);
+		LSMessage* third = request(ntp);
+		CHECK(ntp.sntpClient.isActive());
+		CHECK_EQUAL(ntp.stats.requests, 3u);
+		CHECK_EQUAL(ntp.stats.queries, 1u);
+		CHECK_EQUAL(ntp.stats.coalesced, 2u);
+		CHECK_EQUAL(ntp.stats.cacheHits, 0u);
+		CHECK_EQUAL(ntp.requestMessages.size(), (size_t) 3);
+		CHECK(FakeLunaService::replies(first).empty());
+
+		wait(ntp);
+		CHECK_EQUAL(server.requests, 1);
+		CHECK(ntp.requestMessages.empty());
+
+		long utc = clock.wallSeconds() + 7;
+		LSMessage* const messages[] = { first, second, third };
+		for (size_t i = 0; i < sizeof(messages)/sizeof(messages[0]); ++i)
+		{
+			Reply answer = reply(messages[i]);
+			CHECK(answer.returnValue);
+			CHECK_EQUAL(answer.utc, utc);
+		}
+
+		// offset itself goes to "ntp" clock once
+		CHECK_EQUAL(changes.count, 1);
+		CHECK(llabs(changes.offset - serverOffsetNs) <= 2);
+		CHECK(ntp.haveSample);
+		CHECK_EQUAL(ntp.pollScheduler.failures(), 0u);
+	}
+
+	void testCache(FakeTimeClock& clock, SntpStandIn& server, NTPClock& ntp)
+	{
+		NTPClock::Stats before = ntp.stats;
+
+		// answered right away, extrapolated with time passed since sample
+		Reply answer = reply(request(ntp));
+		CHECK(answer.returnValue);
+		CHECK_EQUAL(answer.utc, serverSeconds(clock));
+
+		clock.advance(30500);
+		answer = reply(request(ntp));
+		CHECK(answer.returnValue);
+		CHECK_EQUAL(answer.utc, serverSeconds(clock));
+
+		CHECK(!ntp.sntpClient.isActive());
+		CHECK_EQUAL(server.requests, 1);
+		CHECK_EQUAL(ntp.stats.requests, before.requests + 2);
+		CHECK_EQUAL(ntp.stats.cacheHits, before.cacheHits + 2);
+		CHECK_EQUAL(ntp.stats.queries, before.queries);
+
+		// suspend counts towards default timeout of 60 s
+		clock.suspend(29000);
+		answer = reply(request(ntp));
+		CHECK_EQUAL(answer.utc, serverSeconds(clock));
+		clock.suspend(500);
+		LSMessage* expired = request(ntp);
+		CHECK(ntp.sntpClient.isActive());
+		CHECK(FakeLunaService::replies(expired).empty());
+		CHECK_EQUAL(ntp.stats.cacheHits, before.cacheHits + 3);
+		CHECK_EQUAL(ntp.stats.queries, before.queries + 1);
+
+		wait(ntp);
+		CHECK_EQUAL(server.requests, 2);
+		answer = reply(expired);
+		CHECK(answer.returnValue);
+		CHECK_EQUAL(answer.utc, clock.wallSeconds() + 7);
+
+		// timeout read when sample is taken, 0 turns cache off
+		CHECK(PrefsDb::instance()->setPref("NTPCacheTimeout", "0"));
+		CHECK(reply(request(ntp)).returnValue);
+		CHECK_EQUAL(ntp.stats.queries, before.queries + 1);
+
+		clock.advance(10000);
+		CHECK(reply(request(ntp)).returnValue);
+		CHECK_EQUAL(ntp.stats.queries, before.queries + 1);
+
+		clock.advance(50000);
+		LSMessage* uncached = request(ntp);
+		CHECK(ntp.sntpClient.isActive());
+		wait(ntp);
+		CHECK(reply(uncached).returnValue);
+		CHECK_EQUAL(server.requests, 3);
+
+		LSMessage* again = request(ntp);
+		CHECK(ntp.sntpClient.isActive());
+		CHECK(FakeLunaService::replies(again).empty());
+		wait(ntp);
+		CHECK(reply(again).returnValue);
+		CHECK_EQUAL(server.requests, 4);
+		CHECK_EQUAL(ntp.stats.cacheHits, before.cacheHits + 5);
+		CHECK_EQUAL(ntp.stats.queries, before.queries + 3);
+	}
+
+	void testRefused(FakeTimeClock& clock, SntpStandIn& server, NTPClock& ntp)
+	{
+		NTPClock::Stats before = ntp.stats;
+		server.mode = SntpStandIn::KissOfDeath;
+
+		// cache is off (timeout 0), so both wait for refused query
+		LSMessage* first = request(ntp);
+		LSMessage* second = request(ntp);
+		wait(ntp);
+
+		Reply answer = reply(first);
+		CHECK(!answer.returnValue);
+		CHECK_EQUAL(answer.errorText, std::string(errorText));
+		answer = reply(second);
+		CHECK(!answer.returnValue);
+		CHECK(ntp.requestMessages.empty());
+
+		CHECK_EQUAL(ntp.stats.queries, before.queries + 1);
+		CHECK_EQUAL(ntp.stats.failures, before.failures + 1);
+		CHECK_EQUAL(ntp.pollScheduler.failures(), 1u);
+		CHECK_EQUAL(ntp.pollScheduler.nextPollIn(), (time_t) 60);
+
+		server.mode = SntpStandIn::Answer;
+	}
+
+	void testStartFailure(FakeTimeClock& clock, SntpStandIn& server, NTPClock& ntp)
+	{
+		NTPClock::Stats before = ntp.stats;
+		int packets = server.requests;
+
+		// separators only: no server to query
+		CHECK(PrefsDb::instance()->setPref("NTPServer", " , "));
+
+		LSMessage* message = request(ntp);
+		CHECK(!ntp.sntpClient.isActive());
+
+		// rejected right away, counted as failed query
+		Reply answer = reply(message);
+		CHECK(!answer.returnValue);
+		CHECK_EQUAL(answer.errorText, std::string(errorText));
+		CHECK(ntp.requestMessages.empty());
+		CHECK_EQUAL(ntp.stats.queries, before.queries + 1);
+		CHECK_EQUAL(ntp.stats.failures, before.failures + 1);
+
+		// back-off keeps doubling as for queries without answer
+		CHECK_EQUAL(ntp.pollScheduler.failures(), 2u);
+		CHECK_EQUAL(ntp.pollScheduler.nextPollIn(), (time_t) 120);
+
+		clock.advance(1000);
+		CHECK(!ntp.requestNTP());
+		CHECK_EQUAL(ntp.stats.queries, before.queries + 2);
+		CHECK_EQUAL(ntp.stats.failures, before.failures + 2);
+		CHECK_EQUAL(ntp.pollScheduler.failures(), 3u);
+		CHECK_EQUAL(ntp.pollScheduler.nextPollIn(), (time_t) 240);
+		CHECK_EQUAL(server.requests, packets);
+
+		// good answer ends back-off
+		CHECK(PrefsDb::instance()->setPref("NTPServer", "127.0.0.1"));
+		CHECK(ntp.requestNTP());
+		wait(ntp);
+		CHECK_EQUAL(ntp.pollScheduler.failures(), 0u);
+		CHECK_EQUAL(server.requests, packets + 1);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	char dirTemplate[] = "/tmp/TestNTPClock.XXXXXX";
+	const char* dir = mkdtemp(dirTemplate);
+	CHECK(dir != NULL);
+	if (!dir)
+		return Test::result("TestNTPClock");
+
+	std::string prefsDbPath = std::string(dir) + "/systemprefs.db";
+	std::string localTimePath = std::string(dir) + "/localtime";
+	PrefsDb::s_prefsDbPath = prefsDbPath.c_str();
+	TimePrefsHandler::setLocalTimeFile(localTimePath.c_str());
+
+	FakeTimeClock clock(start);
+	TimeClock::setInstance(&clock);
+	g_gmainLoop = g_main_loop_new(NULL, FALSE);
+
+	SntpStandIn server(clock, "127.0.0.1");
+	CHECK(server.isValid());
+	server.offsetNs = serverOffsetNs;
+	NTPClock::setServerPort(server.port());
+
+	// automatic polls of service's own NTPClock stay off (no AllowNTPTime)
+	TimePrefsHandler* handler = new TimePrefsHandler(FakeLunaService::service());
+	CHECK(PrefsDb::instance()->setPref("NTPServer", "127.0.0.1"));
+
+	NTPClock ntp(*handler);
+	testCoalescing(clock, server, ntp);
+	testCache(clock, server, ntp);
+	testRefused(clock, server, ntp);
+	testStartFailure(clock, server, ntp);
+
+	TimeClock::setInstance(NULL);
+
+	unlink(prefsDbPath.c_str());
+	unlink(localTimePath.c_str());
+	rmdir(dir);
+
+	return Test::result("TestNTPClock");
+}
@@ -0,0 +1,297 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestNTPPollScheduler.cpp
+ *
+ *  NTP poll scheduler simulated over days of fake time: drift estimation,
+ *  poll interval following drift changes, error bound at polls and
+ *  backoff while server is down.
+ *
+ *  Usage: TestNTPPollScheduler [-v] [trace]
+ *  (-v prints transitions and CPU time per event, trace replaces built-in
+ *  one; see TimeReplay.h for format)
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "FakeTimeClock.h"
+#include "NTPPollScheduler.h"
+#include "TestUtils.h"
+#include "TimeReplay.h"
+
+namespace {
+	const time_t traceStart = 1400000000;
+
+	// same as TimePrefsHandler
+	const time_t minPollInterval = 300;
+	const time_t maxPollInterval = 86399;
+	const time_t minWakeupInterval = 60;
+	const int64_t slewThreshold = 128 * FakeTimeClock::nsecPerMs;
+
+	/*
+	 * Events of trace (besides "suspend"):
+	 *
+	 *   server up|down                    NTP server reachable or not
+	 *   drift <ppm>                       drift of system clock
+	 *   expire                            system time set from other source
+	 *   expect-drift <ppm> <tolerance>    drift estimated by scheduler
+	 *   expect-interval <min> <max>       current poll interval (s)
+	 *   expect-error <ms>                 bound of offsets seen at polls
+	 *                                     since last check
+	 *   expect-polls <min> <max>          polls since last check
+	 */
+	const char* const builtinTrace =
+		"# clock runs 20 ppm fast: polls at min interval until drift is\n"
+		"# known, then interval doubles up to tolerance / drift (3200 s)\n"
+		"0       drift 20\n"
+		"0       server up\n"
+		"20000   expect-drift -20 0.1\n"
+		"20000   expect-interval 3150 3200\n"
+		"20000   expect-error 65\n"
+		"60000   expect-error 65\n"
+		"60000   expect-polls 20 23\n"
+		"# drift changes (e.g. warm-up): estimation restarts, interval\n"
+		"# shrinks right away and error is back within tolerance\n"
+		"60000   drift -30\n"
+		"70000   expect-drift 30 0.1\n"
+		"70000   expect-interval 2100 2134\n"
+		"70000   expect-error 100\n"
+		"110000  expect-error 65\n"
+		"# stable clock: interval grows up to max\n"
+		"110000  drift 0.1\n"
+		"400000  expect-drift -0.1 0.05\n"
+		"400000  expect-interval 86399 86399\n"
+		"400000  expect-error 65\n"
+		"# suspend doesn't delay poll (boot time is counted)\n"
+		"400000  expect-polls 1 100\n"
+		"400000  suspend 90000\n"
+		"490100  expect-polls 1 1\n"
+		"# server down: retries back off from 60 s doubling each time\n"
+		"500000  server down\n"
+		"500000  expire\n"
+		"600000  expect-polls 11 11\n"
+		"600000  server up\n"
+		"625000  expect-polls 1 1\n"
+		"625000  expect-drift -0.1 0.05\n"
+		"625000  expect-error 65\n";
+
+	class Simulation : public TimeReplay
+	{
+	public:
+		Simulation(FakeTimeClock& clock) :
+			TimeReplay(clock, traceStart),
+			m_source(NULL),
+			m_serverUp(false),
+			m_polls(0),
+			m_maxError(0)
+		{
+			m_scheduler.setLimits(minPollInterval, maxPollInterval);
+		}
+
+		~Simulation()
+		{
+			stop();
+		}
+
+	protected:
+		virtual bool handle(const Event& event)
+		{
+			const std::vector<std::string>& args = event.args;
+			if (event.name == "server" && args.size() == 1)
+			{
+				m_serverUp = (args[0] == "up");
+				transition(m_serverUp ? "server up" : "server down");
+				schedule();
+				return true;
+			}
+			if (event.name == "drift" && args.size() == 1)
+			{
+				m_clock.setDrift(atof(args[0].c_str()));
+				return true;
+			}
+			if (event.name == "expire" && args.empty())
+			{
+				m_scheduler.expire();
+				schedule();
+				return true;
+			}
+			if (event.name == "expect-drift" && args.size() == 2)
+			{
+				double drift = atof(args[0].c_str());
+				if (!m_scheduler.hasDrift() || fabs(m_scheduler.drift() - drift) > atof(args[1].c_str()))
+					failAt(event, "drift %.3f ppm", m_scheduler.hasDrift() ? m_scheduler.drift() : NAN);
+				return true;
+			}
+			if (event.name == "expect-interval" && args.size() == 2)
+			{
+				time_t interval = m_scheduler.interval();
+				if (interval < atol(args[0].c_str()) || interval > atol(args[1].c_str()))
+					failAt(event, "interval %ld s", (long) interval);
+				return true;
+			}
+			if (event.name == "expect-error" && args.size() == 1)
+			{
+				if (m_maxError > atoll(args[0].c_str()) * FakeTimeClock::nsecPerMs)
+					failAt(event, "error %.3f ms at poll", m_maxError / 1e6);
+				m_maxError = 0;
+				return true;
+			}
+			if (event.name == "expect-polls" && args.size() == 2)
+			{
+				if (m_polls < atoi(args[0].c_str()) || m_polls > atoi(args[1].c_str()))
+					failAt(event, "%d polls", m_polls);
+				m_polls = 0;
+				return true;
+			}
+			return false;
+		}
+
+		virtual void resumed()
+		{
+			schedule();
+		}
+
+	private:
+		void failAt(const Event& event, const char* format, ...)
+		{
+			char what[128];
+			va_list args;
+			va_start(args, format);
+			vsnprintf(what, sizeof(what), format, args);
+			va_end(args);
+			fprintf(stderr, "trace line %d (%s): %s\n", event.line, event.name.c_str(), what);
+			Test::fail(__FILE__, __LINE__, "trace expectation");
+		}
+
+		void stop()
+		{
+			if (m_source)
+			{
+				g_source_destroy(m_source);
+				g_source_unref(m_source);
+				m_source = NULL;
+			}
+		}
+
+		// TimePrefsHandler::setPeriodicTimeSetWakeup() in short
+		void schedule()
+		{
+			stop();
+			time_t pollIn = m_scheduler.nextPollIn();
+			if (pollIn < minWakeupInterval && !m_scheduler.isPollDue())
+				pollIn = minWakeupInterval;
+
+			m_source = TimeClock::instance()->createTimeout(pollIn * 1000, true);
+			g_source_set_callback(m_source, cbPoll, this, NULL);
+			g_source_attach(m_source, NULL);
+		}
+
+		static gboolean cbPoll(gpointer data)
+		{
+			Simulation* simulation = static_cast<Simulation*>(data);
+			g_source_unref(simulation->m_source);
+			simulation->m_source = NULL;
+			simulation->poll();
+			return FALSE;
+		}
+
+		void poll()
+		{
+			if (!m_scheduler.isPollDue())
+			{
+				schedule();
+				return;
+			}
+
+			++m_polls;
+			if (!m_serverUp)
+			{
+				m_scheduler.failed();
+				transition("poll failed");
+				schedule();
+				return;
+			}
+
+			int64_t offset = referenceNs() - m_clock.wallNs();
+			if (llabs(offset) > m_maxError)
+				m_maxError = llabs(offset);
+			m_scheduler.sampled(offset);
+			correct(offset);
+
+			char what[64];
+			snprintf(what, sizeof(what), "poll: offset %.3f ms, next in %ld s",
+			         offset / 1e6, (long) m_scheduler.interval());
+			transition(what);
+			schedule();
+		}
+
+		// TimePrefsHandler::systemSetTime() in short
+		void correct(int64_t offset)
+		{
+			struct timespec remaining = { 0, 0 };
+			struct timespec delta;
+			if (llabs(offset) < slewThreshold)
+			{
+				FakeTimeClock::toTimespec(offset, delta);
+				m_clock.slewWallTime(delta, &remaining);
+			}
+			else
+			{
+				struct timespec none = { 0, 0 };
+				m_clock.slewWallTime(none, &remaining);
+				FakeTimeClock::toTimespec(m_clock.wallNs() + offset, delta);
+				m_clock.setWallTime(delta);
+			}
+			m_scheduler.corrected(offset - ((int64_t) remaining.tv_sec * FakeTimeClock::nsecPerSec + remaining.tv_nsec));
+		}
+
+	private:
+		NTPPollScheduler m_scheduler;
+		GSource*         m_source;
+		bool             m_serverUp;
+		int              m_polls;
+		int64_t          m_maxError;	// ns
+	};
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+	const char* tracePath = argc > (verbose ? 2 : 1) ? argv[verbose ? 2 : 1] : NULL;
+
+	FakeTimeClock clock(traceStart);
+	TimeClock::setInstance(&clock);
+
+	{
+		Simulation simulation(clock);
+		CHECK(tracePath ? simulation.load(tracePath) : simulation.parse(builtinTrace));
+		CHECK(simulation.run());
+		if (verbose)
+			simulation.report(stdout);
+	}
+
+	TimeClock::setInstance(NULL);
+	return Test::result("TestNTPPollScheduler");
+}
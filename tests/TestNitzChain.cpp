@@ -0,0 +1,418 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestNitzChain.cpp
+ *
+ *  Replay of NITZ messages through TimePrefsHandler::cbSetSystemNetworkTime
+ *  (s_nitzChain) and its timeout cycle (s_timeoutNitzChain) on a fake bus
+ *  and clock: resulting zone and system time, nitzPrefFlags() kept until
+ *  generation of PrefsDb changes, zone not re-applied when a message
+ *  confirms current one, dst decided by timeout chain only (dst and exit
+ *  handlers of message chain did nothing and are gone) and step costs.
+ */
+
+#include <glib.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <cjson/json.h>
+
+#include "ClockHandler.h"
+#include "FakeLunaService.h"
+#include "FakeTimeClock.h"
+#include "PrefsDb.h"
+#include "Settings.h"
+#include "TestUtils.h"
+#include "TimePrefsHandler.h"
+#include "TimeZoneCatalog.h"
+#include "TzPack.h"
+
+extern GMainLoop* g_gmainLoop;
+
+namespace {
+	// 2021-03-26 12:00:00 UTC
+	const time_t start = 1616760000;
+
+	// TIMEOUT_INTERVAL_SEC and bootstrap cycle delay of TimePrefsHandler
+	const int64_t timeoutIntervalMs = 5 * 1000;
+	const int64_t bootstrapDelayMs = 20 * 1000;
+
+	const char* const setPreferences = "luna://com.palm.systemservice/setPreferences";
+	const char* const timeUpdate = "{\"receiveNetworkTimeUpdate\":true}";
+	const char* const zoneUpdate = "{\"receiveNetworkTimezoneUpdate\":true}";
+
+	const char* const catalog =
+		"{\"timeZone\":["
+		"{\"Country\":\"Finland\",\"CountryCode\":\"fi\",\"ZoneID\":\"Europe/Helsinki\","
+		"\"City\":\"Helsinki\",\"offsetFromUTC\":120,\"supportsDST\":1,\"preferred\":true},"
+		"{\"Country\":\"France\",\"CountryCode\":\"fr\",\"ZoneID\":\"Europe/Paris\","
+		"\"City\":\"Paris\",\"offsetFromUTC\":60,\"supportsDST\":1,\"preferred\":true},"
+		"{\"Country\":\"Spain\",\"CountryCode\":\"es\",\"ZoneID\":\"Europe/Madrid\","
+		"\"City\":\"Madrid\",\"offsetFromUTC\":60,\"supportsDST\":1},"
+		"{\"Country\":\"United Kingdom\",\"CountryCode\":\"gb\",\"ZoneID\":\"Europe/London\","
+		"\"City\":\"London\",\"offsetFromUTC\":0,\"supportsDST\":1,\"preferred\":true,\"default\":true},"
+		"{\"Country\":\"United States\",\"CountryCode\":\"us\",\"ZoneID\":\"America/New_York\","
+		"\"City\":\"New York\",\"offsetFromUTC\":-300,\"supportsDST\":1,\"preferred\":true},"
+		"{\"Country\":\"Colombia\",\"CountryCode\":\"co\",\"ZoneID\":\"America/Bogota\","
+		"\"City\":\"Bogota\",\"offsetFromUTC\":-300,\"supportsDST\":0,\"preferred\":true}],"
+		"\"syszones\":["
+		"{\"ZoneID\":\"Etc/GMT-2\",\"offsetFromUTC\":120},"
+		"{\"ZoneID\":\"Etc/GMT-3\",\"offsetFromUTC\":180}],"
+		"\"mccInfo\":["
+		"{\"mcc\":244,\"CountryCode\":\"fi\",\"ZoneID\":\"Europe/Helsinki\","
+		"\"offsetFromUTC\":120,\"supportsDST\":1}]}";
+
+	std::string s_dir;
+	std::string s_prefsDbPath;
+	std::string s_localTimePath;
+	std::string s_journalPath;
+
+	int s_messages = 0;
+
+	/**
+	 * NITZ message as telephony service sends it (fields of time are those
+	 * of struct tm)
+	 */
+	struct Nitz
+	{
+		time_t utc;
+		int offset;		// minutes
+		int dst;
+		int mcc;
+		bool tzvalid;
+		bool timevalid;
+		bool dstvalid;
+		bool tilIgnore;
+	};
+
+	// time already set by TIL, zone given
+	Nitz zoneMessage(int offset, int dst, int mcc)
+	{
+		Nitz nitz = { TimeClock::instance()->wallSeconds(), offset, dst, mcc, true, true, true, false };
+		return nitz;
+	}
+
+	std::string payload(const Nitz& nitz)
+	{
+		struct tm tm;
+		gmtime_r(&nitz.utc, &tm);
+
+		char text[512];
+		snprintf(text, sizeof(text),
+				 "{\"sec\":\"%d\",\"min\":\"%d\",\"hour\":\"%d\",\"mday\":\"%d\",\"mon\":\"%d\","
+				 "\"year\":\"%d\",\"offset\":\"%d\",\"mcc\":\"%d\",\"mnc\":\"1\",\"tzvalid\":%s,"
+				 "\"timevalid\":%s,\"dstvalid\":%s,\"dst\":%d,\"timestamp\":\"%ld\",\"tilIgnore\":%s}",
+				 tm.tm_sec, tm.tm_min, tm.tm_hour, tm.tm_mday, tm.tm_mon, tm.tm_year,
+				 nitz.offset, nitz.mcc, nitz.tzvalid ? "true" : "false",
+				 nitz.timevalid ? "true" : "false", nitz.dstvalid ? "true" : "false", nitz.dst,
+				 (long) TimeClock::instance()->monotonicSeconds(), nitz.tilIgnore ? "true" : "false");
+		return text;
+	}
+
+	bool returnValue(const std::string& reply)
+	{
+		json_object* root = json_tokener_parse(reply.c_str());
+		if (!root || is_error(root))
+			return false;
+		json_object* label = json_object_object_get(root, "returnValue");
+		bool result = label && json_object_get_boolean(label);
+		json_object_put(root);
+		return result;
+	}
+
+	/**
+	 * Send message to /time/setSystemNetworkTime
+	 *
+	 * @return returnValue of reply
+	 */
+	bool send(const Nitz& nitz)
+	{
+		++s_messages;
+		return returnValue(FakeLunaService::call("/time", "setSystemNetworkTime", payload(nitz)));
+	}
+
+	// let timeout cycle started by messages run its chain
+	void runTimeout(FakeTimeClock& clock)
+	{
+		clock.advance(3 * timeoutIntervalMs);
+	}
+
+	std::string currentZone()
+	{
+		const TimeZoneInfo* zone = TimePrefsHandler::instance()->currentTimeZone();
+		return zone ? zone->name : std::string();
+	}
+
+	std::string zonePref()
+	{
+		return TimePrefsHandler::tzNameFromJsonString(PrefsDb::instance()->getPref("timeZone"));
+	}
+
+	// as other process (not through PrefsDb of service) would write it
+	bool writePrefBehindService(const char* key, const char* value)
+	{
+		sqlite3* db = NULL;
+		if (sqlite3_open(s_prefsDbPath.c_str(), &db) != SQLITE_OK)
+			return false;
+		char* query = sqlite3_mprintf("INSERT INTO Preferences VALUES (%Q, %Q)", key, value);
+		bool ok = sqlite3_exec(db, query, NULL, NULL, NULL) == SQLITE_OK;
+		sqlite3_free(query);
+		sqlite3_close(db);
+		return ok;
+	}
+
+	bool writeFile(const std::string& path, const char* content)
+	{
+		FILE* file = fopen(path.c_str(), "w");
+		if (!file)
+			return false;
+		bool ok = fputs(content, file) >= 0;
+		return fclose(file) == 0 && ok;
+	}
+
+	void testTime(FakeTimeClock& clock)
+	{
+		FakeLunaService::clearCalls();
+
+		// time from NITZ (TIL left it to us) is applied through ClockHandler
+		Nitz nitz = { clock.wallSeconds() + 90, 0, 0, 0, false, false, false, true };
+		CHECK(send(nitz));
+		CHECK(labs((long) (clock.wallSeconds() - nitz.utc)) <= 1);
+		CHECK_EQUAL(FakeLunaService::countCalls(setPreferences, timeUpdate), (size_t) 1);
+		CHECK_EQUAL(FakeLunaService::countCalls(setPreferences, zoneUpdate), (size_t) 0);
+
+		// time already set by TIL is only reported
+		time_t before = clock.wallSeconds();
+		Nitz tilSet = { before + 3600, 0, 0, 0, false, true, false, false };
+		CHECK(send(tilSet));
+		CHECK(labs((long) (clock.wallSeconds() - before)) <= 1);
+		CHECK_EQUAL(FakeLunaService::countCalls(setPreferences, timeUpdate), (size_t) 2);
+
+		runTimeout(clock);
+	}
+
+	void testZone(FakeTimeClock& clock)
+	{
+		FakeLunaService::clearCalls();
+
+		unsigned int generation = PrefsDb::instance()->generation();
+		CHECK(send(zoneMessage(120, 0, 244)));
+		CHECK_EQUAL(currentZone(), std::string("Europe/Helsinki"));
+		CHECK_EQUAL(zonePref(), std::string("Europe/Helsinki"));
+		CHECK(PrefsDb::instance()->generation() != generation);
+		CHECK_EQUAL(FakeLunaService::countCalls(setPreferences, zoneUpdate), (size_t) 1);
+
+		// confirmation of current zone doesn't set it again (nor write
+		// timeZone preference) but is still reported
+		generation = PrefsDb::instance()->generation();
+		CHECK(send(zoneMessage(120, 0, 244)));
+		CHECK_EQUAL(currentZone(), std::string("Europe/Helsinki"));
+		CHECK_EQUAL(PrefsDb::instance()->generation(), generation);
+		CHECK_EQUAL(FakeLunaService::countCalls(setPreferences, zoneUpdate), (size_t) 2);
+
+		// France sends 120 for summer time
+		CHECK(send(zoneMessage(120, 0, 208)));
+		CHECK_EQUAL(currentZone(), std::string("Europe/Paris"));
+
+		// preferred zone for offset and dst without MCC
+		CHECK(send(zoneMessage(-300, 0, 0)));
+		CHECK_EQUAL(currentZone(), std::string("America/Bogota"));
+		CHECK(send(zoneMessage(-300, 1, 0)));
+		CHECK_EQUAL(currentZone(), std::string("America/New_York"));
+
+		// no zone and generic ones not allowed: failsafe zone
+		CHECK(send(zoneMessage(180, 0, 0)));
+		CHECK_EQUAL(currentZone(), std::string("Etc/GMT-0"));
+
+		runTimeout(clock);
+	}
+
+	void testPrefFlagsCache(FakeTimeClock& clock)
+	{
+		CHECK(send(zoneMessage(120, 0, 244)));
+		CHECK_EQUAL(currentZone(), std::string("Europe/Helsinki"));
+
+		// flags read by this message are kept while PrefsDb doesn't change
+		CHECK(send(zoneMessage(120, 0, 244)));
+		CHECK(writePrefBehindService("AllowGenericTimezones", "true"));
+
+		CHECK(send(zoneMessage(180, 0, 0)));
+		CHECK_EQUAL(currentZone(), std::string("Etc/GMT-0"));
+
+		// that message wrote timeZone, so next one reads flags again
+		CHECK(send(zoneMessage(180, 0, 0)));
+		CHECK_EQUAL(currentZone(), std::string("Etc/GMT-3"));
+
+		// preferences written by service are picked up right away
+		CHECK(PrefsDb::instance()->setPref("AllowGenericTimezones", "false"));
+		CHECK(send(zoneMessage(120, 0, 244)));
+		CHECK(send(zoneMessage(180, 0, 0)));
+		CHECK_EQUAL(currentZone(), std::string("Etc/GMT-0"));
+
+		runTimeout(clock);
+	}
+
+	void testTimeoutChain(FakeTimeClock& clock)
+	{
+		TimePrefsHandler* handler = TimePrefsHandler::instance();
+
+		// invalid dst is accepted by timeout chain, message chain leaves it
+		Nitz noDst = zoneMessage(60, 1, 0);
+		noDst.dstvalid = false;
+		handler->clearLastNITZValidity();
+		CHECK(send(noDst));
+		CHECK_EQUAL(currentZone(), std::string("Europe/Paris"));
+		CHECK_EQUAL(handler->getLastNITZValidity(), (int) TimePrefsHandler::NITZ_Unknown);
+		runTimeout(clock);
+		CHECK_EQUAL(handler->getLastNITZValidity(), (int) TimePrefsHandler::NITZ_Valid);
+
+		// ...unless dst errors are strict
+		CHECK(PrefsDb::instance()->setPref(".sysservice-time-strictDstErrors", "true"));
+		handler->clearLastNITZValidity();
+		CHECK(send(noDst));
+		runTimeout(clock);
+		CHECK_EQUAL(handler->getLastNITZValidity(), (int) TimePrefsHandler::NITZ_Invalid);
+		CHECK(PrefsDb::instance()->setPref(".sysservice-time-strictDstErrors", "false"));
+
+		// valid dst from message skips dst step of timeout chain
+		handler->clearLastNITZValidity();
+		CHECK(send(zoneMessage(60, 1, 0)));
+		runTimeout(clock);
+		CHECK_EQUAL(handler->getLastNITZValidity(), (int) TimePrefsHandler::NITZ_Valid);
+
+		// zone of MCC is picked by timeout chain if message had no offset
+		CHECK(PrefsDb::instance()->setPref("AllowMCCAssistedTimezones", "true"));
+		Nitz mccOnly = zoneMessage(0, 0, 244);
+		mccOnly.tzvalid = false;
+		CHECK(send(mccOnly));
+		CHECK_EQUAL(currentZone(), std::string("Europe/Paris"));
+		runTimeout(clock);
+		CHECK_EQUAL(currentZone(), std::string("Europe/Helsinki"));
+		CHECK(PrefsDb::instance()->setPref("AllowMCCAssistedTimezones", "false"));
+	}
+
+	/**
+	 * Runs of NITZ steps reported by getSyncStats (-1 if step isn't there)
+	 */
+	int stepRuns(json_object* steps, const char* name)
+	{
+		json_object* step = json_object_object_get(steps, name);
+		if (!step)
+			return -1;
+		return json_object_get_int(json_object_object_get(step, "runs"));
+	}
+
+	void testStepCosts(int messages)
+	{
+		std::string reply = FakeLunaService::call("/time", "getSyncStats", "{}");
+		json_object* root = json_tokener_parse(reply.c_str());
+		CHECK(root && !is_error(root));
+		if (!root || is_error(root))
+			return;
+
+		json_object* nitz = json_object_object_get(root, "nitz");
+		json_object* steps = nitz ? json_object_object_get(nitz, "steps") : NULL;
+		CHECK(steps != NULL);
+		if (steps) {
+			// every message ran all steps of its chain
+			CHECK_EQUAL(stepRuns(steps, "entry"), messages);
+			CHECK_EQUAL(stepRuns(steps, "time"), messages);
+			CHECK_EQUAL(stepRuns(steps, "offset"), messages);
+			CHECK(stepRuns(steps, "timeout-entry") > 0);
+			CHECK_EQUAL(stepRuns(steps, "timeout-dst"), stepRuns(steps, "timeout-entry"));
+			CHECK_EQUAL(stepRuns(steps, "dst"), -1);
+			CHECK_EQUAL(stepRuns(steps, "exit"), -1);
+		}
+		json_object_put(root);
+	}
+
+	// ClockHandler bound to TimePrefsHandler as Main.cpp does it
+	void setupClockHandler(ClockHandler& clockHandler)
+	{
+		TimePrefsHandler* handler = TimePrefsHandler::instance();
+		clockHandler.manualOverride(handler->isManualTimeUsed());
+		handler->systemTimeChanged.connect(&clockHandler, &ClockHandler::adjust);
+		handler->isManualTimeChanged.connect(&clockHandler, &ClockHandler::manualOverride);
+		handler->deprecatedClockChange.connectVoid(&clockHandler, &ClockHandler::update);
+		clockHandler.clockChanged.connect(handler, &TimePrefsHandler::clockChanged);
+
+		const TimePrefsHandler::TimeSources& sources = handler->timeSources();
+		for (size_t i = 0; i < sources.size(); ++i)
+			clockHandler.setup(sources[i], sources.size() - i);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	char dirTemplate[] = "/tmp/TestNitzChain.XXXXXX";
+	const char* dir = mkdtemp(dirTemplate);
+	CHECK(dir != NULL);
+	if (!dir)
+		return Test::result("TestNitzChain");
+	s_dir = dir;
+
+	// zone data, preferences and files of service in temporary directory
+	std::string catalogPath = s_dir + "/timezones.json";
+	std::string packPath = s_dir + "/tzdata.pack";
+	std::string errorText;
+	CHECK(writeFile(catalogPath, catalog));
+	CHECK(TzPack::build("/usr/share/zoneinfo", catalogPath.c_str(), packPath.c_str(), errorText));
+	Settings::settings()->m_zonePackFile = packPath;
+
+	s_prefsDbPath = s_dir + "/systemprefs.db";
+	s_localTimePath = s_dir + "/localtime";
+	s_journalPath = s_dir + "/clockjournal";
+	PrefsDb::s_prefsDbPath = s_prefsDbPath.c_str();
+	TimePrefsHandler::setLocalTimeFile(s_localTimePath.c_str());
+	ClockHandler::setJournalPath(s_journalPath.c_str());
+
+	FakeTimeClock clock(start);
+	TimeClock::setInstance(&clock);
+	g_gmainLoop = g_main_loop_new(NULL, FALSE);
+
+	TimePrefsHandler* handler = new TimePrefsHandler(FakeLunaService::service());
+	CHECK(handler == TimePrefsHandler::instance());
+	CHECK_EQUAL(currentZone(), std::string("Europe/London"));
+
+	ClockHandler clockHandler;
+	setupClockHandler(clockHandler);
+
+	// bootstrap cycle
+	clock.advance(bootstrapDelayMs + timeoutIntervalMs);
+
+	testTime(clock);
+	testZone(clock);
+	testPrefFlagsCache(clock);
+	testTimeoutChain(clock);
+	testStepCosts(s_messages);
+
+	TimeClock::setInstance(NULL);
+
+	const char* const files[] = { "timezones.json", "tzdata.pack", "systemprefs.db",
+								  "localtime", "clockjournal" };
+	for (size_t i = 0; i < sizeof(files)/sizeof(files[0]); ++i)
+		unlink((s_dir + "/" + files[i]).c_str());
+	rmdir(dir);
+
+	return Test::result("TestNitzChain");
+}
@@ -0,0 +1,288 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestSntpClient.cpp
+ *
+ *  SNTP client against stand-in servers (SntpStandIn) on loopback UDP
+ *  sockets.
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+
+#include <string>
+#include <vector>
+
+#include "FakeTimeClock.h"
+#include "SignalSlot.h"
+#include "SntpClient.h"
+#include "SntpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+	const time_t startTime = 1400000000;
+	// real time limit for a single query, guards against hanging forever
+	const guint guardMs = 5000;
+
+	struct Result : public Trackable
+	{
+		Result() : count(0), succeeded(false) {}
+
+		void finished(bool ok, const SntpClient::Sample& best)
+		{
+			++count;
+			succeeded = ok;
+			sample = best;
+		}
+
+		int                count;
+		bool               succeeded;
+		SntpClient::Sample sample;
+	};
+
+	gboolean cbGuard(gpointer data)
+	{
+		*static_cast<bool*>(data) = true;
+		return FALSE;
+	}
+
+	/**
+	 * Run main loop until client finished (or guard expired)
+	 */
+	void wait(const Result& result)
+	{
+		bool expired = false;
+		guint guard = g_timeout_add(guardMs, cbGuard, &expired);
+		while (!result.count && !expired)
+			g_main_context_iteration(NULL, TRUE);
+		if (!expired)
+			g_source_remove(guard);
+		CHECK(!expired);
+	}
+
+	/**
+	 * Run main loop until server got request (or guard expired)
+	 */
+	void waitRequest(const SntpStandIn& server)
+	{
+		bool expired = false;
+		guint guard = g_timeout_add(guardMs, cbGuard, &expired);
+		while (!server.requests && !expired)
+			g_main_context_iteration(NULL, TRUE);
+		if (!expired)
+			g_source_remove(guard);
+		CHECK(!expired);
+	}
+
+	std::vector<std::string> servers(const char* first, const char* second = NULL)
+	{
+		std::vector<std::string> list(1, first);
+		if (second)
+			list.push_back(second);
+		return list;
+	}
+
+	void testAnswer()
+	{
+		FakeTimeClock clock(startTime);
+		TimeClock::setInstance(&clock);
+
+		SntpStandIn server(clock, "127.0.0.1");
+		CHECK(server.isValid());
+		server.offsetNs = 5 * FakeTimeClock::nsecPerSec + 250 * FakeTimeClock::nsecPerMs;
+		server.stratum = 3;
+		server.rootDelayMs = 20;
+		server.rootDispersionMs = 10;
+
+		Result result;
+		SntpClient client;
+		client.finished.connect(&result, &Result::finished);
+
+		CHECK(client.query(servers("127.0.0.1"), 1000, server.port()));
+		CHECK(client.isActive());
+		wait(result);
+
+		CHECK_EQUAL(result.count, 1);
+		CHECK(result.succeeded);
+		CHECK(!client.isActive());
+		CHECK_EQUAL(server.requests, 1);
+		CHECK(result.sample.server == "127.0.0.1");
+		CHECK(result.sample.address == "127.0.0.1");
+		CHECK_EQUAL(result.sample.stratum, 3);
+		// 32-bit fractions round to below a nanosecond
+		CHECK(llabs(result.sample.offset - server.offsetNs) <= 2);
+		CHECK(result.sample.delay <= 1);
+		// half of root delay plus root dispersion (16.16 fields resolve ~15 us)
+		CHECK(llabs(result.sample.distance - 20 * FakeTimeClock::nsecPerMs) <= 50000);
+		CHECK_EQUAL(client.samples().size(), (size_t) 1);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testBestOfTwo()
+	{
+		FakeTimeClock clock(startTime);
+		TimeClock::setInstance(&clock);
+
+		// both on same port as query has single port for all servers
+		SntpStandIn far(clock, "127.0.0.1");
+		SntpStandIn near(clock, "127.0.0.2", far.port());
+		CHECK(far.isValid());
+		CHECK(near.isValid());
+		far.offsetNs = -2 * FakeTimeClock::nsecPerSec;
+		far.stratum = 1;
+		far.rootDispersionMs = 200;
+		near.offsetNs = 3 * FakeTimeClock::nsecPerSec;
+		near.stratum = 4;
+		near.rootDispersionMs = 5;
+
+		Result result;
+		SntpClient client;
+		client.finished.connect(&result, &Result::finished);
+
+		CHECK(client.query(servers("127.0.0.1", "127.0.0.2"), 1000, far.port()));
+		wait(result);
+
+		// lower root distance wins over lower stratum
+		CHECK_EQUAL(result.count, 1);
+		CHECK(result.succeeded);
+		CHECK_EQUAL(client.samples().size(), (size_t) 2);
+		CHECK(result.sample.address == "127.0.0.2");
+		CHECK(llabs(result.sample.offset - near.offsetNs) <= 2);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testKissOfDeath()
+	{
+		FakeTimeClock clock(startTime);
+		TimeClock::setInstance(&clock);
+
+		SntpStandIn server(clock, "127.0.0.1");
+		server.mode = SntpStandIn::KissOfDeath;
+
+		Result result;
+		SntpClient client;
+		client.finished.connect(&result, &Result::finished);
+
+		// answered without sample, so no need to wait for timeout
+		CHECK(client.query(servers("127.0.0.1"), 1000, server.port()));
+		wait(result);
+
+		CHECK_EQUAL(result.count, 1);
+		CHECK(!result.succeeded);
+		CHECK(client.samples().empty());
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testStrayDatagram()
+	{
+		FakeTimeClock clock(startTime);
+		TimeClock::setInstance(&clock);
+
+		SntpStandIn server(clock, "127.0.0.1");
+		server.mode = SntpStandIn::StrayFirst;
+		server.offsetNs = 700 * FakeTimeClock::nsecPerMs;
+
+		Result result;
+		SntpClient client;
+		client.finished.connect(&result, &Result::finished);
+
+		CHECK(client.query(servers("127.0.0.1"), 1000, server.port()));
+		wait(result);
+
+		// answer to other request is skipped
+		CHECK_EQUAL(result.count, 1);
+		CHECK(result.succeeded);
+		CHECK(llabs(result.sample.offset - server.offsetNs) <= 2);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testTimeout()
+	{
+		FakeTimeClock clock(startTime);
+		TimeClock::setInstance(&clock);
+
+		SntpStandIn server(clock, "127.0.0.1");
+		server.mode = SntpStandIn::Silent;
+
+		Result result;
+		SntpClient client;
+		client.finished.connect(&result, &Result::finished);
+
+		CHECK(client.query(servers("127.0.0.1"), 1000, server.port()));
+		CHECK_EQUAL(clock.lastTimeoutMs(), (int64_t) 1000);
+		waitRequest(server);
+		clock.dispatch();
+
+		// still waiting for silent server
+		clock.advance(999);
+		CHECK_EQUAL(result.count, 0);
+		CHECK(client.isActive());
+
+		clock.advance(1);
+		CHECK_EQUAL(result.count, 1);
+		CHECK(!result.succeeded);
+		CHECK(!client.isActive());
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testCancel()
+	{
+		FakeTimeClock clock(startTime);
+		TimeClock::setInstance(&clock);
+
+		SntpStandIn server(clock, "127.0.0.1");
+		server.mode = SntpStandIn::Silent;
+
+		Result result;
+		SntpClient client;
+		client.finished.connect(&result, &Result::finished);
+
+		CHECK(client.query(servers("127.0.0.1"), 1000, server.port()));
+		waitRequest(server);
+		client.cancel();
+		CHECK(!client.isActive());
+
+		// cancelled query never reports
+		clock.advance(2000);
+		CHECK_EQUAL(result.count, 0);
+
+		CHECK(!client.query(std::vector<std::string>(), 1000, server.port()));
+		CHECK(!client.isActive());
+
+		TimeClock::setInstance(NULL);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	testAnswer();
+	testBestOfTwo();
+	testKissOfDeath();
+	testStrayDatagram();
+	testTimeout();
+	testCancel();
+	return Test::result("TestSntpClient");
+}
@@ -0,0 +1,191 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestSystemTimeReply.cpp
+ *
+ *  getSystemTime members over fake clock: formatted once per second,
+ *  zone members refreshed on offset change, tail kept until invalidated.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <cjson/json.h>
+
+#include <string>
+
+#include "FakeTimeClock.h"
+#include "SystemTimeReply.h"
+#include "TestUtils.h"
+
+namespace {
+	// 2021-03-28 01:00 UTC, Europe/Helsinki switches to summer time
+	const time_t springForward = 1616893200;
+
+	void setWallTime(FakeTimeClock& clock, time_t wall)
+	{
+		struct timespec ts;
+		ts.tv_sec = wall;
+		ts.tv_nsec = 0;
+		CHECK(clock.setWallTime(ts));
+	}
+
+	void setZone(const char* tz)
+	{
+		setenv("TZ", tz, 1);
+		tzset();
+	}
+
+	struct Members
+	{
+		Members(const std::string& members) :
+			utc(-1), offset(0), hour(-1), nitzValid(-1)
+		{
+			std::string text = "{" + members + "}";
+			json_object* root = json_tokener_parse(text.c_str());
+			if (!root || is_error(root)) {
+				Test::fail(__FILE__, __LINE__, "members parse");
+				return;
+			}
+
+			json_object* label;
+			if ((label = json_object_object_get(root, "utc")))
+				utc = json_object_get_int64(label);
+			if ((label = json_object_object_get(root, "offset")))
+				offset = json_object_get_int(label);
+			if ((label = json_object_object_get(root, "timezone")))
+				timezone = json_object_get_string(label);
+			if ((label = json_object_object_get(root, "TZ")))
+				abbr = json_object_get_string(label);
+			if ((label = json_object_object_get(root, "localtime")))
+				hour = json_object_get_int(json_object_object_get(label, "hour"));
+			if ((label = json_object_object_get(root, "systemTimeSource")))
+				source = json_object_get_string(label);
+			if ((label = json_object_object_get(root, "NITZValid")))
+				nitzValid = json_object_get_boolean(label);
+			json_object_put(root);
+		}
+
+		int64_t utc;
+		int offset;		// minutes
+		std::string timezone;
+		std::string abbr;
+		int hour;
+		std::string source;
+		int nitzValid;	// -1 if missing
+	};
+
+	std::string tail(const char* source, bool nitzValid)
+	{
+		std::string text;
+		SystemTimeReply::appendMember(text, "timeZoneFile", json_object_new_string("/tmp/localtime"));
+		SystemTimeReply::appendMember(text, "systemTimeSource", json_object_new_string(source));
+		SystemTimeReply::appendMember(text, "NITZValid", json_object_new_boolean(nitzValid));
+		return text;
+	}
+
+	void testSecond(FakeTimeClock& clock)
+	{
+		SystemTimeReply reply;
+		CHECK(reply.needsTail());
+		reply.setTail(tail("ntp", true));
+		CHECK(!reply.needsTail());
+
+		std::string first = reply.members("Europe/Helsinki");
+		Members m(first);
+		CHECK_EQUAL(m.utc, (int64_t) springForward - 3600);
+		CHECK_EQUAL(m.offset, 120);
+		CHECK_EQUAL(m.timezone, std::string("Europe/Helsinki"));
+		CHECK_EQUAL(m.abbr, std::string("EET"));
+		CHECK_EQUAL(m.hour, 2);
+		CHECK_EQUAL(m.source, std::string("ntp"));
+		CHECK_EQUAL(m.nitzValid, 1);
+		CHECK_EQUAL(reply.formatCount(), 1ul);
+
+		// rest of the second is served from snapshot, even if process zone
+		// changes meanwhile (zone change comes with invalidate())
+		clock.advance(400);
+		setZone("UTC");
+		CHECK(reply.members("Europe/Helsinki") == first);
+		clock.advance(599);
+		CHECK(reply.members("Europe/Helsinki") == first);
+		CHECK_EQUAL(reply.formatCount(), 1ul);
+		setZone("Europe/Helsinki");
+
+		// next second
+		clock.advance(1);
+		Members next(reply.members("Europe/Helsinki"));
+		CHECK_EQUAL(next.utc, m.utc + 1);
+		CHECK_EQUAL(next.abbr, std::string("EET"));
+		CHECK_EQUAL(reply.formatCount(), 2ul);
+
+		// going back a second is another second too
+		setWallTime(clock, springForward - 3600);
+		CHECK(reply.members("Europe/Helsinki") == first);
+		CHECK_EQUAL(reply.formatCount(), 3ul);
+	}
+
+	void testZoneMembers(FakeTimeClock& clock)
+	{
+		SystemTimeReply reply;
+		reply.setTail(tail("nitz", false));
+
+		setWallTime(clock, springForward - 1);
+		Members before(reply.members("Europe/Helsinki"));
+		CHECK_EQUAL(before.offset, 120);
+		CHECK_EQUAL(before.abbr, std::string("EET"));
+		CHECK_EQUAL(before.hour, 2);
+
+		// offset and abbreviation follow DST change
+		clock.advance(1000);
+		Members after(reply.members("Europe/Helsinki"));
+		CHECK_EQUAL(after.utc, before.utc + 1);
+		CHECK_EQUAL(after.offset, 180);
+		CHECK_EQUAL(after.abbr, std::string("EEST"));
+		CHECK_EQUAL(after.hour, 4);
+		CHECK_EQUAL(after.nitzValid, 0);
+
+		// invalidated reply takes new tail (and zone) within same second
+		reply.invalidate();
+		CHECK(reply.needsTail());
+		reply.setTail(tail("manual", true));
+		Members changed(reply.members(NULL));
+		CHECK_EQUAL(changed.utc, after.utc);
+		CHECK_EQUAL(changed.source, std::string("manual"));
+		CHECK_EQUAL(changed.timezone, std::string("UTC"));
+		CHECK_EQUAL(changed.abbr, std::string("UTC"));
+		CHECK_EQUAL(reply.formatCount(), 3ul);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	setZone("Europe/Helsinki");
+
+	FakeTimeClock clock(springForward - 3600);
+	TimeClock::setInstance(&clock);
+
+	testSecond(clock);
+	testZoneMembers(clock);
+
+	TimeClock::setInstance(NULL);
+
+	return Test::result("TestSystemTimeReply");
+}
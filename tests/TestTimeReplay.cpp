@@ -0,0 +1,380 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTimeReplay.cpp
+ *
+ *  Replay of time-source traces through clock fusion, NTP poll schedule
+ *  and zone transition timer. Service policy of applying fused clocks
+ *  (priority and re-sync period) follows TimePrefsHandler::clockChanged().
+ *
+ *  Without arguments built-in trace is replayed; recorded trace can be
+ *  passed as first argument (replay report is printed with -v).
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <pbnjson.hpp>
+
+#include "ClockHandler.h"
+#include "FakeTimeClock.h"
+#include "NTPPollScheduler.h"
+#include "SignalSlot.h"
+#include "TestUtils.h"
+#include "TimeReplay.h"
+#include "ZoneTransitionTimer.h"
+
+extern GMainLoop * g_gmainLoop;
+
+namespace {
+	// 2021-03-27 00:00 UTC, a day before Europe/Helsinki summer time
+	const time_t traceStart = 1616803200;
+
+	const time_t minPollInterval = 300;
+	const time_t maxPollInterval = 86399;
+	const time_t minWakeupInterval = 60;
+	const time_t timeDriftPeriod = 4 * 60 * 60;
+	const int64_t slewThreshold = 128 * FakeTimeClock::nsecPerMs;
+
+	/**
+	 * Events:
+	 *   ntp-server up <error ms> | down   state of simulated NTP server
+	 *   nitz <error s>                    NITZ time received
+	 *   broadcast <error s>               broadcast time received
+	 *   drift <ppm>                       drift of system clock
+	 *   zone <name>                       current zone
+	 *   expect-error <ms>                 system time error bound
+	 *   expect-polls <min> <max>          NTP polls since last check
+	 *   expect-slews <min> <max>          slewed corrections since last check
+	 *   expect-transitions <count>        zone transitions so far
+	 */
+	const char* const builtinTrace =
+		"# boot with RTC 90 seconds ahead\n"
+		"0       zone Europe/Helsinki\n"
+		"5       broadcast 0\n"
+		"5.1     expect-error 1000\n"
+		"12      nitz 0\n"
+		"12.1    expect-error 1000\n"
+		"20      ntp-server up 3\n"
+		"20      drift 40\n"
+		"# failed poll after broadcast step, first poll once server is up\n"
+		"80      expect-error 50\n"
+		"80      expect-polls 2 2\n"
+		"# a day of drifting clock (error stays within a poll interval of drift)\n"
+		"86400   expect-error 150\n"
+		"86400   expect-polls 2 300\n"
+		"# drift corrections stay below slew threshold\n"
+		"86400   expect-slews 2 300\n"
+		"# suspended across DST change, NITZ on wake-up\n"
+		"86500   suspend 7200\n"
+		"93800   expect-transitions 1\n"
+		"93800   nitz 0\n"
+		"93900   expect-error 1000\n"
+		"# NTP outage: NITZ keeps time meanwhile\n"
+		"94000   ntp-server down\n"
+		"180000  nitz 0\n"
+		"180100  expect-error 1000\n"
+		"180200  ntp-server up -2\n"
+		"200000  expect-error 150\n"
+		"200000  expect-polls 1 300\n"
+		"200000  expect-transitions 1\n";
+
+	class Service : public TimeReplay, public Trackable
+	{
+	public:
+		Service(FakeTimeClock& clock) :
+			TimeReplay(clock, traceStart),
+			m_pollSource(NULL),
+			m_serverUp(false),
+			m_serverError(0),
+			m_polls(0),
+			m_slews(0),
+			m_zoneTransitions(0),
+			m_currentPriority(-1),
+			m_nextSyncTime(0)
+		{
+			static const char* const sources[] = { "ntp", "sdp", "nitz", "broadcast-adjusted", "broadcast" };
+			const int count = G_N_ELEMENTS(sources);
+			for (int i = 0; i < count; ++i)
+				m_clocks.setup(sources[i], count - 1 - i + 1);
+			m_clocks.clockChanged.connect(this, &Service::clockChanged);
+
+			m_poll.setLimits(minPollInterval, maxPollInterval);
+			m_zoneTimer.reached.connect(this, &Service::zoneTransition);
+		}
+
+		~Service()
+		{
+			stopPolling();
+		}
+
+	protected:
+		virtual bool handle(const Event& event)
+		{
+			const std::vector<std::string>& args = event.args;
+			if (event.name == "ntp-server" && args.size() >= 1)
+			{
+				m_serverUp = args[0] == "up";
+				m_serverError = args.size() > 1 ? atof(args[1].c_str()) * FakeTimeClock::nsecPerMs : 0;
+				transition(std::string("ntp server ") + args[0]);
+				if (m_serverUp)
+				{
+					m_poll.expire();
+					schedulePoll();
+				}
+				return true;
+			}
+			if ((event.name == "nitz" || event.name == "broadcast") && args.size() == 1)
+			{
+				// both carry whole seconds
+				int64_t offset = referenceNs() + atoll(args[0].c_str()) * FakeTimeClock::nsecPerSec - m_clock.wallNs();
+				offset = ClockHandler::secondsOffset(ClockHandler::offsetSeconds(offset));
+				// BroadcastTimeHandler reports local time converted with
+				// user zone too, which is the same in the trace
+				if (event.name == "broadcast")
+					m_clocks.update(offset, ClockHandler::broadcastAdjusted);
+				m_clocks.update(offset, event.name);
+				return true;
+			}
+			if (event.name == "drift" && args.size() == 1)
+			{
+				m_clock.setDrift(atof(args[0].c_str()));
+				return true;
+			}
+			if (event.name == "zone" && args.size() == 1)
+			{
+				m_zoneName = args[0];
+				m_zoneTimer.arm(m_zoneName);
+				return m_zoneTimer.nextTransition() != 0;
+			}
+			if (event.name == "expect-error" && args.size() == 1)
+			{
+				int64_t error = m_clock.wallNs() - referenceNs();
+				if (llabs(error) > atoll(args[0].c_str()) * FakeTimeClock::nsecPerMs)
+					failAt(event, "system time error %.3f ms", error / 1e6);
+				return true;
+			}
+			if (event.name == "expect-polls" && args.size() == 2)
+			{
+				if (m_polls < atoi(args[0].c_str()) || m_polls > atoi(args[1].c_str()))
+					failAt(event, "%d NTP polls", m_polls);
+				m_polls = 0;
+				return true;
+			}
+			if (event.name == "expect-slews" && args.size() == 2)
+			{
+				if (m_slews < atoi(args[0].c_str()) || m_slews > atoi(args[1].c_str()))
+					failAt(event, "%d slews", m_slews);
+				m_slews = 0;
+				return true;
+			}
+			if (event.name == "expect-transitions" && args.size() == 1)
+			{
+				if (m_zoneTransitions != atoi(args[0].c_str()))
+					failAt(event, "%d zone transitions", m_zoneTransitions);
+				return true;
+			}
+			return false;
+		}
+
+		virtual void resumed()
+		{
+			// what TimePrefsHandler does on powerd resume signal
+			m_zoneTimer.resume();
+			schedulePoll();
+		}
+
+	private:
+		void failAt(const Event& event, const char* format, ...)
+		{
+			char what[128];
+			va_list args;
+			va_start(args, format);
+			vsnprintf(what, sizeof(what), format, args);
+			va_end(args);
+			fprintf(stderr, "trace line %d (%s): %s\n", event.line, event.name.c_str(), what);
+			Test::fail(__FILE__, __LINE__, "trace expectation");
+		}
+
+		// TimePrefsHandler::clockChanged() and systemSetTime() in short
+		void clockChanged(const std::string& clockTag, int priority, int64_t systemOffset, time_t lastUpdate)
+		{
+			time_t currentTime = TimeClock::instance()->wallSeconds();
+			if (priority < m_currentPriority && currentTime < m_nextSyncTime)
+				return;
+
+			bool slew = systemOffset != 0 && llabs(systemOffset) < slewThreshold;
+			struct timespec remaining = { 0, 0 };
+			if (slew)
+			{
+				struct timespec delta;
+				FakeTimeClock::toTimespec(systemOffset, delta);
+				m_clock.slewWallTime(delta, &remaining);
+			}
+			else if (systemOffset != 0)
+			{
+				struct timespec none = { 0, 0 };
+				m_clock.slewWallTime(none, &remaining);
+				m_clock.setWallTime(wallAfter(systemOffset));
+				char what[64];
+				snprintf(what, sizeof(what), "step %.3f ms by ", systemOffset / 1e6);
+				transition(what + clockTag);
+			}
+			int64_t netChange = systemOffset - ((int64_t) remaining.tv_sec * FakeTimeClock::nsecPerSec + remaining.tv_nsec);
+			if (slew)
+				++m_slews;
+
+			// /clock/getTime subscribers of a clock aren't notified when
+			// only system time moves
+			ClockHandler::TimeRequest request;
+			request.source = clockTag;
+			pbnjson::JValue reply;
+			std::string stateBefore, stateAfter;
+			m_clocks.answerTime(request, reply, stateBefore);
+			m_clocks.adjust(netChange);
+			m_clocks.answerTime(request, reply, stateAfter);
+			CHECK_STREQUAL(stateBefore.c_str(), stateAfter.c_str());
+			m_poll.corrected(netChange);
+			if (systemOffset != 0 && clockTag != "ntp")
+				m_poll.expire();
+			if (systemOffset != 0 && !slew)
+				m_zoneTimer.arm(m_zoneName);
+
+			m_currentPriority = priority;
+			m_nextSyncTime = lastUpdate + ClockHandler::offsetSeconds(systemOffset) + timeDriftPeriod;
+			schedulePoll();
+		}
+
+		struct timespec wallAfter(int64_t offset) const
+		{
+			int64_t ns = m_clock.wallNs() + offset;
+			struct timespec ts;
+			ts.tv_sec = ns / FakeTimeClock::nsecPerSec;
+			ts.tv_nsec = ns % FakeTimeClock::nsecPerSec;
+			return ts;
+		}
+
+		void zoneTransition()
+		{
+			++m_zoneTransitions;
+			transition("zone transition");
+		}
+
+		void stopPolling()
+		{
+			if (m_pollSource)
+			{
+				g_source_destroy(m_pollSource);
+				g_source_unref(m_pollSource);
+				m_pollSource = NULL;
+			}
+		}
+
+		// TimePrefsHandler::setPeriodicTimeSetWakeup() in short
+		void schedulePoll()
+		{
+			stopPolling();
+			if (!m_serverUp && m_poll.failures() == 0 && !m_poll.isPollDue())
+				return;
+
+			time_t pollIn = m_poll.nextPollIn();
+			if (pollIn < minWakeupInterval && !m_poll.isPollDue())
+				pollIn = minWakeupInterval;
+
+			m_pollSource = TimeClock::instance()->createTimeout(pollIn * 1000, true);
+			g_source_set_callback(m_pollSource, cbPoll, this, NULL);
+			g_source_attach(m_pollSource, NULL);
+		}
+
+		static gboolean cbPoll(gpointer data)
+		{
+			Service* service = static_cast<Service*>(data);
+			g_source_unref(service->m_pollSource);
+			service->m_pollSource = NULL;
+			service->poll();
+			return FALSE;
+		}
+
+		void poll()
+		{
+			if (!m_poll.isPollDue())
+			{
+				schedulePoll();
+				return;
+			}
+
+			++m_polls;
+			if (!m_serverUp)
+			{
+				m_poll.failed();
+				transition("ntp poll failed");
+				schedulePoll();
+				return;
+			}
+
+			int64_t offset = referenceNs() + m_serverError - m_clock.wallNs();
+			m_poll.sampled(offset);
+			m_clocks.update(offset, "ntp");
+			schedulePoll();
+		}
+
+	private:
+		ClockHandler        m_clocks;
+		NTPPollScheduler    m_poll;
+		ZoneTransitionTimer m_zoneTimer;
+		std::string         m_zoneName;
+		GSource*            m_pollSource;
+		bool                m_serverUp;
+		int64_t             m_serverError;
+		int                 m_polls;
+		int                 m_slews;
+		int                 m_zoneTransitions;
+		int                 m_currentPriority;
+		time_t              m_nextSyncTime;
+	};
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	g_gmainLoop = g_main_loop_new(NULL, FALSE);
+
+	bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+	const char* tracePath = argc > (verbose ? 2 : 1) ? argv[verbose ? 2 : 1] : NULL;
+
+	{
+		FakeTimeClock clock(traceStart + 90);
+		TimeClock::setInstance(&clock);
+
+		Service service(clock);
+		bool parsed = tracePath ? service.load(tracePath) : service.parse(builtinTrace);
+		CHECK(parsed);
+		if (parsed)
+			CHECK(service.run());
+		if (verbose || Test::failures())
+			service.report(stdout);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	g_main_loop_unref(g_gmainLoop);
+	return Test::result("TestTimeReplay");
+}
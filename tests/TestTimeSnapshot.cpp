@@ -0,0 +1,177 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTimeSnapshot.cpp
+ *
+ *  Sequence lock of TimeSnapshot under load: writer thread (in place of
+ *  main loop) publishes values derived from publish count while reader
+ *  threads check every snapshot they get is whole (no fields from two
+ *  publishes) and never older than previous one. Then benchmarks read()
+ *  alone and while writer keeps publishing.
+ */
+
+#include <glib.h>
+
+#include "TestUtils.h"
+#include "TimeSnapshot.h"
+
+namespace {
+	const unsigned long rounds = 1000000;
+	const int readerCount = 3;
+	const unsigned long benchmarkReads = 2000000;
+
+	/**
+	 * Round k publishes system offset (generation 2k-1), then zone
+	 * (generation 2k), every field derived from k
+	 */
+	void publishRound(unsigned long k)
+	{
+		TimeSnapshot* snapshot = TimeSnapshot::instance();
+		snapshot->publishSystemOffset(k, 2 * (int64_t) k);
+		snapshot->publishZone(k, k & 1, 3 * (time_t) k);
+	}
+
+	bool isWhole(const TimeSnapshot::Data& data)
+	{
+		unsigned long offsetRound = (data.generation + 1) / 2;
+		unsigned long zoneRound = data.generation / 2;
+
+		if (data.systemOffset != (int64_t) offsetRound ||
+			data.systemUncertainty != 2 * (int64_t) offsetRound)
+			return false;
+
+		if (zoneRound == 0)
+			return !data.haveZone;
+		return data.haveZone &&
+		       data.zoneUtcOffset == (long) zoneRound &&
+		       data.zoneIsDst == (bool) (zoneRound & 1) &&
+		       data.zoneValidUntil == 3 * (time_t) zoneRound;
+	}
+
+	struct Shared
+	{
+		Shared() : stop(0), torn(0), backwards(0), reads(0) {}
+
+		volatile gint stop;
+		volatile gint torn;
+		volatile gint backwards;
+		volatile gint reads;
+	};
+
+	gpointer writer(gpointer data)
+	{
+		Shared* shared = static_cast<Shared*>(data);
+		for (unsigned long k = 1; k <= rounds; ++k)
+			publishRound(k);
+		g_atomic_int_set(&shared->stop, 1);
+		return NULL;
+	}
+
+	gpointer reader(gpointer data)
+	{
+		Shared* shared = static_cast<Shared*>(data);
+		unsigned long last = 0;
+		gint reads = 0;
+		while (!g_atomic_int_get(&shared->stop))
+		{
+			TimeSnapshot::Data snapshot;
+			if (!TimeSnapshot::instance()->read(snapshot))
+				continue;
+			++reads;
+			if (!isWhole(snapshot))
+				g_atomic_int_inc(&shared->torn);
+			if (snapshot.generation < last)
+				g_atomic_int_inc(&shared->backwards);
+			last = snapshot.generation;
+		}
+		g_atomic_int_add(&shared->reads, reads);
+		return NULL;
+	}
+
+	void testConcurrentReads()
+	{
+		TimeSnapshot::Data data;
+		CHECK(!TimeSnapshot::instance()->read(data));
+
+		Shared shared;
+		GThread* readers[readerCount];
+		for (int i = 0; i < readerCount; ++i)
+			readers[i] = g_thread_new("snapshot-reader", reader, &shared);
+		GThread* writerThread = g_thread_new("snapshot-writer", writer, &shared);
+
+		g_thread_join(writerThread);
+		for (int i = 0; i < readerCount; ++i)
+			g_thread_join(readers[i]);
+
+		CHECK_EQUAL(g_atomic_int_get(&shared.torn), 0);
+		CHECK_EQUAL(g_atomic_int_get(&shared.backwards), 0);
+		CHECK(g_atomic_int_get(&shared.reads) > 0);
+
+		// last publish is what everybody sees afterwards
+		CHECK(TimeSnapshot::instance()->read(data));
+		CHECK_EQUAL(data.generation, 2 * rounds);
+		CHECK(isWhole(data));
+	}
+
+	gpointer busyWriter(gpointer data)
+	{
+		Shared* shared = static_cast<Shared*>(data);
+		for (unsigned long k = rounds + 1; !g_atomic_int_get(&shared->stop); ++k)
+			publishRound(k);
+		return NULL;
+	}
+
+	void benchmark()
+	{
+		TimeSnapshot::Data data;
+		unsigned long sum = 0;
+
+		int64_t startNs = Test::nowNs();
+		for (unsigned long i = 0; i < benchmarkReads; ++i)
+		{
+			TimeSnapshot::instance()->read(data);
+			sum += data.generation;
+		}
+		Test::report("read() without writer", benchmarkReads, Test::nowNs() - startNs);
+
+		Shared shared;
+		GThread* writerThread = g_thread_new("snapshot-writer", busyWriter, &shared);
+		startNs = Test::nowNs();
+		for (unsigned long i = 0; i < benchmarkReads; ++i)
+		{
+			TimeSnapshot::instance()->read(data);
+			sum += data.generation;
+		}
+		Test::report("read() while writer publishes", benchmarkReads, Test::nowNs() - startNs);
+		g_atomic_int_set(&shared.stop, 1);
+		g_thread_join(writerThread);
+
+		CHECK(sum > 0);
+		CHECK(isWhole(data));
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	testConcurrentReads();
+	benchmark();
+	return Test::result("TestTimeSnapshot");
+}
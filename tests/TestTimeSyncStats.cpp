@@ -0,0 +1,150 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTimeSyncStats.cpp
+ *
+ *  Histogram buckets of TimeSyncStats: values right below and at every
+ *  bucket limit (limits are what getSyncStats reports), negative values
+ *  counted by magnitude, overflow into last bucket, max and reset, plus
+ *  step costs and reset of whole stats on fake clock.
+ */
+
+#include "FakeTimeClock.h"
+#include "TestUtils.h"
+#include "TimeSyncStats.h"
+
+namespace {
+	typedef TimeSyncStats::Histogram Histogram;
+
+	const int64_t nsecPerMs = FakeTimeClock::nsecPerMs;
+
+	// bucket value was counted in (-1 if histogram doesn't hold exactly it)
+	int bucketOf(int64_t ns)
+	{
+		Histogram histogram;
+		histogram.add(ns);
+		if (histogram.count != 1)
+			return -1;
+
+		int found = -1;
+		for (size_t i = 0; i < Histogram::bucketCount; ++i)
+		{
+			if (histogram.buckets[i] == 1 && found < 0)
+				found = i;
+			else if (histogram.buckets[i] != 0)
+				return -1;
+		}
+		return found;
+	}
+
+	void testLimits()
+	{
+		// power of two milliseconds
+		CHECK_EQUAL(Histogram::bucketLimitMs(0), (int64_t) 1);
+		for (size_t bucket = 1; bucket + 1 < Histogram::bucketCount; ++bucket)
+			CHECK_EQUAL(Histogram::bucketLimitMs(bucket), 2 * Histogram::bucketLimitMs(bucket - 1));
+	}
+
+	void testEdges()
+	{
+		CHECK_EQUAL(bucketOf(0), 0);
+		for (size_t bucket = 0; bucket + 1 < Histogram::bucketCount; ++bucket)
+		{
+			int64_t limitNs = Histogram::bucketLimitMs(bucket) * nsecPerMs;
+
+			// limit is exclusive, for either sign
+			CHECK_EQUAL(bucketOf(limitNs - 1), (int) bucket);
+			CHECK_EQUAL(bucketOf(limitNs), (int) bucket + 1);
+			CHECK_EQUAL(bucketOf(-(limitNs - 1)), (int) bucket);
+			CHECK_EQUAL(bucketOf(-limitNs), (int) bucket + 1);
+		}
+
+		// last bucket has no limit
+		const int last = Histogram::bucketCount - 1;
+		CHECK_EQUAL(bucketOf(Histogram::bucketLimitMs(last - 1) * nsecPerMs * 1000), last);
+		CHECK_EQUAL(bucketOf((int64_t) 1 << 62), last);
+		CHECK_EQUAL(bucketOf(-((int64_t) 1 << 62)), last);
+	}
+
+	void testMaxAndReset()
+	{
+		Histogram histogram;
+		histogram.add(3 * nsecPerMs);
+		histogram.add(-7 * nsecPerMs);
+		histogram.add(5 * nsecPerMs);
+		CHECK_EQUAL(histogram.count, 3u);
+		CHECK_EQUAL(histogram.buckets[2], 1u);	// [2, 4) ms
+		CHECK_EQUAL(histogram.buckets[3], 2u);	// [4, 8) ms
+		// magnitude of negative value
+		CHECK_EQUAL(histogram.max, 7 * nsecPerMs);
+
+		histogram.reset();
+		CHECK_EQUAL(histogram.count, 0u);
+		CHECK_EQUAL(histogram.max, (int64_t) 0);
+		for (size_t i = 0; i < Histogram::bucketCount; ++i)
+			CHECK_EQUAL(histogram.buckets[i], 0u);
+
+		histogram.add(-1);
+		CHECK_EQUAL(histogram.count, 1u);
+		CHECK_EQUAL(histogram.buckets[0], 1u);
+		CHECK_EQUAL(histogram.max, (int64_t) 1);
+	}
+
+	void testStats()
+	{
+		FakeTimeClock clock(1600000000);
+		TimeClock::setInstance(&clock);
+
+		TimeSyncStats stats;
+		CHECK_EQUAL(stats.resetStamp, clock.bootNs());
+
+		TimeSyncStats::Cost& cost = stats.nitzSteps["entry"];
+		cost.add(300);
+		cost.add(100);
+		CHECK_EQUAL(cost.runs, 2u);
+		CHECK_EQUAL(cost.totalNs, (int64_t) 400);
+		CHECK_EQUAL(cost.maxNs, (int64_t) 300);
+
+		stats.steps = 2;
+		stats.stepSize.add(nsecPerMs);
+		stats.sourceUpdates["ntp"] = 3;
+
+		// reset stamp follows boot clock, so suspend counts
+		clock.suspend(60 * 1000);
+		stats.reset();
+		CHECK_EQUAL(stats.resetStamp, clock.bootNs());
+		CHECK_EQUAL(stats.steps, 0u);
+		CHECK_EQUAL(stats.stepSize.count, 0u);
+		CHECK(stats.sourceUpdates.empty());
+		CHECK(stats.nitzSteps.empty());
+
+		TimeClock::setInstance(NULL);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	testLimits();
+	testEdges();
+	testMaxAndReset();
+	testStats();
+	return Test::result("TestTimeSyncStats");
+}
@@ -0,0 +1,422 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTimeZoneCatalog.cpp
+ *
+ *  Loads generated catalog and compares TimeZoneCatalog::memoryUsage() with
+ *  heap actually allocated by the load, then measures resident memory of
+ *  catalog against resident JSON document it replaced and how much of it
+ *  repeated string values take. Benchmarks catalog load and serialization,
+ *  and lookups by name through sorted index against linear scans of zone
+ *  lists they replaced (checking both find same zones). Checks filters,
+ *  paging window and cached whole reply of timeZone values.
+ */
+
+#include <limits.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <cjson/json.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "TimeZoneCatalog.h"
+#include "TestUtils.h"
+
+namespace {
+
+const int zoneCount = 500;
+
+std::string zoneName(int index)
+{
+	// mix of names fitting into std::string object and longer ones
+	char name[64];
+	if (index % 2)
+		snprintf(name, sizeof(name), "Etc/Z%d", index);
+	else
+		snprintf(name, sizeof(name), "America/Argentina/Zone_%d", index);
+	return name;
+}
+
+std::string catalogText()
+{
+	std::string text = "{\"timeZone\":[";
+	char entry[512];
+	for (int i = 0; i < zoneCount; ++i) {
+		snprintf(entry, sizeof(entry),
+				 "%s{\"Country\":\"Country %d\",\"CountryCode\":\"C%d\",\"ZoneID\":\"%s\","
+				 "\"City\":\"City %d\",\"Description\":\"Standard Time %d\","
+				 "\"offsetFromUTC\":%d,\"supportsDST\":%d%s}",
+				 i ? "," : "", i % 50, i % 50, zoneName(i).c_str(), i, i % 40,
+				 (i % 27 - 13) * 60, i % 2, i == 7 ? ",\"default\":true" : "");
+		text += entry;
+	}
+	// generic zone named like a zone above: lookups find the zone
+	text += "],\"syszones\":[{\"ZoneID\":\"Etc/GMT-1\",\"offsetFromUTC\":60},"
+			"{\"ZoneID\":\"Etc/Z1\",\"offsetFromUTC\":0}],"
+			"\"mccInfo\":[{\"mcc\":244,\"CountryCode\":\"fi\",\"ZoneID\":\"Europe/Helsinki\"}]}";
+	return text;
+}
+
+size_t heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 info = mallinfo2();
+#else
+	struct mallinfo info = mallinfo();
+#endif
+	return info.uordblks + info.hblkhd;
+}
+
+long residentBytes()
+{
+	// return freed heap pages first, so only live data is counted
+	malloc_trim(0);
+
+	long resident = 0;
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+	unsigned long size, pages;
+	if (fscanf(file, "%lu %lu", &size, &pages) == 2)
+		resident = pages * sysconf(_SC_PAGESIZE);
+	fclose(file);
+	return resident;
+}
+
+/**
+ * Bytes of string values (like "Country") of catalog entries that repeat a
+ * value of earlier entry, i.e. what interning those values could save
+ */
+size_t repeatedValueBytes(const TimeZoneCatalog& catalog)
+{
+	std::set<std::string> seen;
+	size_t repeated = 0;
+	for (size_t i = 0; i < catalog.size(TimeZoneCatalog::Zones); ++i) {
+		json_object* obj = json_tokener_parse(catalog.zone(TimeZoneCatalog::Zones, i).jsonStringValue.c_str());
+		if (!obj || is_error(obj))
+			continue;
+		json_object_object_foreach(obj, key, val) {
+			if (!val || !json_object_is_type(val, json_type_string))
+				continue;
+			std::string value = json_object_get_string(val);
+			if (!seen.insert(std::string(key) + ":" + value).second)
+				repeated += value.size();
+		}
+		json_object_put(obj);
+	}
+	return repeated;
+}
+
+void measureResident(const std::string& text)
+{
+	long before = residentBytes();
+	json_object* root = json_tokener_parse(text.c_str());
+	CHECK(root != NULL && !is_error(root));
+	long dom = residentBytes() - before;
+	json_object_put(root);
+
+	before = residentBytes();
+	TimeZoneCatalog* catalog = new TimeZoneCatalog;
+	CHECK(catalog->loadText(text.data(), text.size()));
+	long loaded = residentBytes() - before;
+
+	size_t entries = 0;
+	for (size_t i = 0; i < catalog->size(TimeZoneCatalog::Zones); ++i)
+		entries += catalog->zone(TimeZoneCatalog::Zones, i).jsonStringValue.size();
+
+	printf("resident: JSON document %ld KiB, catalog %ld KiB (entry JSON %zu KiB, "
+		   "repeated string values %zu KiB)\n", dom / 1024, loaded / 1024,
+		   entries / 1024, repeatedValueBytes(*catalog) / 1024);
+
+	// catalog must stay well below document it replaced
+	CHECK(loaded < dom);
+	delete catalog;
+}
+
+/**
+ * ZoneIDs listed by values reply and its "total" (-1 if missing)
+ */
+std::vector<std::string> listedZones(const std::string& reply, int& total)
+{
+	std::vector<std::string> zones;
+	total = -1;
+
+	json_object* root = json_tokener_parse(reply.c_str());
+	if (!root || is_error(root)) {
+		Test::fail(__FILE__, __LINE__, "values reply parses");
+		return zones;
+	}
+	CHECK(json_object_get_boolean(json_object_object_get(root, "returnValue")));
+
+	json_object* label = json_object_object_get(root, "total");
+	if (label)
+		total = json_object_get_int(label);
+
+	json_object* array = json_object_object_get(root, "timeZone");
+	for (int i = 0; array && i < json_object_array_length(array); ++i)
+		zones.push_back(json_object_get_string(json_object_object_get(json_object_array_get_idx(array, i), "ZoneID")));
+
+	json_object_put(root);
+	return zones;
+}
+
+void testValuesReply(const std::string& text)
+{
+	TimeZoneCatalog catalog;
+	CHECK(catalog.loadText(text.data(), text.size()));
+
+	// whole document once serialized is served as is
+	TimeZoneCatalog::ValuesFilter all;
+	std::string first, second;
+	catalog.valuesReply(all, first);
+	catalog.valuesReply(all, second);
+	CHECK(first == second);
+	std::string expected = "{";
+	catalog.serializeMembers(expected);
+	expected += ",\"returnValue\":true}";
+	CHECK(first == expected);
+
+	int total;
+	std::vector<std::string> zones = listedZones(first, total);
+	CHECK_EQUAL(zones.size(), (size_t) zoneCount);
+	CHECK_EQUAL(total, -1);
+
+	// filters, each listing all matches by default
+	TimeZoneCatalog::ValuesFilter country;
+	country.countryCode = "C3";
+	std::string reply;
+	catalog.valuesReply(country, reply);
+	zones = listedZones(reply, total);
+	CHECK_EQUAL(total, zoneCount / 50);
+	CHECK_EQUAL(zones.size(), (size_t) total);
+	CHECK(!zones.empty() && zones[0] == zoneName(3) && zones.back() == zoneName(zoneCount - 50 + 3));
+
+	TimeZoneCatalog::ValuesFilter offset;
+	offset.filterOffset = true;
+	offset.offset = -13 * 60;
+	catalog.valuesReply(offset, reply);
+	zones = listedZones(reply, total);
+	CHECK_EQUAL(total, (zoneCount + 26) / 27);
+	CHECK(!zones.empty() && zones[0] == zoneName(0) && zones[1] == zoneName(27));
+
+	TimeZoneCatalog::ValuesFilter prefix;
+	prefix.prefix = "Etc/Z1";
+	prefix.filterOffset = true;
+	prefix.offset = (1 % 27 - 13) * 60;
+	catalog.valuesReply(prefix, reply);
+	zones = listedZones(reply, total);
+	// Etc/Z1, Etc/Z109 and Etc/Z163
+	CHECK_EQUAL(total, 3);
+	CHECK(zones.size() == 3 && zones[0] == "Etc/Z1" && zones[2] == "Etc/Z163");
+
+	TimeZoneCatalog::ValuesFilter none;
+	none.countryCode = "XX";
+	catalog.valuesReply(none, reply);
+	zones = listedZones(reply, total);
+	CHECK_EQUAL(total, 0);
+	CHECK(zones.empty());
+
+	// paging window, total counts all matches
+	TimeZoneCatalog::ValuesFilter page;
+	page.prefix = "Etc/";
+	page.start = 5;
+	page.count = 3;
+	catalog.valuesReply(page, reply);
+	zones = listedZones(reply, total);
+	CHECK_EQUAL(total, zoneCount / 2);
+	CHECK(zones.size() == 3 && zones[0] == zoneName(11) && zones[2] == zoneName(15));
+
+	page.start = -10;	// same as 0
+	catalog.valuesReply(page, reply);
+	zones = listedZones(reply, total);
+	CHECK(zones.size() == 3 && zones[0] == zoneName(1));
+
+	page.start = 0;
+	page.count = 0;
+	catalog.valuesReply(page, reply);
+	zones = listedZones(reply, total);
+	CHECK(zones.empty());
+	CHECK_EQUAL(total, zoneCount / 2);
+
+	page.start = total - 1;
+	page.count = INT_MAX;	// start + count overflows int
+	catalog.valuesReply(page, reply);
+	zones = listedZones(reply, total);
+	CHECK(zones.size() == 1 && zones[0] == zoneName(zoneCount - 1));
+
+	page.start = INT_MAX;
+	catalog.valuesReply(page, reply);
+	zones = listedZones(reply, total);
+	CHECK(zones.empty());
+	CHECK_EQUAL(total, zoneCount / 2);
+
+	// only window without filter isn't whole document either
+	TimeZoneCatalog::ValuesFilter window;
+	window.start = 1;
+	catalog.valuesReply(window, reply);
+	zones = listedZones(reply, total);
+	CHECK_EQUAL(total, zoneCount);
+	CHECK_EQUAL(zones.size(), (size_t) zoneCount - 1);
+
+	// cached reply follows catalog it belongs to (zone data reload)
+	std::string smaller = "{\"timeZone\":[{\"ZoneID\":\"Europe/Helsinki\",\"CountryCode\":\"fi\","
+						  "\"offsetFromUTC\":120,\"supportsDST\":1}]}";
+	TimeZoneCatalog reloaded;
+	CHECK(reloaded.loadText(smaller.data(), smaller.size()));
+	catalog.swap(reloaded);
+	catalog.valuesReply(all, reply);
+	zones = listedZones(reply, total);
+	CHECK(zones.size() == 1 && zones[0] == "Europe/Helsinki");
+	reloaded.valuesReply(all, reply);
+	CHECK(reply == first);
+
+	// and is dropped by load
+	CHECK(reloaded.loadText(smaller.data(), smaller.size()));
+	reloaded.valuesReply(all, reply);
+	CHECK(listedZones(reply, total).size() == 1);
+}
+
+/**
+ * Zone with name as zone lists were searched before sorted index: zones
+ * first, then generic zones
+ */
+const TimeZoneInfo* scanForName(const TimeZoneCatalog& catalog, const std::string& name)
+{
+	const TimeZoneCatalog::Section sections[] = { TimeZoneCatalog::Zones, TimeZoneCatalog::SysZones };
+	for (size_t s = 0; s < sizeof(sections)/sizeof(sections[0]); ++s) {
+		for (size_t i = 0; i < catalog.size(sections[s]); ++i) {
+			if ((catalog.flags(sections[s], i) & TimeZoneCatalog::HasName) &&
+				catalog.zone(sections[s], i).name == name)
+				return &catalog.zone(sections[s], i);
+		}
+	}
+	return NULL;
+}
+
+void benchmark(const std::string& text)
+{
+	const int loads = 50;
+	int64_t begin = Test::nowNs();
+	for (int i = 0; i < loads; ++i) {
+		TimeZoneCatalog catalog;
+		CHECK(catalog.loadText(text.data(), text.size()));
+	}
+	Test::report("catalog loads", loads, Test::nowNs() - begin);
+
+	TimeZoneCatalog catalog;
+	CHECK(catalog.loadText(text.data(), text.size()));
+
+	begin = Test::nowNs();
+	std::string members;
+	for (int i = 0; i < loads; ++i) {
+		members = "{";
+		catalog.serializeMembers(members);
+		members += "}";
+	}
+	Test::report("catalog serializations", loads, Test::nowNs() - begin);
+
+	TimeZoneCatalog reloaded;
+	CHECK(reloaded.loadText(members.data(), members.size()));
+	CHECK_EQUAL(reloaded.size(TimeZoneCatalog::Zones), catalog.size(TimeZoneCatalog::Zones));
+	CHECK_EQUAL(reloaded.size(TimeZoneCatalog::SysZones), catalog.size(TimeZoneCatalog::SysZones));
+
+	// every name, plus misses
+	std::vector<std::string> names;
+	for (int i = 0; i < zoneCount; ++i)
+		names.push_back(zoneName(i));
+	names.push_back("Etc/GMT-1");
+	names.push_back("Europe/Helsinki");
+	names.push_back("Etc/Z");
+
+	const int rounds = 20;
+	unsigned long lookups = rounds * names.size();
+	size_t found = 0;
+	begin = Test::nowNs();
+	for (int r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < names.size(); ++i)
+			found += catalog.zoneFromName(names[i]) != NULL;
+	}
+	Test::report("zone name lookups (sorted index)", lookups, Test::nowNs() - begin);
+
+	size_t scanned = 0;
+	begin = Test::nowNs();
+	for (int r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < names.size(); ++i)
+			scanned += scanForName(catalog, names[i]) != NULL;
+	}
+	Test::report("zone name lookups (list scan)", lookups, Test::nowNs() - begin);
+
+	CHECK_EQUAL(found, scanned);
+	CHECK_EQUAL(found, (size_t) rounds * (zoneCount + 1));
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (catalog.zoneFromName(names[i]) != scanForName(catalog, names[i])) {
+			fprintf(stderr, "  zone %s\n", names[i].c_str());
+			Test::fail(__FILE__, __LINE__, "index finds same zone as list scan");
+		}
+	}
+}
+
+} // namespace
+
+int main()
+{
+	std::string text = catalogText();
+
+	size_t before = heapInUse();
+	TimeZoneCatalog* catalog = new TimeZoneCatalog;
+	CHECK(catalog->loadText(text.data(), text.size()));
+	size_t allocated = heapInUse() - before;
+	size_t usage = catalog->memoryUsage();
+
+	printf("catalog of %d zones: memoryUsage() %zu bytes, allocated %zu bytes\n",
+		   zoneCount, usage, allocated);
+
+	// allocator adds headers and rounding to every block
+	CHECK(usage <= allocated);
+	CHECK(usage >= allocated * 3 / 4);
+
+	CHECK_EQUAL(catalog->size(TimeZoneCatalog::Zones), (size_t) zoneCount);
+	CHECK_EQUAL(catalog->size(TimeZoneCatalog::SysZones), (size_t) 2);
+	CHECK_EQUAL(catalog->size(TimeZoneCatalog::MccZones), (size_t) 1);
+	CHECK_EQUAL(catalog->defaultZone(), 7);
+	CHECK_EQUAL(catalog->mcc(0), 244);
+
+	const TimeZoneInfo* zone = catalog->zoneFromName(zoneName(42));
+	CHECK(zone != NULL);
+	if (zone) {
+		CHECK_EQUAL(zone->countryCode, std::string("C42"));
+		CHECK_EQUAL(zone->offsetToUTC, (42 % 27 - 13) * 60);
+	}
+	CHECK(catalog->zoneFromName("Etc/GMT-1") != NULL);
+	CHECK(catalog->zoneFromName("Europe/Helsinki") == NULL);
+	CHECK(catalog->zoneFromName("Etc/Z1") == &catalog->zone(TimeZoneCatalog::Zones, 1));
+
+	delete catalog;
+
+	testValuesReply(text);
+	measureResident(text);
+	benchmark(text);
+
+	return Test::result("TestTimeZoneCatalog");
+}
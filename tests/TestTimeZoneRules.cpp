@@ -0,0 +1,277 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTimeZoneRules.cpp
+ *
+ *  Compares getTimeZoneRules for all zones of zone.tab and years 1970-2037
+ *  with the original per-year scans of transition list, and benchmarks one
+ *  request for all of them, the year index lookups it does and those scans.
+ *
+ *  Usage: TestTimeZoneRules [first year] [last year]
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <cjson/json.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TimeZoneService.h"
+#include "TzZone.h"
+#include "TestUtils.h"
+
+namespace {
+
+struct Result {
+	bool hasDstChange;
+	int64_t utcOffset;
+	int64_t dstOffset;
+	int64_t dstStart;
+	int64_t dstEnd;
+};
+
+typedef std::list<TzTransition> TransitionList;
+typedef std::map<std::pair<std::string, int>, Result> ResultMap;
+
+/**
+ * Transition list as parseTimeZone() built it
+ */
+void transitionList(const TzZone* zone, TransitionList& list)
+{
+	for (size_t i = 0; i < zone->transitionCount(); ++i) {
+		TzTransition trans;
+		zone->transitionAt(i, trans);
+		list.push_back(trans);
+	}
+}
+
+/**
+ * Original getTimeZoneRuleOne(): scan for year, forward scan of its
+ * transitions or reverse scan for the latest one before it
+ *
+ * @return false if there was no result for year
+ */
+bool scanYear(const TransitionList& transitions, int year, Result& res)
+{
+	res.hasDstChange = false;
+	res.utcOffset = -1;
+	res.dstOffset = -1;
+	res.dstStart = -1;
+	res.dstEnd = -1;
+
+	bool hasEntriesForYear = false;
+	for (TransitionList::const_iterator iter = transitions.begin();
+		 iter != transitions.end(); ++iter) {
+		if (iter->year == year) {
+			hasEntriesForYear = true;
+			break;
+		}
+	}
+
+	if (hasEntriesForYear) {
+		for (TransitionList::const_iterator iter = transitions.begin();
+			 iter != transitions.end(); ++iter) {
+			if (iter->year != year)
+				continue;
+
+			if (iter->isDst) {
+				res.hasDstChange = true;
+				res.dstOffset = iter->utcOffset;
+				res.dstStart = iter->time;
+			}
+			else {
+				res.utcOffset = iter->utcOffset;
+				res.dstEnd = iter->time;
+			}
+		}
+	}
+	else {
+		for (TransitionList::const_reverse_iterator iter = transitions.rbegin();
+			 iter != transitions.rend(); ++iter) {
+			if (iter->year > year)
+				continue;
+			res.utcOffset = iter->utcOffset;
+			break;
+		}
+	}
+
+	if (res.dstStart == -1)
+		res.dstEnd = -1;
+
+	return res.utcOffset != -1;
+}
+
+bool hasTransitionsIn(const TransitionList& transitions, int year)
+{
+	for (TransitionList::const_iterator iter = transitions.begin();
+		 iter != transitions.end(); ++iter) {
+		if (iter->year == year)
+			return true;
+	}
+	return false;
+}
+
+bool sameResult(const Result& a, const Result& b)
+{
+	return a.hasDstChange == b.hasDstChange && a.utcOffset == b.utcOffset &&
+	       a.dstOffset == b.dstOffset && a.dstStart == b.dstStart && a.dstEnd == b.dstEnd;
+}
+
+bool parseReply(const std::string& reply, ResultMap& results)
+{
+	json_object* root = json_tokener_parse(reply.c_str());
+	if (!root || is_error(root))
+		return false;
+
+	json_object* array = json_object_object_get(root, "results");
+	bool ok = array && json_object_is_type(array, json_type_array);
+	for (int i = 0; ok && i < json_object_array_length(array); ++i) {
+		json_object* o = json_object_array_get_idx(array, i);
+		Result r;
+		r.hasDstChange = json_object_get_boolean(json_object_object_get(o, "hasDstChange"));
+		r.utcOffset = json_object_get_int(json_object_object_get(o, "utcOffset"));
+		r.dstOffset = json_object_get_int(json_object_object_get(o, "dstOffset"));
+		r.dstStart = json_object_get_int(json_object_object_get(o, "dstStart"));
+		r.dstEnd = json_object_get_int(json_object_object_get(o, "dstEnd"));
+		std::string tz = json_object_get_string(json_object_object_get(o, "tz"));
+		int year = json_object_get_int(json_object_object_get(o, "year"));
+		results[std::make_pair(tz, year)] = r;
+	}
+
+	json_object_put(root);
+	return ok;
+}
+
+std::vector<std::string> readZoneTab()
+{
+	std::vector<std::string> zones;
+
+	FILE* file = fopen("/usr/share/zoneinfo/zone.tab", "r");
+	if (!file)
+		return zones;
+
+	char line[512];
+	char name[256];
+	while (fgets(line, sizeof(line), file)) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%*s %*s %255s", name) == 1)
+			zones.push_back(name);
+	}
+	fclose(file);
+	return zones;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	int firstYear = argc > 1 ? atoi(argv[1]) : 1970;
+	int lastYear = argc > 2 ? atoi(argv[2]) : 2037;
+
+	std::vector<std::string> names = readZoneTab();
+	CHECK(!names.empty());
+
+	// one request for all zones and years
+	TimeZoneService::TimeZoneEntryList entries;
+	std::vector<TzZoneRef> zones;
+	for (size_t i = 0; i < names.size(); ++i) {
+		TimeZoneService::TimeZoneEntry entry;
+		entry.tz = names[i];
+		for (int year = firstYear; year <= lastYear; ++year)
+			entry.years.push_back(year);
+		entries.push_back(entry);
+
+		zones.push_back(TzZoneRef(TzZone::load(names[i].c_str())));
+		CHECK(!zones.back().isNull());
+	}
+	unsigned long lookups = names.size() * (lastYear - firstYear + 1);
+
+	int64_t begin = Test::nowNs();
+	std::string reply = TimeZoneService::instance()->getTimeZoneRules(entries);
+	Test::report("getTimeZoneRules zone years (one request with reply)", lookups, Test::nowNs() - begin);
+
+	// transitions of year through year index, as getTimeZoneRuleOne() finds them
+	begin = Test::nowNs();
+	long sum = 0;
+	for (size_t i = 0; i < zones.size(); ++i) {
+		if (zones[i].isNull())
+			continue;
+		for (int year = firstYear; year <= lastYear; ++year) {
+			size_t first, last;
+			zones[i]->yearTransitions(year, first, last);
+			TzTransition trans;
+			for (size_t t = first; t < last; ++t) {
+				zones[i]->transitionAt(t, trans);
+				sum += trans.utcOffset;
+			}
+		}
+	}
+	Test::report("year index lookups", lookups, Test::nowNs() - begin);
+
+	// transition list of each zone and per year scans, as before year index
+	begin = Test::nowNs();
+	std::vector<TransitionList> lists(zones.size());
+	ResultMap expected;
+	for (size_t i = 0; i < zones.size(); ++i) {
+		if (zones[i].isNull())
+			continue;
+		transitionList(zones[i].get(), lists[i]);
+		for (int year = firstYear; year <= lastYear; ++year) {
+			Result res;
+			if (scanYear(lists[i], year, res))
+				expected[std::make_pair(names[i], year)] = res;
+		}
+	}
+	Test::report("transition list scans", lookups, Test::nowNs() - begin);
+
+	ResultMap actual;
+	CHECK(parseReply(reply, actual));
+
+	// years with recorded transitions give the same answer; other years
+	// now follow POSIX rule of zone past its last transition
+	long compared = 0;
+	for (size_t i = 0; i < names.size(); ++i) {
+		for (int year = firstYear; year <= lastYear; ++year) {
+			if (!hasTransitionsIn(lists[i], year))
+				continue;
+
+			std::pair<std::string, int> key(names[i], year);
+			ResultMap::const_iterator e = expected.find(key);
+			ResultMap::const_iterator a = actual.find(key);
+			++compared;
+			// both skip years without standard time transition
+			if ((e == expected.end()) != (a == actual.end()) ||
+				(e != expected.end() && !sameResult(e->second, a->second))) {
+				fprintf(stderr, "  %s %d\n", names[i].c_str(), year);
+				Test::fail(__FILE__, __LINE__, "getTimeZoneRules matches transition list scan");
+			}
+		}
+	}
+	CHECK(compared > 0);
+
+	printf("%zu results, %ld zone years with transitions compared (checksum %ld)\n",
+	       actual.size(), compared, sum);
+	return Test::result("TestTimeZoneRules");
+}
@@ -0,0 +1,199 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTzFile.cpp
+ *
+ *  Opens every zone of /usr/share/zoneinfo through TzFile and checks its
+ *  decoded records, then benchmarks parse time and resident memory of
+ *  mapped zones against reading whole files into malloc'ed buffers (what
+ *  parseTimeZone() did before TzFile).
+ */
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "TestUtils.h"
+#include "TzParser.h"
+
+namespace {
+	const char* const zoneInfoDir = "/usr/share/zoneinfo";
+
+	std::vector<std::string> s_files;	// relative to zoneInfoDir
+
+	int collect(const char* path, const struct stat* st, int type, struct FTW* ftw)
+	{
+		if (type != FTW_F || st->st_size == 0)
+			return 0;
+
+		std::string name(path + strlen(zoneInfoDir) + 1);
+		// same data as plain zones
+		if (name.compare(0, 6, "posix/") == 0 || name.compare(0, 6, "right/") == 0)
+			return 0;
+
+		s_files.push_back(name);
+		return 0;
+	}
+
+	bool isTzif(const std::string& name)
+	{
+		FILE* file = fopen((std::string(zoneInfoDir) + "/" + name).c_str(), "rb");
+		if (!file)
+			return false;
+		char magic[4];
+		bool tzif = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+		            memcmp(magic, "TZif", sizeof(magic)) == 0;
+		fclose(file);
+		return tzif;
+	}
+
+	// resident memory (bytes) private to process and shared with page cache
+	struct Resident
+	{
+		Resident() : privateBytes(0), sharedBytes(0)
+		{
+			FILE* file = fopen("/proc/self/statm", "r");
+			if (!file)
+				return;
+			unsigned long size, resident, shared;
+			if (fscanf(file, "%lu %lu %lu", &size, &resident, &shared) == 3) {
+				privateBytes = (resident - shared) * sysconf(_SC_PAGESIZE);
+				sharedBytes = shared * sysconf(_SC_PAGESIZE);
+			}
+			fclose(file);
+		}
+
+		long privateBytes;
+		long sharedBytes;
+	};
+
+	// decode every record, as a full scan of zone does
+	long checkRecords(const TzFile& file, const std::string& name)
+	{
+		long sum = 0;
+		bool ok = true;
+		for (size_t i = 0; i < file.transitionCount(); ++i) {
+			if (i > 0 && file.transitionTime(i) <= file.transitionTime(i - 1))
+				ok = false;
+			if (file.transitionType(i) >= file.typeCount())
+				ok = false;
+			sum += (long) file.transitionTime(i);
+		}
+		for (size_t i = 0; i < file.typeCount(); ++i) {
+			TzLocalTimeType type = file.type(i);
+			if (type.utcOffset < -26 * 3600 || type.utcOffset > 26 * 3600 || !file.abbr(type.abbrIndex))
+				ok = false;
+			sum += type.utcOffset;
+		}
+		if (!ok) {
+			fprintf(stderr, "  zone %s\n", name.c_str());
+			Test::fail(__FILE__, __LINE__, "records of zone are consistent");
+		}
+		return sum;
+	}
+
+	void benchmark(const std::vector<std::string>& zones)
+	{
+		// mapped views
+		Resident before;
+		int64_t begin = Test::nowNs();
+		std::vector<TzFile*> files;
+		long sum = 0;
+		for (size_t i = 0; i < zones.size(); ++i) {
+			TzFile* file = new TzFile;
+			CHECK(file->open(zones[i].c_str()));
+			sum += checkRecords(*file, zones[i]);
+			files.push_back(file);
+		}
+		int64_t mappedNs = Test::nowNs() - begin;
+		Resident mapped;
+
+		size_t mappedSize = 0;
+		for (size_t i = 0; i < files.size(); ++i) {
+			mappedSize += files[i]->mappedSize();
+			delete files[i];
+		}
+
+		// whole files read to heap (without decoding)
+		Resident beforeRead;
+		begin = Test::nowNs();
+		std::vector<char*> buffers;
+		size_t readSize = 0;
+		for (size_t i = 0; i < zones.size(); ++i) {
+			FILE* file = fopen((std::string(zoneInfoDir) + "/" + zones[i]).c_str(), "rb");
+			if (!file)
+				continue;
+			fseek(file, 0, SEEK_END);
+			long size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+			char* buffer = (char*) malloc(size);
+			if (buffer && fread(buffer, 1, size, file) == (size_t) size)
+				readSize += size;
+			fclose(file);
+			buffers.push_back(buffer);
+		}
+		int64_t readNs = Test::nowNs() - begin;
+		Resident read;
+		for (size_t i = 0; i < buffers.size(); ++i)
+			free(buffers[i]);
+
+		CHECK_EQUAL(readSize, mappedSize);
+		Test::report("zones mapped and decoded", zones.size(), mappedNs);
+		Test::report("zones read to heap", zones.size(), readNs);
+		printf("  %zu KiB of zoneinfo data: mapped %ld KiB private + %ld KiB page cache, "
+		       "read %ld KiB private + %ld KiB page cache (checksum %ld)\n", mappedSize / 1024,
+		       (mapped.privateBytes - before.privateBytes) / 1024,
+		       (mapped.sharedBytes - before.sharedBytes) / 1024,
+		       (read.privateBytes - beforeRead.privateBytes) / 1024,
+		       (read.sharedBytes - beforeRead.sharedBytes) / 1024, sum);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	nftw(zoneInfoDir, collect, 16, FTW_PHYS);
+
+	std::vector<std::string> zones;
+	for (size_t i = 0; i < s_files.size(); ++i) {
+		// tables (zone.tab, leapseconds, ...) aren't zones
+		if (isTzif(s_files[i]))
+			zones.push_back(s_files[i]);
+	}
+	CHECK(zones.size() > 300);
+
+	// every zone opens and non-zones are rejected
+	for (size_t i = 0; i < s_files.size(); ++i) {
+		TzFile file;
+		bool tzif = isTzif(s_files[i]);
+		if (file.open(s_files[i].c_str()) != tzif) {
+			fprintf(stderr, "  file %s\n", s_files[i].c_str());
+			Test::fail(__FILE__, __LINE__, "open() accepts only TZif files");
+		}
+	}
+
+	benchmark(zones);
+
+	return Test::result("TestTzFile");
+}
@@ -0,0 +1,470 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTzPack.cpp
+ *
+ *  Builds zone packs from a temporary zoneinfo tree and from
+ *  /usr/share/zoneinfo and checks that find() returns the same bytes as
+ *  zoneinfo files, that load() rejects truncated and corrupted packs, and
+ *  that zones loaded from a pack keep working after setCurrent() swaps it
+ *  for a newer one.
+ */
+
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "TestUtils.h"
+#include "TzPack.h"
+#include "TzParser.h"
+#include "TzZone.h"
+
+namespace {
+	const char* const zoneInfoDir = "/usr/share/zoneinfo";
+
+	// zones copied to temporary tree (nested directories on purpose)
+	const char* const treeZones[] = {
+		"America/Argentina/Buenos_Aires",
+		"America/New_York",
+		"Etc/GMT-3",
+		"Europe/Helsinki",
+		"Europe/London",
+		"UTC",
+	};
+	const size_t treeZoneCount = sizeof(treeZones) / sizeof(treeZones[0]);
+
+	const char* const catalog = "{ \"timeZone\": [], \"syszones\": [] }\n";
+
+	const size_t headerSize = 5 * 4;
+	const size_t recordSize = 3 * 4;
+
+	std::string s_dir;
+	std::vector<std::string> s_systemZones;	// relative to zoneInfoDir
+
+	bool readFile(const std::string& path, std::string& content)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+		content.clear();
+		char buffer[4096];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			content.append(buffer, count);
+		fclose(file);
+		return true;
+	}
+
+	bool writeFile(const std::string& path, const std::string& content)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+		bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+		return fclose(file) == 0 && ok;
+	}
+
+	bool makeDirs(const std::string& path)
+	{
+		for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+			mkdir(path.substr(0, slash).c_str(), 0755);
+		return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+	}
+
+	bool copyZone(const char* name, const std::string& toDir, const char* toName = NULL)
+	{
+		std::string content;
+		std::string to = toDir + "/" + (toName ? toName : name);
+		return readFile(std::string(zoneInfoDir) + "/" + name, content) &&
+		       makeDirs(to.substr(0, to.rfind('/'))) && writeFile(to, content);
+	}
+
+	uint32_t word(const std::string& pack, size_t offset)
+	{
+		const unsigned char* p = (const unsigned char*) pack.data() + offset;
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+	}
+
+	void setWord(std::string& pack, size_t offset, uint32_t value)
+	{
+		pack[offset] = char(value >> 24);
+		pack[offset + 1] = char(value >> 16);
+		pack[offset + 2] = char(value >> 8);
+		pack[offset + 3] = char(value);
+	}
+
+	bool loads(const std::string& path)
+	{
+		return !TzPackRef(TzPack::load(path.c_str())).isNull();
+	}
+
+	bool loads(const std::string& path, const std::string& bytes)
+	{
+		return writeFile(path, bytes) && loads(path);
+	}
+
+	int collect(const char* path, const struct stat* st, int type, struct FTW* ftw)
+	{
+		if (type != FTW_F)
+			return 0;
+
+		std::string name(path + strlen(zoneInfoDir) + 1);
+		if (name.compare(0, 6, "posix/") == 0 || name.compare(0, 6, "right/") == 0)
+			return 0;
+
+		std::string content;
+		if (readFile(path, content) && content.size() >= 44 && content.compare(0, 4, "TZif") == 0)
+			s_systemZones.push_back(name);
+		return 0;
+	}
+
+	int removeEntry(const char* path, const struct stat* st, int type, struct FTW* ftw)
+	{
+		return remove(path);
+	}
+
+	bool findMatches(const TzPack* pack, const std::string& dir, const std::string& name)
+	{
+		const char* data;
+		size_t size;
+		std::string content;
+		if (!pack->find(name.c_str(), data, size) || !readFile(dir + "/" + name, content) ||
+			content.size() != size || memcmp(content.data(), data, size) != 0) {
+			fprintf(stderr, "  zone %s\n", name.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Temporary tree with zones, a linked zone and entries builder skips
+	 */
+	void makeTree(const std::string& tree)
+	{
+		for (size_t i = 0; i < treeZoneCount; ++i)
+			CHECK(copyZone(treeZones[i], tree));
+
+		// link to file is packed (sharing data), link to directory is not
+		CHECK(symlink("Helsinki", (tree + "/Europe/Mariehamn").c_str()) == 0);
+		CHECK(symlink("Europe", (tree + "/Linked").c_str()) == 0);
+
+		CHECK(copyZone("Europe/Helsinki", tree, "posix/Europe/Helsinki"));
+		CHECK(copyZone("Europe/Helsinki", tree, "right/Europe/Helsinki"));
+		CHECK(copyZone("Europe/Helsinki", tree, ".hidden"));
+		CHECK(writeFile(tree + "/zone.tab", "FI\t+6010+02458\tEurope/Helsinki\n"));
+		CHECK(writeFile(tree + "/Short", "TZif2"));
+	}
+
+	void testBuild(const std::string& tree, const std::string& packPath)
+	{
+		std::string catalogPath = s_dir + "/timezones.json";
+		std::string errorText;
+		CHECK(writeFile(catalogPath, catalog));
+		CHECK(TzPack::build(tree.c_str(), catalogPath.c_str(), packPath.c_str(), errorText));
+		CHECK(errorText.empty());
+		CHECK(access((packPath + ".tmp").c_str(), F_OK) != 0);
+
+		TzPackRef pack(TzPack::load(packPath.c_str()));
+		CHECK(!pack.isNull());
+		if (pack.isNull())
+			return;
+
+		CHECK_EQUAL(pack->zoneCount(), treeZoneCount + 1);
+		for (size_t i = 0; i < treeZoneCount; ++i)
+			CHECK(findMatches(pack.get(), tree, treeZones[i]));
+		CHECK(findMatches(pack.get(), tree, "Europe/Mariehamn"));
+		for (size_t i = 1; i < pack->zoneCount(); ++i)
+			CHECK(strcmp(pack->zoneName(i - 1), pack->zoneName(i)) < 0);
+
+		const char* helsinki;
+		const char* mariehamn;
+		size_t size;
+		CHECK(pack->find("Europe/Helsinki", helsinki, size));
+		CHECK(pack->find("Europe/Mariehamn", mariehamn, size));
+		CHECK(helsinki == mariehamn);
+
+		const char* const missing[] = { "", "Europe", "Europe/", "Europe/Hel", "Europe/Helsinkix",
+		                                "GMT-3", "posix/Europe/Helsinki", "right/Europe/Helsinki",
+		                                "Linked/Helsinki", ".hidden", "zone.tab", "Short", "ZZZ" };
+		for (size_t i = 0; i < sizeof(missing) / sizeof(missing[0]); ++i) {
+			const char* data;
+			if (pack->find(missing[i], data, size)) {
+				fprintf(stderr, "  zone '%s'\n", missing[i]);
+				Test::fail(__FILE__, __LINE__, "find() rejects names not packed");
+			}
+		}
+
+		CHECK(std::string(pack->catalog(), pack->catalogSize()) == catalog);
+
+		// no catalog is fine, missing one is not
+		CHECK(TzPack::build(tree.c_str(), NULL, packPath.c_str(), errorText));
+		pack = TzPackRef(TzPack::load(packPath.c_str()));
+		CHECK(!pack.isNull() && pack->catalogSize() == 0 && pack->zoneCount() == treeZoneCount + 1);
+		CHECK(!TzPack::build(tree.c_str(), (s_dir + "/none.json").c_str(), packPath.c_str(), errorText));
+		CHECK(!errorText.empty());
+		CHECK(!TzPack::build((s_dir + "/none").c_str(), catalogPath.c_str(), packPath.c_str(), errorText));
+
+		// restore pack with catalog for later tests
+		CHECK(TzPack::build(tree.c_str(), catalogPath.c_str(), packPath.c_str(), errorText));
+		unlink(catalogPath.c_str());
+	}
+
+	void testCorrupt(const std::string& packPath)
+	{
+		std::string good;
+		CHECK(readFile(packPath, good));
+		CHECK(good.size() > headerSize + 2 * recordSize);
+		if (good.size() <= headerSize + 2 * recordSize)
+			return;
+
+		const std::string path = s_dir + "/corrupt.pack";
+		CHECK(loads(path, good));
+
+		// every truncation, shortest last
+		CHECK(writeFile(path, good));
+		size_t accepted = 0;
+		for (size_t size = good.size(); size-- > 0; ) {
+			if (truncate(path.c_str(), size) != 0 || loads(path))
+				++accepted;
+		}
+		CHECK_EQUAL(accepted, (size_t) 0);
+
+		const size_t size = good.size();
+		const size_t zoneCount = word(good, 8);
+		const size_t first = headerSize;
+		const size_t second = headerSize + recordSize;
+
+		std::string bad = good;
+		bad[0] = 't';
+		CHECK(!loads(path, bad));
+
+		bad = good;
+		setWord(bad, 4, 2);
+		CHECK(!loads(path, bad));
+
+		// index larger than file
+		bad = good;
+		setWord(bad, 8, 0xffffffff);
+		CHECK(!loads(path, bad));
+		setWord(bad, 8, (size - headerSize) / recordSize + 1);
+		CHECK(!loads(path, bad));
+
+		// catalog out of range
+		bad = good;
+		setWord(bad, 12, size + 1);
+		CHECK(!loads(path, bad));
+		bad = good;
+		setWord(bad, 16, word(good, 16) + 1);
+		CHECK(!loads(path, bad));
+		setWord(bad, 16, 0xffffffff);
+		CHECK(!loads(path, bad));
+
+		// unsorted and duplicate names
+		bad = good;
+		bad.replace(first, recordSize, good, second, recordSize);
+		bad.replace(second, recordSize, good, first, recordSize);
+		CHECK(!loads(path, bad));
+		bad = good;
+		bad.replace(second, recordSize, good, first, recordSize);
+		CHECK(!loads(path, bad));
+
+		// name out of range or not terminated (last byte is catalog's)
+		const size_t last = headerSize + (zoneCount - 1) * recordSize;
+		bad = good;
+		setWord(bad, last, size);
+		CHECK(!loads(path, bad));
+		CHECK(good[size - 1] != '\0');
+		setWord(bad, last, size - 1);
+		CHECK(!loads(path, bad));
+
+		// data out of range
+		bad = good;
+		setWord(bad, first + 4, size + 1);
+		CHECK(!loads(path, bad));
+		bad = good;
+		setWord(bad, first + 4, size - 10);
+		setWord(bad, first + 8, 11);
+		CHECK(!loads(path, bad));
+		setWord(bad, first + 8, 0xffffffff);
+		CHECK(!loads(path, bad));
+
+		// other bytes of zone data aren't checked by load()
+		bad = good;
+		bad[word(good, first + 4)] = 'X';
+		CHECK(loads(path, bad));
+
+		unlink(path.c_str());
+	}
+
+	time_t summer()
+	{
+		struct tm tm;
+		memset(&tm, 0, sizeof(tm));
+		tm.tm_year = 2014 - 1900;
+		tm.tm_mon = 6;
+		tm.tm_mday = 1;
+		tm.tm_hour = 12;
+		return timegm(&tm);
+	}
+
+	long summerOffset(const TzZone* zone)
+	{
+		TzZone::LocalTimeInfo info;
+		zone->lookup(summer(), info);
+		return info.utcOffset;
+	}
+
+	void testSwap(const std::string& tree, const std::string& packPath)
+	{
+		TzPackRef first(TzPack::load(packPath.c_str()));
+		CHECK(!first.isNull());
+		if (first.isNull())
+			return;
+		TzPack::setCurrent(first);
+		const TzPack* firstPack = first.get();
+
+		TzZoneRef zone(TzZone::load("Europe/Helsinki"));
+		CHECK(!zone.isNull());
+		if (zone.isNull())
+			return;
+		CHECK(zone->pack() == firstPack);
+		CHECK(zone->filePath() == packPath);
+		CHECK_EQUAL(summerOffset(zone.get()), 3 * 3600L);
+
+		// "Etc/" fallback works for packed zones too
+		TzZoneRef gmt(TzZone::load("GMT-3"));
+		CHECK(!gmt.isNull() && gmt->pack() == firstPack);
+
+		// newer pack with different data for same zone replaces file of
+		// first pack while zone still uses it
+		CHECK(copyZone("Europe/London", tree, "Europe/Helsinki"));
+		std::string errorText;
+		CHECK(TzPack::build(tree.c_str(), NULL, packPath.c_str(), errorText));
+		TzPackRef second(TzPack::load(packPath.c_str()));
+		CHECK(!second.isNull());
+		TzPack::setCurrent(second);
+		CHECK(TzPack::current().get() == second.get());
+		first = TzPackRef();
+		second = TzPackRef();
+		gmt = TzZoneRef();
+
+		// zone keeps first pack mapped
+		CHECK(zone->pack() == firstPack);
+		CHECK_EQUAL(summerOffset(zone.get()), 3 * 3600L);
+		struct tm local;
+		CHECK(zone->toLocal(summer(), local));
+		CHECK_EQUAL(local.tm_hour, 15);
+		CHECK(zone->transitionCount() > 0);
+
+		TzZoneRef reloaded(TzZone::load("Europe/Helsinki"));
+		CHECK(!reloaded.isNull());
+		if (!reloaded.isNull()) {
+			CHECK(reloaded->pack() == TzPack::current().get());
+			CHECK_EQUAL(summerOffset(reloaded.get()), 3600L);
+		}
+
+		// last reference unmaps first pack
+		zone = TzZoneRef();
+
+		// without pack zones come from zoneinfo files again
+		TzPack::setCurrent(TzPackRef());
+		CHECK(TzPack::current().isNull());
+		TzFile::setZoneInfoDir(tree);
+		TzZoneRef loose(TzZone::load("Europe/Helsinki"));
+		CHECK(!loose.isNull());
+		if (!loose.isNull()) {
+			CHECK(loose->pack() == NULL);
+			CHECK(loose->filePath() == tree + "/Europe/Helsinki");
+		}
+		TzFile::setZoneInfoDir(zoneInfoDir);
+
+		// packed zone outlives pack it came from and current pack
+		CHECK(!reloaded.isNull() && reloaded->toLocal(summer(), local) && local.tm_hour == 13);
+	}
+
+	// whole system zoneinfo: every TZif file outside posix/ and right/
+	void testSystemZones(const std::string& packPath)
+	{
+		nftw(zoneInfoDir, collect, 16, FTW_PHYS);
+		CHECK(s_systemZones.size() > 300);
+
+		std::string errorText;
+		int64_t begin = Test::nowNs();
+		CHECK(TzPack::build(zoneInfoDir, NULL, packPath.c_str(), errorText));
+		Test::report("zones packed", s_systemZones.size(), Test::nowNs() - begin);
+
+		TzPackRef pack(TzPack::load(packPath.c_str()));
+		CHECK(!pack.isNull());
+		if (pack.isNull())
+			return;
+
+		// symlinked zones are packed under their own names as well
+		CHECK(pack->zoneCount() >= s_systemZones.size());
+		size_t matching = 0;
+		for (size_t i = 0; i < s_systemZones.size(); ++i) {
+			if (findMatches(pack.get(), zoneInfoDir, s_systemZones[i]))
+				++matching;
+		}
+		CHECK_EQUAL(matching, s_systemZones.size());
+
+		begin = Test::nowNs();
+		size_t found = 0;
+		for (size_t i = 0; i < s_systemZones.size(); ++i) {
+			const char* data;
+			size_t size;
+			if (pack->find(s_systemZones[i].c_str(), data, size))
+				++found;
+		}
+		Test::report("find() lookups", s_systemZones.size(), Test::nowNs() - begin);
+		CHECK_EQUAL(found, s_systemZones.size());
+		printf("  %zu zones in %zu KiB pack\n", pack->zoneCount(), pack->mappedSize() / 1024);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	char dirTemplate[] = "/tmp/TestTzPack.XXXXXX";
+	const char* dir = mkdtemp(dirTemplate);
+	CHECK(dir != NULL);
+	if (!dir)
+		return Test::result("TestTzPack");
+	s_dir = dir;
+
+	std::string tree = s_dir + "/zoneinfo";
+	std::string packPath = s_dir + "/tzdata.pack";
+
+	makeTree(tree);
+	testBuild(tree, packPath);
+	testCorrupt(packPath);
+	testSwap(tree, packPath);
+	testSystemZones(packPath);
+
+	nftw(dir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+	return Test::result("TestTzPack");
+}
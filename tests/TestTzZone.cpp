@@ -0,0 +1,203 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTzZone.cpp
+ *
+ *  Checks TzZone conversions against libc (setenv("TZ")/localtime_r()/
+ *  mktime()) reading the same zoneinfo files, and benchmarks convertDate
+ *  path through TzZoneCache against the setenv("TZ") path it replaced.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "TzZone.h"
+#include "TzZoneCache.h"
+#include "TestUtils.h"
+
+namespace {
+
+// zones picked for unusual rules: southern hemisphere DST, half-hour and
+// 45-minute offsets, negative DST, 30-minute DST, fixed offsets
+const char* const testZones[] = {
+	"UTC",
+	"Etc/GMT+5",
+	"Europe/Helsinki",
+	"Europe/Dublin",
+	"Europe/Moscow",
+	"America/New_York",
+	"America/St_Johns",
+	"America/Sao_Paulo",
+	"America/Santiago",
+	"Asia/Kolkata",
+	"Asia/Kathmandu",
+	"Australia/Lord_Howe",
+	"Pacific/Chatham",
+	"Pacific/Apia",
+	"Africa/Casablanca",
+};
+
+const int64_t rangeBegin = -2000000000LL;
+const int64_t rangeEnd = 4102444800LL; // 2100-01-01
+const int64_t step = 86400 * 7 + 3607;
+
+bool representable(int64_t t)
+{
+	return (int64_t) (time_t) t == t;
+}
+
+void checkZone(const char* name)
+{
+	TzZoneRef zone(TzZone::load(name));
+	CHECK(!zone.isNull());
+	if (zone.isNull()) {
+		fprintf(stderr, "  zone %s\n", name);
+		return;
+	}
+
+	setenv("TZ", name, 1);
+	tzset();
+
+	int mismatches = 0;
+	for (int64_t t = rangeBegin; t < rangeEnd && mismatches < 5; t += step) {
+		if (!representable(t))
+			continue;
+
+		time_t utc = (time_t) t;
+		struct tm expected;
+		struct tm actual;
+		if (!localtime_r(&utc, &expected))
+			continue;
+
+		CHECK(zone->toLocal(utc, actual));
+		if (expected.tm_year != actual.tm_year || expected.tm_yday != actual.tm_yday ||
+			expected.tm_hour != actual.tm_hour || expected.tm_min != actual.tm_min ||
+			expected.tm_isdst != actual.tm_isdst || expected.tm_gmtoff != actual.tm_gmtoff ||
+			strcmp(expected.tm_zone, actual.tm_zone) != 0) {
+			fprintf(stderr, "  %s toLocal(%lld): %s %02d:%02d vs %s %02d:%02d\n", name,
+					(long long) t, expected.tm_zone, expected.tm_hour, expected.tm_min,
+					actual.tm_zone, actual.tm_hour, actual.tm_min);
+			Test::fail(__FILE__, __LINE__, "toLocal() matches localtime_r()");
+			++mismatches;
+		}
+
+		// round trip through mktime() with DST flag resolved by zone
+		struct tm local = expected;
+		local.tm_isdst = -1;
+		time_t expectedUtc = mktime(&local);
+
+		local = expected;
+		local.tm_isdst = -1;
+		time_t actualUtc;
+		CHECK(zone->toUtc(local, actualUtc));
+		if (expectedUtc != actualUtc) {
+			fprintf(stderr, "  %s toUtc(%lld): %lld vs %lld\n", name, (long long) t,
+					(long long) expectedUtc, (long long) actualUtc);
+			Test::fail(__FILE__, __LINE__, "toUtc() matches mktime()");
+			++mismatches;
+		}
+	}
+
+	// every reported transition changes local time rules
+	time_t utc = 0;
+	for (int i = 0; i < 100; ++i) {
+		time_t next;
+		if (!zone->nextTransition(utc, next))
+			break;
+		CHECK(next > utc);
+
+		TzZone::LocalTimeInfo before;
+		TzZone::LocalTimeInfo after;
+		zone->lookup(next - 1, before);
+		zone->lookup(next, after);
+		CHECK(before.utcOffset != after.utcOffset || before.isDst != after.isDst ||
+			  strcmp(before.abbr, after.abbr) != 0);
+		utc = next;
+	}
+}
+
+// convertDate: local time in one zone to local time in another
+void benchmarkConversion()
+{
+	const char* const source = "America/New_York";
+	const char* const dest = "Asia/Kolkata";
+	const int count = 20000;
+	const time_t base = 1400000000;
+	char buffer[32];
+
+	struct tm start;
+	gmtime_r(&base, &start);
+
+	// TimePrefsHandler::cbConvertDate() before TzZone
+	int64_t begin = Test::nowNs();
+	long libcSum = 0;
+	for (int i = 0; i < count; ++i) {
+		struct tm local = start;
+		local.tm_min += i * 37;
+		local.tm_isdst = -1;
+
+		setenv("TZ", source, 1);
+		tzset();
+		time_t utc = mktime(&local);
+
+		setenv("TZ", dest, 1);
+		tzset();
+		struct tm result;
+		localtime_r(&utc, &result);
+		asctime_r(&result, buffer);
+		libcSum += result.tm_hour * 60 + result.tm_min;
+	}
+	Test::report("setenv(\"TZ\") conversions", count, Test::nowNs() - begin);
+
+	// TimePrefsHandler::cbConvertDate() now
+	begin = Test::nowNs();
+	long zoneSum = 0;
+	for (int i = 0; i < count; ++i) {
+		struct tm local = start;
+		local.tm_min += i * 37;
+		local.tm_isdst = -1;
+
+		TzZoneRef sourceZone = TzZoneCache::instance()->get(source);
+		TzZoneRef destZone = TzZoneCache::instance()->get(dest);
+		time_t utc;
+		struct tm result;
+		CHECK(sourceZone->toUtc(local, utc) && destZone->toLocal(utc, result));
+		asctime_r(&result, buffer);
+		zoneSum += result.tm_hour * 60 + result.tm_min;
+	}
+	Test::report("TzZone conversions", count, Test::nowNs() - begin);
+
+	// same answers
+	CHECK_EQUAL(zoneSum, libcSum);
+}
+
+} // namespace
+
+int main()
+{
+	for (size_t i = 0; i < sizeof(testZones) / sizeof(testZones[0]); ++i)
+		checkZone(testZones[i]);
+
+	benchmarkConversion();
+
+	return Test::result("TestTzZone");
+}
@@ -0,0 +1,201 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestTzZoneCache.cpp
+ *
+ *  TzZoneCache over a temporary zoneinfo directory with fake clock: LRU
+ *  eviction under memory limit, zones kept alive by references after
+ *  eviction, and re-check of zoneinfo files once check interval passes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#include "FakeTimeClock.h"
+#include "TestUtils.h"
+#include "TzParser.h"
+#include "TzZoneCache.h"
+
+namespace {
+	const char* const systemZoneInfoDir = "/usr/share/zoneinfo/";
+
+	// same as TzZoneCache
+	const int64_t fileCheckIntervalMs = 60 * 1000;
+
+	// 2021-01-07, test zones have different offsets then
+	const time_t winter = 1610000000;
+
+	bool readFile(const std::string& path, std::string& content)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+
+		char buffer[4096];
+		size_t size;
+		content.clear();
+		while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			content.append(buffer, size);
+		fclose(file);
+		return true;
+	}
+
+	// written to temporary file and renamed like tzdata updates do
+	bool installZone(const std::string& dir, const char* name, const char* systemZone)
+	{
+		std::string content;
+		if (!readFile(std::string(systemZoneInfoDir) + systemZone, content))
+			return false;
+
+		std::string path = dir + "/" + name;
+		std::string tmpPath = path + ".tmp";
+		FILE* file = fopen(tmpPath.c_str(), "wb");
+		if (!file)
+			return false;
+		bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+		ok = fclose(file) == 0 && ok;
+		return ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+
+	long offsetOf(const TzZoneRef& zone)
+	{
+		TzZone::LocalTimeInfo info;
+		zone->lookup(winter, info);
+		return info.utcOffset;
+	}
+
+	void testEviction(const std::string& dir)
+	{
+		TzZoneCache* cache = TzZoneCache::instance();
+		cache->setMemoryLimit(16 * 1024 * 1024);
+		cache->clear();
+
+		size_t usageA = cache->get("A")->memoryUsage();
+		size_t usageB = cache->get("B")->memoryUsage();
+		size_t usageC = cache->get("C")->memoryUsage();
+		cache->clear();
+
+		// A and C fit, B on top of them doesn't
+		cache->setMemoryLimit(usageA + usageB + usageC - 1);
+		TzZoneCache::Stats before = cache->stats();
+
+		TzZoneRef b = cache->get("B");
+		TzZoneRef a = cache->get("A");
+		CHECK(cache->get("B").get() == b.get());
+		CHECK(cache->get("A").get() == a.get());	// B is least recently used now
+		cache->get("C");
+
+		TzZoneCache::Stats after = cache->stats();
+		CHECK_EQUAL(after.evictions - before.evictions, 1ul);
+		CHECK_EQUAL(after.misses - before.misses, 3ul);
+		CHECK_EQUAL(after.hits - before.hits, 2ul);
+		CHECK_EQUAL(after.zones, (size_t) 2);
+		CHECK_EQUAL(after.memoryUsage, usageA + usageC);
+		CHECK(after.memoryUsage <= after.memoryLimit);
+
+		// A stayed, B was evicted but is still alive for its holder
+		CHECK(cache->get("A").get() == a.get());
+		CHECK_EQUAL(offsetOf(b), 9 * 3600L);
+		CHECK(cache->get("B").get() != b.get());
+		CHECK_EQUAL(cache->stats().misses - after.misses, 1ul);
+
+		// dropping whole cache doesn't invalidate zones in use
+		cache->clear();
+		CHECK_EQUAL(cache->stats().zones, (size_t) 0);
+		CHECK_EQUAL(offsetOf(a), 2 * 3600L);
+		CHECK_EQUAL(offsetOf(b), 9 * 3600L);
+
+		// most recently used zone stays even above limit
+		cache->setMemoryLimit(1);
+		TzZoneRef c = cache->get("C");
+		CHECK_EQUAL(cache->stats().zones, (size_t) 1);
+		CHECK(cache->get("C").get() == c.get());
+	}
+
+	void testStale(const std::string& dir, FakeTimeClock& clock)
+	{
+		TzZoneCache* cache = TzZoneCache::instance();
+		cache->setMemoryLimit(16 * 1024 * 1024);
+		cache->clear();
+
+		TzZoneRef a = cache->get("A");
+		CHECK_EQUAL(offsetOf(a), 2 * 3600L);
+
+		// unchanged file is re-checked and kept
+		clock.advance(fileCheckIntervalMs);
+		TzZoneCache::Stats before = cache->stats();
+		CHECK(cache->get("A").get() == a.get());
+		CHECK_EQUAL(cache->stats().invalidations, before.invalidations);
+
+		// tzdata update isn't noticed until check interval passes
+		CHECK(installZone(dir, "A", "America/New_York"));
+		clock.advance(fileCheckIntervalMs - 1000);
+		CHECK(cache->get("A").get() == a.get());
+
+		clock.advance(1000);
+		TzZoneRef updated = cache->get("A");
+		CHECK(updated.get() != a.get());
+		CHECK_EQUAL(offsetOf(updated), -5 * 3600L);
+		CHECK_EQUAL(cache->stats().invalidations - before.invalidations, 1ul);
+
+		// old zone is still valid for its holder
+		CHECK_EQUAL(offsetOf(a), 2 * 3600L);
+
+		// removed file invalidates zone too
+		CHECK(unlink((dir + "/A").c_str()) == 0);
+		clock.advance(fileCheckIntervalMs);
+		CHECK(cache->get("A").isNull());
+		CHECK_EQUAL(cache->stats().invalidations - before.invalidations, 2ul);
+		CHECK_EQUAL(offsetOf(updated), -5 * 3600L);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	char dirTemplate[] = "/tmp/TestTzZoneCache.XXXXXX";
+	const char* dir = mkdtemp(dirTemplate);
+	CHECK(dir != NULL);
+	if (!dir)
+		return Test::result("TestTzZoneCache");
+
+	CHECK(installZone(dir, "A", "Europe/Helsinki"));
+	CHECK(installZone(dir, "B", "Asia/Tokyo"));
+	CHECK(installZone(dir, "C", "America/Sao_Paulo"));
+	TzFile::setZoneInfoDir(dir);
+
+	FakeTimeClock clock(winter);
+	TimeClock::setInstance(&clock);
+
+	testEviction(dir);
+	testStale(dir, clock);
+
+	TzZoneCache::instance()->clear();
+	TimeClock::setInstance(NULL);
+
+	const char* const names[] = { "A", "B", "C" };
+	for (size_t i = 0; i < sizeof(names)/sizeof(names[0]); ++i)
+		unlink((std::string(dir) + "/" + names[i]).c_str());
+	rmdir(dir);
+
+	return Test::result("TestTzZoneCache");
+}
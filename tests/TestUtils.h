@@ -0,0 +1,93 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestUtils.h
+ *
+ *  Minimal checks for unit tests (service is built without exceptions,
+ *  so tests are plain programs reporting failures through exit code) and
+ *  timing of benchmarks which tests print along with their checks.
+ */
+
+#ifndef __TESTUTILS_H
+#define __TESTUTILS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace Test {
+
+inline int& failures()
+{
+	static int count = 0;
+	return count;
+}
+
+inline void fail(const char* file, int line, const char* what)
+{
+	fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+	++failures();
+}
+
+/**
+ * Exit code for main(); prints summary
+ */
+inline int result(const char* name)
+{
+	if (failures())
+		fprintf(stderr, "%s: %d check(s) failed\n", name, failures());
+	else
+		printf("%s: passed\n", name);
+	return failures() ? 1 : 0;
+}
+
+/**
+ * Monotonic time for benchmarks (ns)
+ */
+inline int64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Print benchmark result: count operations took ns
+ */
+inline void report(const char* what, unsigned long count, int64_t ns)
+{
+	printf("  %s: %lu in %.1f ms (%.0f/s, %.3f us each)\n", what, count, ns / 1e6,
+	       ns > 0 ? count * 1e9 / ns : 0.0, count ? ns / 1e3 / count : 0.0);
+}
+
+} // namespace Test
+
+#define CHECK(cond) \
+	do { if (!(cond)) Test::fail(__FILE__, __LINE__, #cond); } while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+	do { if (!((actual) == (expected))) Test::fail(__FILE__, __LINE__, #actual " == " #expected); } while (0)
+
+#define CHECK_STREQUAL(actual, expected) \
+	do { if (strcmp((actual), (expected)) != 0) Test::fail(__FILE__, __LINE__, #actual " == " #expected); } while (0)
+
+#endif // __TESTUTILS_H
@@ -0,0 +1,196 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TestZoneTransitionTimer.cpp
+ *
+ *  Zone transition timer driven by fake clocks: normal wake-up, capped
+ *  waits and transition passed while suspended.
+ */
+
+#include <glib.h>
+
+#include "FakeTimeClock.h"
+#include "SignalSlot.h"
+#include "TestUtils.h"
+#include "TimeSnapshot.h"
+#include "ZoneTransitionTimer.h"
+
+extern GMainLoop * g_gmainLoop;
+
+namespace {
+	// Europe/Helsinki goes to summer time at 2021-03-28 01:00 UTC and back
+	// at 2021-10-31 01:00 UTC
+	const time_t springForward = 1616893200;
+	const time_t fallBack = 1635642000;
+
+	const int64_t minuteMs = 60 * 1000;
+	const int64_t hourMs = 60 * minuteMs;
+
+	struct Counter : public Trackable
+	{
+		Counter() : count(0) {}
+		void reached() { ++count; }
+		int count;
+	};
+
+	void checkZone(long utcOffset, bool isDst, time_t validUntil)
+	{
+		TimeSnapshot::Data data;
+		CHECK(TimeSnapshot::instance()->read(data));
+		CHECK(data.haveZone);
+		CHECK_EQUAL(data.zoneUtcOffset, utcOffset);
+		CHECK_EQUAL(data.zoneIsDst, isDst);
+		CHECK_EQUAL(data.zoneValidUntil, validUntil);
+	}
+
+	void testTransition()
+	{
+		FakeTimeClock clock(springForward - 90 * 60);
+		TimeClock::setInstance(&clock);
+
+		Counter counter;
+		ZoneTransitionTimer timer;
+		timer.reached.connect(&counter, &Counter::reached);
+
+		timer.arm("Europe/Helsinki");
+		CHECK_EQUAL(timer.nextTransition(), springForward);
+		checkZone(2 * 3600, false, springForward);
+
+		// 90 minutes away, so first wait is capped
+		CHECK_EQUAL(clock.lastTimeoutMs(), (int64_t) ZoneTransitionTimer::maxWaitMs);
+		CHECK(!clock.lastTimeoutCoalesced());
+
+		clock.advance(hourMs);
+		CHECK_EQUAL(counter.count, 0);
+		CHECK_EQUAL(clock.lastTimeoutMs(), 30 * minuteMs);
+
+		clock.advance(30 * minuteMs - 1);
+		CHECK_EQUAL(counter.count, 0);
+
+		clock.advance(1);
+		CHECK_EQUAL(counter.count, 1);
+		CHECK_EQUAL(timer.nextTransition(), fallBack);
+		checkZone(3 * 3600, true, fallBack);
+
+		// next transition is months away, only capped waits follow
+		clock.advance(24 * hourMs);
+		CHECK_EQUAL(counter.count, 1);
+		CHECK_EQUAL(clock.lastTimeoutMs(), (int64_t) ZoneTransitionTimer::maxWaitMs);
+
+		timer.stop();
+		CHECK_EQUAL(timer.nextTransition(), 0);
+		TimeClock::setInstance(NULL);
+	}
+
+	void testSuspend()
+	{
+		FakeTimeClock clock(springForward - 30 * 60);
+		TimeClock::setInstance(&clock);
+
+		Counter counter;
+		ZoneTransitionTimer timer;
+		timer.reached.connect(&counter, &Counter::reached);
+		timer.arm("Europe/Helsinki");
+		CHECK_EQUAL(clock.lastTimeoutMs(), 30 * minuteMs);
+
+		// monotonic timeout stands still while suspended across transition
+		clock.suspend(2 * hourMs);
+		clock.dispatch();
+		CHECK_EQUAL(counter.count, 0);
+
+		timer.resume();
+		CHECK_EQUAL(counter.count, 1);
+		CHECK_EQUAL(timer.nextTransition(), fallBack);
+		checkZone(3 * 3600, true, fallBack);
+
+		// timeout from before suspend is gone
+		clock.advance(30 * minuteMs);
+		CHECK_EQUAL(counter.count, 1);
+
+		// resume before transition just waits for the rest of it
+		clock.suspend(24 * hourMs);
+		timer.resume();
+		CHECK_EQUAL(counter.count, 1);
+		CHECK_EQUAL(timer.nextTransition(), fallBack);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testNoTransitions()
+	{
+		FakeTimeClock clock(springForward);
+		TimeClock::setInstance(&clock);
+
+		Counter counter;
+		ZoneTransitionTimer timer;
+		timer.reached.connect(&counter, &Counter::reached);
+		timer.arm("UTC");
+		CHECK_EQUAL(timer.nextTransition(), 0);
+		CHECK_EQUAL(clock.lastTimeoutMs(), -1);
+		checkZone(0, false, 0);
+
+		timer.resume();
+		clock.advance(24 * hourMs);
+		CHECK_EQUAL(counter.count, 0);
+
+		TimeClock::setInstance(NULL);
+	}
+
+	void testNoZone()
+	{
+		FakeTimeClock clock(springForward);
+		TimeClock::setInstance(&clock);
+
+		ZoneTransitionTimer timer;
+		long utcOffset;
+		TimeSnapshot::Data data;
+
+		// offset of previous zone is dropped, not kept past zone change
+		const char* const zones[] = { "", "No/Such_Zone" };
+		for (size_t i = 0; i < sizeof(zones)/sizeof(zones[0]); ++i)
+		{
+			timer.arm("Europe/Helsinki");
+			CHECK(TimeSnapshot::instance()->zoneOffset(springForward, utcOffset));
+
+			timer.arm(zones[i]);
+			CHECK_EQUAL(timer.nextTransition(), 0);
+			CHECK(!TimeSnapshot::instance()->zoneOffset(springForward, utcOffset));
+			CHECK(TimeSnapshot::instance()->read(data));
+			CHECK(!data.haveZone);
+			CHECK_EQUAL(data.zoneUtcOffset, 0L);
+		}
+
+		TimeClock::setInstance(NULL);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	g_gmainLoop = g_main_loop_new(NULL, FALSE);
+
+	testTransition();
+	testSuspend();
+	testNoTransitions();
+	testNoZone();
+
+	g_main_loop_unref(g_gmainLoop);
+	return Test::result("TestZoneTransitionTimer");
+}
@@ -0,0 +1,180 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeReplay.cpp
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sstream>
+
+#include "FakeTimeClock.h"
+#include "TimeReplay.h"
+
+TimeReplay::TimeReplay(FakeTimeClock& clock, time_t startUtc) :
+	m_clock(clock),
+	m_startUtc(startUtc),
+	m_startBoot(clock.bootNs())
+{
+}
+
+bool TimeReplay::parse(const std::string& text)
+{
+	std::istringstream lines(text);
+	std::string line;
+	int lineNo = 0;
+	int64_t last = 0;
+	while (std::getline(lines, line))
+	{
+		++lineNo;
+		std::istringstream words(line);
+		std::string at;
+		if (!(words >> at) || at[0] == '#')
+			continue;
+
+		char* end;
+		double seconds = strtod(at.c_str(), &end);
+		Event event;
+		if (*end != '\0' || !(words >> event.name))
+		{
+			fprintf(stderr, "trace line %d: expected \"<seconds> <event>\"\n", lineNo);
+			return false;
+		}
+
+		event.at = (int64_t) (seconds * 1000 + 0.5);
+		if (event.at < last)
+		{
+			fprintf(stderr, "trace line %d: event goes back in time\n", lineNo);
+			return false;
+		}
+		last = event.at;
+
+		std::string arg;
+		while (words >> arg)
+			event.args.push_back(arg);
+		event.line = lineNo;
+		m_events.push_back(event);
+	}
+	return true;
+}
+
+bool TimeReplay::load(const char* path)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "can't open trace %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	std::string text;
+	char buffer[4096];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text.append(buffer, size);
+	fclose(file);
+
+	return parse(text);
+}
+
+bool TimeReplay::run()
+{
+	bool ok = true;
+	for (size_t i = 0; i < m_events.size(); ++i)
+	{
+		const Event& event = m_events[i];
+		int64_t started = cpuTime();
+
+		if (event.at > now())
+			m_clock.advance(event.at - now());
+
+		bool handled;
+		if (event.name == "suspend" && event.args.size() == 1)
+		{
+			int64_t ms = (int64_t) (strtod(event.args[0].c_str(), NULL) * 1000 + 0.5);
+			m_clock.suspend(ms);
+			resumed();
+			handled = true;
+		}
+		else
+		{
+			handled = handle(event);
+		}
+
+		if (!handled)
+		{
+			fprintf(stderr, "trace line %d: can't handle event %s\n", event.line, event.name.c_str());
+			ok = false;
+		}
+
+		Cost& cost = m_costs[event.name];
+		int64_t spent = cpuTime() - started;
+		++cost.count;
+		cost.total += spent;
+		if (spent > cost.max)
+			cost.max = spent;
+	}
+	return ok;
+}
+
+void TimeReplay::transition(const std::string& what)
+{
+	char stamp[32];
+	snprintf(stamp, sizeof(stamp), "%10.3f ", now() / 1000.0);
+	m_transitions.push_back(stamp + what);
+}
+
+int64_t TimeReplay::now() const
+{
+	return (m_clock.bootNs() - m_startBoot) / FakeTimeClock::nsecPerMs;
+}
+
+int64_t TimeReplay::referenceNs() const
+{
+	return (int64_t) m_startUtc * FakeTimeClock::nsecPerSec + m_clock.bootNs() - m_startBoot;
+}
+
+void TimeReplay::report(FILE* out) const
+{
+	fprintf(out, "transitions (%zu):\n", m_transitions.size());
+	for (size_t i = 0; i < m_transitions.size(); ++i)
+		fprintf(out, "  %s\n", m_transitions[i].c_str());
+
+	fprintf(out, "cpu per event:\n");
+	for (std::map<std::string, Cost>::const_iterator it = m_costs.begin(); it != m_costs.end(); ++it)
+	{
+		fprintf(out, "  %-20s %6lu events, avg %8.1f us, max %8.1f us\n",
+		        it->first.c_str(), it->second.count,
+		        it->second.total / 1000.0 / it->second.count,
+		        it->second.max / 1000.0);
+	}
+}
+
+//static
+int64_t TimeReplay::cpuTime()
+{
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return 0;
+	return (int64_t) ts.tv_sec * FakeTimeClock::nsecPerSec + ts.tv_nsec;
+}
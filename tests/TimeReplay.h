@@ -0,0 +1,140 @@
+/****************************************************************
+ * @@@LICENSE
+ *
+ *  Copyright (c) 2014 LG Electronics, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * LICENSE@@@
+ ****************************************************************/
+
+/**
+ *  @file TimeReplay.h
+ */
+
+#ifndef __TIMEREPLAY_H
+#define __TIMEREPLAY_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+class FakeTimeClock;
+
+/**
+ * Replay of time event traces against FakeTimeClock.
+ *
+ * Trace is a text with one event per line:
+ *
+ *     <seconds since start> <event> [arguments...]
+ *
+ * Empty lines and lines starting with '#' are skipped. Clocks are run
+ * (dispatching timeouts) up to time of each event before it is handed to
+ * handle(). Events "suspend <seconds>" are handled here: wall and boot
+ * clocks move while monotonic one and its timeouts stand still, then
+ * resumed() is called.
+ *
+ * Trace time is reference (true) time, so handlers can compare system
+ * time of clock against it. Transitions reported by handlers and CPU time
+ * spent per event (including timeouts dispatched before it) are collected
+ * for report().
+ */
+class TimeReplay
+{
+public:
+	struct Event
+	{
+		int64_t                  at;	// ms since start
+		std::string              name;
+		std::vector<std::string> args;
+		int                      line;
+	};
+
+	/**
+	 * @param clock clock to drive (should be TimeClock instance)
+	 * @param startUtc reference UTC time of trace start
+	 */
+	TimeReplay(FakeTimeClock& clock, time_t startUtc);
+	virtual ~TimeReplay() {}
+
+	bool parse(const std::string& text);
+	bool load(const char* path);
+
+	/**
+	 * Replay parsed events
+	 *
+	 * @return false if some event wasn't handled
+	 */
+	bool run();
+
+	/**
+	 * Note state change of simulated service (stamped with trace time)
+	 */
+	void transition(const std::string& what);
+
+	const std::vector<std::string>& transitions() const { return m_transitions; }
+
+	/**
+	 * Reference UTC time now (ns)
+	 */
+	int64_t referenceNs() const;
+
+	/**
+	 * Trace time now (ms since start), i.e. boot time passed since start
+	 * (moves while timeouts are dispatched too)
+	 */
+	int64_t now() const;
+
+	/**
+	 * Print transitions and CPU time per event
+	 */
+	void report(FILE* out) const;
+
+protected:
+	/**
+	 * Apply event to simulated service
+	 *
+	 * @return false for unknown or malformed event
+	 */
+	virtual bool handle(const Event& event) = 0;
+
+	/**
+	 * Device woke up after suspend event
+	 */
+	virtual void resumed() {}
+
+	FakeTimeClock& m_clock;
+
+private:
+	struct Cost
+	{
+		Cost() : count(0), total(0), max(0) {}
+		unsigned long count;
+		int64_t       total;	// ns
+		int64_t       max;
+	};
+
+	static int64_t cpuTime();
+
+private:
+	time_t                      m_startUtc;
+	int64_t                     m_startBoot;	// ns
+	std::vector<Event>          m_events;
+	std::vector<std::string>    m_transitions;
+	std::map<std::string, Cost> m_costs;
+};
+
+#endif